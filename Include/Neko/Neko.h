@@ -95,6 +95,13 @@ typedef struct HWND__* HWND;
 #    endif
 #endif
 
+#if defined(__cplusplus)
+#    define NK_STATIC_ASSERT(condition, message) static_assert(condition, message)
+#else
+#    define NK_STATIC_ASSERT(condition, message) _Static_assert(condition, message)
+#endif
+
+#include <stddef.h>
 #include <stdint.h>
 
 typedef uint32_t NkFlags;
@@ -117,6 +124,7 @@ typedef struct NkRenderBundleEncoderImpl* NkRenderBundleEncoder;
 typedef struct NkRenderPassEncoderImpl* NkRenderPassEncoder;
 typedef struct NkRenderPipelineImpl* NkRenderPipeline;
 typedef struct NkSamplerImpl* NkSampler;
+typedef struct NkShaderArchiveImpl* NkShaderArchive;
 typedef struct NkShaderModuleImpl* NkShaderModule;
 typedef struct NkSurfaceImpl* NkSurface;
 typedef struct NkSwapChainImpl* NkSwapChain;
@@ -153,9 +161,20 @@ typedef enum NkBindingType {
     NkBindingType_MultisampledTexture = 0x00000006,
     NkBindingType_ReadonlyStorageTexture = 0x00000007,
     NkBindingType_WriteonlyStorageTexture = 0x00000008,
+    NkBindingType_CombinedTextureSampler = 0x00000009,
     NkBindingType_Force32 = 0x7FFFFFFF
 } NkBindingType;
 
+// Bindings of the bindless bind group. Shaders that declare them in the last bind group get the bindless layout
+// in their reflected pipeline layout. That only happens when everything they declare in the group matches these
+// bindings, otherwise the group is reflected like any other.
+typedef enum NkBindlessBinding {
+    NkBindlessBinding_Textures = 0x00000000,       // sampled textures, indexed by nkTextureViewGetBindlessIndex
+    NkBindlessBinding_Samplers = 0x00000001,       // indexed by nkSamplerGetBindlessIndex
+    NkBindlessBinding_StorageBuffers = 0x00000002, // indexed by nkBufferGetBindlessIndex
+    NkBindlessBinding_Force32 = 0x7FFFFFFF
+} NkBindlessBinding;
+
 typedef enum NkBlendFactor {
     NkBlendFactor_Zero = 0x00000000,
     NkBlendFactor_One = 0x00000001,
@@ -301,6 +320,12 @@ typedef enum NkQueryType {
     NkQueryType_Force32 = 0x7FFFFFFF
 } NkQueryType;
 
+typedef enum NkQueueWriteStatus {
+    NkQueueWriteStatus_Success = 0x00000000,
+    NkQueueWriteStatus_Error = 0x00000001,
+    NkQueueWriteStatus_Force32 = 0x7FFFFFFF
+} NkQueueWriteStatus;
+
 typedef enum NkStencilOperation {
     NkStencilOperation_Keep = 0x00000000,
     NkStencilOperation_Zero = 0x00000001,
@@ -400,6 +425,18 @@ typedef enum NkTextureFormat {
     NkTextureFormat_Force32 = 0x7FFFFFFF
 } NkTextureFormat;
 
+// Formats texture data can be written from when it isn't already in the texture's format. See
+// NkTextureDataLayout::sourceFormat.
+typedef enum NkTextureSourceFormat {
+    NkTextureSourceFormat_Undefined = 0x00000000, // the data is in the texture's format
+    NkTextureSourceFormat_RGB8Unorm = 0x00000001,
+    NkTextureSourceFormat_RGBA8Unorm = 0x00000002,
+    NkTextureSourceFormat_BGRA8Unorm = 0x00000003,
+    NkTextureSourceFormat_RGB32Float = 0x00000004,
+    NkTextureSourceFormat_RGBA32Float = 0x00000005,
+    NkTextureSourceFormat_Force32 = 0x7FFFFFFF
+} NkTextureSourceFormat;
+
 typedef enum NkTextureViewDimension {
     NkTextureViewDimension_Undefined = 0x00000000,
     NkTextureViewDimension_1D = 0x00000001,
@@ -457,6 +494,7 @@ typedef enum NkBufferUsage {
     NkBufferUsage_Storage = 0x00000080,
     NkBufferUsage_Indirect = 0x00000100,
     NkBufferUsage_QueryResolve = 0x00000200,
+    NkBufferUsage_DeviceAddress = 0x00000400, // see nkBufferGetDeviceAddress
     NkBufferUsage_Force32 = 0x7FFFFFFF
 } NkBufferUsage;
 typedef NkFlags NkBufferUsageFlags;
@@ -472,6 +510,16 @@ typedef enum NkColorWriteMask {
 } NkColorWriteMask;
 typedef NkFlags NkColorWriteMaskFlags;
 
+typedef enum NkDynamicState {
+    NkDynamicState_None = 0x00000000,
+    NkDynamicState_Rasterization = 0x00000001, // cull mode, front face and primitive topology
+    NkDynamicState_DepthStencil = 0x00000002,  // depth and stencil tests
+    NkDynamicState_ColorBlend = 0x00000004,    // blending and write mask of each color attachment
+    NkDynamicState_DepthClamp = 0x00000008,
+    NkDynamicState_Force32 = 0x7FFFFFFF
+} NkDynamicState;
+typedef NkFlags NkDynamicStateFlags;
+
 typedef enum NkMapMode {
     NkMapMode_Read = 0x00000001,
     NkMapMode_Write = 0x00000002,
@@ -518,6 +566,7 @@ typedef struct NkBindGroupLayoutEntry {
     NkTextureViewDimension viewDimension;
     NkTextureComponentType textureComponentType;
     NkTextureFormat storageTextureFormat;
+    uint32_t arraySize; // number of resources bound as an array, 0 and 1 both mean a single resource
 } NkBindGroupLayoutEntry;
 
 typedef struct NkBlendInfo {
@@ -552,6 +601,24 @@ typedef struct NkColor {
     float a;
 } NkColor;
 
+typedef void (*NkTaskFunction)(void* taskData);
+typedef void (*NkScheduleTaskCallback)(NkTaskFunction task, void* taskData, void* userdata);
+
+typedef struct NkDeviceInfo {
+    NkSurface surface;
+    const void* pipelineCacheData;       // optional blob previously returned by nkDeviceGetPipelineCacheData
+    size_t pipelineCacheSize;            // size of pipelineCacheData in bytes
+    const char* pipelineCachePath;       // optional file the pipeline cache is mapped from, and saved back to by nkDestroyDevice
+    uint32_t workerThreadCount;          // threads in Neko's internal worker pool, 0 picks one per spare core
+    NkScheduleTaskCallback scheduleTask; // optional user thread pool that background work is handed to instead
+    void* scheduleTaskUserdata;
+    uint32_t pipelineBatchSize;          // pipelines per thread in nkCreateRenderPipelines, 0 compiles a batch on the calling thread
+    NkBool extendedDynamicState;         // opt in to setting the state nkDeviceGetDynamicState reports from render pass encoders
+    NkBool shaderModuleIdentifiers;      // where supported, pipelines already in the pipeline cache never compile their shader modules
+    uint32_t framesInFlight;             // frames the GPU may still be working on when nkDeviceTick is called, 0 means 2
+    NkBool bindless;                     // where supported, global descriptor tables shaders index into, see nkDeviceGetBindlessBindGroup
+} NkDeviceInfo;
+
 typedef struct NkExtent3D {
     uint32_t width;
     uint32_t height;
@@ -573,9 +640,22 @@ typedef struct NkPipelineLayoutInfo {
     const NkBindGroupLayout* bindGroupLayouts;
 } NkPipelineLayoutInfo;
 
+// Overrides the default of a specialization constant, matched to the shader's constant_id. Booleans are passed as
+// a 0 or 1 in u32. Branches and loops that depend on a constant are folded away when the pipeline is compiled.
+typedef struct NkSpecializationConstant {
+    uint32_t constantId;
+    union {
+        uint32_t u32;
+        int32_t i32;
+        float f32;
+    } value;
+} NkSpecializationConstant;
+
 typedef struct NkProgrammableStageInfo {
     NkShaderModule module;
     const char* entryPoint;
+    uint32_t constantCount;
+    const NkSpecializationConstant* constants;
 } NkProgrammableStageInfo;
 
 typedef struct NkQuerySetInfo {
@@ -658,8 +738,30 @@ typedef struct NkTextureDataLayout {
     uint64_t offset;
     uint32_t bytesPerRow;
     uint32_t rowsPerImage;
+    // nkQueueWriteTexture only, fills every level below the written one from it. Formats that can't be blitted,
+    // compressed ones included, leave the levels alone.
+    NkBool generateMipmaps;
+    // nkQueueWriteTexture only, converts the data while it's staged. Textures in the RGBA8 and BGRA8 formats,
+    // sRGB or not, RGB10A2Unorm, RGBA16Float and RGBA32Float can be written from any source format. Float data
+    // written to an sRGB texture is encoded, 8-bit data is taken to be encoded already. Textures in the BC1, BC3,
+    // BC7 and unsigned BC4 and BC5 formats are compressed from it on the device's tasks.
+    NkTextureSourceFormat sourceFormat;
 } NkTextureDataLayout;
 
+// Called once the texture's levels from baseMipLevel down have been copied. Streamed textures report each level
+// from nkDeviceTick, otherwise it runs once for the whole chain before nkQueueLoadTexture returns.
+typedef void (*NkTextureLevelsResidentCallback)(NkTexture texture, uint32_t baseMipLevel, void* userdata);
+
+typedef struct NkTextureFileInfo {
+    NkTextureUsageFlags usage; // CopyDst is added for the upload
+    // Streams the levels in from the smallest up. Each is submitted on its own and nkQueueLoadTexture returns
+    // without waiting for any of them, so the texture can be drawn with its small levels while the large ones are
+    // still being copied. The texture has to outlive the callbacks.
+    NkBool smallestMipFirst;
+    NkTextureLevelsResidentCallback levelsResident; // optional
+    void* userdata;
+} NkTextureFileInfo;
+
 typedef struct NkTextureViewInfo {
     NkTextureFormat format;
     NkTextureViewDimension dimension;
@@ -680,11 +782,13 @@ typedef struct NkBindGroupInfo {
     NkBindGroupLayout layout;
     uint32_t entryCount;
     const NkBindGroupEntry* entries;
+    NkBool transient; // lives for this frame and NkDeviceInfo.framesInFlight more, and is never destroyed
 } NkBindGroupInfo;
 
 typedef struct NkBindGroupLayoutInfo {
     uint32_t entryCount;
     const NkBindGroupLayoutEntry* entries;
+    NkBool perDraw; // bound with nkRenderPassEncoderPushBindGroup rather than made into bind groups
 } NkBindGroupLayoutInfo;
 
 typedef struct NkBufferCopyView {
@@ -694,6 +798,7 @@ typedef struct NkBufferCopyView {
 
 typedef struct NkColorStateInfo {
     NkTextureFormat format;
+    NkBool blendEnabled; // alphaBlend and colorBlend are used as given when set, and ignored otherwise
     NkBlendInfo alphaBlend;
     NkBlendInfo colorBlend;
     NkColorWriteMaskFlags writeMask;
@@ -758,6 +863,7 @@ typedef struct NkVertexStateInfo {
 
 typedef struct NkRenderPipelineInfo {
     NkPipelineLayout layout;
+    uint32_t perDrawBindGroups; // without a layout, bit i makes reflected group i perDraw, see NkBindGroupLayoutInfo
     NkProgrammableStageInfo vertexStage;
     NkProgrammableStageInfo fragmentStage;
     const NkVertexStateInfo* vertexState;
@@ -778,12 +884,31 @@ extern "C" {
 typedef void (*NkDeviceLostCallback)(const char* message, void* userdata);
 typedef void (*NkErrorCallback)(NkErrorType type, const char* message, void* userdata);
 typedef void (*NkFenceOnCompletionCallback)(NkFenceCompletionStatus status, void* userdata);
+typedef void (*NkCreateRenderPipelineAsyncCallback)(NkCreateReadyPipelineStatus status, NkRenderPipeline pipeline, const char* message, void* userdata);
+typedef void (*NkCreateComputePipelineAsyncCallback)(NkCreateReadyPipelineStatus status, NkComputePipeline pipeline, const char* message, void* userdata);
+typedef void (*NkQueueWriteBufferFromFileCallback)(NkQueueWriteStatus status, void* userdata);
 
 NK_EXPORT NkInstance nkCreateInstance();
 
+// Shader archives are written by the ShaderPacker tool. The archive is mapped rather than read, so opening it
+// costs nothing up front and only the shaders that get used are paged in. Returns NK_NULL if the file is missing
+// or isn't a shader archive.
+NK_EXPORT NkShaderArchive nkOpenShaderArchive(const char* path);
+
+// Methods of BindGroup
+NK_EXPORT void nkDestroyBindGroup(NkBindGroup bindGroup);
+
+// Methods of BindGroupLayout
+NK_EXPORT void nkDestroyBindGroupLayout(NkBindGroupLayout bindGroupLayout);
+
 // Methods of Buffer
 NK_EXPORT void nkDestroyBuffer(NkBuffer buffer);
+// The buffer's slot in NkBindlessBinding_StorageBuffers, for buffers with NkBufferUsage_Storage.
+NK_EXPORT uint32_t nkBufferGetBindlessIndex(NkBuffer buffer);
 NK_EXPORT const void* nkBufferGetConstMappedRange(NkBuffer buffer, size_t offset, size_t size);
+// The buffer's GPU address, for buffers with NkBufferUsage_DeviceAddress. Shaders can follow it as a raw pointer,
+// usually handed to them through push constants, without the buffer being in any bind group.
+NK_EXPORT uint64_t nkBufferGetDeviceAddress(NkBuffer buffer);
 NK_EXPORT void* nkBufferGetMappedRange(NkBuffer buffer, size_t offset, size_t size);
 NK_EXPORT NkBufferMapAsyncStatus nkBufferMap(NkBuffer buffer, NkMapModeFlags mode, size_t offset, size_t size);
 NK_EXPORT void nkBufferUnmap(NkBuffer buffer);
@@ -796,6 +921,10 @@ NK_EXPORT void nkCommandEncoderCopyBufferToTexture(NkCommandEncoder commandEncod
 NK_EXPORT void nkCommandEncoderCopyTextureToBuffer(NkCommandEncoder commandEncoder, const NkTextureCopyView* source, const NkBufferCopyView* destination, const NkExtent3D* copySize);
 NK_EXPORT void nkCommandEncoderCopyTextureToTexture(NkCommandEncoder commandEncoder, const NkTextureCopyView* source, const NkTextureCopyView* destination, const NkExtent3D* copySize);
 NK_EXPORT NkCommandBuffer nkCommandEncoderFinish(NkCommandEncoder commandEncoder);
+// Fills levels baseMipLevel + 1 up to baseMipLevel + levelCount - 1 by repeatedly downsampling baseMipLevel, or
+// every level below it when levelCount is 0. The texture needs both NkTextureUsage_CopySrc and CopyDst, and a
+// format that can be blitted; compressed formats can't be. Base levels written by a render pass work too.
+NK_EXPORT void nkCommandEncoderGenerateMipmaps(NkCommandEncoder commandEncoder, NkTexture texture, uint32_t baseMipLevel, uint32_t levelCount);
 NK_EXPORT void nkCommandEncoderInsertDebugMarker(NkCommandEncoder commandEncoder, const char* markerLabel);
 NK_EXPORT void nkCommandEncoderPopDebugGroup(NkCommandEncoder commandEncoder);
 NK_EXPORT void nkCommandEncoderPushDebugGroup(NkCommandEncoder commandEncoder, const char* groupLabel);
@@ -816,10 +945,14 @@ NK_EXPORT void nkComputePassEncoderSetPipeline(NkComputePassEncoder computePassE
 NK_EXPORT void nkComputePassEncoderWriteTimestamp(NkComputePassEncoder computePassEncoder, NkQuerySet querySet, uint32_t queryIndex);
 
 // Methods of ComputePipeline
+NK_EXPORT void nkDestroyComputePipeline(NkComputePipeline computePipeline);
 NK_EXPORT NkBindGroupLayout nkComputePipelineGetBindGroupLayout(NkComputePipeline computePipeline, uint32_t groupIndex);
 
 // Methods of Device
 NK_EXPORT void nkDestroyDevice(NkDevice device);
+// Bind groups are deduplicated like layouts: identical descriptors share one object and each creation needs its
+// own nkDestroyBindGroup. Transient bind groups skip that, they come from per-frame pools that nkDeviceTick recycles.
+// Returns NK_NULL when the entries don't give every binding of the layout, or give one it doesn't have.
 NK_EXPORT NkBindGroup nkCreateBindGroup(NkDevice device, const NkBindGroupInfo* descriptor);
 NK_EXPORT NkBindGroupLayout nkCreateBindGroupLayout(NkDevice device, const NkBindGroupLayoutInfo* descriptor);
 NK_EXPORT NkBuffer nkCreateBuffer(NkDevice device, const NkBufferInfo* descriptor);
@@ -829,15 +962,38 @@ NK_EXPORT NkPipelineLayout nkCreatePipelineLayout(NkDevice device, const NkPipel
 NK_EXPORT NkQuerySet nkCreateQuerySet(NkDevice device, const NkQuerySetInfo* descriptor);
 NK_EXPORT NkRenderBundleEncoder nkCreateRenderBundleEncoder(NkDevice device, const NkRenderBundleEncoderInfo* descriptor);
 NK_EXPORT NkRenderPipeline nkCreateRenderPipeline(NkDevice device, const NkRenderPipelineInfo* descriptor);
+NK_EXPORT void nkCreateRenderPipelines(NkDevice device, uint32_t count, const NkRenderPipelineInfo* descriptors, NkRenderPipeline* pipelines);
 NK_EXPORT NkSampler nkCreateSampler(NkDevice device, const NkSamplerInfo* descriptor);
 NK_EXPORT NkSwapChain nkCreateSwapChain(NkDevice device, NkSurface surface, const NkSwapChainInfo* descriptor);
 NK_EXPORT NkTexture nkCreateTexture(NkDevice device, const NkTextureInfo* descriptor);
+
+// Pipelines are compiled on a worker thread. The callback runs from nkDeviceTick on the thread that calls it,
+// which lets the renderer keep drawing with a fallback until the pipeline is ready. Shader modules referenced
+// by the descriptor must stay alive until the callback has run.
+NK_EXPORT void nkDeviceCreateRenderPipelineAsync(NkDevice device, const NkRenderPipelineInfo* descriptor, NkCreateRenderPipelineAsyncCallback callback, void* userdata);
+NK_EXPORT void nkDeviceCreateComputePipelineAsync(NkDevice device, const NkComputePipelineInfo* descriptor, NkCreateComputePipelineAsyncCallback callback, void* userdata);
+// Devices created with NkDeviceInfo.bindless hold one bind group of large texture, sampler and storage buffer
+// arrays, laid out as NkBindlessBinding. It's owned by the device and can stay bound while objects are added to
+// it. Setting a pipeline whose layout has the bindless layout as its last bind group binds it there as well, and
+// it can be set like any other bind group. Both return NK_NULL when the device doesn't support bindless tables,
+// and the layout is a new reference.
+NK_EXPORT NkBindGroup nkDeviceGetBindlessBindGroup(NkDevice device);
+NK_EXPORT NkBindGroupLayout nkDeviceGetBindlessBindGroupLayout(NkDevice device);
+// Whether buffers can be created with NkBufferUsage_DeviceAddress. nkCreateBuffer refuses the flag otherwise.
+NK_EXPORT NkBool nkDeviceGetBufferDeviceAddressSupport(NkDevice device);
 NK_EXPORT NkQueue nkDeviceGetDefaultQueue(NkDevice device);
+NK_EXPORT NkDynamicStateFlags nkDeviceGetDynamicState(NkDevice device);
+// Call once per frame. Runs finished pipeline callbacks, and recycles the transient bind groups of the frame
+// NkDeviceInfo.framesInFlight frames back, which the GPU must be done with by then.
+NK_EXPORT void nkDeviceTick(NkDevice device);
+NK_EXPORT NkBool nkDeviceGetPipelineCacheData(NkDevice device, size_t* dataSize, void* data);
 NK_EXPORT NkBool nkDevicePopErrorScope(NkDevice device, NkErrorCallback callback, void* userdata);
 NK_EXPORT void nkDevicePushErrorScope(NkDevice device, NkErrorFilter filter);
 NK_EXPORT void nkDeviceSetDeviceLostCallback(NkDevice device, NkDeviceLostCallback callback, void* userdata);
 NK_EXPORT void nkDeviceSetUncapturedErrorCallback(NkDevice device, NkErrorCallback callback, void* userdata);
 
+// Shader modules are deduplicated by their code. Creating a module that already exists hands back the same
+// object with one more reference, and every nkCreateShaderModule needs its own nkDestroyShaderModule.
 NK_EXPORT NkShaderModule nkCreateShaderModule(NkDevice device, const NkShaderModuleInfo* descriptor);
 NK_EXPORT void nkDestroyShaderModule(NkShaderModule shaderModule);
 
@@ -849,7 +1005,10 @@ NK_EXPORT void nkFenceOnCompletion(NkFence fence, uint64_t value, NkFenceOnCompl
 // Methods of Instance
 NK_EXPORT void nkDestroyInstance(NkInstance instance);
 NK_EXPORT NkSurface nkCreateSurface(NkInstance instance, const NkSurfaceInfo* descriptor);
-NK_EXPORT NkDevice nkCreateDevice(NkInstance instance, NkSurface surface);
+NK_EXPORT NkDevice nkCreateDevice(NkInstance instance, const NkDeviceInfo* descriptor);
+
+// Methods of PipelineLayout
+NK_EXPORT void nkDestroyPipelineLayout(NkPipelineLayout pipelineLayout);
 
 // Methods of QuerySet
 NK_EXPORT void nkDestroyQuerySet(NkQuerySet querySet);
@@ -857,9 +1016,19 @@ NK_EXPORT void nkDestroyQuerySet(NkQuerySet querySet);
 // Methods of Queue
 NK_EXPORT void nkDestroyQueue(NkQueue queue);
 NK_EXPORT NkFence nkCreateFence(NkQueue queue, const NkFenceInfo* descriptor);
+// Loads a KTX2 or DDS file into a new texture. The file is mapped and its levels and layers are copied straight
+// into staging memory, then uploaded with one copy unless NkTextureFileInfo::smallestMipFirst streams it. Returns
+// NK_NULL if the file is missing, supercompressed, or in a format Neko doesn't have.
+NK_EXPORT NkTexture nkQueueLoadTexture(NkQueue queue, const char* path, const NkTextureFileInfo* descriptor);
 NK_EXPORT void nkQueueSignal(NkQueue queue, NkFence fence, uint64_t signalValue);
 NK_EXPORT void nkQueueSubmit(NkQueue queue, uint32_t commandCount, const NkCommandBuffer* commands);
 NK_EXPORT void nkQueueWriteBuffer(NkQueue queue, NkBuffer buffer, uint64_t bufferOffset, const void* data, size_t size);
+
+// Reads size bytes at fileOffset from fd into the buffer without blocking the caller. The read goes through
+// io_uring where Linux has it and the device's tasks elsewhere, landing in staging memory that a copy on the queue
+// then moves into the buffer, or directly in buffers that are mapped. callback runs on a background thread once
+// the data is in the buffer, or the read failed, and fd has to stay open until then.
+NK_EXPORT void nkQueueWriteBufferFromFile(NkQueue queue, NkBuffer buffer, uint64_t bufferOffset, int fd, uint64_t fileOffset, size_t size, NkQueueWriteBufferFromFileCallback callback, void* userdata);
 NK_EXPORT void nkQueueWriteTexture(NkQueue queue, const NkTextureCopyView* destination, const void* data, size_t dataSize, const NkTextureDataLayout* dataLayout, const NkExtent3D* writeSize);
 
 // Methods of RenderBundleEncoder
@@ -890,6 +1059,10 @@ NK_EXPORT void nkRenderPassEncoderExecuteBundles(NkRenderPassEncoder renderPassE
 NK_EXPORT void nkRenderPassEncoderInsertDebugMarker(NkRenderPassEncoder renderPassEncoder, const char* markerLabel);
 NK_EXPORT void nkRenderPassEncoderPopDebugGroup(NkRenderPassEncoder renderPassEncoder);
 NK_EXPORT void nkRenderPassEncoderPushDebugGroup(NkRenderPassEncoder renderPassEncoder, const char* groupLabel);
+// Binds the entries to a per-draw bind group layout of the current pipeline without making a bind group. They're
+// written into the command buffer with push descriptors where the device has them, and into a transient bind
+// group otherwise. The entries are copied, so they only have to live for the call.
+NK_EXPORT void nkRenderPassEncoderPushBindGroup(NkRenderPassEncoder renderPassEncoder, uint32_t groupIndex, uint32_t entryCount, const NkBindGroupEntry* entries);
 NK_EXPORT void nkRenderPassEncoderSetBindGroup(NkRenderPassEncoder renderPassEncoder, uint32_t groupIndex, NkBindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets);
 NK_EXPORT void nkRenderPassEncoderSetBlendColor(NkRenderPassEncoder renderPassEncoder, const NkColor* color);
 NK_EXPORT void nkRenderPassEncoderSetIndexBuffer(NkRenderPassEncoder renderPassEncoder, NkBuffer buffer, uint64_t offset, uint64_t size);
@@ -900,10 +1073,33 @@ NK_EXPORT void nkRenderPassEncoderSetVertexBuffer(NkRenderPassEncoder renderPass
 NK_EXPORT void nkRenderPassEncoderSetViewport(NkRenderPassEncoder renderPassEncoder, float x, float y, float width, float height, float minDepth, float maxDepth);
 NK_EXPORT void nkRenderPassEncoderWriteTimestamp(NkRenderPassEncoder renderPassEncoder, NkQuerySet querySet, uint32_t queryIndex);
 
+// Dynamic state, for devices created with NkDeviceInfo.extendedDynamicState. A command may only be used when
+// nkDeviceGetDynamicState reports its state. Pipelines that differ only there share one compile, but setting a
+// pipeline still applies the state its descriptor asked for, and these commands override it until the next
+// nkRenderPassEncoderSetPipeline. The topology can only change within the kind (points, lines or triangles) of
+// the bound pipeline's.
+NK_EXPORT void nkRenderPassEncoderSetColorState(NkRenderPassEncoder renderPassEncoder, uint32_t attachment, const NkColorStateInfo* colorState);
+NK_EXPORT void nkRenderPassEncoderSetCullMode(NkRenderPassEncoder renderPassEncoder, NkCullMode cullMode);
+NK_EXPORT void nkRenderPassEncoderSetDepthClamp(NkRenderPassEncoder renderPassEncoder, NkBool enabled);
+NK_EXPORT void nkRenderPassEncoderSetDepthTest(NkRenderPassEncoder renderPassEncoder, NkBool enabled, NkBool writeEnabled, NkCompareFunction compare);
+NK_EXPORT void nkRenderPassEncoderSetFrontFace(NkRenderPassEncoder renderPassEncoder, NkFrontFace frontFace);
+NK_EXPORT void nkRenderPassEncoderSetPrimitiveTopology(NkRenderPassEncoder renderPassEncoder, NkPrimitiveTopology topology);
+NK_EXPORT void nkRenderPassEncoderSetStencilTest(NkRenderPassEncoder renderPassEncoder, NkBool enabled, const NkStencilStateFaceInfo* front, const NkStencilStateFaceInfo* back);
+
 // Methods of RenderPipeline
 NK_EXPORT void nkDestroyRenderPipeline(NkRenderPipeline renderPipeline);
 NK_EXPORT NkBindGroupLayout nkRenderPipelineGetBindGroupLayout(NkRenderPipeline renderPipeline, uint32_t groupIndex);
 
+// Methods of Sampler
+NK_EXPORT void nkDestroySampler(NkSampler sampler);
+NK_EXPORT uint32_t nkSamplerGetBindlessIndex(NkSampler sampler);
+
+// Methods of ShaderArchive
+NK_EXPORT void nkCloseShaderArchive(NkShaderArchive shaderArchive);
+// Fills in the code of the named shader, ready for nkCreateShaderModule. Uncompressed shaders point straight into
+// the mapping. Either way the code stays valid until the archive is closed. Returns NkFalse for unknown names.
+NK_EXPORT NkBool nkShaderArchiveGetModuleInfo(NkShaderArchive shaderArchive, const char* name, NkShaderModuleInfo* info);
+
 // Methods of Surface
 NK_EXPORT void nkDestroySurface(NkSurface surface);
 
@@ -916,6 +1112,12 @@ NK_EXPORT void nkSwapChainPresent(NkSwapChain swapChain);
 NK_EXPORT void nkDestroyTexture(NkTexture texture);
 NK_EXPORT NkTextureView nkCreateTextureView(NkTexture texture, const NkTextureViewInfo* descriptor);
 
+// Methods of TextureView
+NK_EXPORT void nkDestroyTextureView(NkTextureView textureView);
+// The view's slot in NkBindlessBinding_Textures. It's given out on first use and stays the same until the view
+// is destroyed, when it may be handed to another view.
+NK_EXPORT uint32_t nkTextureViewGetBindlessIndex(NkTextureView textureView);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -958,6 +1160,7 @@ NK_EXPORT NkTextureView nkCreateTextureView(NkTexture texture, const NkTextureVi
 #include <stdlib.h>
 #define NK_MALLOC(size) malloc(size)
 #define NK_CALLOC(num, size) calloc(num, size)
+#define NK_REALLOC(pointer, size) realloc(pointer, size)
 #define NK_FREE(pointer) free(pointer)
 #endif
 
@@ -979,6 +1182,186 @@ NK_EXPORT NkTextureView nkCreateTextureView(NkTexture texture, const NkTextureVi
 #define NK_MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define NK_MIN(x, y) (((x) < (y)) ? (x) : (y))
 
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// File reads into queue writes go through io_uring on Linux, which NK_NO_IO_URING turns off in favour of reads on
+// the device's tasks. It's also off when the C library hides syscall, as strict ISO modes do.
+#if defined(__linux__) && defined(_DEFAULT_SOURCE) && !defined(NK_NO_IO_URING)
+#define NK_IO_URING (1)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+// SIMD paths are picked from what the compiler targets, and everything that has one has a scalar fallback.
+// Define NK_NO_SIMD to always take the fallbacks.
+#ifndef NK_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NK_SSE2 (1)
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+#define NK_SSSE3 (1)
+#endif
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER))
+#define NK_AVX2 (1)
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define NK_NEON (1)
+#endif
+#endif
+
+#if defined(NK_SSE2)
+#include <immintrin.h>
+#endif
+#if defined(NK_NEON)
+#include <arm_neon.h>
+#endif
+
+// Read-only file mappings. Large blobs like pipeline caches are mapped rather than read into the heap,
+// so only the pages that are actually touched get paged in, and the OS can drop them again under pressure.
+
+typedef struct NkMappedFile {
+    void* data;
+    size_t size;
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} NkMappedFile;
+
+static NkBool nkMapFile(const char* path, NkMappedFile* mappedFile) {
+
+    NK_ASSERT(path);
+    NK_ASSERT(mappedFile);
+
+    mappedFile->data = NK_NULL;
+    mappedFile->size = 0;
+
+#if defined(_WIN32)
+    mappedFile->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NK_NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NK_NULL);
+    mappedFile->mapping = NK_NULL;
+    if (mappedFile->file == INVALID_HANDLE_VALUE) {
+        return NkFalse;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mappedFile->file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(mappedFile->file);
+        return NkFalse;
+    }
+
+    mappedFile->mapping = CreateFileMappingA(mappedFile->file, NK_NULL, PAGE_READONLY, 0, 0, NK_NULL);
+    if (mappedFile->mapping == NK_NULL) {
+        CloseHandle(mappedFile->file);
+        return NkFalse;
+    }
+
+    mappedFile->data = MapViewOfFile(mappedFile->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mappedFile->data == NK_NULL) {
+        CloseHandle(mappedFile->mapping);
+        CloseHandle(mappedFile->file);
+        return NkFalse;
+    }
+    mappedFile->size = NK_CAST(size_t, fileSize.QuadPart);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NkFalse;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return NkFalse;
+    }
+
+    void* data = mmap(NK_NULL, NK_CAST(size_t, fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+
+    if (data == MAP_FAILED) {
+        return NkFalse;
+    }
+    mappedFile->data = data;
+    mappedFile->size = NK_CAST(size_t, fileStat.st_size);
+#endif
+
+    return NkTrue;
+}
+
+static void nkUnmapFile(NkMappedFile* mappedFile) {
+
+    NK_ASSERT(mappedFile);
+
+    if (mappedFile->data == NK_NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(mappedFile->data);
+    CloseHandle(mappedFile->mapping);
+    CloseHandle(mappedFile->file);
+#else
+    munmap(mappedFile->data, mappedFile->size);
+#endif
+
+    mappedFile->data = NK_NULL;
+    mappedFile->size = 0;
+}
+
+// Writes to a temporary file next to path and renames it over path once it's complete, so a crash part way
+// through leaves the old file rather than a truncated one.
+static NkBool nkWriteFile(const char* path, const void* data, size_t size) {
+
+    NK_ASSERT(path);
+    NK_ASSERT(data || size == 0);
+
+    static const char suffix[] = ".tmp";
+    const size_t pathLength = strlen(path);
+    char* temporaryPath = NK_PTR_CAST(char*, NK_MALLOC(pathLength + sizeof(suffix)));
+    NK_ASSERT(temporaryPath);
+    memcpy(temporaryPath, path, pathLength);
+    memcpy(temporaryPath + pathLength, suffix, sizeof(suffix));
+
+    FILE* file = fopen(temporaryPath, "wb");
+    if (file == NK_NULL) {
+        NK_FREE(temporaryPath);
+        return NkFalse;
+    }
+
+    const size_t written = fwrite(data, 1, size, file);
+    const int closed = fclose(file);
+
+    NkBool result = (written == size && closed == 0) ? NkTrue : NkFalse;
+    if (result) {
+#if defined(_WIN32)
+        result = MoveFileExA(temporaryPath, path, MOVEFILE_REPLACE_EXISTING) ? NkTrue : NkFalse;
+#else
+        result = rename(temporaryPath, path) == 0 ? NkTrue : NkFalse;
+#endif
+    }
+    if (!result) {
+        remove(temporaryPath);
+    }
+
+    NK_FREE(temporaryPath);
+    return result;
+}
+
 // Initial allocator is super simple linear allocator.
 // In the future it should be backed by a pool of memory blocks to let the allocator expand.
 
@@ -1087,699 +1470,5123 @@ void* nkCommandAllocatorAllocate(NkCommandAllocator* const allocator, uint32_t s
     return nkAllocateFromBuffer(allocator->buffer, allocator->bufferSize, &allocator->allocatedSize, size, alignment, NK_NULL);
 }
 
-struct NkCommandEncoderImpl {
-    NkCommandAllocator allocator;
-};
+#if defined(_WIN32)
+#define NK_ATOMIC_INCREMENT64(pointer) InterlockedIncrement64(pointer)
+typedef volatile LONG64 NkAtomic64;
+#else
+#define NK_ATOMIC_INCREMENT64(pointer) __atomic_add_fetch(pointer, 1, __ATOMIC_SEQ_CST)
+typedef volatile int64_t NkAtomic64;
+#endif
 
-struct NkRenderPassEncoderImpl {
-    NkCommandAllocator* allocator;
-};
+// Every backend object that can be part of a cache key gets a unique id. Hashing ids rather than handles means
+// a new object that happens to be allocated at the address of a destroyed one can never produce a stale cache hit.
+static NkAtomic64 NkObjectIdCounter = 0;
 
-struct NkComputePassEncoderImpl {
-    NkCommandAllocator* allocator;
-};
+static uint64_t nkNextObjectId() {
+    return NK_CAST(uint64_t, NK_ATOMIC_INCREMENT64(&NkObjectIdCounter));
+}
 
-#define NK_COMMAND_ALLOCATOR_SIZE 16384 // this is a hack that will be removed when the command allocator is smarter
+// 64-bit hashing, in the style of MurmurHash3's 64-bit mixing functions. Descriptors are hashed field by field
+// instead of as raw memory, so padding bytes and the addresses of nested arrays never leak into the hash.
 
-NkCommandEncoder nkCreateCommandEncoder(NkDevice device) {
+typedef struct NkHasher {
+    uint64_t state;
+    uint64_t length;
+} NkHasher;
 
-    NkCommandEncoder commandEncoder = NK_PTR_CAST(NkCommandEncoder, NK_MALLOC(sizeof(struct NkCommandEncoderImpl)));
-    NK_ASSERT(commandEncoder);
-    commandEncoder->allocator = nkCreateCommandAllocator(NK_COMMAND_ALLOCATOR_SIZE);
-    return commandEncoder;
-}
+#define NK_HASH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
 
-typedef enum NkCommandType {
-    NkCommandType_BeginComputePass,
-    NkCommandType_BeginRenderPass,
-    NkCommandType_RenderPassEncoderSetPipeline,
-    NkCommandType_RenderPassEncoderSetVertexBuffer,
-    NkCommandType_RenderPassEncoderDraw
-} NkCommandType;
+static NkHasher nkCreateHasher() {
 
-typedef struct NkBeginComputePassCommand {
-    NkCommandType type;
-} NkBeginComputePassCommand;
+    NkHasher hasher;
+    {
+        hasher.state = 0x9E3779B97F4A7C15ull;
+        hasher.length = 0;
+    }
+    return hasher;
+}
 
-// Methods of CommandEncoder
-NkComputePassEncoder nkCommandEncoderBeginComputePass(NkCommandEncoder commandEncoder) {
+static void nkHashU64(NkHasher* hasher, uint64_t value) {
 
-    NK_ASSERT(commandEncoder);
+    NK_ASSERT(hasher);
 
-    NkBeginComputePassCommand* command = NK_PTR_CAST(NkBeginComputePassCommand*, nkCommandAllocatorAllocate(&commandEncoder->allocator, sizeof(NkBeginComputePassCommand), NK_ALIGN_OF(NkBeginComputePassCommand)));
-    NK_ASSERT(command);
+    value *= 0x87C37B91114253D5ull;
+    value = NK_HASH_ROTL64(value, 31);
+    value *= 0x4CF5AD432745937Full;
 
-    command->type = NkCommandType_BeginComputePass;
+    hasher->state ^= value;
+    hasher->state = NK_HASH_ROTL64(hasher->state, 27) * 5 + 0x52DCE729;
+    hasher->length += sizeof(uint64_t);
+}
 
-    NkComputePassEncoder passEncoder = NK_PTR_CAST(NkComputePassEncoder, NK_MALLOC(sizeof(struct NkComputePassEncoderImpl)));
-    NK_ASSERT(passEncoder);
+static void nkHashU32(NkHasher* hasher, uint32_t value) {
+    nkHashU64(hasher, value);
+}
 
-    passEncoder->allocator = &commandEncoder->allocator;
+static void nkHashFloat(NkHasher* hasher, float value) {
 
-    return passEncoder;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    nkHashU64(hasher, bits);
 }
 
-typedef struct NkBeginRenderPassCommand {
-    NkCommandType type;
-} NkBeginRenderPassCommand;
+static void nkHashBytes(NkHasher* hasher, const void* data, size_t size) {
 
-NkRenderPassEncoder nkCommandEncoderBeginRenderPass(NkCommandEncoder commandEncoder, const NkRenderPassInfo* descriptor) {
+    NK_ASSERT(data || size == 0);
 
-    NK_ASSERT(commandEncoder);
-    NK_ASSERT(descriptor);
+    const uint8_t* bytes = NK_PTR_CAST(const uint8_t*, data);
 
-    NkBeginRenderPassCommand* command =
-        NK_PTR_CAST(NkBeginRenderPassCommand*,
-            nkCommandAllocatorAllocate(&commandEncoder->allocator,
-            sizeof(NkBeginRenderPassCommand),
-            NK_ALIGN_OF(NkBeginRenderPassCommand)));
-    NK_ASSERT(command);
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        nkHashU64(hasher, word);
+    }
 
-    command->type = NkCommandType_BeginRenderPass;
+    if (size != 0) {
+        uint64_t tail = 0;
+        memcpy(&tail, bytes, size);
+        nkHashU64(hasher, tail ^ (NK_CAST(uint64_t, size) << 56));
+    }
+}
 
-    NkRenderPassEncoder passEncoder =
-        NK_PTR_CAST(NkRenderPassEncoder, NK_MALLOC(sizeof(struct NkRenderPassEncoderImpl)));
-    NK_ASSERT(passEncoder);
+static void nkHashString(NkHasher* hasher, const char* string) {
 
-    passEncoder->allocator = &commandEncoder->allocator;
+    if (string == NK_NULL) {
+        nkHashU64(hasher, 0);
+        return;
+    }
 
-    return passEncoder;
+    const size_t length = strlen(string);
+    nkHashU64(hasher, length);
+    nkHashBytes(hasher, string, length);
 }
 
-void nkCommandEncoderCopyBufferToBuffer(NkCommandEncoder commandEncoder, NkBuffer source, uint64_t sourceOffset, NkBuffer destination, uint64_t destinationOffset, uint64_t size) {
+static uint64_t nkHasherFinish(const NkHasher* hasher) {
 
-}
+    NK_ASSERT(hasher);
 
-void nkCommandEncoderCopyBufferToTexture(NkCommandEncoder commandEncoder, const NkBufferCopyView* source, const NkTextureCopyView* destination, const NkExtent3D* copySize) {
+    uint64_t hash = hasher->state ^ hasher->length;
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
 
+    // zero marks an empty slot in NkHashMap
+    return hash != 0 ? hash : 1;
 }
 
-void nkCommandEncoderCopyTextureToBuffer(NkCommandEncoder commandEncoder, const NkTextureCopyView* source, const NkBufferCopyView* destination, const NkExtent3D* copySize) {
+// Open-addressing hash map from 64-bit hashes to object pointers, used by the object caches.
+// Keys are already well-distributed hashes, so they index the table directly. Linear probing with
+// backward-shift deletion keeps lookups to a short scan over one contiguous array, without tombstones.
 
-}
+typedef struct NkHashMap {
+    uint64_t* keys;
+    void** values;
+    uint32_t capacity;
+    uint32_t count;
+} NkHashMap;
 
-void nkCommandEncoderCopyTextureToTexture(NkCommandEncoder commandEncoder, const NkTextureCopyView* source, const NkTextureCopyView* destination, const NkExtent3D* copySize) {
+#define NK_HASH_MAP_INITIAL_CAPACITY 64
 
-}
+static void nkHashMapInitWithCapacity(NkHashMap* map, uint32_t capacity) {
 
-NkCommandBuffer nkCommandEncoderFinish(NkCommandEncoder commandEncoder) {
+    NK_ASSERT(map);
+    NK_ASSERT(NK_IS_POWER_OF_TWO(capacity));
 
-    NK_ASSERT(commandEncoder);
+    map->keys = NK_PTR_CAST(uint64_t*, NK_CALLOC(capacity, sizeof(uint64_t)));
+    NK_ASSERT(map->keys);
+    map->values = NK_PTR_CAST(void**, NK_CALLOC(capacity, sizeof(void*)));
+    NK_ASSERT(map->values);
+    map->capacity = capacity;
+    map->count = 0;
 }
 
-void nkCommandEncoderInsertDebugMarker(NkCommandEncoder commandEncoder, const char* markerLabel) {
-
+static void nkHashMapInit(NkHashMap* map) {
+    nkHashMapInitWithCapacity(map, NK_HASH_MAP_INITIAL_CAPACITY);
 }
 
-void nkCommandEncoderPopDebugGroup(NkCommandEncoder commandEncoder) {
+static void nkHashMapDestroy(NkHashMap* map) {
 
+    NK_ASSERT(map);
+    NK_FREE(map->keys);
+    NK_FREE(map->values);
+    map->keys = NK_NULL;
+    map->values = NK_NULL;
+    map->capacity = 0;
+    map->count = 0;
 }
 
-void nkCommandEncoderPushDebugGroup(NkCommandEncoder commandEncoder, const char* groupLabel) {
+static void* nkHashMapFind(const NkHashMap* map, uint64_t key) {
 
-}
+    NK_ASSERT(map);
+    NK_ASSERT(key != 0);
 
-void nkCommandEncoderResolveQuerySet(NkCommandEncoder commandEncoder, NkQuerySet querySet, uint32_t firstQuery, uint32_t queryCount, NkBuffer destination, uint64_t destinationOffset) {
+    const uint32_t mask = map->capacity - 1;
 
+    for (uint32_t slot = NK_CAST(uint32_t, key) & mask;; slot = (slot + 1) & mask) {
+        if (map->keys[slot] == key) {
+            return map->values[slot];
+        }
+        if (map->keys[slot] == 0) {
+            return NK_NULL;
+        }
+    }
 }
 
-void nkCommandEncoderWriteTimestamp(NkCommandEncoder commandEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+static void nkHashMapInsert(NkHashMap* map, uint64_t key, void* value);
 
-}
+static void nkHashMapGrow(NkHashMap* map) {
 
-// Methods of ComputePassEncoder
-void nkComputePassEncoderBeginPipelineStatisticsQuery(NkComputePassEncoder computePassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+    NkHashMap grown;
+    nkHashMapInitWithCapacity(&grown, map->capacity * 2);
+
+    for (uint32_t slot = 0; slot < map->capacity; slot++) {
+        if (map->keys[slot] != 0) {
+            nkHashMapInsert(&grown, map->keys[slot], map->values[slot]);
+        }
+    }
 
+    nkHashMapDestroy(map);
+    *map = grown;
 }
 
-void nkComputePassEncoderDispatch(NkComputePassEncoder computePassEncoder, uint32_t x, uint32_t y, uint32_t z) {
+static void nkHashMapInsert(NkHashMap* map, uint64_t key, void* value) {
 
-}
+    NK_ASSERT(map);
+    NK_ASSERT(key != 0);
 
-void nkComputePassEncoderDispatchIndirect(NkComputePassEncoder computePassEncoder, NkBuffer indirectBuffer, uint64_t indirectOffset) {
+    // keep the load factor under 3/4 so probe sequences stay short
+    if ((map->count + 1) * 4 > map->capacity * 3) {
+        nkHashMapGrow(map);
+    }
 
+    const uint32_t mask = map->capacity - 1;
+
+    for (uint32_t slot = NK_CAST(uint32_t, key) & mask;; slot = (slot + 1) & mask) {
+        if (map->keys[slot] == key) {
+            map->values[slot] = value;
+            return;
+        }
+        if (map->keys[slot] == 0) {
+            map->keys[slot] = key;
+            map->values[slot] = value;
+            map->count++;
+            return;
+        }
+    }
 }
 
-void nkComputePassEncoderEndPass(NkComputePassEncoder computePassEncoder) {
+static void nkHashMapRemove(NkHashMap* map, uint64_t key) {
 
-}
+    NK_ASSERT(map);
+    NK_ASSERT(key != 0);
 
-void nkComputePassEncoderEndPipelineStatisticsQuery(NkComputePassEncoder computePassEncoder) {
+    const uint32_t mask = map->capacity - 1;
 
-}
+    uint32_t slot = NK_CAST(uint32_t, key) & mask;
+    while (map->keys[slot] != key) {
+        if (map->keys[slot] == 0) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
 
-void nkComputePassEncoderInsertDebugMarker(NkComputePassEncoder computePassEncoder, const char* markerLabel) {
+    // Shift later entries of the probe sequence back into the hole, so that no lookup ever stops early.
+    uint32_t hole = slot;
+    for (uint32_t next = (hole + 1) & mask; map->keys[next] != 0; next = (next + 1) & mask) {
+        const uint32_t home = NK_CAST(uint32_t, map->keys[next]) & mask;
+        const int movable = (hole <= next) ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable) {
+            map->keys[hole] = map->keys[next];
+            map->values[hole] = map->values[next];
+            hole = next;
+        }
+    }
 
+    map->keys[hole] = 0;
+    map->values[hole] = NK_NULL;
+    map->count--;
 }
 
-void nkComputePassEncoderPopDebugGroup(NkComputePassEncoder computePassEncoder) {
+static void nkHashMapClear(NkHashMap* map) {
 
+    NK_ASSERT(map);
+    memset(map->keys, 0, sizeof(uint64_t) * map->capacity);
+    memset(map->values, 0, sizeof(void*) * map->capacity);
+    map->count = 0;
 }
 
-void nkComputePassEncoderPushDebugGroup(NkComputePassEncoder computePassEncoder, const char* groupLabel) {
+// Threading primitives, kept to what the device's worker pool needs.
 
-}
+#if defined(_WIN32)
+typedef SRWLOCK NkMutex;
+typedef CONDITION_VARIABLE NkCondition;
+typedef HANDLE NkThread;
+#else
+typedef pthread_mutex_t NkMutex;
+typedef pthread_cond_t NkCondition;
+typedef pthread_t NkThread;
+#endif
 
-void nkComputePassEncoderSetBindGroup(NkComputePassEncoder computePassEncoder, uint32_t groupIndex, NkBindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+static void nkMutexInit(NkMutex* mutex) {
+#if defined(_WIN32)
+    InitializeSRWLock(mutex);
+#else
+    pthread_mutex_init(mutex, NK_NULL);
+#endif
+}
 
+static void nkMutexDestroy(NkMutex* mutex) {
+#if defined(_WIN32)
+    (void)mutex; // SRW locks don't need to be destroyed
+#else
+    pthread_mutex_destroy(mutex);
+#endif
 }
 
-void nkComputePassEncoderSetPipeline(NkComputePassEncoder computePassEncoder, NkComputePipeline pipeline) {
+static void nkMutexLock(NkMutex* mutex) {
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
 
+static void nkMutexUnlock(NkMutex* mutex) {
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
 }
 
-void nkComputePassEncoderWriteTimestamp(NkComputePassEncoder computePassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+static void nkConditionInit(NkCondition* condition) {
+#if defined(_WIN32)
+    InitializeConditionVariable(condition);
+#else
+    pthread_cond_init(condition, NK_NULL);
+#endif
+}
 
+static void nkConditionDestroy(NkCondition* condition) {
+#if defined(_WIN32)
+    (void)condition;
+#else
+    pthread_cond_destroy(condition);
+#endif
 }
 
-// Methods of RenderPassEncoder
-void nkRenderPassEncoderBeginOcclusionQuery(NkRenderPassEncoder renderPassEncoder, uint32_t queryIndex) {
+static void nkConditionWait(NkCondition* condition, NkMutex* mutex) {
+#if defined(_WIN32)
+    SleepConditionVariableSRW(condition, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(condition, mutex);
+#endif
+}
 
+static void nkConditionSignal(NkCondition* condition) {
+#if defined(_WIN32)
+    WakeConditionVariable(condition);
+#else
+    pthread_cond_signal(condition);
+#endif
 }
 
-void nkRenderPassEncoderBeginPipelineStatisticsQuery(NkRenderPassEncoder renderPassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+static void nkConditionBroadcast(NkCondition* condition) {
+#if defined(_WIN32)
+    WakeAllConditionVariable(condition);
+#else
+    pthread_cond_broadcast(condition);
+#endif
+}
 
+static uint32_t nkGetProcessorCount() {
+#if defined(_WIN32)
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return NK_MAX(1u, NK_CAST(uint32_t, systemInfo.dwNumberOfProcessors));
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? NK_CAST(uint32_t, count) : 1u;
+#endif
 }
 
-typedef struct NkRenderPassEncoderDraw {
-    NkCommandType type;
-} NkRenderPassEncoderDraw;
+// A simple FIFO thread pool. This is what runs background work like pipeline compiles when the user
+// doesn't hand Neko a scheduler of their own.
 
-void nkRenderPassEncoderDraw(NkRenderPassEncoder renderPassEncoder, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+typedef struct NkTask {
+    NkTaskFunction function;
+    void* data;
+    struct NkTask* next;
+} NkTask;
 
-    NK_ASSERT(renderPassEncoder);
+typedef struct NkThreadPool {
+    NkMutex mutex;
+    NkCondition taskAvailable;
+    NkTask* head;
+    NkTask* tail;
+    NkThread* threads;
+    uint32_t threadCount;
+    NkBool stopping;
+} NkThreadPool;
 
-    NkRenderPassEncoderDraw* command =
-        NK_PTR_CAST(NkRenderPassEncoderDraw*,
-            nkCommandAllocatorAllocate(renderPassEncoder->allocator,
-            sizeof(NkRenderPassEncoderDraw),
-            NK_ALIGN_OF(NkRenderPassEncoderDraw)));
-    NK_ASSERT(command);
+static void nkThreadPoolWork(NkThreadPool* pool) {
 
-    command->type = NkCommandType_RenderPassEncoderDraw;
-}
+    NK_ASSERT(pool);
 
-void nkRenderPassEncoderDrawIndexed(NkRenderPassEncoder renderPassEncoder, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) {
+    nkMutexLock(&pool->mutex);
 
-}
+    for (;;) {
+        while (pool->head == NK_NULL && !pool->stopping) {
+            nkConditionWait(&pool->taskAvailable, &pool->mutex);
+        }
 
-void nkRenderPassEncoderDrawIndexedIndirect(NkRenderPassEncoder renderPassEncoder, NkBuffer indirectBuffer, uint64_t indirectOffset) {
+        // Queued tasks still run when the pool is stopping, so nothing that was scheduled is ever dropped.
+        if (pool->head == NK_NULL) {
+            break;
+        }
 
-}
+        NkTask* task = pool->head;
+        pool->head = task->next;
+        if (pool->head == NK_NULL) {
+            pool->tail = NK_NULL;
+        }
 
-void nkRenderPassEncoderDrawIndirect(NkRenderPassEncoder renderPassEncoder, NkBuffer indirectBuffer, uint64_t indirectOffset) {
+        nkMutexUnlock(&pool->mutex);
+        task->function(task->data);
+        NK_FREE(task);
+        nkMutexLock(&pool->mutex);
+    }
 
+    nkMutexUnlock(&pool->mutex);
 }
 
-void nkRenderPassEncoderEndOcclusionQuery(NkRenderPassEncoder renderPassEncoder) {
-
+#if defined(_WIN32)
+static DWORD WINAPI nkThreadPoolWorkerMain(LPVOID pool) {
+    nkThreadPoolWork(NK_PTR_CAST(NkThreadPool*, pool));
+    return 0;
+}
+#else
+static void* nkThreadPoolWorkerMain(void* pool) {
+    nkThreadPoolWork(NK_PTR_CAST(NkThreadPool*, pool));
+    return NK_NULL;
 }
+#endif
 
-void nkRenderPassEncoderEndPass(NkRenderPassEncoder renderPassEncoder) {
+static NkThreadPool* nkCreateThreadPool(uint32_t threadCount) {
 
-}
+    NK_ASSERT(threadCount > 0);
 
-void nkRenderPassEncoderEndPipelineStatisticsQuery(NkRenderPassEncoder renderPassEncoder) {
+    NkThreadPool* pool = NK_PTR_CAST(NkThreadPool*, NK_MALLOC(sizeof(NkThreadPool)));
+    NK_ASSERT(pool);
 
-}
+    nkMutexInit(&pool->mutex);
+    nkConditionInit(&pool->taskAvailable);
+    pool->head = NK_NULL;
+    pool->tail = NK_NULL;
+    pool->stopping = NkFalse;
+    pool->threadCount = threadCount;
+    pool->threads = NK_PTR_CAST(NkThread*, NK_MALLOC(sizeof(NkThread) * threadCount));
+    NK_ASSERT(pool->threads);
 
-void nkRenderPassEncoderExecuteBundles(NkRenderPassEncoder renderPassEncoder, uint32_t bundlesCount, const NkRenderBundle* bundles) {
+    for (uint32_t i = 0; i < threadCount; i++) {
+#if defined(_WIN32)
+        pool->threads[i] = CreateThread(NK_NULL, 0, nkThreadPoolWorkerMain, pool, 0, NK_NULL);
+        NK_ASSERT(pool->threads[i]);
+#else
+        const int created = pthread_create(&pool->threads[i], NK_NULL, nkThreadPoolWorkerMain, pool);
+        NK_ASSERT(created == 0);
+        (void)created;
+#endif
+    }
 
+    return pool;
 }
 
-void nkRenderPassEncoderInsertDebugMarker(NkRenderPassEncoder renderPassEncoder, const char* markerLabel) {
+static void nkThreadPoolSchedule(NkThreadPool* pool, NkTaskFunction function, void* data) {
 
-}
+    NK_ASSERT(pool);
+    NK_ASSERT(function);
 
-void nkRenderPassEncoderPopDebugGroup(NkRenderPassEncoder renderPassEncoder) {
+    NkTask* task = NK_PTR_CAST(NkTask*, NK_MALLOC(sizeof(NkTask)));
+    NK_ASSERT(task);
 
-}
+    task->function = function;
+    task->data = data;
+    task->next = NK_NULL;
 
-void nkRenderPassEncoderPushDebugGroup(NkRenderPassEncoder renderPassEncoder, const char* groupLabel) {
+    nkMutexLock(&pool->mutex);
+    NK_ASSERT(!pool->stopping);
+    if (pool->tail) {
+        pool->tail->next = task;
+    }
+    else {
+        pool->head = task;
+    }
+    pool->tail = task;
+    nkMutexUnlock(&pool->mutex);
 
+    nkConditionSignal(&pool->taskAvailable);
 }
 
-void nkRenderPassEncoderSetBindGroup(NkRenderPassEncoder renderPassEncoder, uint32_t groupIndex, NkBindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+static void nkDestroyThreadPool(NkThreadPool* pool) {
 
-}
+    NK_ASSERT(pool);
 
-void nkRenderPassEncoderSetBlendColor(NkRenderPassEncoder renderPassEncoder, const NkColor* color) {
+    nkMutexLock(&pool->mutex);
+    pool->stopping = NkTrue;
+    nkMutexUnlock(&pool->mutex);
+    nkConditionBroadcast(&pool->taskAvailable);
+
+    for (uint32_t i = 0; i < pool->threadCount; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NK_NULL);
+#endif
+    }
 
+    NK_FREE(pool->threads);
+    nkConditionDestroy(&pool->taskAvailable);
+    nkMutexDestroy(&pool->mutex);
+    NK_FREE(pool);
 }
 
-void nkRenderPassEncoderSetIndexBuffer(NkRenderPassEncoder renderPassEncoder, NkBuffer buffer, uint64_t offset, uint64_t size) {
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE) && !defined(_XOPEN_SOURCE) && !defined(_POSIX_C_SOURCE)
+// Strict ISO modes hide pread, which the C library has all the same.
+extern ssize_t pread(int fd, void* buffer, size_t size, off_t offset);
+#endif
+
+// Positional read that keeps going until all of size is in. Fails on errors and on files that end early.
+static NkBool nkReadFileAt(int fd, void* buffer, size_t size, uint64_t offset) {
 
+    uint8_t* bytes = NK_PTR_CAST(uint8_t*, buffer);
+    while (size > 0) {
+        const size_t chunk = NK_MIN(size, NK_CAST(size_t, 1) << 30);
+#if defined(_WIN32)
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = NK_CAST(DWORD, (offset & 0xFFFFFFFF));
+        overlapped.OffsetHigh = NK_CAST(DWORD, (offset >> 32));
+
+        DWORD bytesRead = 0;
+        if (!ReadFile(NK_PTR_CAST(HANDLE, _get_osfhandle(fd)), bytes, NK_CAST(DWORD, chunk), &bytesRead, &overlapped) || bytesRead == 0) {
+            return NkFalse;
+        }
+        const size_t count = bytesRead;
+#else
+        const ssize_t result = pread(fd, bytes, chunk, NK_CAST(off_t, offset));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return NkFalse;
+        }
+        const size_t count = NK_CAST(size_t, result);
+#endif
+        bytes += count;
+        size -= count;
+        offset += count;
+    }
+    return NkTrue;
 }
 
-typedef struct NkRenderPassEncoderSetPipelineCommand {
-    NkCommandType type;
-} NkRenderPassEncoderSetPipelineCommand;
+#if defined(NK_IO_URING)
 
-void nkRenderPassEncoderSetPipeline(NkRenderPassEncoder renderPassEncoder, NkRenderPipeline pipeline) {
+// An io_uring with a thread of its own that reaps completions. Reads are handed to the kernel as they come in,
+// or queued in order once as many are in flight as the ring has entries, and each one's callback runs on the
+// ring's thread once all of it has landed or it has failed. Built on the raw system calls so there's nothing to
+// link against.
 
-    NK_ASSERT(renderPassEncoder);
-    NK_ASSERT(pipeline);
+typedef void (*NkIoRingCallback)(NkBool success, void* data);
 
-    NkRenderPassEncoderSetPipelineCommand* command = 
-        NK_PTR_CAST(NkRenderPassEncoderSetPipelineCommand*, 
-            nkCommandAllocatorAllocate(renderPassEncoder->allocator,
-            sizeof(NkRenderPassEncoderSetPipelineCommand),
-            NK_ALIGN_OF(NkRenderPassEncoderSetPipelineCommand)));
-    NK_ASSERT(command);
+typedef struct NkIoRead {
+    int fd;
+    uint8_t* buffer;
+    size_t size;
+    uint64_t offset;
+    size_t done; // short reads are resubmitted for the rest
+    struct iovec vector;
+    NkIoRingCallback callback;
+    void* data;
+    struct NkIoRead* next; // queued behind the reads in flight
+} NkIoRead;
+
+typedef struct NkIoRing {
+    int fd;
+    uint8_t* submissionRing;
+    size_t submissionRingSize;
+    uint8_t* completionRing; // the submission ring's mapping when the kernel maps both at once
+    size_t completionRingSize;
+    struct io_uring_sqe* entries;
+    size_t entriesSize;
+    uint32_t* submissionHead;
+    uint32_t* submissionTail;
+    uint32_t* submissionArray;
+    uint32_t submissionMask;
+    uint32_t* completionHead;
+    uint32_t* completionTail;
+    struct io_uring_cqe* completions;
+    uint32_t completionMask;
+    NkMutex mutex; // guards the submission ring, readCount and the queued reads
+    NkCondition readRetired;
+    uint32_t readCount; // in flight in the kernel
+    uint32_t maxReadCount; // keeps the completion ring from ever overflowing
+    NkIoRead* queuedReads;
+    NkIoRead* lastQueuedRead;
+    NkThread thread;
+} NkIoRing;
+
+// Pushes a read of whatever's left of read, or with read NK_NULL a no-op that stops the ring's thread. Called
+// with the ring's mutex held. Returns NkFalse if the kernel refused the entry, which is taken back off the ring.
+static NkBool nkIoRingPush(NkIoRing* ring, NkIoRead* read) {
+
+    const uint32_t tail = *ring->submissionTail;
+    const uint32_t index = tail & ring->submissionMask;
+
+    struct io_uring_sqe* entry = ring->entries + index;
+    memset(entry, 0, sizeof(struct io_uring_sqe));
+    entry->opcode = IORING_OP_NOP;
+    entry->fd = -1;
+    entry->user_data = NK_CAST(uint64_t, NK_PTR_CAST(uintptr_t, read));
+
+    // Vectored reads go back to the first kernels with io_uring, plain ones only to 5.6.
+    if (read) {
+        read->vector.iov_base = read->buffer + read->done;
+        read->vector.iov_len = NK_MIN(read->size - read->done, NK_CAST(size_t, 1) << 30);
+        entry->opcode = IORING_OP_READV;
+        entry->fd = read->fd;
+        entry->addr = NK_CAST(uint64_t, NK_PTR_CAST(uintptr_t, &read->vector));
+        entry->len = 1;
+        entry->off = read->offset + read->done;
+    }
 
-    command->type = NkCommandType_RenderPassEncoderSetPipeline;
-}
+    ring->submissionArray[index] = index;
+    __atomic_store_n(ring->submissionTail, tail + 1, __ATOMIC_RELEASE);
 
-void nkRenderPassEncoderSetScissorRect(NkRenderPassEncoder renderPassEncoder, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    for (;;) {
+        const uint32_t pending = tail + 1 - __atomic_load_n(ring->submissionHead, __ATOMIC_ACQUIRE);
+        if (pending == 0) {
+            return NkTrue;
+        }
+        if (syscall(__NR_io_uring_enter, ring->fd, pending, 0, 0, NK_NULL, 0) >= 0 || errno == EINTR || errno == EAGAIN) {
+            continue;
+        }
 
+        // Refused entries never stay behind, so this one is the only entry the kernel hasn't taken.
+        NK_ASSERT(pending == 1);
+        __atomic_store_n(ring->submissionTail, tail, __ATOMIC_RELEASE);
+        return NkFalse;
+    }
 }
 
-void nkRenderPassEncoderSetStencilReference(NkRenderPassEncoder renderPassEncoder, uint32_t reference) {
+// Runs read's callback and hands its slot to the oldest queued read. Called on the ring's thread without the
+// mutex held. Queued reads the kernel refuses fail here too.
+static void nkIoRingRetire(NkIoRing* ring, NkIoRead* read, NkBool success) {
+
+    read->callback(success, read->data);
+    NK_FREE(read);
+
+    NkIoRead* refused = NK_NULL;
 
+    nkMutexLock(&ring->mutex);
+    ring->readCount--;
+    while (ring->queuedReads && ring->readCount < ring->maxReadCount) {
+        NkIoRead* queued = ring->queuedReads;
+        ring->queuedReads = queued->next;
+        if (nkIoRingPush(ring, queued)) {
+            ring->readCount++;
+        }
+        else {
+            queued->next = refused;
+            refused = queued;
+        }
+    }
+    if (ring->queuedReads == NK_NULL) {
+        ring->lastQueuedRead = NK_NULL;
+    }
+    nkMutexUnlock(&ring->mutex);
+    nkConditionSignal(&ring->readRetired);
+
+    while (refused) {
+        NkIoRead* next = refused->next;
+        refused->callback(NkFalse, refused->data);
+        NK_FREE(refused);
+        refused = next;
+    }
 }
 
-typedef struct NkRenderPassEncoderSetVertexBuffer {
-    NkCommandType type;
-} NkRenderPassEncoderSetVertexBuffer;
+static void nkIoRingWork(NkIoRing* ring) {
 
-void nkRenderPassEncoderSetVertexBuffer(NkRenderPassEncoder renderPassEncoder, uint32_t slot, NkBuffer buffer, uint64_t offset, uint64_t size) {
+    for (;;) {
+        const uint32_t head = *ring->completionHead;
+        if (head == __atomic_load_n(ring->completionTail, __ATOMIC_ACQUIRE)) {
+            syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NK_NULL, 0);
+            continue;
+        }
 
-    NK_ASSERT(renderPassEncoder);
+        const struct io_uring_cqe* completion = ring->completions + (head & ring->completionMask);
+        NkIoRead* read = NK_PTR_CAST(NkIoRead*, NK_CAST(uintptr_t, completion->user_data));
+        const int32_t result = completion->res;
+        __atomic_store_n(ring->completionHead, head + 1, __ATOMIC_RELEASE);
 
-    NkRenderPassEncoderSetVertexBuffer* command =
-        NK_PTR_CAST(NkRenderPassEncoderSetVertexBuffer*,
-            nkCommandAllocatorAllocate(renderPassEncoder->allocator,
-                sizeof(NkRenderPassEncoderSetVertexBuffer),
-                NK_ALIGN_OF(NkRenderPassEncoderSetVertexBuffer)));
-    NK_ASSERT(command);
+        if (read == NK_NULL) {
+            break;
+        }
 
-    command->type = NkCommandType_RenderPassEncoderSetVertexBuffer;
-}
+        if (result > 0) {
+            read->done += NK_CAST(size_t, result);
+        }
+        NkBool success = result > 0 ? NkTrue : NkFalse;
+        if ((result > 0 && read->done < read->size) || result == -EINTR || result == -EAGAIN) {
+            nkMutexLock(&ring->mutex);
+            const NkBool pushed = nkIoRingPush(ring, read);
+            nkMutexUnlock(&ring->mutex);
+            if (pushed) {
+                continue;
+            }
+            success = NkFalse;
+        }
 
-void nkRenderPassEncoderSetViewport(NkRenderPassEncoder renderPassEncoder, float x, float y, float width, float height, float minDepth, float maxDepth) {
+        nkIoRingRetire(ring, read, success);
+    }
+}
 
+static void* nkIoRingMain(void* ring) {
+    nkIoRingWork(NK_PTR_CAST(NkIoRing*, ring));
+    return NK_NULL;
 }
 
-void nkRenderPassEncoderWriteTimestamp(NkRenderPassEncoder renderPassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+// Returns NK_NULL where io_uring isn't there, on kernels before 5.1 or in sandboxes that block it.
+static NkIoRing* nkCreateIoRing(uint32_t entryCount) {
 
-}
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
 
-#define NK_MAX_BUFFERS 16
-#define NK_MAX_ATTRIBUTES 16
+    const int fd = NK_CAST(int, syscall(__NR_io_uring_setup, entryCount, &params));
+    if (fd < 0) {
+        return NK_NULL;
+    }
 
-#ifdef NK_VULKAN_IMPLEMENTATION
+    NkIoRing* ring = NK_PTR_CAST(NkIoRing*, NK_MALLOC(sizeof(NkIoRing)));
+    NK_ASSERT(ring);
 
-#include <vulkan/vulkan.h>
-#if defined(_WIN32)
-#define NOMINMAX
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
-#include <vulkan/vulkan_win32.h>
-#endif
+    ring->fd = fd;
+    ring->submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->entriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
 
-const char* NkVkErrorString(VkResult errorCode)
-{
-    switch (errorCode)
-    {
-#define STR(r) case VK_ ##r: return #r
-        STR(NOT_READY);
-        STR(TIMEOUT);
-        STR(EVENT_SET);
-        STR(EVENT_RESET);
-        STR(INCOMPLETE);
-        STR(ERROR_OUT_OF_HOST_MEMORY);
-        STR(ERROR_OUT_OF_DEVICE_MEMORY);
-        STR(ERROR_INITIALIZATION_FAILED);
-        STR(ERROR_DEVICE_LOST);
-        STR(ERROR_MEMORY_MAP_FAILED);
-        STR(ERROR_LAYER_NOT_PRESENT);
-        STR(ERROR_EXTENSION_NOT_PRESENT);
-        STR(ERROR_FEATURE_NOT_PRESENT);
-        STR(ERROR_INCOMPATIBLE_DRIVER);
-        STR(ERROR_TOO_MANY_OBJECTS);
-        STR(ERROR_FORMAT_NOT_SUPPORTED);
-        STR(ERROR_SURFACE_LOST_KHR);
-        STR(ERROR_NATIVE_WINDOW_IN_USE_KHR);
-        STR(SUBOPTIMAL_KHR);
-        STR(ERROR_OUT_OF_DATE_KHR);
-        STR(ERROR_INCOMPATIBLE_DISPLAY_KHR);
-        STR(ERROR_VALIDATION_FAILED_EXT);
-        STR(ERROR_INVALID_SHADER_NV);
-#undef STR
-    default:
-        return "UNKNOWN_ERROR";
+    const NkBool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) ? NkTrue : NkFalse;
+    if (singleMapping) {
+        ring->submissionRingSize = NK_MAX(ring->submissionRingSize, ring->completionRingSize);
+        ring->completionRingSize = ring->submissionRingSize;
     }
-}
 
-#define NK_CHECK_VK(x)                                                                              \
-    do {                                                                                            \
-        VkResult err = x;                                                                           \
-        if (err) {                                                                                  \
-            NK_LOG("ERROR: Detected Vulkan error %string at %string:%d.\n", NkVkErrorString(err));  \
-            abort();                                                                                \
-        }                                                                                           \
-    } while (0)
+    void* submissionRing = mmap(NK_NULL, ring->submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    void* completionRing = singleMapping ? submissionRing :
+        mmap(NK_NULL, ring->completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* entries = mmap(NK_NULL, ring->entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
 
-#define NK_ASSERT_VK_HANDLE(handle)                             \
-    do {                                                        \
-        if ((handle) == VK_NULL_HANDLE) {                       \
-            NK_LOG("ERROR: Handle is NULL at %string:%d.\n");   \
-            abort();                                            \
-        }                                                       \
-    } while (0)
+    if (submissionRing == MAP_FAILED || completionRing == MAP_FAILED || entries == MAP_FAILED) {
+        if (entries != MAP_FAILED) {
+            munmap(entries, ring->entriesSize);
+        }
+        if (completionRing != MAP_FAILED && !singleMapping) {
+            munmap(completionRing, ring->completionRingSize);
+        }
+        if (submissionRing != MAP_FAILED) {
+            munmap(submissionRing, ring->submissionRingSize);
+        }
+        close(fd);
+        NK_FREE(ring);
+        return NK_NULL;
+    }
 
-static const char* NkDeviceExtensions[] = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
-};
+    ring->submissionRing = NK_PTR_CAST(uint8_t*, submissionRing);
+    ring->completionRing = NK_PTR_CAST(uint8_t*, completionRing);
+    ring->entries = NK_PTR_CAST(struct io_uring_sqe*, entries);
+    ring->submissionHead = NK_PTR_CAST(uint32_t*, (ring->submissionRing + params.sq_off.head));
+    ring->submissionTail = NK_PTR_CAST(uint32_t*, (ring->submissionRing + params.sq_off.tail));
+    ring->submissionArray = NK_PTR_CAST(uint32_t*, (ring->submissionRing + params.sq_off.array));
+    ring->submissionMask = *NK_PTR_CAST(uint32_t*, (ring->submissionRing + params.sq_off.ring_mask));
+    ring->completionHead = NK_PTR_CAST(uint32_t*, (ring->completionRing + params.cq_off.head));
+    ring->completionTail = NK_PTR_CAST(uint32_t*, (ring->completionRing + params.cq_off.tail));
+    ring->completions = NK_PTR_CAST(struct io_uring_cqe*, (ring->completionRing + params.cq_off.cqes));
+    ring->completionMask = *NK_PTR_CAST(uint32_t*, (ring->completionRing + params.cq_off.ring_mask));
+
+    nkMutexInit(&ring->mutex);
+    nkConditionInit(&ring->readRetired);
+    ring->readCount = 0;
+    ring->maxReadCount = params.sq_entries;
+    ring->queuedReads = NK_NULL;
+    ring->lastQueuedRead = NK_NULL;
+
+    const int created = pthread_create(&ring->thread, NK_NULL, nkIoRingMain, ring);
+    NK_ASSERT(created == 0);
+    (void)created;
+
+    return ring;
+}
 
-static uint32_t NkDeviceExtensionCount
-    = sizeof(NkDeviceExtensions) / sizeof(NkDeviceExtensions[0]);
+// Queues a read of size bytes at offset. The buffer has to stay valid and the file open until callback runs. Never
+// blocks on the kernel: reads past the ring's entries wait in order for a slot, and a read the kernel refuses
+// fails straight away, with callback running on the calling thread.
+static void nkIoRingRead(NkIoRing* ring, int fd, void* buffer, size_t size, uint64_t offset, NkIoRingCallback callback, void* data) {
 
-static const char* NkInstanceExtensions[] = {
-    VK_KHR_SURFACE_EXTENSION_NAME,
-#if defined(_WIN32)
-    VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-#endif
-    VK_EXT_DEBUG_UTILS_EXTENSION_NAME
-};
+    NK_ASSERT(ring);
+    NK_ASSERT(callback);
 
-static uint32_t NkInstanceExtensionCount 
-    = sizeof(NkInstanceExtensions) / sizeof(NkInstanceExtensions[0]);
+    NkIoRead* read = NK_PTR_CAST(NkIoRead*, NK_MALLOC(sizeof(NkIoRead)));
+    NK_ASSERT(read);
 
-static const char* NkValidationLayers[] = {
-    "VK_LAYER_KHRONOS_validation"
-};
+    read->fd = fd;
+    read->buffer = NK_PTR_CAST(uint8_t*, buffer);
+    read->size = size;
+    read->offset = offset;
+    read->done = 0;
+    read->callback = callback;
+    read->data = data;
+    read->next = NK_NULL;
 
-static uint32_t NkValidationLayerCount
-    = sizeof(NkValidationLayers) / sizeof(NkValidationLayers[0]);
+    nkMutexLock(&ring->mutex);
 
-#ifdef NDEBUG
-const NkBool NkEnableValidationLayers = NkFalse;
-#else
-const NkBool NkEnableValidationLayers = NkTrue;
-#endif
+    if (ring->readCount == ring->maxReadCount) {
+        if (ring->lastQueuedRead) {
+            ring->lastQueuedRead->next = read;
+        }
+        else {
+            ring->queuedReads = read;
+        }
+        ring->lastQueuedRead = read;
+        nkMutexUnlock(&ring->mutex);
+        return;
+    }
 
-// any structs with int32_t foo are unimplemented. This is just to let the code compile in C mode, where empty structs are illegal.
+    const NkBool pushed = nkIoRingPush(ring, read);
+    if (pushed) {
+        ring->readCount++;
+    }
+    nkMutexUnlock(&ring->mutex);
 
-struct NkBindGroupImpl {
-    int32_t foo;
-};
+    if (!pushed) {
+        callback(NkFalse, data);
+        NK_FREE(read);
+    }
+}
 
-struct NkBindGroupLayoutImpl {
-    int32_t foo;
-};
+// Reads still in flight or queued are waited for, the stop request lands behind them.
+static void nkDestroyIoRing(NkIoRing* ring) {
 
-struct NkBufferImpl {
-    int32_t foo;
-};
+    NK_ASSERT(ring);
 
-struct NkCommandBufferImpl {
-    int32_t foo;
-};
+    nkMutexLock(&ring->mutex);
+    while (ring->readCount > 0 || ring->queuedReads) {
+        nkConditionWait(&ring->readRetired, &ring->mutex);
+    }
 
-struct NkComputePipelineImpl {
-    int32_t foo;
-};
+    // With nothing in flight the kernel has no reason to refuse the stop request. Should it anyway, the thread
+    // can't be stopped, and the ring is left to it rather than freed from under it.
+    const NkBool stopping = nkIoRingPush(ring, NK_NULL);
+    nkMutexUnlock(&ring->mutex);
+    if (!stopping) {
+        NK_LOG("Neko: couldn't stop the io_uring thread, leaking its ring at %s:%d.\n");
+        return;
+    }
 
-typedef struct NkVkQueueFamilyIndices {
-    uint32_t graphicsFamily;
-    uint32_t presentFamily;
-} NkVkQueueFamilyIndices;
+    pthread_join(ring->thread, NK_NULL);
 
-struct NkQueueImpl {
-    VkQueue queue;
-};
+    munmap(ring->entries, ring->entriesSize);
+    if (ring->completionRing != ring->submissionRing) {
+        munmap(ring->completionRing, ring->completionRingSize);
+    }
+    munmap(ring->submissionRing, ring->submissionRingSize);
+    close(ring->fd);
 
-struct NkDeviceImpl {
-    NkInstance instance;
-    VkPhysicalDevice physicalDevice;
-    VkDevice device;
-    struct NkQueueImpl queue;
-};
+    nkConditionDestroy(&ring->readRetired);
+    nkMutexDestroy(&ring->mutex);
+    NK_FREE(ring);
+}
 
-struct NkFenceImpl {
-    int32_t foo;
-};
+#endif
 
-struct NkInstanceImpl {
-    VkInstance instance;
-    VkDebugUtilsMessengerEXT debugMessenger;
-};
+// Content hash of shader code. Shader modules are deduplicated on it, and shader archives store it per entry.
+static uint64_t nkHashShaderCode(const void* code, size_t size) {
 
-struct NkPipelineLayoutImpl {
-    int32_t foo;
-};
+    NkHasher hasher = nkCreateHasher();
+    nkHashU64(&hasher, size);
+    nkHashBytes(&hasher, code, size);
+    return nkHasherFinish(&hasher);
+}
 
-struct NkQuerySetImpl {
-    int32_t foo;
-};
+// LZ4 block format decoder. A block is a run of sequences, each a token byte holding the literal length in the
+// high nibble and the match length minus four in the low one, either of which spill into extra bytes at 15. The
+// literals follow, then a two byte little-endian match offset. The last sequence is literals only.
+static NkBool nkLz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
 
-struct NkRenderBundleImpl {
-    int32_t foo;
-};
+    const uint8_t* srcEnd = src + srcSize;
+    uint8_t* dstBegin = dst;
+    uint8_t* dstEnd = dst + dstSize;
 
-struct NkRenderBundleEncoderImpl {
-    int32_t foo;
-};
+    while (src < srcEnd) {
+        const uint8_t token = *src++;
 
-struct NkRenderPipelineImpl {
-    VkPipeline pipeline;
-};
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            uint8_t extra;
+            do {
+                if (src >= srcEnd) {
+                    return NkFalse;
+                }
+                extra = *src++;
+                literalLength += extra;
+            } while (extra == 255);
+        }
 
-struct NkSamplerImpl {
-    int32_t foo;
-};
+        if (literalLength > NK_CAST(size_t, (srcEnd - src)) || literalLength > NK_CAST(size_t, (dstEnd - dst))) {
+            return NkFalse;
+        }
+        memcpy(dst, src, literalLength);
+        src += literalLength;
+        dst += literalLength;
 
-struct NkShaderModuleImpl {
-    VkDevice device;
-    VkShaderModule module;
-};
+        if (src == srcEnd) {
+            break;
+        }
 
-struct NkSurfaceImpl {
-    VkInstance instance;
-    VkSurfaceKHR surface;
-};
+        if (srcEnd - src < 2) {
+            return NkFalse;
+        }
+        const size_t offset = src[0] | (NK_CAST(size_t, src[1]) << 8);
+        src += 2;
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15) {
+            uint8_t extra;
+            do {
+                if (src >= srcEnd) {
+                    return NkFalse;
+                }
+                extra = *src++;
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += 4;
 
-struct NkSwapChainImpl {
-    VkDevice device;
-    VkSwapchainKHR swapChain;
-    VkImage* swapChainImages;
-    uint32_t swapChainImageCount;
-    struct NkTextureViewImpl* swapChainTextureViews;
-    uint32_t currentFrame;
-};
+        if (offset == 0 || offset > NK_CAST(size_t, (dst - dstBegin)) || matchLength > NK_CAST(size_t, (dstEnd - dst))) {
+            return NkFalse;
+        }
 
-struct NkTextureImpl {
-    int32_t foo;
-};
+        // matches may overlap the bytes they produce, so they're copied forwards a byte at a time
+        const uint8_t* match = dst - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            dst[i] = match[i];
+        }
+        dst += matchLength;
+    }
 
-struct NkTextureViewImpl {
-    VkImageView imageView;
-};
+    return dst == dstEnd ? NkTrue : NkFalse;
+}
 
-static NkBool nkVkCheckValidationLayerSupport() {
+// Shader archives. A header, then entries sorted by the hash of their name so lookups are a binary search, then the
+// code of every entry, each starting on an NK_SHADER_ARCHIVE_ALIGNMENT boundary so it can be used in place.
 
-    uint32_t layerCount;
-    NK_CHECK_VK(vkEnumerateInstanceLayerProperties(&layerCount, NK_NULL));
+#define NK_SHADER_ARCHIVE_MAGIC 0x41534B4E // "NKSA"
+#define NK_SHADER_ARCHIVE_VERSION 1
+#define NK_SHADER_ARCHIVE_ALIGNMENT 16
 
-    if (layerCount != 0)
-    {
-        VkLayerProperties* availableLayers = NK_PTR_CAST(VkLayerProperties*, NK_MALLOC(sizeof(VkLayerProperties) * layerCount));
-        NK_ASSERT(availableLayers);
+typedef enum NkShaderArchiveEntryFlags {
+    NkShaderArchiveEntryFlags_None = 0x00000000,
+    NkShaderArchiveEntryFlags_Compressed = 0x00000001, // stored as a single LZ4 block
+    NkShaderArchiveEntryFlags_Force32 = 0x7FFFFFFF
+} NkShaderArchiveEntryFlags;
 
-        NK_CHECK_VK(vkEnumerateInstanceLayerProperties(&layerCount, availableLayers));
+typedef struct NkShaderArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+} NkShaderArchiveHeader;
+
+typedef struct NkShaderArchiveEntry {
+    uint64_t nameHash; // nkHashShaderName
+    uint64_t codeHash; // nkHashShaderCode of the uncompressed code
+    uint64_t offset;   // from the start of the archive
+    uint32_t storedSize;
+    uint32_t size;
+    uint32_t flags;
+    uint32_t reserved;
+} NkShaderArchiveEntry;
+
+static uint64_t nkHashShaderName(const char* name) {
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashString(&hasher, name);
+    return nkHasherFinish(&hasher);
+}
 
-        for (uint32_t i = 0; i < NkValidationLayerCount; i++)
-        {
-            const char* layerName = NkValidationLayers[i];
-            NkBool layerFound = NkFalse;
+struct NkShaderArchiveImpl {
+    NkMappedFile file;
+    const NkShaderArchiveEntry* entries;
+    uint32_t entryCount;
+    NkMutex mutex;           // guards decompressed
+    uint32_t** decompressed; // per entry, filled in on first lookup of a compressed entry
+};
 
-            for (uint32_t j = 0; j < layerCount; j++) {
-                if (strcmp(layerName, availableLayers[j].layerName) == 0) {
-                    layerFound = NkTrue;
-                    break;
-                }
-            }
+static NkBool nkValidateShaderArchive(const NkMappedFile* file) {
 
-            if (!layerFound) {
-                return NkFalse;
-            }
-        }
+    if (file->size < sizeof(NkShaderArchiveHeader)) {
+        return NkFalse;
+    }
 
-        return NkTrue;
+    const NkShaderArchiveHeader* header = NK_PTR_CAST(const NkShaderArchiveHeader*, file->data);
+    if (header->magic != NK_SHADER_ARCHIVE_MAGIC || header->version != NK_SHADER_ARCHIVE_VERSION) {
+        return NkFalse;
     }
-}
 
-static VKAPI_ATTR VkBool32 VKAPI_CALL nkVkDebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-    if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
-        NK_LOG(pCallbackData->pMessage);
+    const uint64_t entriesEnd = sizeof(NkShaderArchiveHeader) + NK_CAST(uint64_t, header->entryCount) * sizeof(NkShaderArchiveEntry);
+    if (entriesEnd > file->size) {
+        return NkFalse;
     }
-    return VK_FALSE;
+
+    const NkShaderArchiveEntry* entries = NK_PTR_CAST(const NkShaderArchiveEntry*, (header + 1));
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        if (entries[i].offset % NK_SHADER_ARCHIVE_ALIGNMENT != 0 || entries[i].offset > file->size ||
+            entries[i].storedSize > file->size - entries[i].offset) {
+            return NkFalse;
+        }
+        // Lookups hand out size bytes, in place for stored entries, so it has to be what's actually there. An LZ4
+        // block can't grow by more than 255 times, which bounds what a compressed entry may claim to decompress to.
+        const NkBool compressed = (entries[i].flags & NkShaderArchiveEntryFlags_Compressed) ? NkTrue : NkFalse;
+        if (entries[i].size % sizeof(uint32_t) != 0 ||
+            (!compressed && entries[i].size != entries[i].storedSize) ||
+            (compressed && entries[i].size > NK_CAST(uint64_t, entries[i].storedSize) * 255)) {
+            return NkFalse;
+        }
+        if (i > 0 && entries[i - 1].nameHash >= entries[i].nameHash) {
+            return NkFalse;
+        }
+    }
+    return NkTrue;
 }
 
-static VkResult nkVkCreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
+NkShaderArchive nkOpenShaderArchive(const char* path) {
 
-    NK_ASSERT_VK_HANDLE(instance);
-    NK_ASSERT(pCreateInfo);
-    NK_ASSERT(pDebugMessenger);
+    NK_ASSERT(path);
 
-    PFN_vkCreateDebugUtilsMessengerEXT func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-    if (func != NK_NULL) {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    NkShaderArchive shaderArchive = NK_PTR_CAST(NkShaderArchive, NK_MALLOC(sizeof(struct NkShaderArchiveImpl)));
+    NK_ASSERT(shaderArchive);
+
+    if (!nkMapFile(path, &shaderArchive->file) || !nkValidateShaderArchive(&shaderArchive->file)) {
+        nkUnmapFile(&shaderArchive->file);
+        NK_FREE(shaderArchive);
+        return NK_NULL;
     }
-    else {
-        return VK_ERROR_EXTENSION_NOT_PRESENT;
+
+    const NkShaderArchiveHeader* header = NK_PTR_CAST(const NkShaderArchiveHeader*, shaderArchive->file.data);
+    shaderArchive->entries = NK_PTR_CAST(const NkShaderArchiveEntry*, (header + 1));
+    shaderArchive->entryCount = header->entryCount;
+    shaderArchive->decompressed = NK_NULL;
+    if (header->entryCount > 0) {
+        shaderArchive->decompressed = NK_PTR_CAST(uint32_t**, NK_CALLOC(header->entryCount, sizeof(uint32_t*)));
+        NK_ASSERT(shaderArchive->decompressed);
     }
+    nkMutexInit(&shaderArchive->mutex);
+
+    return shaderArchive;
 }
 
-static void nkVkDestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
+// Methods of ShaderArchive
+void nkCloseShaderArchive(NkShaderArchive shaderArchive) {
 
-    NK_ASSERT_VK_HANDLE(instance);
-    NK_ASSERT_VK_HANDLE(debugMessenger);
+    NK_ASSERT(shaderArchive);
 
-    PFN_vkDestroyDebugUtilsMessengerEXT func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func != NK_NULL) {
-        func(instance, debugMessenger, pAllocator);
+    for (uint32_t i = 0; i < shaderArchive->entryCount; i++) {
+        NK_FREE(shaderArchive->decompressed[i]);
     }
+    NK_FREE(shaderArchive->decompressed);
+    nkMutexDestroy(&shaderArchive->mutex);
+    nkUnmapFile(&shaderArchive->file);
+    NK_FREE(shaderArchive);
 }
 
-NkInstance nkCreateInstance() {
+static const uint32_t* nkShaderArchiveDecompress(NkShaderArchive shaderArchive, uint32_t index) {
 
-    if (NkEnableValidationLayers) {
-        NK_ASSERT(nkVkCheckValidationLayerSupport());
+    const NkShaderArchiveEntry* entry = shaderArchive->entries + index;
+    const uint8_t* stored = NK_PTR_CAST(const uint8_t*, shaderArchive->file.data) + entry->offset;
+
+    nkMutexLock(&shaderArchive->mutex);
+    if (shaderArchive->decompressed[index] == NK_NULL) {
+        uint32_t* code = NK_PTR_CAST(uint32_t*, NK_MALLOC(entry->size));
+        NK_ASSERT(code);
+        if (nkLz4Decompress(stored, entry->storedSize, NK_PTR_CAST(uint8_t*, code), entry->size)) {
+            shaderArchive->decompressed[index] = code;
+        }
+        else {
+            NK_FREE(code);
+        }
     }
+    const uint32_t* code = shaderArchive->decompressed[index];
+    nkMutexUnlock(&shaderArchive->mutex);
 
-    NkInstance instance = NK_PTR_CAST(NkInstance, NK_MALLOC(sizeof(struct NkInstanceImpl)));
-    NK_ASSERT(instance);
+    return code;
+}
 
-    VkApplicationInfo appInfo;
-    {
-        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-        appInfo.pNext = NK_NULL;
-        appInfo.pApplicationName = "Neko";
-        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.pEngineName = "Neko";
-        appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
-    }
+NkBool nkShaderArchiveGetModuleInfo(NkShaderArchive shaderArchive, const char* name, NkShaderModuleInfo* info) {
 
-    VkInstanceCreateInfo createInfo;
-    {
-        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-        createInfo.pNext = NK_NULL;
-        createInfo.flags = 0;
-        createInfo.pApplicationInfo = &appInfo;
-        createInfo.enabledExtensionCount = sizeof(NkInstanceExtensions) / sizeof(NkInstanceExtensions[0]);
-        createInfo.ppEnabledExtensionNames = NkInstanceExtensions;
-        if (NkEnableValidationLayers) {
-            createInfo.enabledLayerCount = NkValidationLayerCount;
-            createInfo.ppEnabledLayerNames = NkValidationLayers;
+    NK_ASSERT(shaderArchive);
+    NK_ASSERT(name);
+    NK_ASSERT(info);
+
+    const uint64_t nameHash = nkHashShaderName(name);
+
+    uint32_t first = 0;
+    uint32_t last = shaderArchive->entryCount;
+    while (first < last) {
+        const uint32_t middle = first + (last - first) / 2;
+        if (shaderArchive->entries[middle].nameHash < nameHash) {
+            first = middle + 1;
         }
         else {
-            createInfo.enabledLayerCount = 0;
+            last = middle;
         }
     }
 
-    NK_CHECK_VK(vkCreateInstance(&createInfo, NK_NULL, &instance->instance));
+    if (first == shaderArchive->entryCount || shaderArchive->entries[first].nameHash != nameHash) {
+        return NkFalse;
+    }
 
-    VkDebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo;
-    {
-        debugMessengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        debugMessengerCreateInfo.flags = 0;
-        debugMessengerCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-        debugMessengerCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-        debugMessengerCreateInfo.pfnUserCallback = nkVkDebugCallback;
-        debugMessengerCreateInfo.pUserData = NK_NULL;
+    const NkShaderArchiveEntry* entry = shaderArchive->entries + first;
+
+    const void* code = NK_PTR_CAST(const uint8_t*, shaderArchive->file.data) + entry->offset;
+    if (entry->flags & NkShaderArchiveEntryFlags_Compressed) {
+        code = nkShaderArchiveDecompress(shaderArchive, first);
+        if (code == NK_NULL) {
+            return NkFalse;
+        }
     }
 
-    NK_CHECK_VK(nkVkCreateDebugUtilsMessengerEXT(instance->instance, &debugMessengerCreateInfo, NK_NULL, &instance->debugMessenger));
+#ifdef NK_DEBUG
+    NK_ASSERT(nkHashShaderCode(code, entry->size) == entry->codeHash);
+#endif
 
-    return instance;
+    info->size = entry->size;
+    info->source = code;
+    return NkTrue;
 }
 
-// Methods of Buffer
-void nkDestroyBuffer(NkBuffer buffer) {
+// Texel conversion for texture writes whose data isn't in the texture's format. Conversions between 8-bit formats
+// are a byte shuffle, everything else is decoded to floats a chunk of texels at a time and encoded from there.
 
-}
+#define NK_TEXEL_CHUNK 64
 
-const void* nkBufferGetConstMappedRange(NkBuffer buffer, size_t offset, size_t size) {
+static uint32_t nkTextureSourceFormatSize(NkTextureSourceFormat format) {
+    switch (format) {
+    case NkTextureSourceFormat_RGB8Unorm:
+        return 3;
+    case NkTextureSourceFormat_RGBA8Unorm:
+    case NkTextureSourceFormat_BGRA8Unorm:
+        return 4;
+    case NkTextureSourceFormat_RGB32Float:
+        return 12;
+    case NkTextureSourceFormat_RGBA32Float:
+        return 16;
+    default:
+        return 0;
+    }
+}
 
+// Bytes per texel of the formats texel conversion can write, zero for the rest.
+static uint32_t nkConvertedTexelSize(NkTextureFormat format) {
+    switch (format) {
+    case NkTextureFormat_RGBA8Unorm:
+    case NkTextureFormat_RGBA8UnormSrgb:
+    case NkTextureFormat_BGRA8Unorm:
+    case NkTextureFormat_BGRA8UnormSrgb:
+    case NkTextureFormat_RGB10A2Unorm:
+        return 4;
+    case NkTextureFormat_RGBA16Float:
+        return 8;
+    case NkTextureFormat_RGBA32Float:
+        return 16;
+    default:
+        return 0;
+    }
 }
 
-void* nkBufferGetMappedRange(NkBuffer buffer, size_t offset, size_t size) {
+// Expands three channel texels to four with opaque alpha, or just copies four channel ones, swapping red and blue
+// on the way when swap is set.
+static void nkShuffleTexels8(const uint8_t* source, uint32_t sourceChannels, NkBool swap, uint8_t* destination, uint32_t count) {
+
+    uint32_t i = 0;
+
+#if defined(NK_SSSE3)
+    const __m128i alpha = _mm_set1_epi32(NK_CAST(int, 0xFF000000u));
+    if (sourceChannels == 3) {
+        const __m128i shuffle = swap ?
+            _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+            _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        // Each load reads 16 bytes but only uses 12, so the last few texels are left to the scalar loop.
+        for (; i + 6 <= count; i += 4) {
+            const __m128i texels = _mm_loadu_si128(NK_PTR_CAST(const __m128i*, (source + i * 3)));
+            _mm_storeu_si128(NK_PTR_CAST(__m128i*, (destination + i * 4)), _mm_or_si128(_mm_shuffle_epi8(texels, shuffle), alpha));
+        }
+    }
+    else {
+        const __m128i shuffle = swap ?
+            _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15) :
+            _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        for (; i + 4 <= count; i += 4) {
+            const __m128i texels = _mm_loadu_si128(NK_PTR_CAST(const __m128i*, (source + i * 4)));
+            _mm_storeu_si128(NK_PTR_CAST(__m128i*, (destination + i * 4)), _mm_shuffle_epi8(texels, shuffle));
+        }
+    }
+#elif defined(NK_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t texels;
+        if (sourceChannels == 3) {
+            const uint8x16x3_t rgb = vld3q_u8(source + i * 3);
+            texels.val[0] = rgb.val[0];
+            texels.val[1] = rgb.val[1];
+            texels.val[2] = rgb.val[2];
+            texels.val[3] = vdupq_n_u8(0xFF);
+        }
+        else {
+            texels = vld4q_u8(source + i * 4);
+        }
+        if (swap) {
+            const uint8x16_t red = texels.val[0];
+            texels.val[0] = texels.val[2];
+            texels.val[2] = red;
+        }
+        vst4q_u8(destination + i * 4, texels);
+    }
+#endif
 
+    const uint32_t red = swap ? 2 : 0;
+    for (; i < count; i++) {
+        const uint8_t* texel = source + i * sourceChannels;
+        destination[i * 4 + 0] = texel[red];
+        destination[i * 4 + 1] = texel[1];
+        destination[i * 4 + 2] = texel[2 - red];
+        destination[i * 4 + 3] = sourceChannels == 4 ? texel[3] : 0xFF;
+    }
 }
 
-NkBufferMapAsyncStatus nkBufferMap(NkBuffer buffer, NkMapModeFlags mode, size_t offset, size_t size) {
+static void nkDecodeTexels(NkTextureSourceFormat format, const uint8_t* source, float* destination, uint32_t count) {
 
+    switch (format) {
+    case NkTextureSourceFormat_RGB8Unorm:
+    case NkTextureSourceFormat_RGBA8Unorm:
+    case NkTextureSourceFormat_BGRA8Unorm: {
+        const uint32_t channels = format == NkTextureSourceFormat_RGB8Unorm ? 3 : 4;
+        const uint32_t red = format == NkTextureSourceFormat_BGRA8Unorm ? 2 : 0;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* texel = source + i * channels;
+            destination[i * 4 + 0] = texel[red] * (1.0f / 255.0f);
+            destination[i * 4 + 1] = texel[1] * (1.0f / 255.0f);
+            destination[i * 4 + 2] = texel[2 - red] * (1.0f / 255.0f);
+            destination[i * 4 + 3] = channels == 4 ? texel[3] * (1.0f / 255.0f) : 1.0f;
+        }
+        break;
+    }
+    case NkTextureSourceFormat_RGB32Float:
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(destination + i * 4, source + i * 12, 12);
+            destination[i * 4 + 3] = 1.0f;
+        }
+        break;
+    case NkTextureSourceFormat_RGBA32Float:
+        memcpy(destination, source, sizeof(float) * 4 * count);
+        break;
+    default:
+        NK_ASSERT(NkFalse);
+        break;
+    }
 }
 
-void nkBufferUnmap(NkBuffer buffer) {
+// Round to nearest even, with overflow going to infinity and values too small for a half flushed to zero.
+static uint16_t nkFloatToHalf(float value) {
 
-}
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
 
-// Methods of ComputePipeline
-NkBindGroupLayout nkComputePipelineGetBindGroupLayout(NkComputePipeline computePipeline, uint32_t groupIndex) {
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    if (magnitude >= 0x7F800000u) {
+        return NK_CAST(uint16_t, (sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u)));
+    }
+    if (magnitude >= 0x477FF000u) {
+        return NK_CAST(uint16_t, (sign | 0x7C00u));
+    }
+    if (magnitude < 0x38800000u) {
+        // Subnormal halves, shifted into place with the rounding done on the shifted out bits.
+        if (magnitude < 0x33000000u) {
+            return NK_CAST(uint16_t, sign);
+        }
+        const uint32_t exponent = magnitude >> 23;
+        const uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+        const uint32_t shift = 126 - exponent;
+        const uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t middle = 1u << (shift - 1);
+        return NK_CAST(uint16_t, (sign | (half + ((rest > middle || (rest == middle && (half & 1))) ? 1 : 0))));
+    }
 
+    const uint32_t rebased = magnitude - 0x38000000u;
+    const uint32_t rounded = rebased + 0xFFFu + ((rebased >> 13) & 1);
+    return NK_CAST(uint16_t, (sign | (rounded >> 13)));
 }
 
-// Methods of Device
-void nkDestroyDevice(NkDevice device) {
+static void nkEncodeHalf(const float* source, uint16_t* destination, uint32_t count) {
 
-    NK_ASSERT(device);
-    vkDestroyDevice(device->device, NK_NULL);
-    NK_FREE(device);
-}
+    uint32_t i = 0;
 
-NkBindGroup nkCreateBindGroup(NkDevice device, const NkBindGroupInfo* descriptor) {
+#if defined(NK_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        const __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(NK_PTR_CAST(__m128i*, (destination + i)), halves);
+    }
+#elif defined(NK_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1_u16(destination + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + i))));
+    }
+#endif
 
+    for (; i < count; i++) {
+        destination[i] = nkFloatToHalf(source[i]);
+    }
 }
 
-NkBindGroupLayout nkCreateBindGroupLayout(NkDevice device, const NkBindGroupLayoutInfo* descriptor) {
+static void nkEncodeUnorm8(const float* source, uint8_t* destination, uint32_t count) {
 
-}
+    uint32_t i = 0;
 
-NkBuffer nkCreateBuffer(NkDevice device, const NkBufferInfo* descriptor) {
+#if defined(NK_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    for (; i + 16 <= count; i += 16) {
+        __m128i words[4];
+        for (uint32_t j = 0; j < 4; j++) {
+            const __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i + j * 4), zero), one);
+            words[j] = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+        }
+        const __m128i low = _mm_packs_epi32(words[0], words[1]);
+        const __m128i high = _mm_packs_epi32(words[2], words[3]);
+        _mm_storeu_si128(NK_PTR_CAST(__m128i*, (destination + i)), _mm_packus_epi16(low, high));
+    }
+#elif defined(NK_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    for (; i + 8 <= count; i += 8) {
+        const float32x4_t low = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(source + i), zero), one), 255.0f);
+        const float32x4_t high = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(source + i + 4), zero), one), 255.0f);
+        const uint16x8_t words = vcombine_u16(vmovn_u32(vcvtnq_u32_f32(low)), vmovn_u32(vcvtnq_u32_f32(high)));
+        vst1_u8(destination + i, vmovn_u16(words));
+    }
+#endif
 
+    for (; i < count; i++) {
+        const float value = NK_MIN(NK_MAX(source[i], 0.0f), 1.0f);
+        destination[i] = NK_CAST(uint8_t, (value * 255.0f + 0.5f));
+    }
 }
 
-NkComputePipeline nkCreateComputePipeline(NkDevice device, const NkComputePipelineInfo* descriptor) {
-
+// value^exponent for positive, normal values, from the atanh series for log2 and the Taylor series for exp2.
+// It stays within a few millionths of powf, which is plenty for 8-bit results and keeps tools off libm.
+static float nkPowf(float value, float exponent) {
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const int32_t valueExponent = NK_CAST(int32_t, (bits >> 23) & 0xff) - 127;
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+
+    // log2(m) = 2 atanh(t) / ln 2 with t = (m - 1) / (m + 1), and t stays within a third for m in [1, 2).
+    const float t = (mantissa - 1.0f) / (mantissa + 1.0f);
+    const float t2 = t * t;
+    const float series = t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f + t2 * (1.0f / 9.0f)))));
+    const float power = (NK_CAST(float, valueExponent) + series * 2.88539008f) * exponent;
+
+    // 2^power = 2^whole * e^(fraction ln 2), with the fraction in [0, 1).
+    int32_t whole = NK_CAST(int32_t, power);
+    whole -= NK_CAST(float, whole) > power ? 1 : 0;
+    const float x = (power - NK_CAST(float, whole)) * 0.693147181f;
+    const float fraction = 1.0f + x * (1.0f + x * (1.0f / 2.0f + x * (1.0f / 6.0f + x * (1.0f / 24.0f +
+        x * (1.0f / 120.0f + x * (1.0f / 720.0f + x * (1.0f / 5040.0f)))))));
+    NK_ASSERT(whole > -127 && whole < 128);
+    bits = NK_CAST(uint32_t, whole + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return fraction * scale;
 }
 
-NkPipelineLayout nkCreatePipelineLayout(NkDevice device, const NkPipelineLayoutInfo* descriptor) {
+static float nkLinearToSrgb(float value) {
 
+    value = NK_MIN(NK_MAX(value, 0.0f), 1.0f);
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * nkPowf(value, 1.0f / 2.4f) - 0.055f;
 }
 
-NkQuerySet nkCreateQuerySet(NkDevice device, const NkQuerySetInfo* descriptor) {
+// Converts a row of count texels. The destination has to be one of the formats nkConvertedTexelSize knows.
+static void nkConvertTexels(NkTextureSourceFormat sourceFormat, NkTextureFormat format, const void* source, void* destination, uint32_t count) {
+
+    const NkBool bgra = (format == NkTextureFormat_BGRA8Unorm || format == NkTextureFormat_BGRA8UnormSrgb) ? NkTrue : NkFalse;
+    const NkBool srgb = (format == NkTextureFormat_RGBA8UnormSrgb || format == NkTextureFormat_BGRA8UnormSrgb) ? NkTrue : NkFalse;
+    const NkBool bytes = (bgra || srgb || format == NkTextureFormat_RGBA8Unorm) ? NkTrue : NkFalse;
+
+    const uint8_t* sourceBytes = NK_PTR_CAST(const uint8_t*, source);
+    uint8_t* destinationBytes = NK_PTR_CAST(uint8_t*, destination);
+
+    const uint32_t sourceSize = nkTextureSourceFormatSize(sourceFormat);
+    const uint32_t destinationSize = nkConvertedTexelSize(format);
+    NK_ASSERT(sourceSize != 0 && destinationSize != 0);
 
+    if (bytes && sourceSize <= 4) {
+        const NkBool sourceBgra = sourceFormat == NkTextureSourceFormat_BGRA8Unorm ? NkTrue : NkFalse;
+        nkShuffleTexels8(sourceBytes, sourceSize, sourceBgra != bgra ? NkTrue : NkFalse, destinationBytes, count);
+        return;
+    }
+
+    float texels[NK_TEXEL_CHUNK * 4];
+
+    for (uint32_t first = 0; first < count; first += NK_TEXEL_CHUNK) {
+        const uint32_t chunk = NK_MIN(count - first, NK_TEXEL_CHUNK);
+        nkDecodeTexels(sourceFormat, sourceBytes + first * sourceSize, texels, chunk);
+        uint8_t* out = destinationBytes + first * destinationSize;
+
+        switch (format) {
+        case NkTextureFormat_RGBA16Float:
+            nkEncodeHalf(texels, NK_PTR_CAST(uint16_t*, out), chunk * 4);
+            break;
+        case NkTextureFormat_RGBA32Float:
+            memcpy(out, texels, sizeof(float) * 4 * chunk);
+            break;
+        case NkTextureFormat_RGB10A2Unorm:
+            for (uint32_t i = 0; i < chunk; i++) {
+                uint32_t packed = 0;
+                for (uint32_t channel = 0; channel < 4; channel++) {
+                    const float maximum = channel == 3 ? 3.0f : 1023.0f;
+                    const float value = NK_MIN(NK_MAX(texels[i * 4 + channel], 0.0f), 1.0f);
+                    packed |= NK_CAST(uint32_t, (value * maximum + 0.5f)) << (channel * 10);
+                }
+                memcpy(out + i * 4, &packed, sizeof(packed));
+            }
+            break;
+        default:
+            for (uint32_t i = 0; i < chunk; i++) {
+                float* texel = texels + i * 4;
+                if (bgra) {
+                    const float red = texel[0];
+                    texel[0] = texel[2];
+                    texel[2] = red;
+                }
+                if (srgb) {
+                    texel[0] = nkLinearToSrgb(texel[0]);
+                    texel[1] = nkLinearToSrgb(texel[1]);
+                    texel[2] = nkLinearToSrgb(texel[2]);
+                }
+            }
+            nkEncodeUnorm8(texels, out, chunk * 4);
+            break;
+        }
+    }
 }
 
-NkRenderBundleEncoder nkCreateRenderBundleEncoder(NkDevice device, const NkRenderBundleEncoderInfo* descriptor) {
+// Block compression for texture writes whose texture is in a BC format but whose data isn't. It aims at content
+// made at runtime, so every mode takes one pass: endpoints come from the principal axis of the block, and each
+// texel takes the nearest colour on the line between them. BC1, BC3, BC4 and BC5 are supported, and BC7 through
+// mode 6 alone, which is a single RGBA line with 4-bit indices.
 
+static uint32_t nkCompressedBlockSize(NkTextureFormat format) {
+    switch (format) {
+    case NkTextureFormat_BC1RGBAUnorm:
+    case NkTextureFormat_BC1RGBAUnormSrgb:
+    case NkTextureFormat_BC4RUnorm:
+        return 8;
+    case NkTextureFormat_BC3RGBAUnorm:
+    case NkTextureFormat_BC3RGBAUnormSrgb:
+    case NkTextureFormat_BC5RGUnorm:
+    case NkTextureFormat_BC7RGBAUnorm:
+    case NkTextureFormat_BC7RGBAUnormSrgb:
+        return 16;
+    default:
+        return 0;
+    }
 }
 
-static VkVertexInputRate nkVkInputRate(NkInputStepMode stepMode) {
-    switch (stepMode) {
-    case NkInputStepMode_Vertex:
-        return VK_VERTEX_INPUT_RATE_VERTEX;
-    case NkInputStepMode_Instance:
-        return VK_VERTEX_INPUT_RATE_INSTANCE;
+// Per channel minimum and maximum of a block of sixteen RGBA8 texels.
+static void nkBlockBounds(const uint8_t* texels, uint8_t* minimum, uint8_t* maximum) {
+
+#if defined(NK_SSE2)
+    const __m128i row0 = _mm_loadu_si128(NK_PTR_CAST(const __m128i*, texels));
+    const __m128i row1 = _mm_loadu_si128(NK_PTR_CAST(const __m128i*, (texels + 16)));
+    const __m128i row2 = _mm_loadu_si128(NK_PTR_CAST(const __m128i*, (texels + 32)));
+    const __m128i row3 = _mm_loadu_si128(NK_PTR_CAST(const __m128i*, (texels + 48)));
+    __m128i low = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+    __m128i high = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+    low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+    low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+    high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+    high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+    const uint32_t lowBits = NK_CAST(uint32_t, _mm_cvtsi128_si32(low));
+    const uint32_t highBits = NK_CAST(uint32_t, _mm_cvtsi128_si32(high));
+    memcpy(minimum, &lowBits, 4);
+    memcpy(maximum, &highBits, 4);
+#elif defined(NK_NEON)
+    const uint8x16x4_t rows = { { vld1q_u8(texels), vld1q_u8(texels + 16), vld1q_u8(texels + 32), vld1q_u8(texels + 48) } };
+    uint8x16_t low = vminq_u8(vminq_u8(rows.val[0], rows.val[1]), vminq_u8(rows.val[2], rows.val[3]));
+    uint8x16_t high = vmaxq_u8(vmaxq_u8(rows.val[0], rows.val[1]), vmaxq_u8(rows.val[2], rows.val[3]));
+    low = vminq_u8(low, vextq_u8(low, low, 8));
+    low = vminq_u8(low, vextq_u8(low, low, 4));
+    high = vmaxq_u8(high, vextq_u8(high, high, 8));
+    high = vmaxq_u8(high, vextq_u8(high, high, 4));
+    const uint32_t lowBits = vgetq_lane_u32(vreinterpretq_u32_u8(low), 0);
+    const uint32_t highBits = vgetq_lane_u32(vreinterpretq_u32_u8(high), 0);
+    memcpy(minimum, &lowBits, 4);
+    memcpy(maximum, &highBits, 4);
+#else
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        minimum[channel] = 255;
+        maximum[channel] = 0;
+        for (uint32_t i = 0; i < 16; i++) {
+            minimum[channel] = NK_MIN(minimum[channel], texels[i * 4 + channel]);
+            maximum[channel] = NK_MAX(maximum[channel], texels[i * 4 + channel]);
+        }
     }
-    return VK_VERTEX_INPUT_RATE_MAX_ENUM;
+#endif
 }
 
-static VkFormat nkVkFormat(NkVertexFormat format) {
-    switch (format) {
-    case NkVertexFormat_UChar2:
-        return VK_FORMAT_R8G8_UINT;
-    case NkVertexFormat_UChar4:
-        return VK_FORMAT_R8G8B8A8_UINT;
-    case NkVertexFormat_Char2:
-        return VK_FORMAT_R8G8_SINT;
-    case NkVertexFormat_Char4:
-        return VK_FORMAT_R8G8B8A8_SINT;
-    case NkVertexFormat_UChar2Norm:
+// Fits a line through the block's texels, skipping ones with an alpha below 128 when opaqueOnly is set. The first
+// channels of start and end receive its ends, clamped to the block's bounds. Returns NkFalse when there's no
+// texel to fit.
+static NkBool nkFitBlockLine(const uint8_t* texels, uint32_t channels, NkBool opaqueOnly, float* start, float* end) {
+
+    float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        if (opaqueOnly && texels[i * 4 + 3] < 128) {
+            continue;
+        }
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            mean[channel] += texels[i * 4 + channel];
+        }
+        count++;
+    }
+    if (count == 0) {
+        return NkFalse;
+    }
+
+    float covariance[4][4];
+    memset(covariance, 0, sizeof(covariance));
+    float minimum[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    float maximum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        mean[channel] /= NK_CAST(float, count);
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+        if (opaqueOnly && texels[i * 4 + 3] < 128) {
+            continue;
+        }
+        float delta[4];
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            const float value = texels[i * 4 + channel];
+            delta[channel] = value - mean[channel];
+            minimum[channel] = NK_MIN(minimum[channel], value);
+            maximum[channel] = NK_MAX(maximum[channel], value);
+        }
+        for (uint32_t row = 0; row < channels; row++) {
+            for (uint32_t column = 0; column < channels; column++) {
+                covariance[row][column] += delta[row] * delta[column];
+            }
+        }
+    }
+
+    // A few rounds of power iteration find the principal axis. They start from the covariance of the channel that
+    // varies most, which unlike the diagonal of the bounding box can't be at right angles to it.
+    uint32_t widest = 0;
+    for (uint32_t channel = 1; channel < channels; channel++) {
+        widest = covariance[channel][channel] > covariance[widest][widest] ? channel : widest;
+    }
+    float axis[4];
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        axis[channel] = covariance[widest][channel];
+    }
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float largest = 0.0f;
+        for (uint32_t row = 0; row < channels; row++) {
+            for (uint32_t column = 0; column < channels; column++) {
+                next[row] += covariance[row][column] * axis[column];
+            }
+            largest = NK_MAX(largest, NK_MAX(next[row], -next[row]));
+        }
+        if (largest == 0.0f) {
+            break;
+        }
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            axis[channel] = next[channel] / largest;
+        }
+    }
+
+    float length = 0.0f;
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        length += axis[channel] * axis[channel];
+    }
+
+    // Every texel the same colour.
+    if (length == 0.0f) {
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            start[channel] = mean[channel];
+            end[channel] = mean[channel];
+        }
+        return NkTrue;
+    }
+
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    for (uint32_t i = 0; i < 16; i++) {
+        if (opaqueOnly && texels[i * 4 + 3] < 128) {
+            continue;
+        }
+        float projection = 0.0f;
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            projection += (texels[i * 4 + channel] - mean[channel]) * axis[channel];
+        }
+        lowest = NK_MIN(lowest, projection);
+        highest = NK_MAX(highest, projection);
+    }
+
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        start[channel] = NK_MIN(NK_MAX(mean[channel] + axis[channel] * lowest / length, minimum[channel]), maximum[channel]);
+        end[channel] = NK_MIN(NK_MAX(mean[channel] + axis[channel] * highest / length, minimum[channel]), maximum[channel]);
+    }
+    return NkTrue;
+}
+
+static uint16_t nkPack565(const float* color) {
+
+    const uint32_t red = NK_CAST(uint32_t, (color[0] * 31.0f / 255.0f + 0.5f));
+    const uint32_t green = NK_CAST(uint32_t, (color[1] * 63.0f / 255.0f + 0.5f));
+    const uint32_t blue = NK_CAST(uint32_t, (color[2] * 31.0f / 255.0f + 0.5f));
+    return NK_CAST(uint16_t, ((red << 11) | (green << 5) | blue));
+}
+
+static void nkUnpack565(uint16_t packed, int32_t* color) {
+
+    const int32_t red = (packed >> 11) & 31;
+    const int32_t green = (packed >> 5) & 63;
+    const int32_t blue = packed & 31;
+    color[0] = (red << 3) | (red >> 2);
+    color[1] = (green << 2) | (green >> 4);
+    color[2] = (blue << 3) | (blue >> 2);
+}
+
+// Texels with an alpha below 128 become transparent when punchThrough is set, which takes BC1's three colour mode.
+static void nkCompressBC1(const uint8_t* texels, NkBool punchThrough, uint8_t* block) {
+
+    NkBool transparent = NkFalse;
+    for (uint32_t i = 0; i < 16 && punchThrough; i++) {
+        transparent = (transparent || texels[i * 4 + 3] < 128) ? NkTrue : NkFalse;
+    }
+
+    float start[3] = { 0.0f, 0.0f, 0.0f };
+    float end[3] = { 0.0f, 0.0f, 0.0f };
+    nkFitBlockLine(texels, 3, transparent, start, end);
+
+    uint16_t color0 = nkPack565(end);
+    uint16_t color1 = nkPack565(start);
+
+    // Four colours want color0 above color1 and three want it below, equal ones work for either.
+    if (transparent ? color0 > color1 : color0 < color1) {
+        const uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    int32_t palette[4][3];
+    nkUnpack565(color0, palette[0]);
+    nkUnpack565(color1, palette[1]);
+    for (uint32_t channel = 0; channel < 3; channel++) {
+        if (transparent) {
+            palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+            palette[3][channel] = 0;
+        }
+        else {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+    }
+
+    const uint32_t colorCount = transparent ? 3 : 4;
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < 16 && color0 != color1; i++) {
+        const uint8_t* texel = texels + i * 4;
+        uint32_t best = 0;
+        if (transparent && texel[3] < 128) {
+            best = 3;
+        }
+        else {
+            int32_t bestDistance = INT32_MAX;
+            for (uint32_t candidate = 0; candidate < colorCount; candidate++) {
+                const int32_t red = texel[0] - palette[candidate][0];
+                const int32_t green = texel[1] - palette[candidate][1];
+                const int32_t blue = texel[2] - palette[candidate][2];
+                const int32_t distance = red * red + green * green + blue * blue;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = candidate;
+                }
+            }
+        }
+        indices |= best << (i * 2);
+    }
+
+    // A block whose colours quantised to one endpoint is drawn from color0 alone, unless some texel is transparent.
+    if (color0 == color1 && transparent) {
+        for (uint32_t i = 0; i < 16; i++) {
+            indices |= (texels[i * 4 + 3] < 128 ? 3u : 0u) << (i * 2);
+        }
+    }
+
+    block[0] = NK_CAST(uint8_t, (color0 & 0xFF));
+    block[1] = NK_CAST(uint8_t, (color0 >> 8));
+    block[2] = NK_CAST(uint8_t, (color1 & 0xFF));
+    block[3] = NK_CAST(uint8_t, (color1 >> 8));
+    memcpy(block + 4, &indices, sizeof(indices));
+}
+
+// One channel of the block, as BC4 stores it and BC3 stores alpha. Always takes the eight value mode.
+static void nkCompressBC4(const uint8_t* texels, uint32_t channel, uint8_t minimum, uint8_t maximum, uint8_t* block) {
+
+    block[0] = maximum;
+    block[1] = minimum;
+
+    uint64_t indices = 0;
+    const int32_t range = maximum - minimum;
+    for (uint32_t i = 0; i < 16 && range > 0; i++) {
+        // Steps from maximum down to minimum, which the format numbers 0, 2, 3, 4, 5, 6, 7, 1.
+        const int32_t step = ((maximum - texels[i * 4 + channel]) * 14 + range) / (2 * range);
+        const uint64_t index = step == 0 ? 0 : (step == 7 ? 1 : NK_CAST(uint64_t, (step + 1)));
+        indices |= index << (i * 3);
+    }
+
+    for (uint32_t i = 0; i < 6; i++) {
+        block[2 + i] = NK_CAST(uint8_t, ((indices >> (i * 8)) & 0xFF));
+    }
+}
+
+static const uint8_t NkBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static void nkWriteBits(uint8_t* block, uint32_t* position, uint32_t value, uint32_t count) {
+
+    for (uint32_t i = 0; i < count; i++, (*position)++) {
+        block[*position >> 3] |= NK_CAST(uint8_t, (((value >> i) & 1) << (*position & 7)));
+    }
+}
+
+// BC7 mode 6: one pair of RGBA endpoints with seven bits per channel and a shared low bit per endpoint.
+static void nkCompressBC7(const uint8_t* texels, uint8_t* block) {
+
+    float line[2][4] = { { 0.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 0.0f } };
+    nkFitBlockLine(texels, 4, NkFalse, line[0], line[1]);
+
+    // Each endpoint keeps whichever low bit lands it closest to the fitted one.
+    uint32_t endpoints[2][4];
+    uint32_t lowBits[2];
+    for (uint32_t e = 0; e < 2; e++) {
+        float bestError = 0.0f;
+        for (uint32_t bit = 0; bit < 2; bit++) {
+            float error = 0.0f;
+            uint32_t quantized[4];
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                const float value = (line[e][channel] - NK_CAST(float, bit)) * 0.5f + 0.5f;
+                quantized[channel] = NK_CAST(uint32_t, NK_MIN(NK_MAX(value, 0.0f), 127.0f));
+                const float difference = NK_CAST(float, ((quantized[channel] << 1) | bit)) - line[e][channel];
+                error += difference * difference;
+            }
+            if (bit == 0 || error < bestError) {
+                bestError = error;
+                lowBits[e] = bit;
+                memcpy(endpoints[e], quantized, sizeof(quantized));
+            }
+        }
+    }
+
+    int32_t palette[16][4];
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        const int32_t first = NK_CAST(int32_t, ((endpoints[0][channel] << 1) | lowBits[0]));
+        const int32_t last = NK_CAST(int32_t, ((endpoints[1][channel] << 1) | lowBits[1]));
+        for (uint32_t i = 0; i < 16; i++) {
+            palette[i][channel] = ((64 - NkBC7Weights4[i]) * first + NkBC7Weights4[i] * last + 32) >> 6;
+        }
+    }
+
+    uint32_t indices[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        const uint8_t* texel = texels + i * 4;
+        int32_t bestDistance = INT32_MAX;
+        for (uint32_t candidate = 0; candidate < 16; candidate++) {
+            int32_t distance = 0;
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                const int32_t difference = texel[channel] - palette[candidate][channel];
+                distance += difference * difference;
+            }
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                indices[i] = candidate;
+            }
+        }
+    }
+
+    // The first index is stored without its top bit, so the endpoints swap when it's set.
+    if (indices[0] & 8) {
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            const uint32_t swap = endpoints[0][channel];
+            endpoints[0][channel] = endpoints[1][channel];
+            endpoints[1][channel] = swap;
+        }
+        const uint32_t swap = lowBits[0];
+        lowBits[0] = lowBits[1];
+        lowBits[1] = swap;
+        for (uint32_t i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(block, 0, 16);
+    uint32_t position = 0;
+    nkWriteBits(block, &position, 1u << 6, 7);
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        nkWriteBits(block, &position, endpoints[0][channel], 7);
+        nkWriteBits(block, &position, endpoints[1][channel], 7);
+    }
+    nkWriteBits(block, &position, lowBits[0], 1);
+    nkWriteBits(block, &position, lowBits[1], 1);
+    nkWriteBits(block, &position, indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        nkWriteBits(block, &position, indices[i], 4);
+    }
+}
+
+static void nkCompressBlock(NkTextureFormat format, const uint8_t* texels, uint8_t* block) {
+
+    uint8_t minimum[4];
+    uint8_t maximum[4];
+
+    switch (format) {
+    case NkTextureFormat_BC1RGBAUnorm:
+    case NkTextureFormat_BC1RGBAUnormSrgb:
+        nkCompressBC1(texels, NkTrue, block);
+        break;
+    case NkTextureFormat_BC3RGBAUnorm:
+    case NkTextureFormat_BC3RGBAUnormSrgb:
+        nkBlockBounds(texels, minimum, maximum);
+        nkCompressBC4(texels, 3, minimum[3], maximum[3], block);
+        nkCompressBC1(texels, NkFalse, block + 8);
+        break;
+    case NkTextureFormat_BC4RUnorm:
+        nkBlockBounds(texels, minimum, maximum);
+        nkCompressBC4(texels, 0, minimum[0], maximum[0], block);
+        break;
+    case NkTextureFormat_BC5RGUnorm:
+        nkBlockBounds(texels, minimum, maximum);
+        nkCompressBC4(texels, 0, minimum[0], maximum[0], block);
+        nkCompressBC4(texels, 1, minimum[1], maximum[1], block + 8);
+        break;
+    case NkTextureFormat_BC7RGBAUnorm:
+    case NkTextureFormat_BC7RGBAUnormSrgb:
+        nkCompressBC7(texels, block);
+        break;
+    default:
+        NK_ASSERT(NkFalse);
+        break;
+    }
+}
+
+// Compresses a row of blocks from the four source rows it covers. Blocks hanging over the right or bottom edge
+// repeat the last column or row. scratch holds four rows of RGBA8 texels.
+static void nkCompressBlockRow(NkTextureSourceFormat sourceFormat, NkTextureFormat format, const uint8_t* const* rows, uint32_t width, uint8_t* scratch, uint8_t* destination) {
+
+    const NkBool srgb = (format == NkTextureFormat_BC1RGBAUnormSrgb || format == NkTextureFormat_BC3RGBAUnormSrgb ||
+        format == NkTextureFormat_BC7RGBAUnormSrgb) ? NkTrue : NkFalse;
+    const uint32_t blockSize = nkCompressedBlockSize(format);
+
+    for (uint32_t y = 0; y < 4; y++) {
+        nkConvertTexels(sourceFormat, srgb ? NkTextureFormat_RGBA8UnormSrgb : NkTextureFormat_RGBA8Unorm, rows[y], scratch + y * width * 4, width);
+    }
+
+    uint8_t texels[64];
+    for (uint32_t x = 0; x < width; x += 4) {
+        for (uint32_t y = 0; y < 4; y++) {
+            const uint8_t* row = scratch + y * width * 4;
+            if (x + 4 <= width) {
+                memcpy(texels + y * 16, row + x * 4, 16);
+                continue;
+            }
+            for (uint32_t i = 0; i < 4; i++) {
+                memcpy(texels + y * 16 + i * 4, row + NK_MIN(x + i, width - 1) * 4, 4);
+            }
+        }
+        nkCompressBlock(format, texels, destination + (x / 4) * blockSize);
+    }
+}
+
+// Commands are allocated back to back but differ in size, so the encoder also lists them in the order they were
+// encoded, which is the order the backend replays them in.
+struct NkCommandEncoderImpl {
+    NkCommandAllocator allocator;
+    const void** commands;
+    uint32_t commandCount;
+    uint32_t commandCapacity;
+};
+
+// What an encoder finishes into. The backend replays it when it's submitted, and frees it after that.
+struct NkCommandBufferImpl {
+    NkCommandAllocator allocator;
+    const void** commands;
+    uint32_t commandCount;
+};
+
+struct NkRenderPassEncoderImpl {
+    NkCommandEncoder commandEncoder;
+};
+
+struct NkComputePassEncoderImpl {
+    NkCommandEncoder commandEncoder;
+};
+
+#define NK_COMMAND_ALLOCATOR_SIZE 16384 // this is a hack that will be removed when the command allocator is smarter
+
+NkCommandEncoder nkCreateCommandEncoder(NkDevice device) {
+
+    NkCommandEncoder commandEncoder = NK_PTR_CAST(NkCommandEncoder, NK_MALLOC(sizeof(struct NkCommandEncoderImpl)));
+    NK_ASSERT(commandEncoder);
+    commandEncoder->allocator = nkCreateCommandAllocator(NK_COMMAND_ALLOCATOR_SIZE);
+    commandEncoder->commandCapacity = 64;
+    commandEncoder->commandCount = 0;
+    commandEncoder->commands = NK_PTR_CAST(const void**, NK_MALLOC(sizeof(const void*) * commandEncoder->commandCapacity));
+    NK_ASSERT(commandEncoder->commands);
+    return commandEncoder;
+}
+
+// Allocates a command and lists it for replay. Data a command points at is allocated after it with
+// nkCommandAllocatorAllocate, and isn't listed.
+void* nkCommandEncoderAllocateCommand(NkCommandEncoder commandEncoder, uint32_t size, uint32_t alignment) {
+
+    NK_ASSERT(commandEncoder);
+
+    if (commandEncoder->commandCount == commandEncoder->commandCapacity) {
+        commandEncoder->commandCapacity *= 2;
+        commandEncoder->commands = NK_PTR_CAST(const void**, NK_REALLOC(commandEncoder->commands, sizeof(const void*) * commandEncoder->commandCapacity));
+        NK_ASSERT(commandEncoder->commands);
+    }
+
+    void* command = nkCommandAllocatorAllocate(&commandEncoder->allocator, size, alignment);
+    commandEncoder->commands[commandEncoder->commandCount++] = command;
+    return command;
+}
+
+void nkFreeCommandBuffer(NkCommandBuffer commandBuffer) {
+
+    NK_ASSERT(commandBuffer);
+    NK_FREE(NK_PTR_CAST(void*, commandBuffer->allocator.buffer));
+    NK_FREE(NK_PTR_CAST(void*, commandBuffer->commands));
+    NK_FREE(commandBuffer);
+}
+
+typedef enum NkCommandType {
+    NkCommandType_BeginComputePass,
+    NkCommandType_BeginRenderPass,
+    NkCommandType_RenderPassEncoderEndPass,
+    NkCommandType_RenderPassEncoderSetPipeline,
+    NkCommandType_RenderPassEncoderSetVertexBuffer,
+    NkCommandType_RenderPassEncoderDraw,
+    NkCommandType_RenderPassEncoderSetColorState,
+    NkCommandType_RenderPassEncoderSetCullMode,
+    NkCommandType_RenderPassEncoderSetDepthClamp,
+    NkCommandType_RenderPassEncoderSetDepthTest,
+    NkCommandType_RenderPassEncoderSetFrontFace,
+    NkCommandType_RenderPassEncoderSetPrimitiveTopology,
+    NkCommandType_RenderPassEncoderSetStencilTest,
+    NkCommandType_RenderPassEncoderPushBindGroup,
+    NkCommandType_RenderPassEncoderSetBindGroup,
+    NkCommandType_ComputePassEncoderEndPass,
+    NkCommandType_ComputePassEncoderSetPipeline,
+    NkCommandType_ComputePassEncoderSetBindGroup,
+    NkCommandType_ComputePassEncoderDispatch,
+    NkCommandType_CommandEncoderGenerateMipmaps
+} NkCommandType;
+
+// Shared by render and compute passes, which only differ in the type.
+typedef struct NkSetBindGroupCommand {
+    NkCommandType type;
+    uint32_t groupIndex;
+    NkBindGroup group;
+    uint32_t dynamicOffsetCount;
+    const uint32_t* dynamicOffsets; // copied next to the command
+} NkSetBindGroupCommand;
+
+static void nkCommandEncoderSetBindGroup(NkCommandEncoder commandEncoder, NkCommandType type, uint32_t groupIndex, NkBindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+
+    NK_ASSERT(group);
+    NK_ASSERT(dynamicOffsetCount == 0 || dynamicOffsets);
+
+    NkSetBindGroupCommand* command =
+        NK_PTR_CAST(NkSetBindGroupCommand*,
+            nkCommandEncoderAllocateCommand(commandEncoder,
+            sizeof(NkSetBindGroupCommand),
+            NK_ALIGN_OF(NkSetBindGroupCommand)));
+    NK_ASSERT(command);
+
+    command->type = type;
+    command->groupIndex = groupIndex;
+    command->group = group;
+    command->dynamicOffsetCount = dynamicOffsetCount;
+    command->dynamicOffsets = NK_NULL;
+
+    if (dynamicOffsetCount > 0) {
+        uint32_t* copiedOffsets =
+            NK_PTR_CAST(uint32_t*,
+                nkCommandAllocatorAllocate(&commandEncoder->allocator,
+                NK_CAST(uint32_t, sizeof(uint32_t) * dynamicOffsetCount),
+                NK_ALIGN_OF(uint32_t)));
+        NK_ASSERT(copiedOffsets);
+        memcpy(copiedOffsets, dynamicOffsets, sizeof(uint32_t) * dynamicOffsetCount);
+        command->dynamicOffsets = copiedOffsets;
+    }
+}
+
+typedef struct NkBeginComputePassCommand {
+    NkCommandType type;
+} NkBeginComputePassCommand;
+
+// Methods of CommandEncoder
+NkComputePassEncoder nkCommandEncoderBeginComputePass(NkCommandEncoder commandEncoder) {
+
+    NK_ASSERT(commandEncoder);
+
+    NkBeginComputePassCommand* command = NK_PTR_CAST(NkBeginComputePassCommand*, nkCommandEncoderAllocateCommand(commandEncoder, sizeof(NkBeginComputePassCommand), NK_ALIGN_OF(NkBeginComputePassCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_BeginComputePass;
+
+    NkComputePassEncoder passEncoder = NK_PTR_CAST(NkComputePassEncoder, NK_MALLOC(sizeof(struct NkComputePassEncoderImpl)));
+    NK_ASSERT(passEncoder);
+
+    passEncoder->commandEncoder = commandEncoder;
+
+    return passEncoder;
+}
+
+// The attachments are copied next to the command, so the descriptor only has to live for the call. The backend
+// resolves the copy into a render pass when the commands are replayed.
+typedef struct NkBeginRenderPassCommand {
+    NkCommandType type;
+    NkRenderPassInfo info;
+    NkRenderPassDepthStencilAttachmentInfo depthStencilAttachment;
+} NkBeginRenderPassCommand;
+
+NkRenderPassEncoder nkCommandEncoderBeginRenderPass(NkCommandEncoder commandEncoder, const NkRenderPassInfo* descriptor) {
+
+    NK_ASSERT(commandEncoder);
+    NK_ASSERT(descriptor);
+
+    NkBeginRenderPassCommand* command =
+        NK_PTR_CAST(NkBeginRenderPassCommand*,
+            nkCommandEncoderAllocateCommand(commandEncoder,
+            sizeof(NkBeginRenderPassCommand),
+            NK_ALIGN_OF(NkBeginRenderPassCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_BeginRenderPass;
+    command->info = *descriptor;
+
+    if (descriptor->colorAttachmentCount > 0) {
+        NK_ASSERT(descriptor->colorAttachments);
+        NkRenderPassColorAttachmentInfo* colorAttachments =
+            NK_PTR_CAST(NkRenderPassColorAttachmentInfo*,
+                nkCommandAllocatorAllocate(&commandEncoder->allocator,
+                NK_CAST(uint32_t, sizeof(NkRenderPassColorAttachmentInfo) * descriptor->colorAttachmentCount),
+                NK_ALIGN_OF(NkRenderPassColorAttachmentInfo)));
+        NK_ASSERT(colorAttachments);
+        memcpy(colorAttachments, descriptor->colorAttachments, sizeof(NkRenderPassColorAttachmentInfo) * descriptor->colorAttachmentCount);
+        command->info.colorAttachments = colorAttachments;
+    }
+
+    if (descriptor->depthStencilAttachment) {
+        command->depthStencilAttachment = *descriptor->depthStencilAttachment;
+        command->info.depthStencilAttachment = &command->depthStencilAttachment;
+    }
+
+    NkRenderPassEncoder passEncoder =
+        NK_PTR_CAST(NkRenderPassEncoder, NK_MALLOC(sizeof(struct NkRenderPassEncoderImpl)));
+    NK_ASSERT(passEncoder);
+
+    passEncoder->commandEncoder = commandEncoder;
+
+    return passEncoder;
+}
+
+void nkCommandEncoderCopyBufferToBuffer(NkCommandEncoder commandEncoder, NkBuffer source, uint64_t sourceOffset, NkBuffer destination, uint64_t destinationOffset, uint64_t size) {
+
+}
+
+void nkCommandEncoderCopyBufferToTexture(NkCommandEncoder commandEncoder, const NkBufferCopyView* source, const NkTextureCopyView* destination, const NkExtent3D* copySize) {
+
+}
+
+void nkCommandEncoderCopyTextureToBuffer(NkCommandEncoder commandEncoder, const NkTextureCopyView* source, const NkBufferCopyView* destination, const NkExtent3D* copySize) {
+
+}
+
+void nkCommandEncoderCopyTextureToTexture(NkCommandEncoder commandEncoder, const NkTextureCopyView* source, const NkTextureCopyView* destination, const NkExtent3D* copySize) {
+
+}
+
+NkCommandBuffer nkCommandEncoderFinish(NkCommandEncoder commandEncoder) {
+
+    NK_ASSERT(commandEncoder);
+
+    NkCommandBuffer commandBuffer = NK_PTR_CAST(NkCommandBuffer, NK_MALLOC(sizeof(struct NkCommandBufferImpl)));
+    NK_ASSERT(commandBuffer);
+
+    commandBuffer->allocator = commandEncoder->allocator;
+    commandBuffer->commands = commandEncoder->commands;
+    commandBuffer->commandCount = commandEncoder->commandCount;
+
+    NK_FREE(commandEncoder);
+    return commandBuffer;
+}
+
+typedef struct NkCommandEncoderGenerateMipmapsCommand {
+    NkCommandType type;
+    NkTexture texture;
+    uint32_t baseMipLevel;
+    uint32_t levelCount;
+} NkCommandEncoderGenerateMipmapsCommand;
+
+void nkCommandEncoderGenerateMipmaps(NkCommandEncoder commandEncoder, NkTexture texture, uint32_t baseMipLevel, uint32_t levelCount) {
+
+    NK_ASSERT(commandEncoder);
+    NK_ASSERT(texture);
+
+    NkCommandEncoderGenerateMipmapsCommand* command =
+        NK_PTR_CAST(NkCommandEncoderGenerateMipmapsCommand*,
+            nkCommandEncoderAllocateCommand(commandEncoder,
+            sizeof(NkCommandEncoderGenerateMipmapsCommand),
+            NK_ALIGN_OF(NkCommandEncoderGenerateMipmapsCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_CommandEncoderGenerateMipmaps;
+    command->texture = texture;
+    command->baseMipLevel = baseMipLevel;
+    command->levelCount = levelCount;
+}
+
+void nkCommandEncoderInsertDebugMarker(NkCommandEncoder commandEncoder, const char* markerLabel) {
+
+}
+
+void nkCommandEncoderPopDebugGroup(NkCommandEncoder commandEncoder) {
+
+}
+
+void nkCommandEncoderPushDebugGroup(NkCommandEncoder commandEncoder, const char* groupLabel) {
+
+}
+
+void nkCommandEncoderResolveQuerySet(NkCommandEncoder commandEncoder, NkQuerySet querySet, uint32_t firstQuery, uint32_t queryCount, NkBuffer destination, uint64_t destinationOffset) {
+
+}
+
+void nkCommandEncoderWriteTimestamp(NkCommandEncoder commandEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+
+}
+
+// Methods of ComputePassEncoder
+void nkComputePassEncoderBeginPipelineStatisticsQuery(NkComputePassEncoder computePassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+
+}
+
+typedef struct NkComputePassEncoderDispatchCommand {
+    NkCommandType type;
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+} NkComputePassEncoderDispatchCommand;
+
+void nkComputePassEncoderDispatch(NkComputePassEncoder computePassEncoder, uint32_t x, uint32_t y, uint32_t z) {
+
+    NK_ASSERT(computePassEncoder);
+
+    NkComputePassEncoderDispatchCommand* command =
+        NK_PTR_CAST(NkComputePassEncoderDispatchCommand*,
+            nkCommandEncoderAllocateCommand(computePassEncoder->commandEncoder,
+            sizeof(NkComputePassEncoderDispatchCommand),
+            NK_ALIGN_OF(NkComputePassEncoderDispatchCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_ComputePassEncoderDispatch;
+    command->x = x;
+    command->y = y;
+    command->z = z;
+}
+
+void nkComputePassEncoderDispatchIndirect(NkComputePassEncoder computePassEncoder, NkBuffer indirectBuffer, uint64_t indirectOffset) {
+
+}
+
+typedef struct NkComputePassEncoderEndPassCommand {
+    NkCommandType type;
+} NkComputePassEncoderEndPassCommand;
+
+void nkComputePassEncoderEndPass(NkComputePassEncoder computePassEncoder) {
+
+    NK_ASSERT(computePassEncoder);
+
+    NkComputePassEncoderEndPassCommand* command =
+        NK_PTR_CAST(NkComputePassEncoderEndPassCommand*,
+            nkCommandEncoderAllocateCommand(computePassEncoder->commandEncoder,
+            sizeof(NkComputePassEncoderEndPassCommand),
+            NK_ALIGN_OF(NkComputePassEncoderEndPassCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_ComputePassEncoderEndPass;
+
+    NK_FREE(computePassEncoder);
+}
+
+void nkComputePassEncoderEndPipelineStatisticsQuery(NkComputePassEncoder computePassEncoder) {
+
+}
+
+void nkComputePassEncoderInsertDebugMarker(NkComputePassEncoder computePassEncoder, const char* markerLabel) {
+
+}
+
+void nkComputePassEncoderPopDebugGroup(NkComputePassEncoder computePassEncoder) {
+
+}
+
+void nkComputePassEncoderPushDebugGroup(NkComputePassEncoder computePassEncoder, const char* groupLabel) {
+
+}
+
+void nkComputePassEncoderSetBindGroup(NkComputePassEncoder computePassEncoder, uint32_t groupIndex, NkBindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+
+    NK_ASSERT(computePassEncoder);
+
+    nkCommandEncoderSetBindGroup(computePassEncoder->commandEncoder, NkCommandType_ComputePassEncoderSetBindGroup,
+        groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+typedef struct NkComputePassEncoderSetPipelineCommand {
+    NkCommandType type;
+    NkComputePipeline pipeline; // its layout is what bind groups are bound against
+} NkComputePassEncoderSetPipelineCommand;
+
+void nkComputePassEncoderSetPipeline(NkComputePassEncoder computePassEncoder, NkComputePipeline pipeline) {
+
+    NK_ASSERT(computePassEncoder);
+    NK_ASSERT(pipeline);
+
+    NkComputePassEncoderSetPipelineCommand* command =
+        NK_PTR_CAST(NkComputePassEncoderSetPipelineCommand*,
+            nkCommandEncoderAllocateCommand(computePassEncoder->commandEncoder,
+            sizeof(NkComputePassEncoderSetPipelineCommand),
+            NK_ALIGN_OF(NkComputePassEncoderSetPipelineCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_ComputePassEncoderSetPipeline;
+    command->pipeline = pipeline;
+}
+
+void nkComputePassEncoderWriteTimestamp(NkComputePassEncoder computePassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+
+}
+
+// Methods of RenderPassEncoder
+void nkRenderPassEncoderBeginOcclusionQuery(NkRenderPassEncoder renderPassEncoder, uint32_t queryIndex) {
+
+}
+
+void nkRenderPassEncoderBeginPipelineStatisticsQuery(NkRenderPassEncoder renderPassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+
+}
+
+typedef struct NkRenderPassEncoderDraw {
+    NkCommandType type;
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
+} NkRenderPassEncoderDraw;
+
+void nkRenderPassEncoderDraw(NkRenderPassEncoder renderPassEncoder, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderDraw* command =
+        NK_PTR_CAST(NkRenderPassEncoderDraw*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderDraw),
+            NK_ALIGN_OF(NkRenderPassEncoderDraw)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderDraw;
+    command->vertexCount = vertexCount;
+    command->instanceCount = instanceCount;
+    command->firstVertex = firstVertex;
+    command->firstInstance = firstInstance;
+}
+
+void nkRenderPassEncoderDrawIndexed(NkRenderPassEncoder renderPassEncoder, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) {
+
+}
+
+void nkRenderPassEncoderDrawIndexedIndirect(NkRenderPassEncoder renderPassEncoder, NkBuffer indirectBuffer, uint64_t indirectOffset) {
+
+}
+
+void nkRenderPassEncoderDrawIndirect(NkRenderPassEncoder renderPassEncoder, NkBuffer indirectBuffer, uint64_t indirectOffset) {
+
+}
+
+void nkRenderPassEncoderEndOcclusionQuery(NkRenderPassEncoder renderPassEncoder) {
+
+}
+
+typedef struct NkRenderPassEncoderEndPassCommand {
+    NkCommandType type;
+} NkRenderPassEncoderEndPassCommand;
+
+void nkRenderPassEncoderEndPass(NkRenderPassEncoder renderPassEncoder) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderEndPassCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderEndPassCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderEndPassCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderEndPassCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderEndPass;
+
+    NK_FREE(renderPassEncoder);
+}
+
+void nkRenderPassEncoderEndPipelineStatisticsQuery(NkRenderPassEncoder renderPassEncoder) {
+
+}
+
+void nkRenderPassEncoderExecuteBundles(NkRenderPassEncoder renderPassEncoder, uint32_t bundlesCount, const NkRenderBundle* bundles) {
+
+}
+
+void nkRenderPassEncoderInsertDebugMarker(NkRenderPassEncoder renderPassEncoder, const char* markerLabel) {
+
+}
+
+void nkRenderPassEncoderPopDebugGroup(NkRenderPassEncoder renderPassEncoder) {
+
+}
+
+void nkRenderPassEncoderPushDebugGroup(NkRenderPassEncoder renderPassEncoder, const char* groupLabel) {
+
+}
+
+typedef struct NkRenderPassEncoderPushBindGroupCommand {
+    NkCommandType type;
+    uint32_t groupIndex;
+    uint32_t entryCount;
+    const NkBindGroupEntry* entries; // copied next to the command
+} NkRenderPassEncoderPushBindGroupCommand;
+
+void nkRenderPassEncoderPushBindGroup(NkRenderPassEncoder renderPassEncoder, uint32_t groupIndex, uint32_t entryCount, const NkBindGroupEntry* entries) {
+
+    NK_ASSERT(renderPassEncoder);
+    NK_ASSERT(entryCount == 0 || entries);
+
+    NkRenderPassEncoderPushBindGroupCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderPushBindGroupCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderPushBindGroupCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderPushBindGroupCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderPushBindGroup;
+    command->groupIndex = groupIndex;
+    command->entryCount = entryCount;
+    command->entries = NK_NULL;
+
+    if (entryCount > 0) {
+        NkBindGroupEntry* copiedEntries =
+            NK_PTR_CAST(NkBindGroupEntry*,
+                nkCommandAllocatorAllocate(&renderPassEncoder->commandEncoder->allocator,
+                NK_CAST(uint32_t, sizeof(NkBindGroupEntry) * entryCount),
+                NK_ALIGN_OF(NkBindGroupEntry)));
+        NK_ASSERT(copiedEntries);
+        memcpy(copiedEntries, entries, sizeof(NkBindGroupEntry) * entryCount);
+        command->entries = copiedEntries;
+    }
+}
+
+void nkRenderPassEncoderSetBindGroup(NkRenderPassEncoder renderPassEncoder, uint32_t groupIndex, NkBindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    nkCommandEncoderSetBindGroup(renderPassEncoder->commandEncoder, NkCommandType_RenderPassEncoderSetBindGroup,
+        groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+void nkRenderPassEncoderSetBlendColor(NkRenderPassEncoder renderPassEncoder, const NkColor* color) {
+
+}
+
+void nkRenderPassEncoderSetIndexBuffer(NkRenderPassEncoder renderPassEncoder, NkBuffer buffer, uint64_t offset, uint64_t size) {
+
+}
+
+typedef struct NkRenderPassEncoderSetPipelineCommand {
+    NkCommandType type;
+    NkRenderPipeline pipeline; // its layout is what pushed bind groups are written against
+} NkRenderPassEncoderSetPipelineCommand;
+
+void nkRenderPassEncoderSetPipeline(NkRenderPassEncoder renderPassEncoder, NkRenderPipeline pipeline) {
+
+    NK_ASSERT(renderPassEncoder);
+    NK_ASSERT(pipeline);
+
+    NkRenderPassEncoderSetPipelineCommand* command = 
+        NK_PTR_CAST(NkRenderPassEncoderSetPipelineCommand*, 
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetPipelineCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetPipelineCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetPipeline;
+    command->pipeline = pipeline;
+}
+
+void nkRenderPassEncoderSetScissorRect(NkRenderPassEncoder renderPassEncoder, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+
+}
+
+void nkRenderPassEncoderSetStencilReference(NkRenderPassEncoder renderPassEncoder, uint32_t reference) {
+
+}
+
+typedef struct NkRenderPassEncoderSetVertexBuffer {
+    NkCommandType type;
+    uint32_t slot;
+    NkBuffer buffer;
+    uint64_t offset;
+} NkRenderPassEncoderSetVertexBuffer;
+
+void nkRenderPassEncoderSetVertexBuffer(NkRenderPassEncoder renderPassEncoder, uint32_t slot, NkBuffer buffer, uint64_t offset, uint64_t size) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderSetVertexBuffer* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetVertexBuffer*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+                sizeof(NkRenderPassEncoderSetVertexBuffer),
+                NK_ALIGN_OF(NkRenderPassEncoderSetVertexBuffer)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetVertexBuffer;
+    command->slot = slot;
+    command->buffer = buffer;
+    command->offset = offset;
+}
+
+void nkRenderPassEncoderSetViewport(NkRenderPassEncoder renderPassEncoder, float x, float y, float width, float height, float minDepth, float maxDepth) {
+
+}
+
+void nkRenderPassEncoderWriteTimestamp(NkRenderPassEncoder renderPassEncoder, NkQuerySet querySet, uint32_t queryIndex) {
+
+}
+
+typedef struct NkRenderPassEncoderSetColorStateCommand {
+    NkCommandType type;
+    uint32_t attachment;
+    NkBool blendEnabled;
+    NkBlendInfo alphaBlend;
+    NkBlendInfo colorBlend;
+    NkColorWriteMaskFlags writeMask;
+} NkRenderPassEncoderSetColorStateCommand;
+
+void nkRenderPassEncoderSetColorState(NkRenderPassEncoder renderPassEncoder, uint32_t attachment, const NkColorStateInfo* colorState) {
+
+    NK_ASSERT(renderPassEncoder);
+    NK_ASSERT(colorState);
+
+    NkRenderPassEncoderSetColorStateCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetColorStateCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetColorStateCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetColorStateCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetColorState;
+    command->attachment = attachment;
+    command->blendEnabled = colorState->blendEnabled;
+    command->alphaBlend = colorState->alphaBlend;
+    command->colorBlend = colorState->colorBlend;
+    command->writeMask = colorState->writeMask;
+}
+
+typedef struct NkRenderPassEncoderSetCullModeCommand {
+    NkCommandType type;
+    NkCullMode cullMode;
+} NkRenderPassEncoderSetCullModeCommand;
+
+void nkRenderPassEncoderSetCullMode(NkRenderPassEncoder renderPassEncoder, NkCullMode cullMode) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderSetCullModeCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetCullModeCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetCullModeCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetCullModeCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetCullMode;
+    command->cullMode = cullMode;
+}
+
+typedef struct NkRenderPassEncoderSetDepthClampCommand {
+    NkCommandType type;
+    NkBool enabled;
+} NkRenderPassEncoderSetDepthClampCommand;
+
+void nkRenderPassEncoderSetDepthClamp(NkRenderPassEncoder renderPassEncoder, NkBool enabled) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderSetDepthClampCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetDepthClampCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetDepthClampCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetDepthClampCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetDepthClamp;
+    command->enabled = enabled;
+}
+
+typedef struct NkRenderPassEncoderSetDepthTestCommand {
+    NkCommandType type;
+    NkBool enabled;
+    NkBool writeEnabled;
+    NkCompareFunction compare;
+} NkRenderPassEncoderSetDepthTestCommand;
+
+void nkRenderPassEncoderSetDepthTest(NkRenderPassEncoder renderPassEncoder, NkBool enabled, NkBool writeEnabled, NkCompareFunction compare) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderSetDepthTestCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetDepthTestCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetDepthTestCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetDepthTestCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetDepthTest;
+    command->enabled = enabled;
+    command->writeEnabled = writeEnabled;
+    command->compare = compare;
+}
+
+typedef struct NkRenderPassEncoderSetFrontFaceCommand {
+    NkCommandType type;
+    NkFrontFace frontFace;
+} NkRenderPassEncoderSetFrontFaceCommand;
+
+void nkRenderPassEncoderSetFrontFace(NkRenderPassEncoder renderPassEncoder, NkFrontFace frontFace) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderSetFrontFaceCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetFrontFaceCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetFrontFaceCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetFrontFaceCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetFrontFace;
+    command->frontFace = frontFace;
+}
+
+typedef struct NkRenderPassEncoderSetPrimitiveTopologyCommand {
+    NkCommandType type;
+    NkPrimitiveTopology topology;
+} NkRenderPassEncoderSetPrimitiveTopologyCommand;
+
+void nkRenderPassEncoderSetPrimitiveTopology(NkRenderPassEncoder renderPassEncoder, NkPrimitiveTopology topology) {
+
+    NK_ASSERT(renderPassEncoder);
+
+    NkRenderPassEncoderSetPrimitiveTopologyCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetPrimitiveTopologyCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetPrimitiveTopologyCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetPrimitiveTopologyCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetPrimitiveTopology;
+    command->topology = topology;
+}
+
+typedef struct NkRenderPassEncoderSetStencilTestCommand {
+    NkCommandType type;
+    NkBool enabled;
+    NkStencilStateFaceInfo front;
+    NkStencilStateFaceInfo back;
+} NkRenderPassEncoderSetStencilTestCommand;
+
+void nkRenderPassEncoderSetStencilTest(NkRenderPassEncoder renderPassEncoder, NkBool enabled, const NkStencilStateFaceInfo* front, const NkStencilStateFaceInfo* back) {
+
+    NK_ASSERT(renderPassEncoder);
+    NK_ASSERT(front);
+    NK_ASSERT(back);
+
+    NkRenderPassEncoderSetStencilTestCommand* command =
+        NK_PTR_CAST(NkRenderPassEncoderSetStencilTestCommand*,
+            nkCommandEncoderAllocateCommand(renderPassEncoder->commandEncoder,
+            sizeof(NkRenderPassEncoderSetStencilTestCommand),
+            NK_ALIGN_OF(NkRenderPassEncoderSetStencilTestCommand)));
+    NK_ASSERT(command);
+
+    command->type = NkCommandType_RenderPassEncoderSetStencilTest;
+    command->enabled = enabled;
+    command->front = *front;
+    command->back = *back;
+}
+
+#define NK_MAX_BUFFERS 16
+#define NK_MAX_ATTRIBUTES 16
+#define NK_MAX_BIND_GROUPS 4
+#define NK_MAX_COLOR_ATTACHMENTS 8
+#define NK_MAX_SPECIALIZATION_CONSTANTS 32
+#define NK_MAX_BINDINGS_PER_BIND_GROUP 32
+
+#ifdef NK_VULKAN_IMPLEMENTATION
+
+#include <vulkan/vulkan.h>
+#if defined(_WIN32)
+#include <vulkan/vulkan_win32.h>
+#endif
+
+const char* NkVkErrorString(VkResult errorCode)
+{
+    switch (errorCode)
+    {
+#define STR(r) case VK_ ##r: return #r
+        STR(NOT_READY);
+        STR(TIMEOUT);
+        STR(EVENT_SET);
+        STR(EVENT_RESET);
+        STR(INCOMPLETE);
+        STR(ERROR_OUT_OF_HOST_MEMORY);
+        STR(ERROR_OUT_OF_DEVICE_MEMORY);
+        STR(ERROR_INITIALIZATION_FAILED);
+        STR(ERROR_DEVICE_LOST);
+        STR(ERROR_MEMORY_MAP_FAILED);
+        STR(ERROR_LAYER_NOT_PRESENT);
+        STR(ERROR_EXTENSION_NOT_PRESENT);
+        STR(ERROR_FEATURE_NOT_PRESENT);
+        STR(ERROR_INCOMPATIBLE_DRIVER);
+        STR(ERROR_TOO_MANY_OBJECTS);
+        STR(ERROR_FORMAT_NOT_SUPPORTED);
+        STR(ERROR_SURFACE_LOST_KHR);
+        STR(ERROR_NATIVE_WINDOW_IN_USE_KHR);
+        STR(SUBOPTIMAL_KHR);
+        STR(ERROR_OUT_OF_DATE_KHR);
+        STR(ERROR_INCOMPATIBLE_DISPLAY_KHR);
+        STR(ERROR_VALIDATION_FAILED_EXT);
+        STR(ERROR_INVALID_SHADER_NV);
+#undef STR
+    default:
+        return "UNKNOWN_ERROR";
+    }
+}
+
+#define NK_CHECK_VK(x)                                                                              \
+    do {                                                                                            \
+        VkResult err = x;                                                                           \
+        if (err) {                                                                                  \
+            NK_LOG("ERROR: Detected Vulkan error %string at %string:%d.\n", NkVkErrorString(err));  \
+            abort();                                                                                \
+        }                                                                                           \
+    } while (0)
+
+#define NK_ASSERT_VK_HANDLE(handle)                             \
+    do {                                                        \
+        if ((handle) == VK_NULL_HANDLE) {                       \
+            NK_LOG("ERROR: Handle is NULL at %string:%d.\n");   \
+            abort();                                            \
+        }                                                       \
+    } while (0)
+
+static const char* NkDeviceExtensions[] = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
+
+static uint32_t NkDeviceExtensionCount
+    = sizeof(NkDeviceExtensions) / sizeof(NkDeviceExtensions[0]);
+
+static const char* NkInstanceExtensions[] = {
+    VK_KHR_SURFACE_EXTENSION_NAME,
+#if defined(_WIN32)
+    VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+#endif
+    VK_EXT_DEBUG_UTILS_EXTENSION_NAME
+};
+
+static uint32_t NkInstanceExtensionCount 
+    = sizeof(NkInstanceExtensions) / sizeof(NkInstanceExtensions[0]);
+
+static const char* NkValidationLayers[] = {
+    "VK_LAYER_KHRONOS_validation"
+};
+
+static uint32_t NkValidationLayerCount
+    = sizeof(NkValidationLayers) / sizeof(NkValidationLayers[0]);
+
+#ifdef NDEBUG
+const NkBool NkEnableValidationLayers = NkFalse;
+#else
+const NkBool NkEnableValidationLayers = NkTrue;
+#endif
+
+// What a shader module declares, as found by nkVkReflectShader.
+
+typedef enum NkVkShaderBaseType {
+    NkVkShaderBaseType_Float,
+    NkVkShaderBaseType_Int,
+    NkVkShaderBaseType_UInt,
+} NkVkShaderBaseType;
+
+typedef struct NkVkShaderInput {
+    uint32_t location;
+    uint32_t componentCount;
+    NkVkShaderBaseType baseType;
+} NkVkShaderInput;
+
+typedef struct NkVkShaderBinding {
+    uint32_t group;
+    NkBindGroupLayoutEntry entry;
+} NkVkShaderBinding;
+
+typedef struct NkVkShaderReflection {
+    NkVkShaderBinding* bindings;
+    uint32_t bindingCount;
+    NkVkShaderInput* inputs;
+    uint32_t inputCount;
+    uint32_t pushConstantSize;
+} NkVkShaderReflection;
+
+// any structs with int32_t foo are unimplemented. This is just to let the code compile in C mode, where empty structs are illegal.
+
+struct NkBindGroupImpl {
+    NkDevice device;
+    struct NkBindGroupLayoutImpl* layout; // NK_NULL for bind groups the device owns, which hold no reference
+    VkDescriptorSet set;
+    uint64_t hash;
+    uint32_t refCount;
+};
+
+#define NK_VK_DESCRIPTOR_TYPE_COUNT 11 // VK_DESCRIPTOR_TYPE_SAMPLER to VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+
+// Every set allocated for a layout has the same shape, so each layout gets pools sized for exactly its sets.
+// Nothing in them ever fragments, and sets of destroyed bind groups are kept for the next bind group to reuse.
+typedef struct NkVkDescriptorPools {
+    VkDescriptorPoolSize sizes[NK_VK_DESCRIPTOR_TYPE_COUNT]; // per set
+    uint32_t sizeCount;
+    VkDescriptorPool* pools;
+    uint32_t poolCount;
+    uint32_t setsLeft;  // in the newest pool
+    uint32_t nextPoolSets;
+    VkDescriptorSet* freeSets;
+    uint32_t freeSetCount;
+    uint32_t freeSetCapacity;
+} NkVkDescriptorPools;
+
+struct NkBindGroupLayoutImpl {
+    NkDevice device;
+    VkDescriptorSetLayout layout;
+    uint64_t hash;
+    uint32_t refCount;
+    NkBindGroupLayoutEntry* entries; // sorted by binding
+    uint32_t entryCount;
+    NkBool perDraw;
+    NkBool pushed; // perDraw on a device with push descriptors, there are no sets of this layout
+    NkVkDescriptorPools descriptorPools; // guarded by the device's bindGroupMutex
+    VkDescriptorUpdateTemplate updateTemplate; // VK_NULL_HANDLE for layouts without bindings or sets
+    uint32_t* descriptorOffsets; // per entry, where its first descriptor sits in the data the template reads
+    uint32_t descriptorCount;
+};
+
+// One slot of the packed array a bind group layout's update template reads, every descriptor takes one.
+typedef union NkVkDescriptorData {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+} NkVkDescriptorData;
+
+struct NkBufferImpl {
+    NkDevice device;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint64_t size;
+    uint64_t id;
+    NkBufferUsageFlags usage;
+    void* mapped; // host visible buffers stay mapped for their whole life
+    uint32_t bindlessIndex;
+    VkDeviceAddress deviceAddress; // queried once at creation, zero without NkBufferUsage_DeviceAddress
+};
+
+struct NkComputePipelineImpl {
+    NkDevice device;
+    VkPipeline pipeline;
+    struct NkPipelineLayoutImpl* layout;
+};
+
+typedef struct NkVkQueueFamilyIndices {
+    uint32_t graphicsFamily;
+    uint32_t presentFamily;
+} NkVkQueueFamilyIndices;
+
+// A texture nkQueueLoadTexture streams in a level at a time. Its levels share one staging buffer, which is
+// destroyed once the last of them has landed.
+typedef struct NkVkTextureStream {
+    NkTexture texture;
+    NkBuffer staging;
+    NkTextureLevelsResidentCallback levelsResident;
+    void* userdata;
+    uint32_t pendingLevelCount;
+} NkVkTextureStream;
+
+typedef struct NkVkLevelUpload {
+    struct NkVkLevelUpload* next;
+    NkVkTextureStream* stream;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    uint32_t baseMipLevel;
+} NkVkLevelUpload;
+
+struct NkQueueImpl {
+    NkDevice device;
+    VkQueue queue;
+    NkMutex uploadMutex; // guards uploadPool, uploadFence and levelUploads
+    VkCommandPool uploadPool;
+    VkFence uploadFence;
+    NkVkLevelUpload* levelUploads; // streamed levels in submission order, retired by nkDeviceTick
+    NkVkLevelUpload* lastLevelUpload;
+#if defined(NK_IO_URING)
+    NkIoRing* ioRing; // NK_NULL when the kernel has no io_uring, file writes are read on the device's tasks then
+#endif
+};
+
+// Entry points of VK_EXT_extended_dynamic_state 1 to 3, only loaded for the state the device made dynamic.
+typedef struct NkVkDynamicStateFunctions {
+    PFN_vkCmdSetCullModeEXT cmdSetCullMode;
+    PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace;
+    PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology;
+    PFN_vkCmdSetPrimitiveRestartEnableEXT cmdSetPrimitiveRestartEnable;
+    PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable;
+    PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable;
+    PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp;
+    PFN_vkCmdSetStencilTestEnableEXT cmdSetStencilTestEnable;
+    PFN_vkCmdSetStencilOpEXT cmdSetStencilOp;
+    PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable;
+    PFN_vkCmdSetColorBlendEquationEXT cmdSetColorBlendEquation;
+    PFN_vkCmdSetColorWriteMaskEXT cmdSetColorWriteMask;
+    PFN_vkCmdSetDepthClampEnableEXT cmdSetDepthClampEnable;
+} NkVkDynamicStateFunctions;
+
+#define NK_VK_BINDLESS_TABLE_COUNT 3 // one per NkBindlessBinding
+#define NK_VK_BINDLESS_GROUP (NK_MAX_BIND_GROUPS - 1)
+#define NK_VK_BINDLESS_INVALID_INDEX 0xFFFFFFFFu
+
+typedef struct NkVkBindlessTable {
+    uint32_t capacity;
+    uint32_t next;         // lowest index never handed out
+    uint32_t* freeIndices; // indices given back by destroyed objects, handed out again first
+    uint32_t freeCount;
+} NkVkBindlessTable;
+
+struct NkDeviceImpl {
+    NkInstance instance;
+    VkPhysicalDevice physicalDevice;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDevice device;
+    struct NkQueueImpl queue;
+    VkPipelineCache pipelineCache;
+    char* pipelineCachePath;
+    NkBool graphicsPipelineLibrary;
+    NkBool dynamicRendering;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering;
+    NkBool depthClamp;
+    NkBool samplerAnisotropy;
+    NkBool pushDescriptors;
+    PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSet;
+    NkBool bufferDeviceAddress;
+    PFN_vkGetBufferDeviceAddressKHR getBufferDeviceAddress;
+    NkDynamicStateFlags dynamicState; // state render pass encoders set, which pipelines leave out of their hash
+    NkBool dynamicPrimitiveRestart;   // VK_EXT_extended_dynamic_state2, restart follows the dynamic topology
+    NkVkDynamicStateFunctions dynamicStateFunctions;
+    NkBool shaderModuleIdentifiers;
+    PFN_vkGetShaderModuleCreateInfoIdentifierEXT getShaderModuleCreateInfoIdentifier;
+    NkMutex moduleMutex; // guards shaderModules, their reference counts and modules created on first use
+    NkHashMap shaderModules;
+    NkMutex pipelineMutex; // guards renderPipelines, renderPipelineVariants, pipelineLibraries and the reference counts of render pipelines
+    NkHashMap renderPipelines;
+    NkHashMap renderPipelineVariants; // keyed by compiled pipeline and dynamic state, see nkVkGetRenderPipelineVariant
+    NkHashMap pipelineLibraries;
+    NkMutex layoutMutex; // guards bindGroupLayouts, pipelineLayouts and their reference counts
+    NkHashMap bindGroupLayouts;
+    NkHashMap pipelineLayouts;
+    NkMutex renderPassMutex; // guards renderPasses and framebuffers
+    NkHashMap renderPasses;
+    NkHashMap framebuffers;
+    NkMutex bindGroupMutex; // guards bindGroups, their reference counts, descriptor pools and bindGroupFrames
+    NkHashMap bindGroups;
+    struct NkVkBindGroupFrame* bindGroupFrames; // framesInFlight + 1 of them, used round robin by nkDeviceTick
+    uint32_t bindGroupFrameCount;
+    uint32_t bindGroupFrameIndex;
+    NkMutex samplerMutex; // guards samplers and their reference counts
+    NkHashMap samplers; // nkVkHashSampler of the resolved info to its NkSampler, removed by the last nkDestroySampler
+    NkBool bindless;
+    NkMutex bindlessMutex; // guards bindlessTables and writes to the bindless set
+    struct NkBindGroupLayoutImpl* bindlessLayout;
+    VkDescriptorPool bindlessPool;
+    struct NkBindGroupImpl bindlessBindGroup;
+    NkVkBindlessTable bindlessTables[NK_VK_BINDLESS_TABLE_COUNT];
+    NkThreadPool* threadPool; // NK_NULL when the user schedules Neko's tasks themselves
+    NkScheduleTaskCallback scheduleTask;
+    void* scheduleTaskUserdata;
+    uint32_t pipelineBatchSize;
+    NkMutex taskMutex;
+    NkCondition tasksIdle;
+    uint32_t pendingTaskCount;
+    struct NkVkPipelineTask* completedHead;
+    struct NkVkPipelineTask* completedTail;
+};
+
+struct NkFenceImpl {
+    int32_t foo;
+};
+
+struct NkInstanceImpl {
+    VkInstance instance;
+    VkDebugUtilsMessengerEXT debugMessenger;
+};
+
+struct NkPipelineLayoutImpl {
+    NkDevice device;
+    VkPipelineLayout layout;
+    uint64_t hash;
+    uint32_t refCount;
+    struct NkBindGroupLayoutImpl* bindGroupLayouts[NK_MAX_BIND_GROUPS];
+    uint32_t bindGroupLayoutCount;
+    uint32_t pushConstantSize;
+    VkShaderStageFlags pushConstantStages;
+};
+
+struct NkQuerySetImpl {
+    int32_t foo;
+};
+
+struct NkRenderBundleImpl {
+    int32_t foo;
+};
+
+struct NkRenderBundleEncoderImpl {
+    int32_t foo;
+};
+
+// What a render pipeline's descriptor asked for in the state that device->dynamicState leaves out of the
+// VkPipeline. It's zeroed before it's filled in, so it can be hashed as bytes.
+typedef struct NkVkRenderPipelineDynamicState {
+    VkPrimitiveTopology topology;
+    VkBool32 primitiveRestart;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkBool32 depthClamp;
+    VkBool32 depthTest;
+    VkBool32 depthWrite;
+    VkCompareOp depthCompare;
+    VkBool32 stencilTest;
+    VkStencilOpState stencilFaces[2]; // front then back, only the ops are dynamic
+    uint32_t colorStateCount;
+    VkBool32 blendEnables[NK_MAX_COLOR_ATTACHMENTS];
+    VkColorBlendEquationEXT blendEquations[NK_MAX_COLOR_ATTACHMENTS];
+    VkColorComponentFlags writeMasks[NK_MAX_COLOR_ATTACHMENTS];
+} NkVkRenderPipelineDynamicState;
+
+struct NkRenderPipelineImpl {
+    NkDevice device;
+    struct NkRenderPipelineImpl* compiled; // owner of the VkPipeline, the pipeline itself unless it's a variant
+    VkPipeline pipeline;       // swapped for the optimized pipeline under pipelineMutex, so read it with that held
+    VkPipeline linkedPipeline; // fast-linked pipeline that pipeline replaced, when built from pipeline libraries
+    struct NkPipelineLayoutImpl* layout;
+    NkVkRenderPipelineDynamicState dynamicState; // set when a variant is bound
+    uint64_t hash;
+    uint32_t refCount;
+};
+
+struct NkSamplerImpl {
+    NkDevice device;
+    VkSampler sampler;
+    uint64_t id;
+    uint64_t hash;
+    uint32_t refCount; // samplers are deduplicated, one per distinct NkSamplerInfo
+    uint32_t bindlessIndex;
+};
+
+// With VK_EXT_shader_module_identifier a stage can name its module by identifier instead. The chained info comes
+// first so a stage's pNext leads back to the module, for when a pipeline misses the cache and the code is needed.
+typedef struct NkVkShaderIdentifier {
+    VkPipelineShaderStageModuleIdentifierCreateInfoEXT info;
+    VkShaderModuleIdentifierEXT identifier;
+    struct NkShaderModuleImpl* module;
+} NkVkShaderIdentifier;
+
+struct NkShaderModuleImpl {
+    NkDevice device;
+    VkShaderModule module; // created on first use when the device passes identifiers
+    uint64_t hash;         // of the code, which is also what pipelines are keyed on
+    uint32_t refCount;
+    uint32_t* code;        // only kept while the module may still have to be created
+    uint32_t codeSize;
+    NkVkShaderIdentifier identifier;
+    NkVkShaderReflection reflection;
+};
+
+struct NkSurfaceImpl {
+    VkInstance instance;
+    VkSurfaceKHR surface;
+};
+
+struct NkSwapChainImpl {
+    VkDevice device;
+    VkSwapchainKHR swapChain;
+    VkImage* swapChainImages;
+    uint32_t swapChainImageCount;
+    struct NkTextureViewImpl* swapChainTextureViews;
+    uint32_t currentFrame;
+};
+
+#define NK_VK_INLINE_TEXTURE_VIEWS 4
+
+typedef struct NkVkTextureViewEntry {
+    uint64_t key; // the resolved NkTextureViewInfo, packed by nkVkPackTextureViewInfo
+    struct NkTextureViewImpl* view;
+} NkVkTextureViewEntry;
+
+struct NkTextureImpl {
+    NkDevice device;
+    VkImage image;
+    VkDeviceMemory memory;
+    uint64_t id;
+    NkTextureUsageFlags usage;
+    NkTextureDimension dimension;
+    NkTextureFormat format;
+    VkFormat imageFormat;
+    NkExtent3D size; // depth is 1 for anything but 3D textures
+    uint32_t mipLevelCount;
+    uint32_t arrayLayerCount;
+    VkSampleCountFlagBits sampleCount;
+    VkImageLayout layout; // every subresource rests in it between commands, undefined until the texture is written
+    NkMutex viewMutex; // guards views and their reference counts
+    NkVkTextureViewEntry* views; // inlineViews, until the texture needs more views than fit there
+    uint32_t viewCount;
+    uint32_t viewCapacity;
+    NkVkTextureViewEntry inlineViews[NK_VK_INLINE_TEXTURE_VIEWS];
+};
+
+struct NkTextureViewImpl {
+    NkDevice device;
+    NkTexture texture; // NK_NULL for swap chain views
+    uint32_t refCount;
+    VkImageView imageView;
+    VkImage image;
+    uint64_t id;
+    VkFormat format;
+    VkExtent2D extent;
+    VkSampleCountFlagBits sampleCount;
+    VkImageSubresourceRange subresourceRange;
+    NkBool presentable; // swap chain images rest in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR between passes
+    uint32_t bindlessIndex;
+};
+
+static NkBool nkVkCheckValidationLayerSupport() {
+
+    uint32_t layerCount;
+    NK_CHECK_VK(vkEnumerateInstanceLayerProperties(&layerCount, NK_NULL));
+
+    if (layerCount != 0)
+    {
+        VkLayerProperties* availableLayers = NK_PTR_CAST(VkLayerProperties*, NK_MALLOC(sizeof(VkLayerProperties) * layerCount));
+        NK_ASSERT(availableLayers);
+
+        NK_CHECK_VK(vkEnumerateInstanceLayerProperties(&layerCount, availableLayers));
+
+        for (uint32_t i = 0; i < NkValidationLayerCount; i++)
+        {
+            const char* layerName = NkValidationLayers[i];
+            NkBool layerFound = NkFalse;
+
+            for (uint32_t j = 0; j < layerCount; j++) {
+                if (strcmp(layerName, availableLayers[j].layerName) == 0) {
+                    layerFound = NkTrue;
+                    break;
+                }
+            }
+
+            if (!layerFound) {
+                return NkFalse;
+            }
+        }
+
+        return NkTrue;
+    }
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL nkVkDebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
+    if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        NK_LOG(pCallbackData->pMessage);
+    }
+    return VK_FALSE;
+}
+
+static VkResult nkVkCreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
+
+    NK_ASSERT_VK_HANDLE(instance);
+    NK_ASSERT(pCreateInfo);
+    NK_ASSERT(pDebugMessenger);
+
+    PFN_vkCreateDebugUtilsMessengerEXT func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+    if (func != NK_NULL) {
+        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    }
+    else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+static void nkVkDestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
+
+    NK_ASSERT_VK_HANDLE(instance);
+    NK_ASSERT_VK_HANDLE(debugMessenger);
+
+    PFN_vkDestroyDebugUtilsMessengerEXT func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (func != NK_NULL) {
+        func(instance, debugMessenger, pAllocator);
+    }
+}
+
+NkInstance nkCreateInstance() {
+
+    if (NkEnableValidationLayers) {
+        NK_ASSERT(nkVkCheckValidationLayerSupport());
+    }
+
+    NkInstance instance = NK_PTR_CAST(NkInstance, NK_MALLOC(sizeof(struct NkInstanceImpl)));
+    NK_ASSERT(instance);
+
+    VkApplicationInfo appInfo;
+    {
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pNext = NK_NULL;
+        appInfo.pApplicationName = "Neko";
+        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.pEngineName = "Neko";
+        appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+    }
+
+    VkInstanceCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.pApplicationInfo = &appInfo;
+        createInfo.enabledExtensionCount = sizeof(NkInstanceExtensions) / sizeof(NkInstanceExtensions[0]);
+        createInfo.ppEnabledExtensionNames = NkInstanceExtensions;
+        if (NkEnableValidationLayers) {
+            createInfo.enabledLayerCount = NkValidationLayerCount;
+            createInfo.ppEnabledLayerNames = NkValidationLayers;
+        }
+        else {
+            createInfo.enabledLayerCount = 0;
+        }
+    }
+
+    NK_CHECK_VK(vkCreateInstance(&createInfo, NK_NULL, &instance->instance));
+
+    VkDebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo;
+    {
+        debugMessengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+        debugMessengerCreateInfo.flags = 0;
+        debugMessengerCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        debugMessengerCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        debugMessengerCreateInfo.pfnUserCallback = nkVkDebugCallback;
+        debugMessengerCreateInfo.pUserData = NK_NULL;
+    }
+
+    NK_CHECK_VK(nkVkCreateDebugUtilsMessengerEXT(instance->instance, &debugMessengerCreateInfo, NK_NULL, &instance->debugMessenger));
+
+    return instance;
+}
+
+// SPIR-V reflection. Shader modules are walked once when they're created, and what they declare is kept
+// around so pipelines can build their layouts without being handed one.
+
+#define NK_SPIRV_MAGIC 0x07230203
+
+typedef enum NkVkSpirvOp {
+    NkVkSpirvOp_EntryPoint = 15,
+    NkVkSpirvOp_TypeInt = 21,
+    NkVkSpirvOp_TypeFloat = 22,
+    NkVkSpirvOp_TypeVector = 23,
+    NkVkSpirvOp_TypeMatrix = 24,
+    NkVkSpirvOp_TypeImage = 25,
+    NkVkSpirvOp_TypeSampler = 26,
+    NkVkSpirvOp_TypeSampledImage = 27,
+    NkVkSpirvOp_TypeArray = 28,
+    NkVkSpirvOp_TypeRuntimeArray = 29,
+    NkVkSpirvOp_TypeStruct = 30,
+    NkVkSpirvOp_TypePointer = 32,
+    NkVkSpirvOp_Constant = 43,
+    NkVkSpirvOp_Function = 54,
+    NkVkSpirvOp_Variable = 59,
+    NkVkSpirvOp_Decorate = 71,
+    NkVkSpirvOp_MemberDecorate = 72,
+} NkVkSpirvOp;
+
+typedef enum NkVkSpirvDecoration {
+    NkVkSpirvDecoration_Block = 2,
+    NkVkSpirvDecoration_BufferBlock = 3,
+    NkVkSpirvDecoration_ArrayStride = 6,
+    NkVkSpirvDecoration_BuiltIn = 11,
+    NkVkSpirvDecoration_NonWritable = 24,
+    NkVkSpirvDecoration_NonReadable = 25,
+    NkVkSpirvDecoration_Location = 30,
+    NkVkSpirvDecoration_Binding = 33,
+    NkVkSpirvDecoration_DescriptorSet = 34,
+    NkVkSpirvDecoration_Offset = 35,
+} NkVkSpirvDecoration;
+
+typedef enum NkVkSpirvStorageClass {
+    NkVkSpirvStorageClass_UniformConstant = 0,
+    NkVkSpirvStorageClass_Input = 1,
+    NkVkSpirvStorageClass_Uniform = 2,
+    NkVkSpirvStorageClass_PushConstant = 9,
+    NkVkSpirvStorageClass_StorageBuffer = 12,
+} NkVkSpirvStorageClass;
+
+#define NK_SPIRV_DIM_BUFFER 5
+#define NK_SPIRV_DIM_SUBPASS_DATA 6
+
+#define NK_SPIRV_FLAG_SET (1u << 0)
+#define NK_SPIRV_FLAG_BINDING (1u << 1)
+#define NK_SPIRV_FLAG_LOCATION (1u << 2)
+#define NK_SPIRV_FLAG_BLOCK (1u << 3)
+#define NK_SPIRV_FLAG_BUFFER_BLOCK (1u << 4)
+#define NK_SPIRV_FLAG_BUILT_IN (1u << 5)
+#define NK_SPIRV_FLAG_NON_WRITABLE (1u << 6)
+#define NK_SPIRV_FLAG_NON_READABLE (1u << 7)
+
+// What the parser remembers about a single SPIR-V id. The meaning of the operands depends on the opcode
+// that defined the id, e.g. element type and length for arrays, or storage class and pointee for pointers.
+typedef struct NkVkSpirvId {
+    uint32_t opcode;
+    uint32_t operands[3];
+    uint32_t size;
+    uint32_t flags;
+    uint32_t set;
+    uint32_t binding;
+    uint32_t location;
+    uint32_t arrayStride;
+    uint32_t nonWritableMemberCount; // readonly blocks decorate each member rather than the variable
+} NkVkSpirvId;
+
+typedef struct NkVkSpirvMemberOffset {
+    uint32_t structId;
+    uint32_t member;
+    uint32_t offset;
+} NkVkSpirvMemberOffset;
+
+static uint32_t nkVkSpirvMemberOffset(const NkVkSpirvMemberOffset* offsets, uint32_t offsetCount, uint32_t structId, uint32_t member, uint32_t fallback) {
+
+    for (uint32_t i = 0; i < offsetCount; i++) {
+        if (offsets[i].structId == structId && offsets[i].member == member) {
+            return offsets[i].offset;
+        }
+    }
+    return fallback;
+}
+
+static NkBool nkVkReflectBindingType(const NkVkSpirvId* ids, uint32_t bound, const NkVkSpirvId* variable, uint32_t storageClass, uint32_t typeId, NkVkShaderBinding* binding) {
+
+    NK_ASSERT(typeId < bound);
+
+    // Arrays of resources become a single binding with an array size. Runtime arrays are left unsized.
+    binding->entry.arraySize = 1;
+    if (ids[typeId].opcode == NkVkSpirvOp_TypeArray) {
+        binding->entry.arraySize = ids[typeId].operands[1];
+        typeId = ids[typeId].operands[0];
+    }
+    else if (ids[typeId].opcode == NkVkSpirvOp_TypeRuntimeArray) {
+        binding->entry.arraySize = 0;
+        typeId = ids[typeId].operands[0];
+    }
+
+    NK_ASSERT(typeId < bound);
+    const NkVkSpirvId* type = ids + typeId;
+
+    if (storageClass == NkVkSpirvStorageClass_StorageBuffer ||
+        (storageClass == NkVkSpirvStorageClass_Uniform && (type->flags & NK_SPIRV_FLAG_BUFFER_BLOCK))) {
+        binding->entry.type = ((variable->flags | type->flags) & NK_SPIRV_FLAG_NON_WRITABLE) ?
+            NkBindingType_ReadonlyStorageBuffer : NkBindingType_StorageBuffer;
+        binding->entry.minBufferBindingSize = type->size;
+        return NkTrue;
+    }
+
+    if (storageClass == NkVkSpirvStorageClass_Uniform) {
+        binding->entry.type = NkBindingType_UniformBuffer;
+        binding->entry.minBufferBindingSize = type->size;
+        return NkTrue;
+    }
+
+    switch (type->opcode) {
+    case NkVkSpirvOp_TypeSampler:
+        binding->entry.type = NkBindingType_Sampler;
+        return NkTrue;
+    case NkVkSpirvOp_TypeSampledImage:
+        binding->entry.type = NkBindingType_CombinedTextureSampler;
+        return NkTrue;
+    case NkVkSpirvOp_TypeImage:
+        // Texel buffers and input attachments have no Neko binding type yet.
+        if (type->operands[0] == NK_SPIRV_DIM_BUFFER || type->operands[0] == NK_SPIRV_DIM_SUBPASS_DATA) {
+            return NkFalse;
+        }
+        if (type->operands[2] == 2) {
+            binding->entry.type = (variable->flags & NK_SPIRV_FLAG_NON_WRITABLE) ?
+                NkBindingType_ReadonlyStorageTexture : NkBindingType_WriteonlyStorageTexture;
+        }
+        else {
+            binding->entry.multisampled = type->operands[1] ? NkTrue : NkFalse;
+            binding->entry.type = binding->entry.multisampled ?
+                NkBindingType_MultisampledTexture : NkBindingType_SampledTexture;
+        }
+        return NkTrue;
+    }
+
+    return NkFalse;
+}
+
+static void nkVkReflectShader(const uint32_t* code, size_t wordCount, NkVkShaderReflection* reflection) {
+
+    NK_ASSERT(reflection);
+
+    reflection->bindings = NK_NULL;
+    reflection->bindingCount = 0;
+    reflection->inputs = NK_NULL;
+    reflection->inputCount = 0;
+    reflection->pushConstantSize = 0;
+
+    if (wordCount < 5 || code[0] != NK_SPIRV_MAGIC) {
+        return;
+    }
+
+    const uint32_t bound = code[3];
+
+    NkVkSpirvId* ids = NK_PTR_CAST(NkVkSpirvId*, NK_CALLOC(bound, sizeof(NkVkSpirvId)));
+    NK_ASSERT(ids);
+
+    uint32_t offsetCount = 0;
+    uint32_t offsetCapacity = 16;
+    NkVkSpirvMemberOffset* offsets =
+        NK_PTR_CAST(NkVkSpirvMemberOffset*, NK_MALLOC(sizeof(NkVkSpirvMemberOffset) * offsetCapacity));
+    NK_ASSERT(offsets);
+
+    uint32_t bindingCapacity = 0;
+    uint32_t inputCapacity = 0;
+
+    size_t word = 5;
+    while (word < wordCount) {
+
+        const uint32_t opcode = code[word] & 0xFFFF;
+        const uint32_t length = code[word] >> 16;
+        const uint32_t* operands = code + word + 1;
+
+        if (length == 0 || word + length > wordCount) {
+            break;
+        }
+
+        // Everything reflection cares about is declared before the first function.
+        if (opcode == NkVkSpirvOp_Function) {
+            break;
+        }
+
+        switch (opcode) {
+        case NkVkSpirvOp_Decorate: {
+            NK_ASSERT(operands[0] < bound);
+            NkVkSpirvId* target = ids + operands[0];
+            switch (operands[1]) {
+            case NkVkSpirvDecoration_Block:
+                target->flags |= NK_SPIRV_FLAG_BLOCK;
+                break;
+            case NkVkSpirvDecoration_BufferBlock:
+                target->flags |= NK_SPIRV_FLAG_BUFFER_BLOCK;
+                break;
+            case NkVkSpirvDecoration_ArrayStride:
+                target->arrayStride = operands[2];
+                break;
+            case NkVkSpirvDecoration_BuiltIn:
+                target->flags |= NK_SPIRV_FLAG_BUILT_IN;
+                break;
+            case NkVkSpirvDecoration_NonWritable:
+                target->flags |= NK_SPIRV_FLAG_NON_WRITABLE;
+                break;
+            case NkVkSpirvDecoration_NonReadable:
+                target->flags |= NK_SPIRV_FLAG_NON_READABLE;
+                break;
+            case NkVkSpirvDecoration_Location:
+                target->flags |= NK_SPIRV_FLAG_LOCATION;
+                target->location = operands[2];
+                break;
+            case NkVkSpirvDecoration_Binding:
+                target->flags |= NK_SPIRV_FLAG_BINDING;
+                target->binding = operands[2];
+                break;
+            case NkVkSpirvDecoration_DescriptorSet:
+                target->flags |= NK_SPIRV_FLAG_SET;
+                target->set = operands[2];
+                break;
+            }
+            break;
+        }
+        case NkVkSpirvOp_MemberDecorate:
+            if (operands[2] == NkVkSpirvDecoration_Offset) {
+                if (offsetCount == offsetCapacity) {
+                    offsetCapacity *= 2;
+                    offsets = NK_PTR_CAST(NkVkSpirvMemberOffset*, NK_REALLOC(offsets, sizeof(NkVkSpirvMemberOffset) * offsetCapacity));
+                    NK_ASSERT(offsets);
+                }
+                offsets[offsetCount].structId = operands[0];
+                offsets[offsetCount].member = operands[1];
+                offsets[offsetCount].offset = operands[3];
+                offsetCount++;
+            }
+            else if (operands[2] == NkVkSpirvDecoration_BuiltIn) {
+                NK_ASSERT(operands[0] < bound);
+                ids[operands[0]].flags |= NK_SPIRV_FLAG_BUILT_IN;
+            }
+            else if (operands[2] == NkVkSpirvDecoration_NonWritable) {
+                NK_ASSERT(operands[0] < bound);
+                ids[operands[0]].nonWritableMemberCount++;
+            }
+            break;
+        case NkVkSpirvOp_TypeInt:
+        case NkVkSpirvOp_TypeFloat: {
+            NkVkSpirvId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1]; // width
+            type->operands[1] = opcode == NkVkSpirvOp_TypeInt ? operands[2] : 1; // signedness
+            type->size = operands[1] / 8;
+            break;
+        }
+        case NkVkSpirvOp_TypeVector:
+        case NkVkSpirvOp_TypeMatrix: {
+            NkVkSpirvId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1]; // component or column type
+            type->operands[1] = operands[2]; // component or column count
+            type->size = ids[operands[1]].size * operands[2];
+            break;
+        }
+        case NkVkSpirvOp_TypeImage: {
+            NkVkSpirvId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[2]; // dim
+            type->operands[1] = operands[5]; // multisampled
+            type->operands[2] = operands[6]; // sampled: 1 sampled image, 2 storage image
+            break;
+        }
+        case NkVkSpirvOp_TypeSampler:
+        case NkVkSpirvOp_TypeSampledImage:
+            ids[operands[0]].opcode = opcode;
+            break;
+        case NkVkSpirvOp_TypeArray:
+        case NkVkSpirvOp_TypeRuntimeArray: {
+            NkVkSpirvId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1];
+            type->operands[1] = opcode == NkVkSpirvOp_TypeArray ? ids[operands[2]].operands[0] : 0;
+            const uint32_t stride = type->arrayStride ? type->arrayStride : ids[operands[1]].size;
+            type->size = stride * type->operands[1];
+            break;
+        }
+        case NkVkSpirvOp_TypeStruct: {
+            NkVkSpirvId* type = ids + operands[0];
+            type->opcode = opcode;
+            uint32_t size = 0;
+            for (uint32_t member = 0; member + 2 < length; member++) {
+                const uint32_t offset = nkVkSpirvMemberOffset(offsets, offsetCount, operands[0], member, size);
+                size = NK_MAX(size, offset + ids[operands[member + 1]].size);
+            }
+            type->size = size;
+            // A block is only read-only when none of its members can be written.
+            if (length > 2 && type->nonWritableMemberCount >= length - 2) {
+                type->flags |= NK_SPIRV_FLAG_NON_WRITABLE;
+            }
+            break;
+        }
+        case NkVkSpirvOp_TypePointer: {
+            NkVkSpirvId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1]; // storage class
+            type->operands[1] = operands[2]; // pointee
+            break;
+        }
+        case NkVkSpirvOp_Constant:
+            // Only 32-bit integer constants matter here, they size arrays.
+            ids[operands[1]].opcode = opcode;
+            ids[operands[1]].operands[0] = operands[2];
+            break;
+        case NkVkSpirvOp_Variable: {
+            const NkVkSpirvId* variable = ids + operands[1];
+            const uint32_t storageClass = operands[2];
+            const uint32_t pointeeId = ids[operands[0]].operands[1];
+            NK_ASSERT(pointeeId < bound);
+
+            if (storageClass == NkVkSpirvStorageClass_PushConstant) {
+                reflection->pushConstantSize = NK_MAX(reflection->pushConstantSize, ids[pointeeId].size);
+            }
+            else if (storageClass == NkVkSpirvStorageClass_Input) {
+                const NkVkSpirvId* type = ids + pointeeId;
+                if (!(variable->flags & NK_SPIRV_FLAG_LOCATION) || (variable->flags & NK_SPIRV_FLAG_BUILT_IN) ||
+                    type->opcode == NkVkSpirvOp_TypeStruct) {
+                    break;
+                }
+
+                if (reflection->inputCount == inputCapacity) {
+                    inputCapacity = inputCapacity ? inputCapacity * 2 : 8;
+                    reflection->inputs = NK_PTR_CAST(NkVkShaderInput*, NK_REALLOC(reflection->inputs, sizeof(NkVkShaderInput) * inputCapacity));
+                    NK_ASSERT(reflection->inputs);
+                }
+
+                const NkVkSpirvId* component = type->opcode == NkVkSpirvOp_TypeVector ? ids + type->operands[0] : type;
+
+                NkVkShaderInput* input = reflection->inputs + reflection->inputCount++;
+                input->location = variable->location;
+                input->componentCount = type->opcode == NkVkSpirvOp_TypeVector ? type->operands[1] : 1;
+                input->baseType = component->opcode == NkVkSpirvOp_TypeFloat ? NkVkShaderBaseType_Float :
+                    component->operands[1] ? NkVkShaderBaseType_Int : NkVkShaderBaseType_UInt;
+            }
+            else if (storageClass == NkVkSpirvStorageClass_UniformConstant ||
+                     storageClass == NkVkSpirvStorageClass_Uniform ||
+                     storageClass == NkVkSpirvStorageClass_StorageBuffer) {
+
+                if (!(variable->flags & NK_SPIRV_FLAG_BINDING)) {
+                    break;
+                }
+
+                NkVkShaderBinding binding;
+                memset(&binding, 0, sizeof(binding));
+                binding.group = variable->set;
+                binding.entry.binding = variable->binding;
+
+                if (!nkVkReflectBindingType(ids, bound, variable, storageClass, pointeeId, &binding)) {
+                    NK_LOG("Neko: ignoring unsupported shader resource at set %u, binding %u at %s:%d.\n", variable->set, variable->binding);
+                    break;
+                }
+
+                if (reflection->bindingCount == bindingCapacity) {
+                    bindingCapacity = bindingCapacity ? bindingCapacity * 2 : 8;
+                    reflection->bindings = NK_PTR_CAST(NkVkShaderBinding*, NK_REALLOC(reflection->bindings, sizeof(NkVkShaderBinding) * bindingCapacity));
+                    NK_ASSERT(reflection->bindings);
+                }
+                reflection->bindings[reflection->bindingCount++] = binding;
+            }
+            break;
+        }
+        }
+
+        word += length;
+    }
+
+    NK_FREE(offsets);
+    NK_FREE(ids);
+}
+
+static void nkVkDestroyShaderReflection(NkVkShaderReflection* reflection) {
+
+    NK_FREE(reflection->bindings);
+    NK_FREE(reflection->inputs);
+}
+
+static VkShaderStageFlags nkVkShaderStageFlags(NkShaderStageFlags stages) {
+
+    VkShaderStageFlags flags = 0;
+    if (stages & NkShaderStage_Vertex) {
+        flags |= VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    if (stages & NkShaderStage_Fragment) {
+        flags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    if (stages & NkShaderStage_Compute) {
+        flags |= VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    return flags;
+}
+
+static VkDescriptorType nkVkDescriptorType(const NkBindGroupLayoutEntry* entry) {
+    switch (entry->type) {
+    case NkBindingType_UniformBuffer:
+        return entry->hasDynamicOffset ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case NkBindingType_StorageBuffer:
+    case NkBindingType_ReadonlyStorageBuffer:
+        return entry->hasDynamicOffset ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    case NkBindingType_Sampler:
+    case NkBindingType_ComparisonSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case NkBindingType_SampledTexture:
+    case NkBindingType_MultisampledTexture:
+        return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    case NkBindingType_ReadonlyStorageTexture:
+    case NkBindingType_WriteonlyStorageTexture:
+        return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    case NkBindingType_CombinedTextureSampler:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    default:
+        break;
+    }
+    return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+}
+
+static uint32_t nkVkDescriptorCount(const NkBindGroupLayoutEntry* entry) {
+    return entry->arraySize > 0 ? entry->arraySize : 1;
+}
+
+static void nkVkSortBindGroupLayoutEntries(NkBindGroupLayoutEntry* entries, uint32_t entryCount) {
+
+    for (uint32_t i = 1; i < entryCount; i++) {
+        NkBindGroupLayoutEntry entry = entries[i];
+        uint32_t j = i;
+        while (j > 0 && entries[j - 1].binding > entry.binding) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+// Only what ends up in the VkDescriptorSetLayout is hashed. Two layouts that differ in, say, the texture
+// component type they expect are the same thing to Vulkan, and can share bind groups.
+static uint64_t nkVkHashBindGroupLayoutEntries(const NkBindGroupLayoutEntry* entries, uint32_t entryCount, NkBool perDraw) {
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU32(&hasher, perDraw);
+    nkHashU32(&hasher, entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        nkHashU32(&hasher, entries[i].binding);
+        nkHashU32(&hasher, nkVkDescriptorType(entries + i));
+        nkHashU32(&hasher, nkVkDescriptorCount(entries + i));
+        nkHashU32(&hasher, nkVkShaderStageFlags(entries[i].visibility));
+    }
+    return nkHasherFinish(&hasher);
+}
+
+#define NK_VK_MIN_SETS_PER_POOL 8
+#define NK_VK_MAX_SETS_PER_POOL 1024
+
+static void nkVkInitDescriptorPools(NkVkDescriptorPools* pools, const NkBindGroupLayoutEntry* entries, uint32_t entryCount) {
+
+    memset(pools, 0, sizeof(NkVkDescriptorPools));
+    pools->nextPoolSets = NK_VK_MIN_SETS_PER_POOL;
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const VkDescriptorType type = nkVkDescriptorType(entries + i);
+        VkDescriptorPoolSize* size = NK_NULL;
+        for (uint32_t s = 0; s < pools->sizeCount; s++) {
+            if (pools->sizes[s].type == type) {
+                size = pools->sizes + s;
+                break;
+            }
+        }
+        if (size == NK_NULL) {
+            NK_ASSERT(pools->sizeCount < NK_VK_DESCRIPTOR_TYPE_COUNT);
+            size = pools->sizes + pools->sizeCount++;
+            size->type = type;
+            size->descriptorCount = 0;
+        }
+        size->descriptorCount += nkVkDescriptorCount(entries + i);
+    }
+}
+
+static void nkVkDestroyDescriptorPools(NkDevice device, NkVkDescriptorPools* pools) {
+
+    for (uint32_t i = 0; i < pools->poolCount; i++) {
+        vkDestroyDescriptorPool(device->device, pools->pools[i], NK_NULL);
+    }
+    NK_FREE(pools->pools);
+    NK_FREE(pools->freeSets);
+}
+
+// Bind groups are written through a template made once per layout: a binding is one template entry covering
+// all of its array elements, each reading one NkVkDescriptorData slot.
+static void nkVkCreateDescriptorUpdateTemplate(NkDevice device, NkBindGroupLayout layout) {
+
+    layout->updateTemplate = VK_NULL_HANDLE;
+    layout->descriptorOffsets = NK_NULL;
+    layout->descriptorCount = 0;
+
+    if (layout->entryCount == 0) {
+        return;
+    }
+
+    layout->descriptorOffsets = NK_PTR_CAST(uint32_t*, NK_MALLOC(sizeof(uint32_t) * layout->entryCount));
+    NK_ASSERT(layout->descriptorOffsets);
+
+    VkDescriptorUpdateTemplateEntry templateEntries[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    for (uint32_t i = 0; i < layout->entryCount; i++) {
+        const NkBindGroupLayoutEntry* entry = layout->entries + i;
+        layout->descriptorOffsets[i] = layout->descriptorCount;
+
+        VkDescriptorUpdateTemplateEntry* templateEntry = templateEntries + i;
+        templateEntry->dstBinding = entry->binding;
+        templateEntry->dstArrayElement = 0;
+        templateEntry->descriptorCount = nkVkDescriptorCount(entry);
+        templateEntry->descriptorType = nkVkDescriptorType(entry);
+        templateEntry->offset = sizeof(NkVkDescriptorData) * layout->descriptorCount;
+        templateEntry->stride = sizeof(NkVkDescriptorData);
+
+        layout->descriptorCount += templateEntry->descriptorCount;
+    }
+
+    // Pushed layouts are written with vkCmdPushDescriptorSetKHR from the same packed data. Every device can push
+    // at least 32 descriptors at once.
+    if (layout->pushed) {
+        NK_ASSERT(layout->descriptorCount <= NK_MAX_BINDINGS_PER_BIND_GROUP);
+        return;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.descriptorUpdateEntryCount = layout->entryCount;
+        createInfo.pDescriptorUpdateEntries = templateEntries;
+        createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        createInfo.descriptorSetLayout = layout->layout;
+        createInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // only read for push descriptor templates
+        createInfo.pipelineLayout = VK_NULL_HANDLE;
+        createInfo.set = 0;
+    }
+
+    NK_CHECK_VK(vkCreateDescriptorUpdateTemplate(device->device, &createInfo, NK_NULL, &layout->updateTemplate));
+}
+
+static void nkVkDestroyDescriptorUpdateTemplate(NkDevice device, NkBindGroupLayout layout) {
+
+    if (layout->updateTemplate != VK_NULL_HANDLE) {
+        vkDestroyDescriptorUpdateTemplate(device->device, layout->updateTemplate, NK_NULL);
+    }
+    NK_FREE(layout->descriptorOffsets);
+}
+
+// Returns a new reference to the bind group layout for these entries, creating it the first time they're seen.
+static NkBindGroupLayout nkVkGetBindGroupLayout(NkDevice device, const NkBindGroupLayoutEntry* entries, uint32_t entryCount, NkBool perDraw) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(entryCount == 0 || entries);
+
+    NkBindGroupLayoutEntry* sortedEntries = NK_NULL;
+    if (entryCount > 0) {
+        sortedEntries = NK_PTR_CAST(NkBindGroupLayoutEntry*, NK_MALLOC(sizeof(NkBindGroupLayoutEntry) * entryCount));
+        NK_ASSERT(sortedEntries);
+        memcpy(sortedEntries, entries, sizeof(NkBindGroupLayoutEntry) * entryCount);
+        nkVkSortBindGroupLayoutEntries(sortedEntries, entryCount);
+    }
+
+    const uint64_t hash = nkVkHashBindGroupLayoutEntries(sortedEntries, entryCount, perDraw);
+
+    nkMutexLock(&device->layoutMutex);
+
+    NkBindGroupLayout bindGroupLayout =
+        NK_PTR_CAST(NkBindGroupLayout, nkHashMapFind(&device->bindGroupLayouts, hash));
+    if (bindGroupLayout) {
+        bindGroupLayout->refCount++;
+        nkMutexUnlock(&device->layoutMutex);
+        NK_FREE(sortedEntries);
+        return bindGroupLayout;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    NK_ASSERT(entryCount <= NK_MAX_BINDINGS_PER_BIND_GROUP);
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        VkDescriptorSetLayoutBinding* binding = bindings + i;
+        binding->binding = sortedEntries[i].binding;
+        binding->descriptorType = nkVkDescriptorType(sortedEntries + i);
+        binding->descriptorCount = nkVkDescriptorCount(sortedEntries + i);
+        binding->stageFlags = nkVkShaderStageFlags(sortedEntries[i].visibility);
+        binding->pImmutableSamplers = NK_NULL;
+
+        // Push descriptors can't have dynamic offsets, and per-draw bindings have no use for them anyway.
+        NK_ASSERT(!perDraw || !sortedEntries[i].hasDynamicOffset);
+    }
+
+    const NkBool pushed = (perDraw && device->pushDescriptors) ? NkTrue : NkFalse;
+
+    VkDescriptorSetLayoutCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = pushed ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
+        createInfo.bindingCount = entryCount;
+        createInfo.pBindings = bindings;
+    }
+
+    bindGroupLayout = NK_PTR_CAST(NkBindGroupLayout, NK_MALLOC(sizeof(struct NkBindGroupLayoutImpl)));
+    NK_ASSERT(bindGroupLayout);
+
+    bindGroupLayout->device = device;
+    bindGroupLayout->hash = hash;
+    bindGroupLayout->refCount = 1;
+    bindGroupLayout->entries = sortedEntries;
+    bindGroupLayout->entryCount = entryCount;
+    bindGroupLayout->perDraw = perDraw;
+    bindGroupLayout->pushed = pushed;
+    nkVkInitDescriptorPools(&bindGroupLayout->descriptorPools, sortedEntries, entryCount);
+
+    NK_CHECK_VK(vkCreateDescriptorSetLayout(device->device, &createInfo, NK_NULL, &bindGroupLayout->layout));
+    nkVkCreateDescriptorUpdateTemplate(device, bindGroupLayout);
+
+    nkHashMapInsert(&device->bindGroupLayouts, hash, bindGroupLayout);
+
+    nkMutexUnlock(&device->layoutMutex);
+
+    return bindGroupLayout;
+}
+
+// Returns a new reference to the pipeline layout made of these bind group layouts and push constants.
+static NkPipelineLayout nkVkGetPipelineLayout(NkDevice device, const NkBindGroupLayout* bindGroupLayouts, uint32_t bindGroupLayoutCount, uint32_t pushConstantSize, VkShaderStageFlags pushConstantStages) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(bindGroupLayoutCount <= NK_MAX_BIND_GROUPS);
+
+    // Vulkan allows only one push descriptor set per pipeline layout.
+    uint32_t pushedCount = 0;
+    for (uint32_t i = 0; i < bindGroupLayoutCount; i++) {
+        pushedCount += bindGroupLayouts[i]->pushed ? 1 : 0;
+    }
+    NK_ASSERT(pushedCount <= 1);
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU32(&hasher, bindGroupLayoutCount);
+    for (uint32_t i = 0; i < bindGroupLayoutCount; i++) {
+        nkHashU64(&hasher, bindGroupLayouts[i]->hash);
+    }
+    nkHashU32(&hasher, pushConstantSize);
+    nkHashU32(&hasher, pushConstantSize ? pushConstantStages : 0);
+    const uint64_t hash = nkHasherFinish(&hasher);
+
+    nkMutexLock(&device->layoutMutex);
+
+    NkPipelineLayout pipelineLayout =
+        NK_PTR_CAST(NkPipelineLayout, nkHashMapFind(&device->pipelineLayouts, hash));
+    if (pipelineLayout) {
+        pipelineLayout->refCount++;
+        nkMutexUnlock(&device->layoutMutex);
+        return pipelineLayout;
+    }
+
+    pipelineLayout = NK_PTR_CAST(NkPipelineLayout, NK_MALLOC(sizeof(struct NkPipelineLayoutImpl)));
+    NK_ASSERT(pipelineLayout);
+
+    pipelineLayout->device = device;
+    pipelineLayout->hash = hash;
+    pipelineLayout->refCount = 1;
+    pipelineLayout->bindGroupLayoutCount = bindGroupLayoutCount;
+    pipelineLayout->pushConstantSize = pushConstantSize;
+    pipelineLayout->pushConstantStages = pushConstantSize ? pushConstantStages : 0;
+
+    VkDescriptorSetLayout setLayouts[NK_MAX_BIND_GROUPS];
+    for (uint32_t i = 0; i < bindGroupLayoutCount; i++) {
+        // The bind group layouts are already locked by the caller's references, so this can't race a destroy.
+        bindGroupLayouts[i]->refCount++;
+        pipelineLayout->bindGroupLayouts[i] = bindGroupLayouts[i];
+        setLayouts[i] = bindGroupLayouts[i]->layout;
+    }
+
+    VkPushConstantRange pushConstantRange;
+    {
+        pushConstantRange.stageFlags = pipelineLayout->pushConstantStages;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = pushConstantSize;
+    }
+
+    VkPipelineLayoutCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.setLayoutCount = bindGroupLayoutCount;
+        createInfo.pSetLayouts = setLayouts;
+        createInfo.pushConstantRangeCount = pushConstantSize ? 1 : 0;
+        createInfo.pPushConstantRanges = &pushConstantRange;
+    }
+
+    NK_CHECK_VK(vkCreatePipelineLayout(device->device, &createInfo, NK_NULL, &pipelineLayout->layout));
+
+    nkHashMapInsert(&device->pipelineLayouts, hash, pipelineLayout);
+
+    nkMutexUnlock(&device->layoutMutex);
+
+    return pipelineLayout;
+}
+
+static NkPipelineLayout nkVkRetainPipelineLayout(NkPipelineLayout pipelineLayout) {
+
+    NkDevice device = pipelineLayout->device;
+    nkMutexLock(&device->layoutMutex);
+    pipelineLayout->refCount++;
+    nkMutexUnlock(&device->layoutMutex);
+    return pipelineLayout;
+}
+
+static NkBindGroupLayout nkVkRetainBindGroupLayout(NkBindGroupLayout bindGroupLayout) {
+
+    NkDevice device = bindGroupLayout->device;
+    nkMutexLock(&device->layoutMutex);
+    bindGroupLayout->refCount++;
+    nkMutexUnlock(&device->layoutMutex);
+    return bindGroupLayout;
+}
+
+// Whether a reflected binding is one of the bindless tables: in the last group, at a table's binding, and of the
+// same descriptor type. Array sizes aren't compared, shaders usually leave the tables unsized.
+static NkBool nkVkIsBindlessBinding(NkDevice device, const NkVkShaderBinding* binding) {
+
+    if (binding->group != NK_VK_BINDLESS_GROUP || binding->entry.binding >= NK_VK_BINDLESS_TABLE_COUNT) {
+        return NkFalse;
+    }
+    const NkBindGroupLayoutEntry* table = device->bindlessLayout->entries + binding->entry.binding;
+    return nkVkDescriptorType(&binding->entry) == nkVkDescriptorType(table) ? NkTrue : NkFalse;
+}
+
+// Works out the layout a pipeline needs from the stages it's made of. When the user supplied a layout it
+// wins, but reflected push constants are still added to it, since NkPipelineLayoutInfo can't express them.
+// Returns a new reference.
+static NkPipelineLayout nkVkResolvePipelineLayout(NkDevice device, NkPipelineLayout layout, const NkProgrammableStageInfo* const* stages, const NkShaderStage* stageFlags, uint32_t stageCount, uint32_t perDrawGroups) {
+
+    uint32_t pushConstantSize = 0;
+    VkShaderStageFlags pushConstantStages = 0;
+
+    for (uint32_t i = 0; i < stageCount; i++) {
+        const NkVkShaderReflection* reflection = &stages[i]->module->reflection;
+        if (reflection->pushConstantSize > 0) {
+            pushConstantSize = NK_MAX(pushConstantSize, reflection->pushConstantSize);
+            pushConstantStages |= nkVkShaderStageFlags(stageFlags[i]);
+        }
+    }
+
+    if (layout) {
+        if (pushConstantSize <= layout->pushConstantSize) {
+            return nkVkRetainPipelineLayout(layout);
+        }
+        return nkVkGetPipelineLayout(device, layout->bindGroupLayouts, layout->bindGroupLayoutCount, pushConstantSize, pushConstantStages);
+    }
+
+    // On a bindless device the last group becomes the bindless tables, but only when every binding the stages
+    // declare there is one of them. A group that's used for anything else is left to reflection.
+    NkBool bindless = NkFalse;
+    if (device->bindless) {
+        NkBool matches = NkTrue;
+        for (uint32_t i = 0; i < stageCount; i++) {
+            const NkVkShaderReflection* reflection = &stages[i]->module->reflection;
+            for (uint32_t b = 0; b < reflection->bindingCount; b++) {
+                if (reflection->bindings[b].group == NK_VK_BINDLESS_GROUP) {
+                    bindless = NkTrue;
+                    matches = (matches && nkVkIsBindlessBinding(device, reflection->bindings + b)) ? NkTrue : NkFalse;
+                }
+            }
+        }
+        bindless = (bindless && matches) ? NkTrue : NkFalse;
+    }
+
+    NkBindGroupLayoutEntry entries[NK_MAX_BIND_GROUPS][NK_MAX_BINDINGS_PER_BIND_GROUP];
+    uint32_t entryCounts[NK_MAX_BIND_GROUPS] = { 0 };
+    uint32_t groupCount = 0;
+
+    for (uint32_t i = 0; i < stageCount; i++) {
+        const NkVkShaderReflection* reflection = &stages[i]->module->reflection;
+        for (uint32_t b = 0; b < reflection->bindingCount; b++) {
+            const NkVkShaderBinding* binding = reflection->bindings + b;
+            NK_ASSERT(binding->group < NK_MAX_BIND_GROUPS);
+
+            if (bindless && binding->group == NK_VK_BINDLESS_GROUP) {
+                groupCount = NK_MAX(groupCount, binding->group + 1);
+                continue;
+            }
+
+            NkBindGroupLayoutEntry* groupEntries = entries[binding->group];
+            uint32_t* entryCount = entryCounts + binding->group;
+
+            // Resources used by several stages share one binding, visible to all of them.
+            NkBindGroupLayoutEntry* entry = NK_NULL;
+            for (uint32_t e = 0; e < *entryCount; e++) {
+                if (groupEntries[e].binding == binding->entry.binding) {
+                    entry = groupEntries + e;
+                    break;
+                }
+            }
+
+            if (entry) {
+                NK_ASSERT(nkVkDescriptorType(entry) == nkVkDescriptorType(&binding->entry));
+                entry->minBufferBindingSize = NK_MAX(entry->minBufferBindingSize, binding->entry.minBufferBindingSize);
+            }
+            else {
+                NK_ASSERT(*entryCount < NK_MAX_BINDINGS_PER_BIND_GROUP);
+                entry = groupEntries + (*entryCount)++;
+                *entry = binding->entry;
+                entry->visibility = 0;
+            }
+            entry->visibility |= stageFlags[i];
+
+            groupCount = NK_MAX(groupCount, binding->group + 1);
+        }
+    }
+
+    // Groups the shaders skip still need a (empty) layout to keep the ones after them in place.
+    NkBindGroupLayout bindGroupLayouts[NK_MAX_BIND_GROUPS];
+    for (uint32_t group = 0; group < groupCount; group++) {
+        const NkBool perDraw = (perDrawGroups & (1u << group)) ? NkTrue : NkFalse;
+        NK_ASSERT(!perDraw || !bindless || group != NK_VK_BINDLESS_GROUP);
+        bindGroupLayouts[group] = (bindless && group == NK_VK_BINDLESS_GROUP) ?
+            nkVkRetainBindGroupLayout(device->bindlessLayout) : nkVkGetBindGroupLayout(device, entries[group], entryCounts[group], perDraw);
+    }
+
+    NkPipelineLayout pipelineLayout =
+        nkVkGetPipelineLayout(device, bindGroupLayouts, groupCount, pushConstantSize, pushConstantStages);
+
+    for (uint32_t group = 0; group < groupCount; group++) {
+        nkDestroyBindGroupLayout(bindGroupLayouts[group]);
+    }
+
+    return pipelineLayout;
+}
+
+static void nkVkDestroyLayouts(NkDevice device) {
+
+    // Anything still alive here was leaked by the application. Pipeline layouts go first since they hold
+    // references to bind group layouts.
+    for (uint32_t i = 0; i < device->pipelineLayouts.capacity; i++) {
+        NkPipelineLayout pipelineLayout = NK_PTR_CAST(NkPipelineLayout, device->pipelineLayouts.values[i]);
+        if (device->pipelineLayouts.keys[i] != 0 && pipelineLayout) {
+            vkDestroyPipelineLayout(device->device, pipelineLayout->layout, NK_NULL);
+            NK_FREE(pipelineLayout);
+        }
+    }
+    for (uint32_t i = 0; i < device->bindGroupLayouts.capacity; i++) {
+        NkBindGroupLayout bindGroupLayout = NK_PTR_CAST(NkBindGroupLayout, device->bindGroupLayouts.values[i]);
+        if (device->bindGroupLayouts.keys[i] != 0 && bindGroupLayout) {
+            nkVkDestroyDescriptorPools(device, &bindGroupLayout->descriptorPools);
+            nkVkDestroyDescriptorUpdateTemplate(device, bindGroupLayout);
+            vkDestroyDescriptorSetLayout(device->device, bindGroupLayout->layout, NK_NULL);
+            NK_FREE(bindGroupLayout->entries);
+            NK_FREE(bindGroupLayout);
+        }
+    }
+    nkHashMapDestroy(&device->pipelineLayouts);
+    nkHashMapDestroy(&device->bindGroupLayouts);
+    nkMutexDestroy(&device->layoutMutex);
+}
+
+// Hands out a set for the layout, reusing one from a destroyed bind group when there is one. Pools start
+// small and double, so layouts that only ever get a couple of bind groups don't reserve space for hundreds.
+// Called with the bindGroupMutex held.
+static VkDescriptorSet nkVkAllocateLayoutSet(NkDevice device, NkBindGroupLayout layout) {
+
+    NkVkDescriptorPools* pools = &layout->descriptorPools;
+
+    if (pools->freeSetCount > 0) {
+        return pools->freeSets[--pools->freeSetCount];
+    }
+
+    if (pools->setsLeft == 0) {
+        const uint32_t setCount = pools->nextPoolSets;
+        pools->nextPoolSets = NK_MIN(setCount * 2, NK_VK_MAX_SETS_PER_POOL);
+
+        // A pool needs at least one pool size, even when the sets allocated from it are empty.
+        VkDescriptorPoolSize sizes[NK_VK_DESCRIPTOR_TYPE_COUNT];
+        uint32_t sizeCount = 0;
+        for (uint32_t i = 0; i < pools->sizeCount; i++) {
+            sizes[sizeCount].type = pools->sizes[i].type;
+            sizes[sizeCount].descriptorCount = pools->sizes[i].descriptorCount * setCount;
+            sizeCount++;
+        }
+        if (sizeCount == 0) {
+            sizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+            sizes[0].descriptorCount = 1;
+            sizeCount = 1;
+        }
+
+        VkDescriptorPoolCreateInfo createInfo;
+        {
+            createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            createInfo.pNext = NK_NULL;
+            createInfo.flags = 0;
+            createInfo.maxSets = setCount;
+            createInfo.poolSizeCount = sizeCount;
+            createInfo.pPoolSizes = sizes;
+        }
+
+        VkDescriptorPool pool;
+        NK_CHECK_VK(vkCreateDescriptorPool(device->device, &createInfo, NK_NULL, &pool));
+
+        pools->pools = NK_PTR_CAST(VkDescriptorPool*, NK_REALLOC(pools->pools, sizeof(VkDescriptorPool) * (pools->poolCount + 1)));
+        NK_ASSERT(pools->pools);
+        pools->pools[pools->poolCount++] = pool;
+        pools->setsLeft = setCount;
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo;
+    {
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.pNext = NK_NULL;
+        allocateInfo.descriptorPool = pools->pools[pools->poolCount - 1];
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &layout->layout;
+    }
+
+    // The pool was sized for exactly this many sets of this layout, so running out here is a bug.
+    VkDescriptorSet set;
+    NK_CHECK_VK(vkAllocateDescriptorSets(device->device, &allocateInfo, &set));
+    pools->setsLeft--;
+    return set;
+}
+
+static void nkVkFreeLayoutSet(NkBindGroupLayout layout, VkDescriptorSet set) {
+
+    NkVkDescriptorPools* pools = &layout->descriptorPools;
+    if (pools->freeSetCount == pools->freeSetCapacity) {
+        pools->freeSetCapacity = NK_MAX(pools->freeSetCapacity * 2, NK_VK_MIN_SETS_PER_POOL);
+        pools->freeSets = NK_PTR_CAST(VkDescriptorSet*, NK_REALLOC(pools->freeSets, sizeof(VkDescriptorSet) * pools->freeSetCapacity));
+        NK_ASSERT(pools->freeSets);
+    }
+    pools->freeSets[pools->freeSetCount++] = set;
+}
+
+// Transient bind groups come from pools shared by every layout, which are reset wholesale once the GPU can no
+// longer be reading them. Their structs live in chunks that are reused the same way, so a frame's worth of
+// transient bind groups costs no allocations once the first few frames have sized everything.
+
+#define NK_VK_TRANSIENT_SETS_PER_POOL 1024
+#define NK_VK_BIND_GROUPS_PER_CHUNK 256
+
+typedef struct NkVkBindGroupChunk {
+    struct NkVkBindGroupChunk* next;
+    uint32_t count;
+    struct NkBindGroupImpl bindGroups[NK_VK_BIND_GROUPS_PER_CHUNK];
+} NkVkBindGroupChunk;
+
+typedef struct NkVkBindGroupFrame {
+    VkDescriptorPool* pools;
+    uint32_t poolCount;
+    uint32_t currentPool;
+    NkVkBindGroupChunk* chunks;
+    NkVkBindGroupChunk* currentChunk;
+    NkHashMap bindGroups; // transient bind groups made this frame, by the same hash as persistent ones
+} NkVkBindGroupFrame;
+
+static const VkDescriptorPoolSize NkVkTransientPoolSizes[] = {
+    { VK_DESCRIPTOR_TYPE_SAMPLER, NK_VK_TRANSIENT_SETS_PER_POOL },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, NK_VK_TRANSIENT_SETS_PER_POOL * 2 },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NK_VK_TRANSIENT_SETS_PER_POOL * 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, NK_VK_TRANSIENT_SETS_PER_POOL / 2 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, NK_VK_TRANSIENT_SETS_PER_POOL * 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NK_VK_TRANSIENT_SETS_PER_POOL },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, NK_VK_TRANSIENT_SETS_PER_POOL / 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, NK_VK_TRANSIENT_SETS_PER_POOL / 2 },
+};
+
+#define NK_VK_TRANSIENT_POOL_SIZE_COUNT (sizeof(NkVkTransientPoolSizes) / sizeof(NkVkTransientPoolSizes[0]))
+
+// Pools are made when a set doesn't fit the frame's last one, so each is grown to fit at least that set. A layout
+// with more descriptors of a type than the usual sizes allow, or of a type they leave out, still gets its set.
+static VkDescriptorPool nkVkCreateTransientPool(NkDevice device, NkBindGroupLayout layout) {
+
+    VkDescriptorPoolSize sizes[NK_VK_TRANSIENT_POOL_SIZE_COUNT + NK_VK_DESCRIPTOR_TYPE_COUNT];
+    memcpy(sizes, NkVkTransientPoolSizes, sizeof(NkVkTransientPoolSizes));
+    uint32_t sizeCount = NK_VK_TRANSIENT_POOL_SIZE_COUNT;
+
+    const NkVkDescriptorPools* needed = &layout->descriptorPools;
+    for (uint32_t i = 0; i < needed->sizeCount; i++) {
+        uint32_t j = 0;
+        while (j < sizeCount && sizes[j].type != needed->sizes[i].type) {
+            j++;
+        }
+        if (j == sizeCount) {
+            sizes[sizeCount].type = needed->sizes[i].type;
+            sizes[sizeCount].descriptorCount = 0;
+            sizeCount++;
+        }
+        sizes[j].descriptorCount = NK_MAX(sizes[j].descriptorCount, needed->sizes[i].descriptorCount);
+    }
+
+    VkDescriptorPoolCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.maxSets = NK_VK_TRANSIENT_SETS_PER_POOL;
+        createInfo.poolSizeCount = sizeCount;
+        createInfo.pPoolSizes = sizes;
+    }
+
+    VkDescriptorPool pool;
+    NK_CHECK_VK(vkCreateDescriptorPool(device->device, &createInfo, NK_NULL, &pool));
+    return pool;
+}
+
+// Called with the bindGroupMutex held.
+static VkDescriptorSet nkVkAllocateTransientSet(NkDevice device, NkVkBindGroupFrame* frame, NkBindGroupLayout layout) {
+
+    VkDescriptorSetAllocateInfo allocateInfo;
+    {
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.pNext = NK_NULL;
+        allocateInfo.descriptorPool = VK_NULL_HANDLE;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &layout->layout;
+    }
+
+    // A pool that can't fit the set moves the frame on to the next one, making it if this frame has never
+    // needed that many before. A new pool is made to fit the set, so if allocating from it fails anyway, moving
+    // on won't help and the error is reported like any other Vulkan failure.
+    for (;;) {
+        NkBool created = NkFalse;
+        if (frame->currentPool == frame->poolCount) {
+            frame->pools = NK_PTR_CAST(VkDescriptorPool*, NK_REALLOC(frame->pools, sizeof(VkDescriptorPool) * (frame->poolCount + 1)));
+            NK_ASSERT(frame->pools);
+            frame->pools[frame->poolCount++] = nkVkCreateTransientPool(device, layout);
+            created = NkTrue;
+        }
+
+        allocateInfo.descriptorPool = frame->pools[frame->currentPool];
+
+        VkDescriptorSet set;
+        const VkResult result = vkAllocateDescriptorSets(device->device, &allocateInfo, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+
+        if (created || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+            NK_CHECK_VK(result);
+        }
+        frame->currentPool++;
+    }
+}
+
+static struct NkBindGroupImpl* nkVkAllocateTransientBindGroup(NkVkBindGroupFrame* frame) {
+
+    NkVkBindGroupChunk* chunk = frame->currentChunk;
+    if (chunk && chunk->count == NK_VK_BIND_GROUPS_PER_CHUNK) {
+        chunk = chunk->next;
+        if (chunk) {
+            frame->currentChunk = chunk;
+        }
+    }
+
+    if (chunk == NK_NULL) {
+        chunk = NK_PTR_CAST(NkVkBindGroupChunk*, NK_MALLOC(sizeof(NkVkBindGroupChunk)));
+        NK_ASSERT(chunk);
+        chunk->next = NK_NULL;
+        chunk->count = 0;
+        if (frame->currentChunk) {
+            frame->currentChunk->next = chunk;
+        }
+        else {
+            frame->chunks = chunk;
+        }
+        frame->currentChunk = chunk;
+    }
+
+    return chunk->bindGroups + chunk->count++;
+}
+
+static void nkVkResetBindGroupFrame(NkDevice device, NkVkBindGroupFrame* frame) {
+
+    for (uint32_t i = 0; i < frame->poolCount && i <= frame->currentPool; i++) {
+        NK_CHECK_VK(vkResetDescriptorPool(device->device, frame->pools[i], 0));
+    }
+    frame->currentPool = 0;
+
+    for (NkVkBindGroupChunk* chunk = frame->chunks; chunk; chunk = chunk->next) {
+        chunk->count = 0;
+    }
+    frame->currentChunk = frame->chunks;
+
+    nkHashMapClear(&frame->bindGroups);
+}
+
+static void nkVkAdvanceBindGroupFrame(NkDevice device) {
+
+    nkMutexLock(&device->bindGroupMutex);
+    device->bindGroupFrameIndex = (device->bindGroupFrameIndex + 1) % device->bindGroupFrameCount;
+    nkVkResetBindGroupFrame(device, device->bindGroupFrames + device->bindGroupFrameIndex);
+    nkMutexUnlock(&device->bindGroupMutex);
+}
+
+static void nkVkInitBindGroups(NkDevice device, const NkDeviceInfo* descriptor) {
+
+    nkMutexInit(&device->bindGroupMutex);
+    nkHashMapInit(&device->bindGroups);
+
+    // The frame being filled and the ones the GPU may still be reading each need their own pools.
+    const uint32_t framesInFlight = descriptor->framesInFlight > 0 ? descriptor->framesInFlight : 2;
+    device->bindGroupFrameCount = framesInFlight + 1;
+    device->bindGroupFrameIndex = 0;
+    device->bindGroupFrames =
+        NK_PTR_CAST(NkVkBindGroupFrame*, NK_CALLOC(device->bindGroupFrameCount, sizeof(NkVkBindGroupFrame)));
+    NK_ASSERT(device->bindGroupFrames);
+
+    for (uint32_t i = 0; i < device->bindGroupFrameCount; i++) {
+        nkHashMapInit(&device->bindGroupFrames[i].bindGroups);
+    }
+}
+
+static void nkVkDestroyBindGroups(NkDevice device) {
+
+    // Persistent bind groups still alive here were leaked by the application. Their sets go away with the
+    // layouts' pools in nkVkDestroyLayouts.
+    for (uint32_t i = 0; i < device->bindGroups.capacity; i++) {
+        NkBindGroup bindGroup = NK_PTR_CAST(NkBindGroup, device->bindGroups.values[i]);
+        if (device->bindGroups.keys[i] != 0 && bindGroup) {
+            NK_FREE(bindGroup);
+        }
+    }
+    nkHashMapDestroy(&device->bindGroups);
+
+    for (uint32_t i = 0; i < device->bindGroupFrameCount; i++) {
+        NkVkBindGroupFrame* frame = device->bindGroupFrames + i;
+        for (uint32_t p = 0; p < frame->poolCount; p++) {
+            vkDestroyDescriptorPool(device->device, frame->pools[p], NK_NULL);
+        }
+        NK_FREE(frame->pools);
+
+        NkVkBindGroupChunk* chunk = frame->chunks;
+        while (chunk) {
+            NkVkBindGroupChunk* next = chunk->next;
+            NK_FREE(chunk);
+            chunk = next;
+        }
+        nkHashMapDestroy(&frame->bindGroups);
+    }
+    NK_FREE(device->bindGroupFrames);
+    nkMutexDestroy(&device->bindGroupMutex);
+}
+
+// Entries are put in binding order so the same resources always hash the same. The sort is stable: entries
+// that share a binding fill consecutive elements of an arrayed binding in the order they were given.
+static void nkVkSortBindGroupEntries(NkBindGroupEntry* entries, uint32_t entryCount) {
+
+    for (uint32_t i = 1; i < entryCount; i++) {
+        NkBindGroupEntry entry = entries[i];
+        uint32_t j = i;
+        while (j > 0 && entries[j - 1].binding > entry.binding) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+static uint64_t nkVkHashBindGroup(NkBindGroupLayout layout, const NkBindGroupEntry* entries, uint32_t entryCount) {
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU64(&hasher, layout->hash);
+    nkHashU32(&hasher, entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        nkHashU32(&hasher, entries[i].binding);
+        nkHashU64(&hasher, entries[i].buffer ? entries[i].buffer->id : 0);
+        nkHashU64(&hasher, entries[i].offset);
+        nkHashU64(&hasher, entries[i].size);
+        nkHashU64(&hasher, entries[i].sampler ? entries[i].sampler->id : 0);
+        nkHashU64(&hasher, entries[i].textureView ? entries[i].textureView->id : 0);
+    }
+    return nkHasherFinish(&hasher);
+}
+
+static void nkVkInitDescriptorData(NkVkDescriptorData* data, VkDescriptorType type, const NkBindGroupEntry* entry) {
+
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        NK_ASSERT(entry->buffer);
+        data->buffer.buffer = entry->buffer->buffer;
+        data->buffer.offset = entry->offset;
+        data->buffer.range = entry->size > 0 ? entry->size : VK_WHOLE_SIZE;
+        break;
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+        NK_ASSERT(entry->sampler);
+        data->image.sampler = entry->sampler->sampler;
+        data->image.imageView = VK_NULL_HANDLE;
+        data->image.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        break;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        NK_ASSERT(entry->textureView);
+        data->image.sampler = entry->sampler ? entry->sampler->sampler : VK_NULL_HANDLE;
+        data->image.imageView = entry->textureView->imageView;
+        data->image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        NK_ASSERT(entry->textureView);
+        data->image.sampler = VK_NULL_HANDLE;
+        data->image.imageView = entry->textureView->imageView;
+        data->image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        break;
+    default:
+        NK_ASSERT(NkFalse);
+        break;
+    }
+}
+
+// Packs the entries into one slot per descriptor, in the order of the layout's descriptorOffsets. Both the
+// entries and the layout's entries are sorted by binding, so they're walked side by side. Entries that don't match
+// the layout are reported and nothing is packed past them, so the caller must not use the data then.
+static NkBool nkVkPackBindGroupEntries(NkBindGroupLayout layout, const NkBindGroupEntry* entries, uint32_t entryCount, NkVkDescriptorData* data) {
+
+    uint32_t written[NK_MAX_BINDINGS_PER_BIND_GROUP] = { 0 };
+    uint32_t layoutIndex = 0;
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const NkBindGroupEntry* entry = entries + i;
+        while (layoutIndex < layout->entryCount && layout->entries[layoutIndex].binding < entry->binding) {
+            layoutIndex++;
+        }
+        if (layoutIndex == layout->entryCount || layout->entries[layoutIndex].binding != entry->binding) {
+            NK_LOG("Neko: bind group entry for binding %u isn't in its layout at %s:%d.\n", entry->binding);
+            return NkFalse;
+        }
+
+        const NkBindGroupLayoutEntry* layoutEntry = layout->entries + layoutIndex;
+        const uint32_t element = written[layoutIndex]++;
+        if (element >= nkVkDescriptorCount(layoutEntry)) {
+            NK_LOG("Neko: too many bind group entries for binding %u at %s:%d.\n", entry->binding);
+            return NkFalse;
+        }
+
+        nkVkInitDescriptorData(data + layout->descriptorOffsets[layoutIndex] + element, nkVkDescriptorType(layoutEntry), entry);
+    }
+
+    // Every element of every binding gets written. Elements of an array the caller left out repeat the last one
+    // they gave, so the set never holds a descriptor that was never written.
+    for (uint32_t i = 0; i < layout->entryCount; i++) {
+        if (written[i] == 0) {
+            NK_LOG("Neko: bind group has no entry for binding %u at %s:%d.\n", layout->entries[i].binding);
+            return NkFalse;
+        }
+        NkVkDescriptorData* bindingData = data + layout->descriptorOffsets[i];
+        for (uint32_t element = written[i]; element < nkVkDescriptorCount(layout->entries + i); element++) {
+            bindingData[element] = bindingData[written[i] - 1];
+        }
+    }
+    return NkTrue;
+}
+
+// Writes the whole set in one call through the layout's update template. The set is left alone when the entries
+// don't match the layout.
+static NkBool nkVkWriteBindGroup(NkDevice device, NkBindGroupLayout layout, VkDescriptorSet set, const NkBindGroupEntry* entries, uint32_t entryCount) {
+
+    if (layout->descriptorCount == 0) {
+        return NkTrue;
+    }
+
+    NkVkDescriptorData stackData[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    NkVkDescriptorData* data = stackData;
+    if (layout->descriptorCount > NK_MAX_BINDINGS_PER_BIND_GROUP) {
+        data = NK_PTR_CAST(NkVkDescriptorData*, NK_MALLOC(sizeof(NkVkDescriptorData) * layout->descriptorCount));
+        NK_ASSERT(data);
+    }
+
+    const NkBool packed = nkVkPackBindGroupEntries(layout, entries, entryCount, data);
+    if (packed) {
+        vkUpdateDescriptorSetWithTemplate(device->device, set, layout->updateTemplate, data);
+    }
+
+    if (data != stackData) {
+        NK_FREE(data);
+    }
+    return packed;
+}
+
+// Bindless tables are one update-after-bind set the device owns, holding big partially bound arrays of every
+// texture view, sampler and storage buffer that has asked for an index. An object gets its index the first
+// time it's asked for one and gives it back when it's destroyed, so indices stay put for the object's lifetime.
+
+#define NK_VK_BINDLESS_MAX_TEXTURES 65536
+#define NK_VK_BINDLESS_MAX_SAMPLERS 2048
+#define NK_VK_BINDLESS_MAX_STORAGE_BUFFERS 65536
+
+static void nkVkInitBindless(NkDevice device) {
+
+    device->bindlessLayout = NK_NULL;
+    device->bindlessPool = VK_NULL_HANDLE;
+    memset(&device->bindlessBindGroup, 0, sizeof(device->bindlessBindGroup));
+    memset(device->bindlessTables, 0, sizeof(device->bindlessTables));
+
+    if (!device->bindless) {
+        return;
+    }
+
+    nkMutexInit(&device->bindlessMutex);
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties;
+    {
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        indexingProperties.pNext = NK_NULL;
+    }
+
+    VkPhysicalDeviceProperties2 properties;
+    {
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexingProperties;
+    }
+
+    vkGetPhysicalDeviceProperties2(device->physicalDevice, &properties);
+
+    device->bindlessTables[NkBindlessBinding_Textures].capacity = NK_MIN(NK_VK_BINDLESS_MAX_TEXTURES,
+        NK_MIN(indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages));
+    device->bindlessTables[NkBindlessBinding_Samplers].capacity = NK_MIN(NK_MIN(NK_VK_BINDLESS_MAX_SAMPLERS, device->properties.limits.maxSamplerAllocationCount),
+        NK_MIN(indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers));
+    device->bindlessTables[NkBindlessBinding_StorageBuffers].capacity = NK_MIN(NK_VK_BINDLESS_MAX_STORAGE_BUFFERS,
+        NK_MIN(indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers));
+
+    static const NkBindingType types[NK_VK_BINDLESS_TABLE_COUNT] = {
+        NkBindingType_SampledTexture,
+        NkBindingType_Sampler,
+        NkBindingType_StorageBuffer,
+    };
+
+    NkBindGroupLayoutEntry* entries = NK_PTR_CAST(NkBindGroupLayoutEntry*, NK_CALLOC(NK_VK_BINDLESS_TABLE_COUNT, sizeof(NkBindGroupLayoutEntry)));
+    NK_ASSERT(entries);
+
+    VkDescriptorSetLayoutBinding bindings[NK_VK_BINDLESS_TABLE_COUNT];
+    VkDescriptorBindingFlags bindingFlags[NK_VK_BINDLESS_TABLE_COUNT];
+    VkDescriptorPoolSize poolSizes[NK_VK_BINDLESS_TABLE_COUNT];
+
+    for (uint32_t i = 0; i < NK_VK_BINDLESS_TABLE_COUNT; i++) {
+        NkVkBindlessTable* table = device->bindlessTables + i;
+        table->freeIndices = NK_PTR_CAST(uint32_t*, NK_MALLOC(sizeof(uint32_t) * NK_MAX(table->capacity, 1)));
+        NK_ASSERT(table->freeIndices);
+
+        entries[i].binding = i;
+        entries[i].visibility = NkShaderStage_Vertex | NkShaderStage_Fragment | NkShaderStage_Compute;
+        entries[i].type = types[i];
+        entries[i].arraySize = table->capacity;
+
+        bindings[i].binding = i;
+        bindings[i].descriptorType = nkVkDescriptorType(entries + i);
+        bindings[i].descriptorCount = table->capacity;
+        bindings[i].stageFlags = nkVkShaderStageFlags(entries[i].visibility);
+        bindings[i].pImmutableSamplers = NK_NULL;
+
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        poolSizes[i].type = bindings[i].descriptorType;
+        poolSizes[i].descriptorCount = table->capacity;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo;
+    {
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.pNext = NK_NULL;
+        bindingFlagsInfo.bindingCount = NK_VK_BINDLESS_TABLE_COUNT;
+        bindingFlagsInfo.pBindingFlags = bindingFlags;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo;
+    {
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = NK_VK_BINDLESS_TABLE_COUNT;
+        layoutInfo.pBindings = bindings;
+    }
+
+    // The layout is an ordinary bind group layout as far as pipeline layouts are concerned. Its hash is kept
+    // apart from the layout nkCreateBindGroupLayout would make for the same entries, which can't be bound
+    // after updates.
+    NkHasher hasher = nkCreateHasher();
+    nkHashU64(&hasher, nkVkHashBindGroupLayoutEntries(entries, NK_VK_BINDLESS_TABLE_COUNT, NkFalse));
+    nkHashU32(&hasher, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+    NkBindGroupLayout layout = NK_PTR_CAST(NkBindGroupLayout, NK_MALLOC(sizeof(struct NkBindGroupLayoutImpl)));
+    NK_ASSERT(layout);
+
+    layout->device = device;
+    layout->hash = nkHasherFinish(&hasher);
+    layout->refCount = 1;
+    layout->entries = entries;
+    layout->entryCount = NK_VK_BINDLESS_TABLE_COUNT;
+    layout->perDraw = NkFalse;
+    layout->pushed = NkFalse;
+    nkVkInitDescriptorPools(&layout->descriptorPools, NK_NULL, 0);
+    layout->updateTemplate = VK_NULL_HANDLE;
+    layout->descriptorOffsets = NK_NULL;
+    layout->descriptorCount = 0;
+
+    NK_CHECK_VK(vkCreateDescriptorSetLayout(device->device, &layoutInfo, NK_NULL, &layout->layout));
+
+    nkHashMapInsert(&device->bindGroupLayouts, layout->hash, layout);
+    device->bindlessLayout = layout;
+
+    VkDescriptorPoolCreateInfo poolInfo;
+    {
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.pNext = NK_NULL;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = NK_VK_BINDLESS_TABLE_COUNT;
+        poolInfo.pPoolSizes = poolSizes;
+    }
+
+    NK_CHECK_VK(vkCreateDescriptorPool(device->device, &poolInfo, NK_NULL, &device->bindlessPool));
+
+    VkDescriptorSetAllocateInfo allocateInfo;
+    {
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.pNext = NK_NULL;
+        allocateInfo.descriptorPool = device->bindlessPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &layout->layout;
+    }
+
+    NK_CHECK_VK(vkAllocateDescriptorSets(device->device, &allocateInfo, &device->bindlessBindGroup.set));
+    device->bindlessBindGroup.device = device;
+}
+
+static void nkVkDestroyBindless(NkDevice device) {
+
+    if (!device->bindless) {
+        return;
+    }
+
+    vkDestroyDescriptorPool(device->device, device->bindlessPool, NK_NULL);
+    for (uint32_t i = 0; i < NK_VK_BINDLESS_TABLE_COUNT; i++) {
+        NK_FREE(device->bindlessTables[i].freeIndices);
+    }
+    nkDestroyBindGroupLayout(device->bindlessLayout);
+    nkMutexDestroy(&device->bindlessMutex);
+}
+
+// Hands out the object's index in the table, writing its descriptor the first time.
+static uint32_t nkVkGetBindlessIndex(NkDevice device, NkBindlessBinding binding, uint32_t* index, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo) {
+
+    NK_ASSERT(device->bindless);
+
+    nkMutexLock(&device->bindlessMutex);
+
+    if (*index == NK_VK_BINDLESS_INVALID_INDEX) {
+        NkVkBindlessTable* table = device->bindlessTables + binding;
+        if (table->freeCount > 0) {
+            *index = table->freeIndices[--table->freeCount];
+        }
+        else {
+            NK_ASSERT(table->next < table->capacity);
+            *index = table->next++;
+        }
+
+        VkWriteDescriptorSet write;
+        {
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.pNext = NK_NULL;
+            write.dstSet = device->bindlessBindGroup.set;
+            write.dstBinding = binding;
+            write.dstArrayElement = *index;
+            write.descriptorCount = 1;
+            write.descriptorType = nkVkDescriptorType(device->bindlessLayout->entries + binding);
+            write.pImageInfo = imageInfo;
+            write.pBufferInfo = bufferInfo;
+            write.pTexelBufferView = NK_NULL;
+        }
+
+        // The set is shared, so writes to it are serialized here.
+        vkUpdateDescriptorSets(device->device, 1, &write, 0, NK_NULL);
+    }
+
+    const uint32_t result = *index;
+    nkMutexUnlock(&device->bindlessMutex);
+    return result;
+}
+
+static void nkVkReleaseBindlessIndex(NkDevice device, NkBindlessBinding binding, uint32_t index) {
+
+    if (index == NK_VK_BINDLESS_INVALID_INDEX) {
+        return;
+    }
+
+    nkMutexLock(&device->bindlessMutex);
+    NkVkBindlessTable* table = device->bindlessTables + binding;
+    table->freeIndices[table->freeCount++] = index;
+    nkMutexUnlock(&device->bindlessMutex);
+}
+
+// Methods of BindGroup
+void nkDestroyBindGroup(NkBindGroup bindGroup) {
+
+    NK_ASSERT(bindGroup);
+
+    // Transient bind groups are recycled by nkDeviceTick, and the bindless one lives as long as the device.
+    NkBindGroupLayout layout = bindGroup->layout;
+    if (layout == NK_NULL) {
+        return;
+    }
+
+    NkDevice device = bindGroup->device;
+
+    nkMutexLock(&device->bindGroupMutex);
+    NK_ASSERT(bindGroup->refCount > 0);
+
+    // Bind groups are deduplicated, so every creation with the same layout and resources shares this object.
+    if (--bindGroup->refCount > 0) {
+        nkMutexUnlock(&device->bindGroupMutex);
+        return;
+    }
+
+    nkHashMapRemove(&device->bindGroups, bindGroup->hash);
+    nkVkFreeLayoutSet(layout, bindGroup->set);
+    nkMutexUnlock(&device->bindGroupMutex);
+
+    nkDestroyBindGroupLayout(layout);
+    NK_FREE(bindGroup);
+}
+
+// Methods of BindGroupLayout
+void nkDestroyBindGroupLayout(NkBindGroupLayout bindGroupLayout) {
+
+    NK_ASSERT(bindGroupLayout);
+
+    NkDevice device = bindGroupLayout->device;
+
+    nkMutexLock(&device->layoutMutex);
+    NK_ASSERT(bindGroupLayout->refCount > 0);
+
+    // Layouts are deduplicated, so every creation with the same entries shares this object.
+    if (--bindGroupLayout->refCount > 0) {
+        nkMutexUnlock(&device->layoutMutex);
+        return;
+    }
+
+    nkHashMapRemove(&device->bindGroupLayouts, bindGroupLayout->hash);
+    nkMutexUnlock(&device->layoutMutex);
+
+    // Every bind group made with this layout held a reference to it, so none of its sets are in use.
+    nkVkDestroyDescriptorPools(device, &bindGroupLayout->descriptorPools);
+    nkVkDestroyDescriptorUpdateTemplate(device, bindGroupLayout);
+    vkDestroyDescriptorSetLayout(device->device, bindGroupLayout->layout, NK_NULL);
+    NK_FREE(bindGroupLayout->entries);
+    NK_FREE(bindGroupLayout);
+}
+
+// Methods of Buffer
+void nkDestroyBuffer(NkBuffer buffer) {
+
+    NK_ASSERT(buffer);
+
+    NkDevice device = buffer->device;
+    nkVkReleaseBindlessIndex(device, NkBindlessBinding_StorageBuffers, buffer->bindlessIndex);
+    if (buffer->mapped) {
+        vkUnmapMemory(device->device, buffer->memory);
+    }
+    vkDestroyBuffer(device->device, buffer->buffer, NK_NULL);
+    vkFreeMemory(device->device, buffer->memory, NK_NULL);
+    NK_FREE(buffer);
+}
+
+uint32_t nkBufferGetBindlessIndex(NkBuffer buffer) {
+
+    NK_ASSERT(buffer);
+    NK_ASSERT(buffer->usage & NkBufferUsage_Storage);
+
+    VkDescriptorBufferInfo bufferInfo;
+    {
+        bufferInfo.buffer = buffer->buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+    }
+
+    return nkVkGetBindlessIndex(buffer->device, NkBindlessBinding_StorageBuffers, &buffer->bindlessIndex, NK_NULL, &bufferInfo);
+}
+
+const void* nkBufferGetConstMappedRange(NkBuffer buffer, size_t offset, size_t size) {
+    return nkBufferGetMappedRange(buffer, offset, size);
+}
+
+uint64_t nkBufferGetDeviceAddress(NkBuffer buffer) {
+
+    NK_ASSERT(buffer);
+    NK_ASSERT(buffer->usage & NkBufferUsage_DeviceAddress);
+
+    return buffer->deviceAddress;
+}
+
+void* nkBufferGetMappedRange(NkBuffer buffer, size_t offset, size_t size) {
+
+    NK_ASSERT(buffer);
+    NK_ASSERT(buffer->mapped);
+    NK_ASSERT(offset + size <= buffer->size);
+
+    return NK_PTR_CAST(uint8_t*, buffer->mapped) + offset;
+}
+
+// Mappable buffers are host coherent and mapped for their whole life, so there's nothing to wait for.
+NkBufferMapAsyncStatus nkBufferMap(NkBuffer buffer, NkMapModeFlags mode, size_t offset, size_t size) {
+
+    NK_ASSERT(buffer);
+
+    return (buffer->mapped && offset + size <= buffer->size) ? NkBufferMapAsyncStatus_Success : NkBufferMapAsyncStatus_Error;
+}
+
+void nkBufferUnmap(NkBuffer buffer) {
+    NK_ASSERT(buffer);
+}
+
+// Methods of ComputePipeline
+void nkDestroyComputePipeline(NkComputePipeline computePipeline) {
+
+    NK_ASSERT(computePipeline);
+
+    vkDestroyPipeline(computePipeline->device->device, computePipeline->pipeline, NK_NULL);
+    nkDestroyPipelineLayout(computePipeline->layout);
+    NK_FREE(computePipeline);
+}
+
+NkBindGroupLayout nkComputePipelineGetBindGroupLayout(NkComputePipeline computePipeline, uint32_t groupIndex) {
+
+    NK_ASSERT(computePipeline);
+    NK_ASSERT(groupIndex < computePipeline->layout->bindGroupLayoutCount);
+
+    return nkVkRetainBindGroupLayout(computePipeline->layout->bindGroupLayouts[groupIndex]);
+}
+
+// Methods of Device
+static void nkVkSavePipelineCache(NkDevice device);
+static void nkVkDestroyPipelineTasks(NkDevice device);
+static void nkVkDestroyPipelineLibraries(NkDevice device);
+static void nkVkDestroyQueue(NkDevice device);
+static void nkVkDestroyRenderPasses(NkDevice device);
+static void nkVkDestroySamplers(NkDevice device);
+static void nkVkDestroyShaderModules(NkDevice device);
+
+void nkDestroyDevice(NkDevice device) {
+
+    NK_ASSERT(device);
+
+    nkVkDestroyPipelineTasks(device);
+
+    if (device->pipelineCachePath) {
+        nkVkSavePipelineCache(device);
+        NK_FREE(device->pipelineCachePath);
+    }
+    vkDestroyPipelineCache(device->device, device->pipelineCache, NK_NULL);
+
+    nkVkDestroyPipelineLibraries(device);
+    nkHashMapDestroy(&device->renderPipelineVariants);
+    nkHashMapDestroy(&device->renderPipelines);
+    nkMutexDestroy(&device->pipelineMutex);
+
+    nkVkDestroySamplers(device);
+    nkVkDestroyBindless(device);
+    nkVkDestroyBindGroups(device);
+    nkVkDestroyLayouts(device);
+    nkVkDestroyRenderPasses(device);
+    nkVkDestroyShaderModules(device);
+    nkVkDestroyQueue(device);
+
+    vkDestroyDevice(device->device, NK_NULL);
+    NK_FREE(device);
+}
+
+NkBindGroup nkCreateBindGroup(NkDevice device, const NkBindGroupInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(descriptor->layout);
+    NK_ASSERT(descriptor->entryCount == 0 || descriptor->entries);
+    NK_ASSERT(descriptor->entryCount <= NK_MAX_BINDINGS_PER_BIND_GROUP);
+
+    NkBindGroupLayout layout = descriptor->layout;
+    NK_ASSERT(layout != device->bindlessLayout);
+    NK_ASSERT(!layout->pushed);
+
+    NkBindGroupEntry entries[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    const uint32_t entryCount = descriptor->entryCount;
+    if (entryCount > 0) {
+        memcpy(entries, descriptor->entries, sizeof(NkBindGroupEntry) * entryCount);
+    }
+    nkVkSortBindGroupEntries(entries, entryCount);
+
+    const uint64_t hash = nkVkHashBindGroup(layout, entries, entryCount);
+
+    nkMutexLock(&device->bindGroupMutex);
+
+    if (descriptor->transient) {
+        NkVkBindGroupFrame* frame = device->bindGroupFrames + device->bindGroupFrameIndex;
+
+        NkBindGroup bindGroup = NK_PTR_CAST(NkBindGroup, nkHashMapFind(&frame->bindGroups, hash));
+        if (bindGroup == NK_NULL) {
+            // a set that couldn't be written goes back with the rest of the frame's pool
+            const VkDescriptorSet set = nkVkAllocateTransientSet(device, frame, layout);
+            if (!nkVkWriteBindGroup(device, layout, set, entries, entryCount)) {
+                nkMutexUnlock(&device->bindGroupMutex);
+                return NK_NULL;
+            }
+
+            bindGroup = nkVkAllocateTransientBindGroup(frame);
+            bindGroup->device = device;
+            bindGroup->layout = NK_NULL;
+            bindGroup->set = set;
+            bindGroup->hash = hash;
+            bindGroup->refCount = 0;
+            nkHashMapInsert(&frame->bindGroups, hash, bindGroup);
+        }
+
+        nkMutexUnlock(&device->bindGroupMutex);
+        return bindGroup;
+    }
+
+    NkBindGroup bindGroup = NK_PTR_CAST(NkBindGroup, nkHashMapFind(&device->bindGroups, hash));
+    if (bindGroup) {
+        bindGroup->refCount++;
+        nkMutexUnlock(&device->bindGroupMutex);
+        return bindGroup;
+    }
+
+    // The set is written before it's published, so another thread can't find it half filled in.
+    const VkDescriptorSet set = nkVkAllocateLayoutSet(device, layout);
+    if (!nkVkWriteBindGroup(device, layout, set, entries, entryCount)) {
+        nkVkFreeLayoutSet(layout, set);
+        nkMutexUnlock(&device->bindGroupMutex);
+        return NK_NULL;
+    }
+
+    bindGroup = NK_PTR_CAST(NkBindGroup, NK_MALLOC(sizeof(struct NkBindGroupImpl)));
+    NK_ASSERT(bindGroup);
+
+    bindGroup->device = device;
+    bindGroup->layout = nkVkRetainBindGroupLayout(layout);
+    bindGroup->set = set;
+    bindGroup->hash = hash;
+    bindGroup->refCount = 1;
+
+    nkHashMapInsert(&device->bindGroups, hash, bindGroup);
+
+    nkMutexUnlock(&device->bindGroupMutex);
+
+    return bindGroup;
+}
+
+NkBindGroupLayout nkCreateBindGroupLayout(NkDevice device, const NkBindGroupLayoutInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    return nkVkGetBindGroupLayout(device, descriptor->entries, descriptor->entryCount, descriptor->perDraw);
+}
+
+static VkBufferUsageFlags nkVkBufferUsage(NkBufferUsageFlags usage) {
+
+    VkBufferUsageFlags flags = 0;
+    if (usage & NkBufferUsage_CopySrc) {
+        flags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
+    if (usage & (NkBufferUsage_CopyDst | NkBufferUsage_QueryResolve)) {
+        flags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+    if (usage & NkBufferUsage_Index) {
+        flags |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    }
+    if (usage & NkBufferUsage_Vertex) {
+        flags |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    }
+    if (usage & NkBufferUsage_Uniform) {
+        flags |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    }
+    if (usage & NkBufferUsage_Storage) {
+        flags |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    }
+    if (usage & NkBufferUsage_Indirect) {
+        flags |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    }
+    if (usage & NkBufferUsage_DeviceAddress) {
+        flags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    }
+    return flags;
+}
+
+// Picks the first memory type with every required property, preferring one that also has the preferred ones.
+static uint32_t nkVkFindMemoryType(NkDevice device, uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) {
+
+    const VkPhysicalDeviceMemoryProperties* properties = &device->memoryProperties;
+    const VkMemoryPropertyFlags wanted[2] = { required | preferred, required };
+
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < properties->memoryTypeCount; i++) {
+            const VkMemoryPropertyFlags flags = properties->memoryTypes[i].propertyFlags;
+            if ((typeBits & (1u << i)) && (flags & wanted[pass]) == wanted[pass]) {
+                return i;
+            }
+        }
+    }
+
+    NK_ASSERT(NkFalse);
+    return 0;
+}
+
+NkBuffer nkCreateBuffer(NkDevice device, const NkBufferInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    if ((descriptor->usage & NkBufferUsage_DeviceAddress) && !device->bufferDeviceAddress) {
+        NK_LOG("Neko: NkBufferUsage_DeviceAddress isn't supported by this device at %s:%d.\n");
+        return NK_NULL;
+    }
+
+    NkBuffer buffer = NK_PTR_CAST(NkBuffer, NK_MALLOC(sizeof(struct NkBufferImpl)));
+    NK_ASSERT(buffer);
+
+    buffer->device = device;
+    buffer->size = descriptor->size;
+    buffer->id = nkNextObjectId();
+    buffer->usage = descriptor->usage;
+    buffer->mapped = NK_NULL;
+    buffer->bindlessIndex = NK_VK_BINDLESS_INVALID_INDEX;
+    buffer->deviceAddress = 0;
+
+    // Vulkan has no empty buffers.
+    VkBufferCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.size = NK_MAX(descriptor->size, 4);
+        createInfo.usage = nkVkBufferUsage(descriptor->usage);
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.queueFamilyIndexCount = 0;
+        createInfo.pQueueFamilyIndices = NK_NULL;
+    }
+
+    NK_CHECK_VK(vkCreateBuffer(device->device, &createInfo, NK_NULL, &buffer->buffer));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device->device, buffer->buffer, &requirements);
+
+    // Anything the CPU touches lives in host memory and stays mapped, everything else goes where the GPU is fastest.
+    const NkBool hostVisible = (descriptor->mappedAtCreation || (descriptor->usage & (NkBufferUsage_MapRead | NkBufferUsage_MapWrite))) ? NkTrue : NkFalse;
+    const VkMemoryPropertyFlags required = hostVisible ?
+        (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const VkMemoryPropertyFlags preferred = (descriptor->usage & NkBufferUsage_MapRead) ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT : 0;
+
+    // Memory backing an addressable buffer has to be allocated as addressable too.
+    VkMemoryAllocateFlagsInfo flagsInfo;
+    {
+        flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+        flagsInfo.pNext = NK_NULL;
+        flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+        flagsInfo.deviceMask = 0;
+    }
+
+    VkMemoryAllocateInfo allocateInfo;
+    {
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.pNext = (descriptor->usage & NkBufferUsage_DeviceAddress) ? &flagsInfo : NK_NULL;
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = nkVkFindMemoryType(device, requirements.memoryTypeBits, required, preferred);
+    }
+
+    NK_CHECK_VK(vkAllocateMemory(device->device, &allocateInfo, NK_NULL, &buffer->memory));
+    NK_CHECK_VK(vkBindBufferMemory(device->device, buffer->buffer, buffer->memory, 0));
+
+    // The address never changes, so it's asked for once instead of on every call.
+    if (descriptor->usage & NkBufferUsage_DeviceAddress) {
+        VkBufferDeviceAddressInfo addressInfo;
+        {
+            addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+            addressInfo.pNext = NK_NULL;
+            addressInfo.buffer = buffer->buffer;
+        }
+        buffer->deviceAddress = device->getBufferDeviceAddress(device->device, &addressInfo);
+    }
+
+    if (hostVisible) {
+        NK_CHECK_VK(vkMapMemory(device->device, buffer->memory, 0, VK_WHOLE_SIZE, 0, &buffer->mapped));
+    }
+
+    return buffer;
+}
+
+NkPipelineLayout nkCreatePipelineLayout(NkDevice device, const NkPipelineLayoutInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    return nkVkGetPipelineLayout(device, descriptor->bindGroupLayouts, descriptor->bindGroupLayoutCount, 0, 0);
+}
+
+NkQuerySet nkCreateQuerySet(NkDevice device, const NkQuerySetInfo* descriptor) {
+
+}
+
+NkRenderBundleEncoder nkCreateRenderBundleEncoder(NkDevice device, const NkRenderBundleEncoderInfo* descriptor) {
+
+}
+
+static VkVertexInputRate nkVkInputRate(NkInputStepMode stepMode) {
+    switch (stepMode) {
+    case NkInputStepMode_Vertex:
+        return VK_VERTEX_INPUT_RATE_VERTEX;
+    case NkInputStepMode_Instance:
+        return VK_VERTEX_INPUT_RATE_INSTANCE;
+    }
+    return VK_VERTEX_INPUT_RATE_MAX_ENUM;
+}
+
+static VkFormat nkVkFormat(NkVertexFormat format) {
+    switch (format) {
+    case NkVertexFormat_UChar2:
+        return VK_FORMAT_R8G8_UINT;
+    case NkVertexFormat_UChar4:
+        return VK_FORMAT_R8G8B8A8_UINT;
+    case NkVertexFormat_Char2:
+        return VK_FORMAT_R8G8_SINT;
+    case NkVertexFormat_Char4:
+        return VK_FORMAT_R8G8B8A8_SINT;
+    case NkVertexFormat_UChar2Norm:
         return VK_FORMAT_R8G8_UNORM;
     case NkVertexFormat_UChar4Norm:
         return VK_FORMAT_R8G8B8A8_UNORM;
@@ -1832,763 +6639,5694 @@ static VkFormat nkVkFormat(NkVertexFormat format) {
     case NkVertexFormat_Int4:
         return VK_FORMAT_R32G32B32A32_SINT;
     }
-    return VK_FORMAT_MAX_ENUM;
+    return VK_FORMAT_MAX_ENUM;
+}
+
+static VkFormat nkVkTextureFormat(NkTextureFormat format) {
+    switch (format) {
+    case NkTextureFormat_R8Unorm:
+        return VK_FORMAT_R8_UNORM;
+    case NkTextureFormat_R8Snorm:
+        return VK_FORMAT_R8_SNORM;
+    case NkTextureFormat_R8Uint:
+        return VK_FORMAT_R8_UINT;
+    case NkTextureFormat_R8Sint:
+        return VK_FORMAT_R8_SINT;
+    case NkTextureFormat_R16Uint:
+        return VK_FORMAT_R16_UINT;
+    case NkTextureFormat_R16Sint:
+        return VK_FORMAT_R16_SINT;
+    case NkTextureFormat_R16Float:
+        return VK_FORMAT_R16_SFLOAT;
+    case NkTextureFormat_RG8Unorm:
+        return VK_FORMAT_R8G8_UNORM;
+    case NkTextureFormat_RG8Snorm:
+        return VK_FORMAT_R8G8_SNORM;
+    case NkTextureFormat_RG8Uint:
+        return VK_FORMAT_R8G8_UINT;
+    case NkTextureFormat_RG8Sint:
+        return VK_FORMAT_R8G8_SINT;
+    case NkTextureFormat_R32Float:
+        return VK_FORMAT_R32_SFLOAT;
+    case NkTextureFormat_R32Uint:
+        return VK_FORMAT_R32_UINT;
+    case NkTextureFormat_R32Sint:
+        return VK_FORMAT_R32_SINT;
+    case NkTextureFormat_RG16Uint:
+        return VK_FORMAT_R16G16_UINT;
+    case NkTextureFormat_RG16Sint:
+        return VK_FORMAT_R16G16_SINT;
+    case NkTextureFormat_RG16Float:
+        return VK_FORMAT_R16G16_SFLOAT;
+    case NkTextureFormat_RGBA8Unorm:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    case NkTextureFormat_RGBA8UnormSrgb:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    case NkTextureFormat_RGBA8Snorm:
+        return VK_FORMAT_R8G8B8A8_SNORM;
+    case NkTextureFormat_RGBA8Uint:
+        return VK_FORMAT_R8G8B8A8_UINT;
+    case NkTextureFormat_RGBA8Sint:
+        return VK_FORMAT_R8G8B8A8_SINT;
+    case NkTextureFormat_BGRA8Unorm:
+        return VK_FORMAT_B8G8R8A8_UNORM;
+    case NkTextureFormat_BGRA8UnormSrgb:
+        return VK_FORMAT_B8G8R8A8_SRGB;
+    case NkTextureFormat_RGB10A2Unorm:
+        return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    case NkTextureFormat_RG11B10Ufloat:
+        return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+    case NkTextureFormat_RGB9E5Ufloat:
+        return VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+    case NkTextureFormat_RG32Float:
+        return VK_FORMAT_R32G32_SFLOAT;
+    case NkTextureFormat_RG32Uint:
+        return VK_FORMAT_R32G32_UINT;
+    case NkTextureFormat_RG32Sint:
+        return VK_FORMAT_R32G32_SINT;
+    case NkTextureFormat_RGBA16Uint:
+        return VK_FORMAT_R16G16B16A16_UINT;
+    case NkTextureFormat_RGBA16Sint:
+        return VK_FORMAT_R16G16B16A16_SINT;
+    case NkTextureFormat_RGBA16Float:
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case NkTextureFormat_RGBA32Float:
+        return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case NkTextureFormat_RGBA32Uint:
+        return VK_FORMAT_R32G32B32A32_UINT;
+    case NkTextureFormat_RGBA32Sint:
+        return VK_FORMAT_R32G32B32A32_SINT;
+    case NkTextureFormat_Depth32Float:
+        return VK_FORMAT_D32_SFLOAT;
+    case NkTextureFormat_Depth24Plus:
+        return VK_FORMAT_D32_SFLOAT; // "24 plus" only promises at least 24 bits, and D32 is the format every desktop driver supports
+    case NkTextureFormat_Depth24PlusStencil8:
+        return VK_FORMAT_D24_UNORM_S8_UINT;
+    case NkTextureFormat_Stencil8:
+        return VK_FORMAT_S8_UINT;
+    case NkTextureFormat_BC1RGBAUnorm:
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case NkTextureFormat_BC1RGBAUnormSrgb:
+        return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case NkTextureFormat_BC2RGBAUnorm:
+        return VK_FORMAT_BC2_UNORM_BLOCK;
+    case NkTextureFormat_BC2RGBAUnormSrgb:
+        return VK_FORMAT_BC2_SRGB_BLOCK;
+    case NkTextureFormat_BC3RGBAUnorm:
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    case NkTextureFormat_BC3RGBAUnormSrgb:
+        return VK_FORMAT_BC3_SRGB_BLOCK;
+    case NkTextureFormat_BC4RUnorm:
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+    case NkTextureFormat_BC4RSnorm:
+        return VK_FORMAT_BC4_SNORM_BLOCK;
+    case NkTextureFormat_BC5RGUnorm:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case NkTextureFormat_BC5RGSnorm:
+        return VK_FORMAT_BC5_SNORM_BLOCK;
+    case NkTextureFormat_BC6HRGBUfloat:
+        return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case NkTextureFormat_BC6HRGBFloat:
+        return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+    case NkTextureFormat_BC7RGBAUnorm:
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+    case NkTextureFormat_BC7RGBAUnormSrgb:
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static NkBool nkVkFormatHasDepth(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return NkTrue;
+    default:
+        return NkFalse;
+    }
+}
+
+static NkBool nkVkFormatHasStencil(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    case VK_FORMAT_S8_UINT:
+        return NkTrue;
+    default:
+        return NkFalse;
+    }
+}
+
+static VkImageAspectFlags nkVkImageAspect(VkFormat format, NkTextureAspect aspect) {
+    switch (aspect) {
+    case NkTextureAspect_DepthOnly:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case NkTextureAspect_StencilOnly:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        break;
+    }
+
+    VkImageAspectFlags flags = 0;
+    flags |= nkVkFormatHasDepth(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : 0;
+    flags |= nkVkFormatHasStencil(format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0;
+    return flags != 0 ? flags : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+static VkSampleCountFlagBits nkVkSampleCount(uint32_t sampleCount) {
+    return sampleCount > 1 ? NK_CAST(VkSampleCountFlagBits, sampleCount) : VK_SAMPLE_COUNT_1_BIT;
+}
+
+static VkCompareOp nkVkCompareOp(NkCompareFunction compare) {
+    switch (compare) {
+    case NkCompareFunction_Never:
+        return VK_COMPARE_OP_NEVER;
+    case NkCompareFunction_Less:
+        return VK_COMPARE_OP_LESS;
+    case NkCompareFunction_LessEqual:
+        return VK_COMPARE_OP_LESS_OR_EQUAL;
+    case NkCompareFunction_Greater:
+        return VK_COMPARE_OP_GREATER;
+    case NkCompareFunction_GreaterEqual:
+        return VK_COMPARE_OP_GREATER_OR_EQUAL;
+    case NkCompareFunction_Equal:
+        return VK_COMPARE_OP_EQUAL;
+    case NkCompareFunction_NotEqual:
+        return VK_COMPARE_OP_NOT_EQUAL;
+    default:
+        return VK_COMPARE_OP_ALWAYS;
+    }
+}
+
+static VkStencilOp nkVkStencilOp(NkStencilOperation operation) {
+    switch (operation) {
+    case NkStencilOperation_Zero:
+        return VK_STENCIL_OP_ZERO;
+    case NkStencilOperation_Replace:
+        return VK_STENCIL_OP_REPLACE;
+    case NkStencilOperation_Invert:
+        return VK_STENCIL_OP_INVERT;
+    case NkStencilOperation_IncrementClamp:
+        return VK_STENCIL_OP_INCREMENT_AND_CLAMP;
+    case NkStencilOperation_DecrementClamp:
+        return VK_STENCIL_OP_DECREMENT_AND_CLAMP;
+    case NkStencilOperation_IncrementWrap:
+        return VK_STENCIL_OP_INCREMENT_AND_WRAP;
+    case NkStencilOperation_DecrementWrap:
+        return VK_STENCIL_OP_DECREMENT_AND_WRAP;
+    default:
+        return VK_STENCIL_OP_KEEP;
+    }
+}
+
+static VkBlendFactor nkVkBlendFactor(NkBlendFactor factor) {
+    switch (factor) {
+    case NkBlendFactor_Zero:
+        return VK_BLEND_FACTOR_ZERO;
+    case NkBlendFactor_One:
+        return VK_BLEND_FACTOR_ONE;
+    case NkBlendFactor_SrcColor:
+        return VK_BLEND_FACTOR_SRC_COLOR;
+    case NkBlendFactor_OneMinusSrcColor:
+        return VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+    case NkBlendFactor_SrcAlpha:
+        return VK_BLEND_FACTOR_SRC_ALPHA;
+    case NkBlendFactor_OneMinusSrcAlpha:
+        return VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    case NkBlendFactor_DstColor:
+        return VK_BLEND_FACTOR_DST_COLOR;
+    case NkBlendFactor_OneMinusDstColor:
+        return VK_BLEND_FACTOR_ONE_MINUS_DST_COLOR;
+    case NkBlendFactor_DstAlpha:
+        return VK_BLEND_FACTOR_DST_ALPHA;
+    case NkBlendFactor_OneMinusDstAlpha:
+        return VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA;
+    case NkBlendFactor_SrcAlphaSaturated:
+        return VK_BLEND_FACTOR_SRC_ALPHA_SATURATE;
+    case NkBlendFactor_BlendColor:
+        return VK_BLEND_FACTOR_CONSTANT_COLOR;
+    case NkBlendFactor_OneMinusBlendColor:
+        return VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR;
+    default:
+        return VK_BLEND_FACTOR_ONE;
+    }
+}
+
+static VkBlendOp nkVkBlendOp(NkBlendOperation operation) {
+    switch (operation) {
+    case NkBlendOperation_Subtract:
+        return VK_BLEND_OP_SUBTRACT;
+    case NkBlendOperation_ReverseSubtract:
+        return VK_BLEND_OP_REVERSE_SUBTRACT;
+    case NkBlendOperation_Min:
+        return VK_BLEND_OP_MIN;
+    case NkBlendOperation_Max:
+        return VK_BLEND_OP_MAX;
+    default:
+        return VK_BLEND_OP_ADD;
+    }
+}
+
+// A zeroed NkBlendInfo is taken to mean no blending, the same as the replace equation, rather than writing zero.
+static VkColorComponentFlags nkVkColorWriteMask(NkColorWriteMaskFlags writeMask) {
+
+    VkColorComponentFlags flags = 0;
+    flags |= (writeMask & NkColorWriteMask_Red) ? VK_COLOR_COMPONENT_R_BIT : 0;
+    flags |= (writeMask & NkColorWriteMask_Green) ? VK_COLOR_COMPONENT_G_BIT : 0;
+    flags |= (writeMask & NkColorWriteMask_Blue) ? VK_COLOR_COMPONENT_B_BIT : 0;
+    flags |= (writeMask & NkColorWriteMask_Alpha) ? VK_COLOR_COMPONENT_A_BIT : 0;
+    return flags;
+}
+
+static VkCullModeFlags nkVkCullMode(NkCullMode cullMode) {
+    switch (cullMode) {
+    case NkCullMode_Front:
+        return VK_CULL_MODE_FRONT_BIT;
+    case NkCullMode_Back:
+        return VK_CULL_MODE_BACK_BIT;
+    default:
+        return VK_CULL_MODE_NONE;
+    }
+}
+
+static VkFrontFace nkVkFrontFace(NkFrontFace frontFace) {
+    return frontFace == NkFrontFace_CW ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+}
+
+static VkAttachmentLoadOp nkVkLoadOp(NkLoadOp loadOp) {
+    return loadOp == NkLoadOp_Clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+}
+
+static VkAttachmentStoreOp nkVkStoreOp(NkStoreOp storeOp) {
+    // NkStoreOp_Clear means the contents aren't needed after the pass, which is what DONT_CARE lets the driver skip
+    return storeOp == NkStoreOp_Store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+}
+
+static VkPrimitiveTopology nkVkPrimitiveTopology(NkPrimitiveTopology topology) {
+    switch (topology) {
+    case NkPrimitiveTopology_PointList:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case NkPrimitiveTopology_LineList:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case NkPrimitiveTopology_LineStrip:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+    case NkPrimitiveTopology_TriangleList:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    case NkPrimitiveTopology_TriangleStrip:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    }
+    return VK_PRIMITIVE_TOPOLOGY_MAX_ENUM;
+}
+
+VkBool32 nkVkShouldEnablePrimitiveRestart(NkPrimitiveTopology topology) {
+    // Primitive restart is always enabled in Neko (due to Metal always enabling primitive restart)
+    // but Vulkan validation rules ask that primitive restart be only enabled on primitive topologies
+    // that support restarting.
+
+    switch (topology) {
+    case NkPrimitiveTopology_PointList:
+    case NkPrimitiveTopology_LineList:
+    case NkPrimitiveTopology_TriangleList:
+        return NkFalse;
+    case NkPrimitiveTopology_LineStrip:
+    case NkPrimitiveTopology_TriangleStrip:
+        return NkTrue;
+    }
+}
+
+// Dynamic topology can only move between topologies of the same class, so that's all a pipeline is keyed on.
+static VkPrimitiveTopology nkVkPrimitiveTopologyClass(NkPrimitiveTopology topology) {
+    switch (topology) {
+    case NkPrimitiveTopology_PointList:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case NkPrimitiveTopology_LineList:
+    case NkPrimitiveTopology_LineStrip:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+static void nkVkHashProgrammableStage(NkHasher* hasher, const NkProgrammableStageInfo* stage) {
+
+    nkHashU64(hasher, stage->module ? stage->module->hash : 0);
+    nkHashString(hasher, stage->entryPoint);
+
+    nkHashU32(hasher, stage->constantCount);
+    for (uint32_t i = 0; i < stage->constantCount; i++) {
+        nkHashU32(hasher, stage->constants[i].constantId);
+        nkHashU32(hasher, stage->constants[i].value.u32);
+    }
+}
+
+static void nkVkHashStencilFace(NkHasher* hasher, const NkStencilStateFaceInfo* face) {
+
+    nkHashU32(hasher, face->compare);
+    nkHashU32(hasher, face->failOp);
+    nkHashU32(hasher, face->depthFailOp);
+    nkHashU32(hasher, face->passOp);
+}
+
+static void nkVkHashBlend(NkHasher* hasher, const NkBlendInfo* blend) {
+
+    nkHashU32(hasher, blend->operation);
+    nkHashU32(hasher, blend->srcFactor);
+    nkHashU32(hasher, blend->dstFactor);
+}
+
+static NkPipelineLayout nkVkResolveRenderPipelineLayout(NkDevice device, const NkRenderPipelineInfo* descriptor) {
+
+    const NkProgrammableStageInfo* stages[] = { &descriptor->vertexStage, &descriptor->fragmentStage };
+    const NkShaderStage stageFlags[] = { NkShaderStage_Vertex, NkShaderStage_Fragment };
+    return nkVkResolvePipelineLayout(device, descriptor->layout, stages, stageFlags, 2, descriptor->perDrawBindGroups);
+}
+
+static NkPipelineLayout nkVkResolveComputePipelineLayout(NkDevice device, const NkComputePipelineInfo* descriptor) {
+
+    const NkProgrammableStageInfo* stages[] = { &descriptor->computeStage };
+    const NkShaderStage stageFlags[] = { NkShaderStage_Compute };
+    return nkVkResolvePipelineLayout(device, descriptor->layout, stages, stageFlags, 1, 0);
+}
+
+// The four pieces VK_EXT_graphics_pipeline_library splits a graphics pipeline into. Render pipelines are
+// hashed per part, so a part can be cached and shared between every pipeline that uses it.
+typedef enum NkVkPipelineLibraryPart {
+    NkVkPipelineLibraryPart_VertexInput,
+    NkVkPipelineLibraryPart_PreRasterization,
+    NkVkPipelineLibraryPart_Fragment,
+    NkVkPipelineLibraryPart_FragmentOutput,
+    NkVkPipelineLibraryPart_Count,
+} NkVkPipelineLibraryPart;
+
+// Hashes everything in the descriptor that can affect each part of the compiled pipeline. Optional state is
+// prefixed with a presence flag, so that leaving a struct out never hashes the same as passing one full of zeroes.
+// State the device sets dynamically is left out, which is what folds permutations that differ only there together.
+static void nkVkHashRenderPipelineParts(NkDevice device, const NkRenderPipelineInfo* descriptor, NkPipelineLayout layout, uint64_t* partHashes) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(layout);
+    NK_ASSERT(partHashes);
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU32(&hasher, NkVkPipelineLibraryPart_VertexInput);
+
+    nkHashU32(&hasher, descriptor->vertexState != NK_NULL);
+    if (descriptor->vertexState) {
+        nkHashU32(&hasher, descriptor->vertexState->vertexBufferCount);
+        for (uint32_t slot = 0; slot < descriptor->vertexState->vertexBufferCount; slot++) {
+            const NkVertexBufferLayoutInfo* vertexBuffer = descriptor->vertexState->vertexBuffers + slot;
+            nkHashU64(&hasher, vertexBuffer->arrayStride);
+            nkHashU32(&hasher, vertexBuffer->stepMode);
+            nkHashU32(&hasher, vertexBuffer->attributeCount);
+            for (uint32_t attributeIndex = 0; attributeIndex < vertexBuffer->attributeCount; attributeIndex++) {
+                const NkVertexAttributeInfo* attribute = vertexBuffer->attributes + attributeIndex;
+                nkHashU32(&hasher, attribute->format);
+                nkHashU64(&hasher, attribute->offset);
+                nkHashU32(&hasher, attribute->shaderLocation);
+            }
+        }
+    }
+
+    if (device->dynamicState & NkDynamicState_Rasterization) {
+        nkHashU32(&hasher, nkVkPrimitiveTopologyClass(descriptor->primitiveTopology));
+        if (!device->dynamicPrimitiveRestart) {
+            nkHashU32(&hasher, nkVkShouldEnablePrimitiveRestart(descriptor->primitiveTopology));
+        }
+    }
+    else {
+        nkHashU32(&hasher, descriptor->primitiveTopology);
+    }
+
+    partHashes[NkVkPipelineLibraryPart_VertexInput] = nkHasherFinish(&hasher);
+
+    hasher = nkCreateHasher();
+    nkHashU32(&hasher, NkVkPipelineLibraryPart_PreRasterization);
+
+    nkVkHashProgrammableStage(&hasher, &descriptor->vertexStage);
+    nkHashU64(&hasher, layout->hash);
+
+    nkHashU32(&hasher, descriptor->rasterizationState != NK_NULL);
+    if (descriptor->rasterizationState) {
+        if (!(device->dynamicState & NkDynamicState_Rasterization)) {
+            nkHashU32(&hasher, descriptor->rasterizationState->frontFace);
+            nkHashU32(&hasher, descriptor->rasterizationState->cullMode);
+        }
+        nkHashU32(&hasher, NK_CAST(uint32_t, descriptor->rasterizationState->depthBias));
+        nkHashFloat(&hasher, descriptor->rasterizationState->depthBiasSlopeScale);
+        nkHashFloat(&hasher, descriptor->rasterizationState->depthBiasClamp);
+        if (!(device->dynamicState & NkDynamicState_DepthClamp)) {
+            nkHashU32(&hasher, descriptor->rasterizationState->clampDepth);
+        }
+    }
+
+    partHashes[NkVkPipelineLibraryPart_PreRasterization] = nkHasherFinish(&hasher);
+
+    hasher = nkCreateHasher();
+    nkHashU32(&hasher, NkVkPipelineLibraryPart_Fragment);
+
+    nkVkHashProgrammableStage(&hasher, &descriptor->fragmentStage);
+    nkHashU64(&hasher, layout->hash);
+
+    nkHashU32(&hasher, descriptor->sampleCount);
+
+    nkHashU32(&hasher, descriptor->depthStencilState != NK_NULL);
+    if (descriptor->depthStencilState) {
+        nkHashU32(&hasher, descriptor->depthStencilState->format);
+        if (!(device->dynamicState & NkDynamicState_DepthStencil)) {
+            nkHashU32(&hasher, descriptor->depthStencilState->depthWriteEnabled);
+            nkHashU32(&hasher, descriptor->depthStencilState->depthCompare);
+            nkVkHashStencilFace(&hasher, &descriptor->depthStencilState->stencilFront);
+            nkVkHashStencilFace(&hasher, &descriptor->depthStencilState->stencilBack);
+        }
+        nkHashU32(&hasher, descriptor->depthStencilState->stencilReadMask);
+        nkHashU32(&hasher, descriptor->depthStencilState->stencilWriteMask);
+    }
+
+    partHashes[NkVkPipelineLibraryPart_Fragment] = nkHasherFinish(&hasher);
+
+    hasher = nkCreateHasher();
+    nkHashU32(&hasher, NkVkPipelineLibraryPart_FragmentOutput);
+
+    nkHashU32(&hasher, descriptor->depthStencilState ? descriptor->depthStencilState->format : 0);
+
+    nkHashU32(&hasher, descriptor->colorStateCount);
+    for (uint32_t i = 0; i < descriptor->colorStateCount; i++) {
+        const NkColorStateInfo* colorState = descriptor->colorStates + i;
+        nkHashU32(&hasher, colorState->format);
+        if (!(device->dynamicState & NkDynamicState_ColorBlend)) {
+            // the blend halves don't reach the pipeline unless blending is enabled
+            nkHashU32(&hasher, colorState->blendEnabled ? 1 : 0);
+            if (colorState->blendEnabled) {
+                nkVkHashBlend(&hasher, &colorState->alphaBlend);
+                nkVkHashBlend(&hasher, &colorState->colorBlend);
+            }
+            nkHashU32(&hasher, colorState->writeMask);
+        }
+    }
+
+    nkHashU32(&hasher, descriptor->sampleCount);
+    nkHashU32(&hasher, descriptor->sampleMask);
+    nkHashU32(&hasher, descriptor->alphaToCoverageEnabled);
+
+    partHashes[NkVkPipelineLibraryPart_FragmentOutput] = nkHasherFinish(&hasher);
+}
+
+static uint64_t nkVkHashPipelineParts(const uint64_t* partHashes) {
+
+    NkHasher hasher = nkCreateHasher();
+    for (uint32_t part = 0; part < NkVkPipelineLibraryPart_Count; part++) {
+        nkHashU64(&hasher, partHashes[part]);
+    }
+    return nkHasherFinish(&hasher);
+}
+
+static uint64_t nkVkHashRenderPipelineInfo(NkDevice device, const NkRenderPipelineInfo* descriptor, NkPipelineLayout layout) {
+
+    uint64_t partHashes[NkVkPipelineLibraryPart_Count];
+    nkVkHashRenderPipelineParts(device, descriptor, layout, partHashes);
+    return nkVkHashPipelineParts(partHashes);
+}
+
+// Render passes and framebuffers. Devices with VK_KHR_dynamic_rendering need neither, everything else gets them
+// from two caches, so that beginning a pass costs one hash lookup once an attachment set has been seen.
+
+#define NK_VK_MAX_FRAMEBUFFER_ATTACHMENTS (NK_MAX_COLOR_ATTACHMENTS * 2 + 1)
+
+// Everything a VkRenderPass bakes in about its attachments. Views aren't part of it, so every attachment set with
+// the same formats and operations shares one render pass. Attachments are numbered colors first, then the resolve
+// targets of the colors that have one, then depth stencil, both here and in the framebuffers built against it.
+typedef struct NkVkRenderPassKey {
+    uint32_t colorAttachmentCount;
+    VkFormat colorFormats[NK_MAX_COLOR_ATTACHMENTS];
+    VkAttachmentLoadOp colorLoadOps[NK_MAX_COLOR_ATTACHMENTS];
+    VkAttachmentStoreOp colorStoreOps[NK_MAX_COLOR_ATTACHMENTS];
+    VkImageLayout colorLayouts[NK_MAX_COLOR_ATTACHMENTS];
+    VkImageLayout resolveLayouts[NK_MAX_COLOR_ATTACHMENTS]; // VK_IMAGE_LAYOUT_UNDEFINED without a resolve target
+    VkFormat depthStencilFormat; // VK_FORMAT_UNDEFINED without a depth stencil attachment
+    VkAttachmentLoadOp depthLoadOp;
+    VkAttachmentStoreOp depthStoreOp;
+    VkAttachmentLoadOp stencilLoadOp;
+    VkAttachmentStoreOp stencilStoreOp;
+    VkSampleCountFlagBits sampleCount;
+} NkVkRenderPassKey;
+
+typedef struct NkVkRenderPass {
+    VkRenderPass renderPass;
+} NkVkRenderPass;
+
+typedef struct NkVkFramebuffer {
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    uint64_t viewIds[NK_VK_MAX_FRAMEBUFFER_ATTACHMENTS];
+    uint32_t viewCount;
+} NkVkFramebuffer;
+
+static NkBool nkVkIsDepthStencilFormat(VkFormat format) {
+    return (nkVkFormatHasDepth(format) || nkVkFormatHasStencil(format)) ? NkTrue : NkFalse;
+}
+
+// The layout a view is left in between passes. Swap chain images go back to the presentation engine after every
+// pass, everything else stays in the layout it is drawn in.
+static VkImageLayout nkVkAttachmentLayout(NkTextureView view) {
+
+    if (view->presentable) {
+        return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+    return nkVkIsDepthStencilFormat(view->format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+}
+
+static void nkVkInitRenderPassKey(NkVkRenderPassKey* key, const NkRenderPassInfo* descriptor) {
+
+    NK_ASSERT(descriptor->colorAttachmentCount <= NK_MAX_COLOR_ATTACHMENTS);
+
+    memset(key, 0, sizeof(NkVkRenderPassKey));
+    key->colorAttachmentCount = descriptor->colorAttachmentCount;
+    key->sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        const NkRenderPassColorAttachmentInfo* attachment = descriptor->colorAttachments + i;
+        NK_ASSERT(attachment->attachment);
+
+        key->colorFormats[i] = attachment->attachment->format;
+        key->colorLoadOps[i] = nkVkLoadOp(attachment->loadOp);
+        key->colorStoreOps[i] = nkVkStoreOp(attachment->storeOp);
+        key->colorLayouts[i] = nkVkAttachmentLayout(attachment->attachment);
+        key->resolveLayouts[i] = attachment->resolveTarget ? nkVkAttachmentLayout(attachment->resolveTarget) : VK_IMAGE_LAYOUT_UNDEFINED;
+        key->sampleCount = attachment->attachment->sampleCount;
+    }
+
+    key->depthStencilFormat = VK_FORMAT_UNDEFINED;
+    if (descriptor->depthStencilAttachment) {
+        const NkRenderPassDepthStencilAttachmentInfo* attachment = descriptor->depthStencilAttachment;
+        NK_ASSERT(attachment->attachment);
+
+        key->depthStencilFormat = attachment->attachment->format;
+        key->depthLoadOp = nkVkLoadOp(attachment->depthLoadOp);
+        key->depthStoreOp = nkVkStoreOp(attachment->depthStoreOp);
+        key->stencilLoadOp = nkVkLoadOp(attachment->stencilLoadOp);
+        key->stencilStoreOp = nkVkStoreOp(attachment->stencilStoreOp);
+        key->sampleCount = attachment->attachment->sampleCount;
+    }
+}
+
+// A pipeline only has to be compatible with the passes it draws in, which comes down to formats and sample counts.
+// Resolve attachments don't count towards compatibility when a pass has a single subpass, so one render pass built
+// from the pipeline's formats covers every attachment set the pipeline can be used with.
+static void nkVkInitPipelineRenderPassKey(NkVkRenderPassKey* key, const NkRenderPipelineInfo* descriptor) {
+
+    NK_ASSERT(descriptor->colorStateCount <= NK_MAX_COLOR_ATTACHMENTS);
+
+    memset(key, 0, sizeof(NkVkRenderPassKey));
+    key->colorAttachmentCount = descriptor->colorStateCount;
+    key->sampleCount = nkVkSampleCount(descriptor->sampleCount);
+
+    for (uint32_t i = 0; i < descriptor->colorStateCount; i++) {
+        key->colorFormats[i] = nkVkTextureFormat(descriptor->colorStates[i].format);
+        key->colorLoadOps[i] = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        key->colorStoreOps[i] = VK_ATTACHMENT_STORE_OP_STORE;
+        key->colorLayouts[i] = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        key->resolveLayouts[i] = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    key->depthStencilFormat = descriptor->depthStencilState ? nkVkTextureFormat(descriptor->depthStencilState->format) : VK_FORMAT_UNDEFINED;
+    key->depthLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    key->depthStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+    key->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    key->stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+}
+
+static uint64_t nkVkHashRenderPassKey(const NkVkRenderPassKey* key) {
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU32(&hasher, key->colorAttachmentCount);
+    for (uint32_t i = 0; i < key->colorAttachmentCount; i++) {
+        nkHashU32(&hasher, key->colorFormats[i]);
+        nkHashU32(&hasher, key->colorLoadOps[i]);
+        nkHashU32(&hasher, key->colorStoreOps[i]);
+        nkHashU32(&hasher, key->colorLayouts[i]);
+        nkHashU32(&hasher, key->resolveLayouts[i]);
+    }
+    nkHashU32(&hasher, key->depthStencilFormat);
+    if (key->depthStencilFormat != VK_FORMAT_UNDEFINED) {
+        nkHashU32(&hasher, key->depthLoadOp);
+        nkHashU32(&hasher, key->depthStoreOp);
+        nkHashU32(&hasher, key->stencilLoadOp);
+        nkHashU32(&hasher, key->stencilStoreOp);
+    }
+    nkHashU32(&hasher, key->sampleCount);
+    return nkHasherFinish(&hasher);
+}
+
+static VkRenderPass nkVkCreateRenderPass(NkDevice device, const NkVkRenderPassKey* key) {
+
+    VkAttachmentDescription attachments[NK_VK_MAX_FRAMEBUFFER_ATTACHMENTS];
+    VkAttachmentReference colorReferences[NK_MAX_COLOR_ATTACHMENTS];
+    VkAttachmentReference resolveReferences[NK_MAX_COLOR_ATTACHMENTS];
+    VkAttachmentReference depthStencilReference;
+    uint32_t attachmentCount = 0;
+    NkBool hasResolveTargets = NkFalse;
+
+    for (uint32_t i = 0; i < key->colorAttachmentCount; i++) {
+        VkAttachmentDescription* attachment = attachments + attachmentCount;
+        {
+            attachment->flags = 0;
+            attachment->format = key->colorFormats[i];
+            attachment->samples = key->sampleCount;
+            attachment->loadOp = key->colorLoadOps[i];
+            attachment->storeOp = key->colorStoreOps[i];
+            attachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            // a cleared attachment throws its old contents away, so they don't need to be transitioned
+            attachment->initialLayout = key->colorLoadOps[i] == VK_ATTACHMENT_LOAD_OP_CLEAR ? VK_IMAGE_LAYOUT_UNDEFINED : key->colorLayouts[i];
+            attachment->finalLayout = key->colorLayouts[i];
+        }
+        colorReferences[i].attachment = attachmentCount++;
+        colorReferences[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    for (uint32_t i = 0; i < key->colorAttachmentCount; i++) {
+        resolveReferences[i].attachment = VK_ATTACHMENT_UNUSED;
+        resolveReferences[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (key->resolveLayouts[i] == VK_IMAGE_LAYOUT_UNDEFINED) {
+            continue;
+        }
+
+        VkAttachmentDescription* attachment = attachments + attachmentCount;
+        {
+            attachment->flags = 0;
+            attachment->format = key->colorFormats[i];
+            attachment->samples = VK_SAMPLE_COUNT_1_BIT;
+            attachment->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachment->finalLayout = key->resolveLayouts[i];
+        }
+        resolveReferences[i].attachment = attachmentCount++;
+        resolveReferences[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        hasResolveTargets = NkTrue;
+    }
+
+    const NkBool hasDepthStencil = key->depthStencilFormat != VK_FORMAT_UNDEFINED ? NkTrue : NkFalse;
+    if (hasDepthStencil) {
+        const NkBool clearsDepth = (!nkVkFormatHasDepth(key->depthStencilFormat) || key->depthLoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR) ? NkTrue : NkFalse;
+        const NkBool clearsStencil = (!nkVkFormatHasStencil(key->depthStencilFormat) || key->stencilLoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR) ? NkTrue : NkFalse;
+
+        VkAttachmentDescription* attachment = attachments + attachmentCount;
+        {
+            attachment->flags = 0;
+            attachment->format = key->depthStencilFormat;
+            attachment->samples = key->sampleCount;
+            attachment->loadOp = key->depthLoadOp;
+            attachment->storeOp = key->depthStoreOp;
+            attachment->stencilLoadOp = key->stencilLoadOp;
+            attachment->stencilStoreOp = key->stencilStoreOp;
+            attachment->initialLayout = (clearsDepth && clearsStencil) ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            attachment->finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        }
+        depthStencilReference.attachment = attachmentCount++;
+        depthStencilReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+
+    VkSubpassDescription subpass;
+    {
+        subpass.flags = 0;
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.inputAttachmentCount = 0;
+        subpass.pInputAttachments = NK_NULL;
+        subpass.colorAttachmentCount = key->colorAttachmentCount;
+        subpass.pColorAttachments = colorReferences;
+        subpass.pResolveAttachments = hasResolveTargets ? resolveReferences : NK_NULL;
+        subpass.pDepthStencilAttachment = hasDepthStencil ? &depthStencilReference : NK_NULL;
+        subpass.preserveAttachmentCount = 0;
+        subpass.pPreserveAttachments = NK_NULL;
+    }
+
+    // The implicit dependency on earlier work starts at the top of the pipe, which would let the layout transitions
+    // run before a swap chain image has been acquired. Waiting on the attachment stages closes that gap.
+    VkSubpassDependency dependency;
+    {
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dependencyFlags = 0;
+    }
+
+    VkRenderPassCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.attachmentCount = attachmentCount;
+        createInfo.pAttachments = attachments;
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpass;
+        createInfo.dependencyCount = 1;
+        createInfo.pDependencies = &dependency;
+    }
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    NK_CHECK_VK(vkCreateRenderPass(device->device, &createInfo, NK_NULL, &renderPass));
+    return renderPass;
+}
+
+static VkRenderPass nkVkGetRenderPass(NkDevice device, const NkVkRenderPassKey* key, uint64_t hash) {
+
+    nkMutexLock(&device->renderPassMutex);
+    NkVkRenderPass* cached = NK_PTR_CAST(NkVkRenderPass*, nkHashMapFind(&device->renderPasses, hash));
+    nkMutexUnlock(&device->renderPassMutex);
+
+    if (cached) {
+        return cached->renderPass;
+    }
+
+    VkRenderPass renderPass = nkVkCreateRenderPass(device, key);
+
+    nkMutexLock(&device->renderPassMutex);
+
+    cached = NK_PTR_CAST(NkVkRenderPass*, nkHashMapFind(&device->renderPasses, hash));
+    if (cached) {
+        nkMutexUnlock(&device->renderPassMutex);
+        vkDestroyRenderPass(device->device, renderPass, NK_NULL);
+        return cached->renderPass;
+    }
+
+    cached = NK_PTR_CAST(NkVkRenderPass*, NK_MALLOC(sizeof(NkVkRenderPass)));
+    NK_ASSERT(cached);
+    cached->renderPass = renderPass;
+    nkHashMapInsert(&device->renderPasses, hash, cached);
+
+    nkMutexUnlock(&device->renderPassMutex);
+
+    return renderPass;
+}
+
+static VkRenderPass nkVkGetPipelineRenderPass(NkDevice device, const NkRenderPipelineInfo* descriptor) {
+
+    NkVkRenderPassKey key;
+    nkVkInitPipelineRenderPassKey(&key, descriptor);
+    return nkVkGetRenderPass(device, &key, nkVkHashRenderPassKey(&key));
+}
+
+// Gathers the views of an attachment set, numbered the way nkVkCreateRenderPass numbers its attachments.
+static uint32_t nkVkGatherAttachmentViews(const NkRenderPassInfo* descriptor, NkTextureView* views) {
+
+    uint32_t viewCount = 0;
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        views[viewCount++] = descriptor->colorAttachments[i].attachment;
+    }
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        if (descriptor->colorAttachments[i].resolveTarget) {
+            views[viewCount++] = descriptor->colorAttachments[i].resolveTarget;
+        }
+    }
+    if (descriptor->depthStencilAttachment) {
+        views[viewCount++] = descriptor->depthStencilAttachment->attachment;
+    }
+    return viewCount;
+}
+
+static const NkVkFramebuffer* nkVkGetFramebuffer(NkDevice device, const NkRenderPassInfo* descriptor) {
+
+    NkVkRenderPassKey key;
+    nkVkInitRenderPassKey(&key, descriptor);
+    const uint64_t renderPassHash = nkVkHashRenderPassKey(&key);
+
+    NkTextureView views[NK_VK_MAX_FRAMEBUFFER_ATTACHMENTS];
+    const uint32_t viewCount = nkVkGatherAttachmentViews(descriptor, views);
+    NK_ASSERT(viewCount > 0);
+
+    // views are hashed by id, so a view allocated where a destroyed one used to be can't hit a stale framebuffer
+    NkHasher hasher = nkCreateHasher();
+    nkHashU64(&hasher, renderPassHash);
+    for (uint32_t i = 0; i < viewCount; i++) {
+        nkHashU64(&hasher, views[i]->id);
+    }
+    const uint64_t hash = nkHasherFinish(&hasher);
+
+    nkMutexLock(&device->renderPassMutex);
+    NkVkFramebuffer* cached = NK_PTR_CAST(NkVkFramebuffer*, nkHashMapFind(&device->framebuffers, hash));
+    nkMutexUnlock(&device->renderPassMutex);
+
+    if (cached) {
+        return cached;
+    }
+
+    NkVkFramebuffer* framebuffer = NK_PTR_CAST(NkVkFramebuffer*, NK_MALLOC(sizeof(NkVkFramebuffer)));
+    NK_ASSERT(framebuffer);
+
+    framebuffer->renderPass = nkVkGetRenderPass(device, &key, renderPassHash);
+    framebuffer->extent = views[0]->extent;
+    framebuffer->viewCount = viewCount;
+
+    VkImageView imageViews[NK_VK_MAX_FRAMEBUFFER_ATTACHMENTS];
+    for (uint32_t i = 0; i < viewCount; i++) {
+        NK_ASSERT(views[i]->extent.width == framebuffer->extent.width && views[i]->extent.height == framebuffer->extent.height);
+        imageViews[i] = views[i]->imageView;
+        framebuffer->viewIds[i] = views[i]->id;
+    }
+
+    VkFramebufferCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.renderPass = framebuffer->renderPass;
+        createInfo.attachmentCount = viewCount;
+        createInfo.pAttachments = imageViews;
+        createInfo.width = framebuffer->extent.width;
+        createInfo.height = framebuffer->extent.height;
+        createInfo.layers = 1;
+    }
+    NK_CHECK_VK(vkCreateFramebuffer(device->device, &createInfo, NK_NULL, &framebuffer->framebuffer));
+
+    nkMutexLock(&device->renderPassMutex);
+
+    cached = NK_PTR_CAST(NkVkFramebuffer*, nkHashMapFind(&device->framebuffers, hash));
+    if (cached) {
+        nkMutexUnlock(&device->renderPassMutex);
+        vkDestroyFramebuffer(device->device, framebuffer->framebuffer, NK_NULL);
+        NK_FREE(framebuffer);
+        return cached;
+    }
+
+    nkHashMapInsert(&device->framebuffers, hash, framebuffer);
+
+    nkMutexUnlock(&device->renderPassMutex);
+
+    return framebuffer;
+}
+
+// Framebuffers hold on to the views they were built from, so they go when one of those views does. Views are
+// destroyed rarely enough, typically on resize, that scanning the cache beats tracking framebuffers per view.
+// Render passes don't reference any views and stay cached.
+static void nkVkEvictFramebuffers(NkDevice device, uint64_t viewId) {
+
+    nkMutexLock(&device->renderPassMutex);
+
+    if (device->framebuffers.count == 0) {
+        nkMutexUnlock(&device->renderPassMutex);
+        return;
+    }
+
+    uint64_t* evicted = NK_PTR_CAST(uint64_t*, NK_MALLOC(sizeof(uint64_t) * device->framebuffers.count));
+    NK_ASSERT(evicted);
+    uint32_t evictedCount = 0;
+
+    for (uint32_t slot = 0; slot < device->framebuffers.capacity; slot++) {
+        if (device->framebuffers.keys[slot] == 0) {
+            continue;
+        }
+        const NkVkFramebuffer* framebuffer = NK_PTR_CAST(const NkVkFramebuffer*, device->framebuffers.values[slot]);
+        for (uint32_t i = 0; i < framebuffer->viewCount; i++) {
+            if (framebuffer->viewIds[i] == viewId) {
+                evicted[evictedCount++] = device->framebuffers.keys[slot];
+                break;
+            }
+        }
+    }
+
+    // removing shifts entries between slots, so nothing is removed until the scan is over
+    for (uint32_t i = 0; i < evictedCount; i++) {
+        NkVkFramebuffer* framebuffer = NK_PTR_CAST(NkVkFramebuffer*, nkHashMapFind(&device->framebuffers, evicted[i]));
+        vkDestroyFramebuffer(device->device, framebuffer->framebuffer, NK_NULL);
+        NK_FREE(framebuffer);
+        nkHashMapRemove(&device->framebuffers, evicted[i]);
+    }
+
+    nkMutexUnlock(&device->renderPassMutex);
+
+    NK_FREE(evicted);
+}
+
+static void nkVkDestroyRenderPasses(NkDevice device) {
+
+    for (uint32_t slot = 0; slot < device->framebuffers.capacity; slot++) {
+        if (device->framebuffers.keys[slot] != 0) {
+            NkVkFramebuffer* framebuffer = NK_PTR_CAST(NkVkFramebuffer*, device->framebuffers.values[slot]);
+            vkDestroyFramebuffer(device->device, framebuffer->framebuffer, NK_NULL);
+            NK_FREE(framebuffer);
+        }
+    }
+    nkHashMapDestroy(&device->framebuffers);
+
+    for (uint32_t slot = 0; slot < device->renderPasses.capacity; slot++) {
+        if (device->renderPasses.keys[slot] != 0) {
+            NkVkRenderPass* renderPass = NK_PTR_CAST(NkVkRenderPass*, device->renderPasses.values[slot]);
+            vkDestroyRenderPass(device->device, renderPass->renderPass, NK_NULL);
+            NK_FREE(renderPass);
+        }
+    }
+    nkHashMapDestroy(&device->renderPasses);
+
+    nkMutexDestroy(&device->renderPassMutex);
+}
+
+// Dynamic rendering leaves layouts alone, so swap chain images are moved in and out of their attachment layout
+// around the pass. Texture views are moved into it by nkVkTransitionTextureAttachments.
+static void nkVkTransitionPresentableAttachments(VkCommandBuffer commandBuffer, const NkRenderPassInfo* descriptor, NkBool beginning) {
+
+    VkImageMemoryBarrier barriers[NK_MAX_COLOR_ATTACHMENTS * 2];
+    uint32_t barrierCount = 0;
+
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        const NkRenderPassColorAttachmentInfo* attachment = descriptor->colorAttachments + i;
+        const NkTextureView views[2] = { attachment->attachment, attachment->resolveTarget };
+
+        for (uint32_t j = 0; j < 2; j++) {
+            if (views[j] == NK_NULL || !views[j]->presentable) {
+                continue;
+            }
+
+            // the previous contents only matter to an attachment that loads them
+            const NkBool keepsContents = (j == 0 && attachment->loadOp == NkLoadOp_Load) ? NkTrue : NkFalse;
+
+            VkImageMemoryBarrier* barrier = barriers + barrierCount++;
+            {
+                barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier->pNext = NK_NULL;
+                barrier->srcAccessMask = beginning ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier->dstAccessMask = beginning ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
+                barrier->oldLayout = beginning ? (keepsContents ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED) : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier->newLayout = beginning ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+                barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier->image = views[j]->image;
+                barrier->subresourceRange = views[j]->subresourceRange;
+            }
+        }
+    }
+
+    if (barrierCount == 0) {
+        return;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        beginning ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, NK_NULL, 0, NK_NULL, barrierCount, barriers);
+}
+
+// Textures are tracked through texture->layout, so a pass moves its texture attachments from wherever they rest
+// into the layout it draws in, and leaves them there for whatever reads them next.
+static void nkVkTransitionTextureAttachments(VkCommandBuffer commandBuffer, const NkRenderPassInfo* descriptor) {
+
+    VkImageMemoryBarrier barriers[NK_MAX_COLOR_ATTACHMENTS * 2 + 1];
+    uint32_t barrierCount = 0;
+
+    NkTextureView views[NK_MAX_COLOR_ATTACHMENTS * 2 + 1];
+    uint32_t viewCount = 0;
+
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        views[viewCount++] = descriptor->colorAttachments[i].attachment;
+        views[viewCount++] = descriptor->colorAttachments[i].resolveTarget;
+    }
+    views[viewCount++] = descriptor->depthStencilAttachment ? descriptor->depthStencilAttachment->attachment : NK_NULL;
+
+    for (uint32_t i = 0; i < viewCount; i++) {
+        const NkTextureView view = views[i];
+        if (view == NK_NULL || view->texture == NK_NULL) {
+            continue;
+        }
+
+        const VkImageLayout layout = nkVkAttachmentLayout(view);
+        if (view->texture->layout == layout) {
+            continue;
+        }
+
+        VkImageMemoryBarrier* barrier = barriers + barrierCount++;
+        {
+            barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier->pNext = NK_NULL;
+            barrier->srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier->dstAccessMask = nkVkIsDepthStencilFormat(view->format) ?
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT :
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barrier->oldLayout = view->texture->layout;
+            barrier->newLayout = layout;
+            barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier->image = view->image;
+            barrier->subresourceRange = view->subresourceRange;
+        }
+
+        view->texture->layout = layout;
+    }
+
+    if (barrierCount == 0) {
+        return;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, NK_NULL, 0, NK_NULL, barrierCount, barriers);
+}
+
+static void nkVkInitRenderingAttachment(VkRenderingAttachmentInfo* info, NkTextureView view, VkImageLayout layout, NkLoadOp loadOp, NkStoreOp storeOp) {
+
+    info->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    info->pNext = NK_NULL;
+    info->imageView = view->imageView;
+    info->imageLayout = layout;
+    info->resolveMode = VK_RESOLVE_MODE_NONE;
+    info->resolveImageView = VK_NULL_HANDLE;
+    info->resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    info->loadOp = nkVkLoadOp(loadOp);
+    info->storeOp = nkVkStoreOp(storeOp);
+    memset(&info->clearValue, 0, sizeof(VkClearValue));
+}
+
+static void nkVkBeginRendering(NkDevice device, VkCommandBuffer commandBuffer, const NkRenderPassInfo* descriptor) {
+
+    VkRenderingAttachmentInfo colorAttachments[NK_MAX_COLOR_ATTACHMENTS];
+    VkRenderingAttachmentInfo depthAttachment;
+    VkRenderingAttachmentInfo stencilAttachment;
+    VkExtent2D extent = { 0, 0 };
+
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        const NkRenderPassColorAttachmentInfo* attachment = descriptor->colorAttachments + i;
+        VkRenderingAttachmentInfo* info = colorAttachments + i;
+
+        nkVkInitRenderingAttachment(info, attachment->attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, attachment->loadOp, attachment->storeOp);
+        info->clearValue.color.float32[0] = attachment->clearColor.r;
+        info->clearValue.color.float32[1] = attachment->clearColor.g;
+        info->clearValue.color.float32[2] = attachment->clearColor.b;
+        info->clearValue.color.float32[3] = attachment->clearColor.a;
+
+        if (attachment->resolveTarget) {
+            info->resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+            info->resolveImageView = attachment->resolveTarget->imageView;
+            info->resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+
+        extent = attachment->attachment->extent;
+    }
+
+    NkBool hasDepth = NkFalse;
+    NkBool hasStencil = NkFalse;
+
+    if (descriptor->depthStencilAttachment) {
+        const NkRenderPassDepthStencilAttachmentInfo* attachment = descriptor->depthStencilAttachment;
+
+        hasDepth = nkVkFormatHasDepth(attachment->attachment->format);
+        hasStencil = nkVkFormatHasStencil(attachment->attachment->format);
+
+        nkVkInitRenderingAttachment(&depthAttachment, attachment->attachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, attachment->depthLoadOp, attachment->depthStoreOp);
+        depthAttachment.clearValue.depthStencil.depth = attachment->clearDepth;
+        depthAttachment.clearValue.depthStencil.stencil = attachment->clearStencil;
+
+        nkVkInitRenderingAttachment(&stencilAttachment, attachment->attachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, attachment->stencilLoadOp, attachment->stencilStoreOp);
+        stencilAttachment.clearValue = depthAttachment.clearValue;
+
+        extent = attachment->attachment->extent;
+    }
+
+    nkVkTransitionPresentableAttachments(commandBuffer, descriptor, NkTrue);
+
+    VkRenderingInfo renderingInfo;
+    {
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.pNext = NK_NULL;
+        renderingInfo.flags = 0;
+        renderingInfo.renderArea.offset.x = 0;
+        renderingInfo.renderArea.offset.y = 0;
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.viewMask = 0;
+        renderingInfo.colorAttachmentCount = descriptor->colorAttachmentCount;
+        renderingInfo.pColorAttachments = colorAttachments;
+        renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : NK_NULL;
+        renderingInfo.pStencilAttachment = hasStencil ? &stencilAttachment : NK_NULL;
+    }
+
+    device->cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+// Begins a render pass on a command buffer, for when encoded commands are replayed. With dynamic rendering
+// nothing needs to be looked up at all. Otherwise the attachment set is hashed and resolves to a cached
+// framebuffer, which also carries its render pass.
+static void nkVkBeginRenderPass(NkDevice device, VkCommandBuffer commandBuffer, const NkRenderPassInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(descriptor->colorAttachmentCount <= NK_MAX_COLOR_ATTACHMENTS);
+
+    nkVkTransitionTextureAttachments(commandBuffer, descriptor);
+
+    if (device->dynamicRendering) {
+        nkVkBeginRendering(device, commandBuffer, descriptor);
+        return;
+    }
+
+    const NkVkFramebuffer* framebuffer = nkVkGetFramebuffer(device, descriptor);
+
+    // clear values are indexed by attachment, resolve targets just take up their slots
+    VkClearValue clearValues[NK_VK_MAX_FRAMEBUFFER_ATTACHMENTS];
+    uint32_t clearValueCount = 0;
+
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        const NkColor* clearColor = &descriptor->colorAttachments[i].clearColor;
+        VkClearValue* clearValue = clearValues + clearValueCount++;
+        clearValue->color.float32[0] = clearColor->r;
+        clearValue->color.float32[1] = clearColor->g;
+        clearValue->color.float32[2] = clearColor->b;
+        clearValue->color.float32[3] = clearColor->a;
+    }
+
+    for (uint32_t i = 0; i < descriptor->colorAttachmentCount; i++) {
+        if (descriptor->colorAttachments[i].resolveTarget) {
+            memset(clearValues + clearValueCount++, 0, sizeof(VkClearValue));
+        }
+    }
+
+    if (descriptor->depthStencilAttachment) {
+        VkClearValue* clearValue = clearValues + clearValueCount++;
+        clearValue->depthStencil.depth = descriptor->depthStencilAttachment->clearDepth;
+        clearValue->depthStencil.stencil = descriptor->depthStencilAttachment->clearStencil;
+    }
+
+    VkRenderPassBeginInfo beginInfo;
+    {
+        beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        beginInfo.pNext = NK_NULL;
+        beginInfo.renderPass = framebuffer->renderPass;
+        beginInfo.framebuffer = framebuffer->framebuffer;
+        beginInfo.renderArea.offset.x = 0;
+        beginInfo.renderArea.offset.y = 0;
+        beginInfo.renderArea.extent = framebuffer->extent;
+        beginInfo.clearValueCount = clearValueCount;
+        beginInfo.pClearValues = clearValues;
+    }
+
+    vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+static void nkVkEndRenderPass(NkDevice device, VkCommandBuffer commandBuffer, const NkRenderPassInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    if (device->dynamicRendering) {
+        device->cmdEndRendering(commandBuffer);
+        nkVkTransitionPresentableAttachments(commandBuffer, descriptor, NkFalse);
+        return;
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+// Dynamic state. Pipelines on a device with extended dynamic state leave it undefined, so every pass is started by
+// nkVkSetDefaultDynamicState, binding a pipeline sets what its descriptor asked for with nkVkSetPipelineDynamicState,
+// and the encoder's commands are replayed over that until the next pipeline is bound.
+
+static void nkVkSetStencilFaceOp(NkDevice device, VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, const NkStencilStateFaceInfo* face) {
+
+    device->dynamicStateFunctions.cmdSetStencilOp(commandBuffer, faceMask,
+        nkVkStencilOp(face->failOp),
+        nkVkStencilOp(face->passOp),
+        nkVkStencilOp(face->depthFailOp),
+        nkVkCompareOp(face->compare));
+}
+
+static void nkVkSetColorState(NkDevice device, VkCommandBuffer commandBuffer, uint32_t attachment, VkBool32 blendEnable, const VkColorBlendEquationEXT* equation, VkColorComponentFlags writeMask) {
+
+    NK_ASSERT(attachment < NK_MAX_COLOR_ATTACHMENTS);
+
+    device->dynamicStateFunctions.cmdSetColorBlendEnable(commandBuffer, attachment, 1, &blendEnable);
+    device->dynamicStateFunctions.cmdSetColorBlendEquation(commandBuffer, attachment, 1, equation);
+    device->dynamicStateFunctions.cmdSetColorWriteMask(commandBuffer, attachment, 1, &writeMask);
+}
+
+static void nkVkSetDefaultDynamicState(NkDevice device, VkCommandBuffer commandBuffer, uint32_t colorAttachmentCount) {
+
+    NK_ASSERT(device);
+
+    const NkVkDynamicStateFunctions* functions = &device->dynamicStateFunctions;
+
+    if (device->dynamicState & NkDynamicState_Rasterization) {
+        functions->cmdSetCullMode(commandBuffer, VK_CULL_MODE_NONE);
+        functions->cmdSetFrontFace(commandBuffer, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        // topology has no sensible default, binding a pipeline sets the one it was created with
+    }
+
+    if (device->dynamicState & NkDynamicState_DepthStencil) {
+        functions->cmdSetDepthTestEnable(commandBuffer, VK_FALSE);
+        functions->cmdSetDepthWriteEnable(commandBuffer, VK_FALSE);
+        functions->cmdSetDepthCompareOp(commandBuffer, VK_COMPARE_OP_ALWAYS);
+        functions->cmdSetStencilTestEnable(commandBuffer, VK_FALSE);
+        functions->cmdSetStencilOp(commandBuffer, VK_STENCIL_FACE_FRONT_AND_BACK, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_ALWAYS);
+    }
+
+    if (device->dynamicState & NkDynamicState_ColorBlend) {
+        VkColorBlendEquationEXT equation;
+        {
+            equation.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            equation.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+            equation.colorBlendOp = VK_BLEND_OP_ADD;
+            equation.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            equation.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            equation.alphaBlendOp = VK_BLEND_OP_ADD;
+        }
+        for (uint32_t i = 0; i < colorAttachmentCount; i++) {
+            nkVkSetColorState(device, commandBuffer, i, VK_FALSE, &equation, nkVkColorWriteMask(NkColorWriteMask_All));
+        }
+    }
+
+    if (device->dynamicState & NkDynamicState_DepthClamp) {
+        functions->cmdSetDepthClampEnable(commandBuffer, VK_FALSE);
+    }
+}
+
+static void nkVkSetPipelineDynamicState(NkDevice device, VkCommandBuffer commandBuffer, const NkVkRenderPipelineDynamicState* state) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(state);
+
+    const NkVkDynamicStateFunctions* functions = &device->dynamicStateFunctions;
+
+    if (device->dynamicState & NkDynamicState_Rasterization) {
+        functions->cmdSetCullMode(commandBuffer, state->cullMode);
+        functions->cmdSetFrontFace(commandBuffer, state->frontFace);
+        functions->cmdSetPrimitiveTopology(commandBuffer, state->topology);
+        if (device->dynamicPrimitiveRestart) {
+            functions->cmdSetPrimitiveRestartEnable(commandBuffer, state->primitiveRestart);
+        }
+    }
+
+    if (device->dynamicState & NkDynamicState_DepthStencil) {
+        const VkStencilFaceFlags faceMasks[2] = { VK_STENCIL_FACE_FRONT_BIT, VK_STENCIL_FACE_BACK_BIT };
+        functions->cmdSetDepthTestEnable(commandBuffer, state->depthTest);
+        functions->cmdSetDepthWriteEnable(commandBuffer, state->depthWrite);
+        functions->cmdSetDepthCompareOp(commandBuffer, state->depthCompare);
+        functions->cmdSetStencilTestEnable(commandBuffer, state->stencilTest);
+        for (uint32_t i = 0; i < 2; i++) {
+            const VkStencilOpState* face = state->stencilFaces + i;
+            functions->cmdSetStencilOp(commandBuffer, faceMasks[i], face->failOp, face->passOp, face->depthFailOp, face->compareOp);
+        }
+    }
+
+    if (device->dynamicState & NkDynamicState_ColorBlend) {
+        for (uint32_t i = 0; i < state->colorStateCount; i++) {
+            nkVkSetColorState(device, commandBuffer, i, state->blendEnables[i], state->blendEquations + i, state->writeMasks[i]);
+        }
+    }
+
+    if (device->dynamicState & NkDynamicState_DepthClamp) {
+        functions->cmdSetDepthClampEnable(commandBuffer, state->depthClamp);
+    }
+}
+
+static void nkVkExecuteDynamicStateCommand(NkDevice device, VkCommandBuffer commandBuffer, const void* command) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(command);
+
+    const NkVkDynamicStateFunctions* functions = &device->dynamicStateFunctions;
+
+    switch (*NK_PTR_CAST(const NkCommandType*, command)) {
+    case NkCommandType_RenderPassEncoderSetColorState: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_ColorBlend);
+        const NkRenderPassEncoderSetColorStateCommand* setColorState = NK_PTR_CAST(const NkRenderPassEncoderSetColorStateCommand*, command);
+        const VkBool32 blendEnable = setColorState->blendEnabled ? VK_TRUE : VK_FALSE;
+        VkColorBlendEquationEXT equation;
+        {
+            equation.srcColorBlendFactor = nkVkBlendFactor(setColorState->colorBlend.srcFactor);
+            equation.dstColorBlendFactor = nkVkBlendFactor(setColorState->colorBlend.dstFactor);
+            equation.colorBlendOp = nkVkBlendOp(setColorState->colorBlend.operation);
+            equation.srcAlphaBlendFactor = nkVkBlendFactor(setColorState->alphaBlend.srcFactor);
+            equation.dstAlphaBlendFactor = nkVkBlendFactor(setColorState->alphaBlend.dstFactor);
+            equation.alphaBlendOp = nkVkBlendOp(setColorState->alphaBlend.operation);
+        }
+        nkVkSetColorState(device, commandBuffer, setColorState->attachment, blendEnable, &equation, nkVkColorWriteMask(setColorState->writeMask));
+        break;
+    }
+    case NkCommandType_RenderPassEncoderSetCullMode: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_Rasterization);
+        const NkRenderPassEncoderSetCullModeCommand* setCullMode = NK_PTR_CAST(const NkRenderPassEncoderSetCullModeCommand*, command);
+        functions->cmdSetCullMode(commandBuffer, nkVkCullMode(setCullMode->cullMode));
+        break;
+    }
+    case NkCommandType_RenderPassEncoderSetDepthClamp: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_DepthClamp);
+        const NkRenderPassEncoderSetDepthClampCommand* setDepthClamp = NK_PTR_CAST(const NkRenderPassEncoderSetDepthClampCommand*, command);
+        functions->cmdSetDepthClampEnable(commandBuffer, setDepthClamp->enabled ? VK_TRUE : VK_FALSE);
+        break;
+    }
+    case NkCommandType_RenderPassEncoderSetDepthTest: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_DepthStencil);
+        const NkRenderPassEncoderSetDepthTestCommand* setDepthTest = NK_PTR_CAST(const NkRenderPassEncoderSetDepthTestCommand*, command);
+        functions->cmdSetDepthTestEnable(commandBuffer, setDepthTest->enabled ? VK_TRUE : VK_FALSE);
+        functions->cmdSetDepthWriteEnable(commandBuffer, setDepthTest->writeEnabled ? VK_TRUE : VK_FALSE);
+        functions->cmdSetDepthCompareOp(commandBuffer, nkVkCompareOp(setDepthTest->compare));
+        break;
+    }
+    case NkCommandType_RenderPassEncoderSetFrontFace: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_Rasterization);
+        const NkRenderPassEncoderSetFrontFaceCommand* setFrontFace = NK_PTR_CAST(const NkRenderPassEncoderSetFrontFaceCommand*, command);
+        functions->cmdSetFrontFace(commandBuffer, nkVkFrontFace(setFrontFace->frontFace));
+        break;
+    }
+    case NkCommandType_RenderPassEncoderSetPrimitiveTopology: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_Rasterization);
+        const NkRenderPassEncoderSetPrimitiveTopologyCommand* setTopology = NK_PTR_CAST(const NkRenderPassEncoderSetPrimitiveTopologyCommand*, command);
+        functions->cmdSetPrimitiveTopology(commandBuffer, nkVkPrimitiveTopology(setTopology->topology));
+        if (device->dynamicPrimitiveRestart) {
+            functions->cmdSetPrimitiveRestartEnable(commandBuffer, nkVkShouldEnablePrimitiveRestart(setTopology->topology));
+        }
+        break;
+    }
+    case NkCommandType_RenderPassEncoderSetStencilTest: {
+        NK_ASSERT(device->dynamicState & NkDynamicState_DepthStencil);
+        const NkRenderPassEncoderSetStencilTestCommand* setStencilTest = NK_PTR_CAST(const NkRenderPassEncoderSetStencilTestCommand*, command);
+        functions->cmdSetStencilTestEnable(commandBuffer, setStencilTest->enabled ? VK_TRUE : VK_FALSE);
+        nkVkSetStencilFaceOp(device, commandBuffer, VK_STENCIL_FACE_FRONT_BIT, &setStencilTest->front);
+        nkVkSetStencilFaceOp(device, commandBuffer, VK_STENCIL_FACE_BACK_BIT, &setStencilTest->back);
+        break;
+    }
+    default:
+        NK_ASSERT(NkFalse);
+        break;
+    }
+}
+
+// Pipelines laid out with the bindless group get the device's set with them, so shaders can always reach the
+// tables the bindless indices point into.
+static void nkVkBindBindlessGroup(NkDevice device, VkCommandBuffer commandBuffer, NkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint) {
+
+    if (!device->bindless || pipelineLayout->bindGroupLayoutCount <= NK_VK_BINDLESS_GROUP ||
+        pipelineLayout->bindGroupLayouts[NK_VK_BINDLESS_GROUP] != device->bindlessLayout) {
+        return;
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout->layout, NK_VK_BINDLESS_GROUP, 1, &device->bindlessBindGroup.set, 0, NK_NULL);
+}
+
+// Bound against the layout of the pipeline bound when the command is replayed, so a bind group made for an equal
+// layout works with any pipeline that shares it.
+static void nkVkExecuteSetBindGroupCommand(VkCommandBuffer commandBuffer, NkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint, const NkSetBindGroupCommand* command) {
+
+    NK_ASSERT(pipelineLayout);
+    NK_ASSERT(command->groupIndex < pipelineLayout->bindGroupLayoutCount);
+    NK_ASSERT(!pipelineLayout->bindGroupLayouts[command->groupIndex]->pushed);
+
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout->layout, command->groupIndex, 1, &command->group->set,
+        command->dynamicOffsetCount, command->dynamicOffsets);
+}
+
+// Pushed entries are written against the layout of the pipeline bound when the command is replayed.
+static void nkVkExecutePushBindGroupCommand(NkDevice device, VkCommandBuffer commandBuffer, NkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint, const NkRenderPassEncoderPushBindGroupCommand* command) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(pipelineLayout);
+    NK_ASSERT(command->groupIndex < pipelineLayout->bindGroupLayoutCount);
+    NK_ASSERT(command->entryCount <= NK_MAX_BINDINGS_PER_BIND_GROUP);
+
+    NkBindGroupLayout layout = pipelineLayout->bindGroupLayouts[command->groupIndex];
+    NK_ASSERT(layout->perDraw);
+
+    NkBindGroupEntry entries[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    if (command->entryCount > 0) {
+        memcpy(entries, command->entries, sizeof(NkBindGroupEntry) * command->entryCount);
+    }
+    nkVkSortBindGroupEntries(entries, command->entryCount);
+
+    // Without push descriptors the entries become a transient bind group, which is deduplicated within the frame.
+    if (!layout->pushed) {
+        NkBindGroupInfo info;
+        {
+            info.layout = layout;
+            info.entryCount = command->entryCount;
+            info.entries = entries;
+            info.transient = NkTrue;
+        }
+
+        NkBindGroup bindGroup = nkCreateBindGroup(device, &info);
+        if (bindGroup == NK_NULL) {
+            return;
+        }
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout->layout, command->groupIndex, 1, &bindGroup->set, 0, NK_NULL);
+        return;
+    }
+
+    if (layout->descriptorCount == 0) {
+        return;
+    }
+
+    NkVkDescriptorData data[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    if (!nkVkPackBindGroupEntries(layout, entries, command->entryCount, data)) {
+        return;
+    }
+
+    // Writes want tightly packed image or buffer infos, so the slots are split back out by kind.
+    VkDescriptorImageInfo imageInfos[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    VkDescriptorBufferInfo bufferInfos[NK_MAX_BINDINGS_PER_BIND_GROUP];
+    VkWriteDescriptorSet writes[NK_MAX_BINDINGS_PER_BIND_GROUP];
+
+    for (uint32_t i = 0; i < layout->entryCount; i++) {
+        const uint32_t first = layout->descriptorOffsets[i];
+        const uint32_t count = nkVkDescriptorCount(layout->entries + i);
+
+        VkWriteDescriptorSet* write = writes + i;
+        write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write->pNext = NK_NULL;
+        write->dstSet = VK_NULL_HANDLE; // ignored when pushing
+        write->dstBinding = layout->entries[i].binding;
+        write->dstArrayElement = 0;
+        write->descriptorCount = count;
+        write->descriptorType = nkVkDescriptorType(layout->entries + i);
+        write->pImageInfo = NK_NULL;
+        write->pBufferInfo = NK_NULL;
+        write->pTexelBufferView = NK_NULL;
+
+        switch (write->descriptorType) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            for (uint32_t element = 0; element < count; element++) {
+                bufferInfos[first + element] = data[first + element].buffer;
+            }
+            write->pBufferInfo = bufferInfos + first;
+            break;
+        default:
+            for (uint32_t element = 0; element < count; element++) {
+                imageInfos[first + element] = data[first + element].image;
+            }
+            write->pImageInfo = imageInfos + first;
+            break;
+        }
+    }
+
+    device->cmdPushDescriptorSet(commandBuffer, bindPoint, pipelineLayout->layout, command->groupIndex, layout->entryCount, writes);
+}
+
+static void nkVkInitQueue(NkDevice device, uint32_t familyIndex) {
+
+    NkQueue queue = &device->queue;
+    queue->device = device;
+    vkGetDeviceQueue(device->device, familyIndex, 0, &queue->queue);
+    nkMutexInit(&queue->uploadMutex);
+
+    VkCommandPoolCreateInfo poolInfo;
+    {
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.pNext = NK_NULL;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = familyIndex;
+    }
+
+    NK_CHECK_VK(vkCreateCommandPool(device->device, &poolInfo, NK_NULL, &queue->uploadPool));
+
+    VkFenceCreateInfo fenceInfo;
+    {
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.pNext = NK_NULL;
+        fenceInfo.flags = 0;
+    }
+
+    NK_CHECK_VK(vkCreateFence(device->device, &fenceInfo, NK_NULL, &queue->uploadFence));
+    queue->levelUploads = NK_NULL;
+    queue->lastLevelUpload = NK_NULL;
+
+#if defined(NK_IO_URING)
+    queue->ioRing = nkCreateIoRing(64);
+#endif
+}
+
+static void nkVkFinishLevelUpload(NkVkLevelUpload* upload, NkBool notify) {
+
+    NkVkTextureStream* stream = upload->stream;
+    if (notify && stream->levelsResident) {
+        stream->levelsResident(stream->texture, upload->baseMipLevel, stream->userdata);
+    }
+    if (--stream->pendingLevelCount == 0) {
+        nkDestroyBuffer(stream->staging);
+        NK_FREE(stream);
+    }
+    NK_FREE(upload);
+}
+
+static void nkVkDestroyQueue(NkDevice device) {
+
+    NkQueue queue = &device->queue;
+#if defined(NK_IO_URING)
+    if (queue->ioRing) {
+        nkDestroyIoRing(queue->ioRing);
+    }
+#endif
+
+    // Streamed levels still in flight are waited for, but nobody is told about them with the device going away.
+    while (queue->levelUploads) {
+        NkVkLevelUpload* upload = queue->levelUploads;
+        queue->levelUploads = upload->next;
+        NK_CHECK_VK(vkWaitForFences(device->device, 1, &upload->fence, VK_TRUE, UINT64_MAX));
+        vkDestroyFence(device->device, upload->fence, NK_NULL);
+        vkFreeCommandBuffers(device->device, queue->uploadPool, 1, &upload->commandBuffer);
+        nkVkFinishLevelUpload(upload, NkFalse);
+    }
+
+    vkDestroyFence(device->device, queue->uploadFence, NK_NULL);
+    vkDestroyCommandPool(device->device, queue->uploadPool, NK_NULL);
+    nkMutexDestroy(&queue->uploadMutex);
+}
+
+// Queue writes record into a command buffer of their own and wait for it before returning, so the data they
+// copy only has to live for the call. Holds the uploadMutex until nkVkSubmitUpload.
+static VkCommandBuffer nkVkBeginUpload(NkQueue queue) {
+
+    NkDevice device = queue->device;
+
+    nkMutexLock(&queue->uploadMutex);
+
+    VkCommandBufferAllocateInfo allocateInfo;
+    {
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.pNext = NK_NULL;
+        allocateInfo.commandPool = queue->uploadPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+    }
+
+    VkCommandBuffer commandBuffer;
+    NK_CHECK_VK(vkAllocateCommandBuffers(device->device, &allocateInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo beginInfo;
+    {
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.pNext = NK_NULL;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = NK_NULL;
+    }
+
+    NK_CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    return commandBuffer;
+}
+
+static void nkVkQueueUpload(NkQueue queue, VkCommandBuffer commandBuffer, VkFence fence) {
+
+    NK_CHECK_VK(vkEndCommandBuffer(commandBuffer));
+
+    VkSubmitInfo submitInfo;
+    {
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = NK_NULL;
+        submitInfo.waitSemaphoreCount = 0;
+        submitInfo.pWaitSemaphores = NK_NULL;
+        submitInfo.pWaitDstStageMask = NK_NULL;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 0;
+        submitInfo.pSignalSemaphores = NK_NULL;
+    }
+
+    NK_CHECK_VK(vkQueueSubmit(queue->queue, 1, &submitInfo, fence));
+}
+
+static void nkVkSubmitUpload(NkQueue queue, VkCommandBuffer commandBuffer) {
+
+    NkDevice device = queue->device;
+
+    nkVkQueueUpload(queue, commandBuffer, queue->uploadFence);
+    NK_CHECK_VK(vkWaitForFences(device->device, 1, &queue->uploadFence, VK_TRUE, UINT64_MAX));
+    NK_CHECK_VK(vkResetFences(device->device, 1, &queue->uploadFence));
+
+    vkFreeCommandBuffers(device->device, queue->uploadPool, 1, &commandBuffer);
+    nkMutexUnlock(&queue->uploadMutex);
+}
+
+// Submits one level of a streamed texture with a fence of its own and returns without waiting. Releases the
+// uploadMutex like nkVkSubmitUpload.
+static void nkVkSubmitLevelUpload(NkQueue queue, VkCommandBuffer commandBuffer, NkVkTextureStream* stream, uint32_t baseMipLevel) {
+
+    NkDevice device = queue->device;
+
+    NkVkLevelUpload* upload = NK_PTR_CAST(NkVkLevelUpload*, NK_MALLOC(sizeof(NkVkLevelUpload)));
+    NK_ASSERT(upload);
+
+    upload->next = NK_NULL;
+    upload->stream = stream;
+    upload->commandBuffer = commandBuffer;
+    upload->baseMipLevel = baseMipLevel;
+
+    VkFenceCreateInfo fenceInfo;
+    {
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.pNext = NK_NULL;
+        fenceInfo.flags = 0;
+    }
+
+    NK_CHECK_VK(vkCreateFence(device->device, &fenceInfo, NK_NULL, &upload->fence));
+    nkVkQueueUpload(queue, commandBuffer, upload->fence);
+
+    if (queue->lastLevelUpload) {
+        queue->lastLevelUpload->next = upload;
+    }
+    else {
+        queue->levelUploads = upload;
+    }
+    queue->lastLevelUpload = upload;
+
+    nkMutexUnlock(&queue->uploadMutex);
+}
+
+// Retires the streamed levels that have landed, oldest first, stopping at the first that hasn't so levels are
+// reported in the order they were submitted. Callbacks run without the uploadMutex so they can write to the queue.
+static void nkVkRetireLevelUploads(NkQueue queue) {
+
+    NkDevice device = queue->device;
+
+    nkMutexLock(&queue->uploadMutex);
+
+    NkVkLevelUpload* finished = queue->levelUploads;
+    NkVkLevelUpload* lastFinished = NK_NULL;
+    NkVkLevelUpload* upload = queue->levelUploads;
+    while (upload) {
+        const VkResult status = vkGetFenceStatus(device->device, upload->fence);
+        if (status == VK_NOT_READY) {
+            break;
+        }
+        NK_CHECK_VK(status);
+
+        vkDestroyFence(device->device, upload->fence, NK_NULL);
+        vkFreeCommandBuffers(device->device, queue->uploadPool, 1, &upload->commandBuffer);
+        lastFinished = upload;
+        upload = upload->next;
+    }
+
+    queue->levelUploads = upload;
+    if (upload == NK_NULL) {
+        queue->lastLevelUpload = NK_NULL;
+    }
+    if (lastFinished) {
+        lastFinished->next = NK_NULL;
+    }
+    else {
+        finished = NK_NULL;
+    }
+
+    nkMutexUnlock(&queue->uploadMutex);
+
+    while (finished) {
+        NkVkLevelUpload* next = finished->next;
+        nkVkFinishLevelUpload(finished, NkTrue);
+        finished = next;
+    }
+}
+
+// Bytes per texel, or per 4x4 block for the compressed formats, which blockSize reports the width of.
+static uint32_t nkVkTexelBlockSize(NkTextureFormat format, uint32_t* blockSize) {
+
+    *blockSize = 1;
+    switch (format) {
+    case NkTextureFormat_R8Unorm:
+    case NkTextureFormat_R8Snorm:
+    case NkTextureFormat_R8Uint:
+    case NkTextureFormat_R8Sint:
+    case NkTextureFormat_Stencil8:
+        return 1;
+    case NkTextureFormat_R16Uint:
+    case NkTextureFormat_R16Sint:
+    case NkTextureFormat_R16Float:
+    case NkTextureFormat_RG8Unorm:
+    case NkTextureFormat_RG8Snorm:
+    case NkTextureFormat_RG8Uint:
+    case NkTextureFormat_RG8Sint:
+        return 2;
+    case NkTextureFormat_RG16Uint:
+    case NkTextureFormat_RG16Sint:
+    case NkTextureFormat_RG16Float:
+    case NkTextureFormat_R32Float:
+    case NkTextureFormat_R32Uint:
+    case NkTextureFormat_R32Sint:
+    case NkTextureFormat_RGBA8Unorm:
+    case NkTextureFormat_RGBA8UnormSrgb:
+    case NkTextureFormat_RGBA8Snorm:
+    case NkTextureFormat_RGBA8Uint:
+    case NkTextureFormat_RGBA8Sint:
+    case NkTextureFormat_BGRA8Unorm:
+    case NkTextureFormat_BGRA8UnormSrgb:
+    case NkTextureFormat_RGB10A2Unorm:
+    case NkTextureFormat_RG11B10Ufloat:
+    case NkTextureFormat_RGB9E5Ufloat:
+    case NkTextureFormat_Depth32Float:
+    case NkTextureFormat_Depth24Plus:
+    case NkTextureFormat_Depth24PlusStencil8:
+        return 4;
+    case NkTextureFormat_RG32Float:
+    case NkTextureFormat_RG32Uint:
+    case NkTextureFormat_RG32Sint:
+    case NkTextureFormat_RGBA16Uint:
+    case NkTextureFormat_RGBA16Sint:
+    case NkTextureFormat_RGBA16Float:
+        return 8;
+    case NkTextureFormat_RGBA32Float:
+    case NkTextureFormat_RGBA32Uint:
+    case NkTextureFormat_RGBA32Sint:
+        return 16;
+    case NkTextureFormat_BC1RGBAUnorm:
+    case NkTextureFormat_BC1RGBAUnormSrgb:
+    case NkTextureFormat_BC4RUnorm:
+    case NkTextureFormat_BC4RSnorm:
+        *blockSize = 4;
+        return 8;
+    case NkTextureFormat_BC2RGBAUnorm:
+    case NkTextureFormat_BC2RGBAUnormSrgb:
+    case NkTextureFormat_BC3RGBAUnorm:
+    case NkTextureFormat_BC3RGBAUnormSrgb:
+    case NkTextureFormat_BC5RGUnorm:
+    case NkTextureFormat_BC5RGSnorm:
+    case NkTextureFormat_BC6HRGBUfloat:
+    case NkTextureFormat_BC6HRGBFloat:
+    case NkTextureFormat_BC7RGBAUnorm:
+    case NkTextureFormat_BC7RGBAUnormSrgb:
+        *blockSize = 4;
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// Where a texture waits between commands once something has been written to it.
+static VkImageLayout nkVkTextureRestingLayout(NkTexture texture) {
+    return (texture->usage & NkTextureUsage_Sampled) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+}
+
+static void nkVkTextureBarrier(VkCommandBuffer commandBuffer, NkTexture texture, uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+
+    VkImageMemoryBarrier barrier;
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = NK_NULL;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = texture->image;
+        barrier.subresourceRange.aspectMask = nkVkImageAspect(texture->imageFormat, NkTextureAspect_All);
+        barrier.subresourceRange.baseMipLevel = baseMipLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = texture->arrayLayerCount;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NK_NULL, 0, NK_NULL, 1, &barrier);
+}
+
+// Whether the texture's format can be blitted, and with which filter. Formats that can't be filtered linearly, such
+// as integer and depth formats, fall back to nearest. Compressed formats can't be blitted to at all, so their mips
+// have to come with the texture, and asking for them is logged and skipped.
+static NkBool nkVkGetMipmapFilter(NkDevice device, NkTexture texture, VkFilter* filter) {
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device->physicalDevice, texture->imageFormat, &properties);
+
+    const VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((properties.optimalTilingFeatures & blit) != blit) {
+        NK_LOG("Neko: Mipmaps can't be generated for a texture whose format can't be blitted at %s:%d.\n");
+        return NkFalse;
+    }
+
+    *filter = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    return NkTrue;
+}
+
+// Blits every level from the one above it, so each only reads texels that were just written. The filter comes
+// from nkVkGetMipmapFilter, which has to be asked before anything is recorded.
+static void nkVkRecordGenerateMipmaps(VkCommandBuffer commandBuffer, NkTexture texture, uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout baseLayout, VkFilter filter) {
+
+    NK_ASSERT((texture->usage & (NkTextureUsage_CopySrc | NkTextureUsage_CopyDst)) == (NkTextureUsage_CopySrc | NkTextureUsage_CopyDst));
+    NK_ASSERT(texture->sampleCount == VK_SAMPLE_COUNT_1_BIT);
+
+    if (levelCount < 2) {
+        return;
+    }
+
+    // The levels being filled lose whatever they held, so they come from the undefined layout.
+    nkVkTextureBarrier(commandBuffer, texture, baseMipLevel, 1, baseLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    nkVkTextureBarrier(commandBuffer, texture, baseMipLevel + 1, levelCount - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    const VkImageAspectFlags aspect = nkVkImageAspect(texture->imageFormat, NkTextureAspect_All);
+
+    for (uint32_t level = baseMipLevel + 1; level < baseMipLevel + levelCount; level++) {
+        VkImageBlit blit;
+        {
+            blit.srcSubresource.aspectMask = aspect;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = texture->arrayLayerCount;
+            blit.srcOffsets[0].x = 0;
+            blit.srcOffsets[0].y = 0;
+            blit.srcOffsets[0].z = 0;
+            blit.srcOffsets[1].x = NK_CAST(int32_t, NK_MAX(texture->size.width >> (level - 1), 1));
+            blit.srcOffsets[1].y = NK_CAST(int32_t, NK_MAX(texture->size.height >> (level - 1), 1));
+            blit.srcOffsets[1].z = NK_CAST(int32_t, NK_MAX(texture->size.depth >> (level - 1), 1));
+            blit.dstSubresource.aspectMask = aspect;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstSubresource.baseArrayLayer = 0;
+            blit.dstSubresource.layerCount = texture->arrayLayerCount;
+            blit.dstOffsets[0].x = 0;
+            blit.dstOffsets[0].y = 0;
+            blit.dstOffsets[0].z = 0;
+            blit.dstOffsets[1].x = NK_CAST(int32_t, NK_MAX(texture->size.width >> level, 1));
+            blit.dstOffsets[1].y = NK_CAST(int32_t, NK_MAX(texture->size.height >> level, 1));
+            blit.dstOffsets[1].z = NK_CAST(int32_t, NK_MAX(texture->size.depth >> level, 1));
+        }
+
+        vkCmdBlitImage(commandBuffer,
+            texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, filter);
+
+        nkVkTextureBarrier(commandBuffer, texture, level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+
+    // The whole chain is a transfer source now, so one barrier hands it back.
+    nkVkTextureBarrier(commandBuffer, texture, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, nkVkTextureRestingLayout(texture),
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+}
+
+static void nkVkExecuteGenerateMipmapsCommand(NkDevice device, VkCommandBuffer commandBuffer, const NkCommandEncoderGenerateMipmapsCommand* command) {
+
+    NkTexture texture = command->texture;
+    NK_ASSERT(command->baseMipLevel < texture->mipLevelCount);
+
+    // Writes and render passes both leave the texture's layout behind, so undefined means nothing ever wrote it.
+    if (texture->layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        NK_LOG("Neko: Mipmaps were generated for a texture that has never been written at %s:%d.\n");
+        return;
+    }
+
+    const uint32_t levelCount = command->levelCount != 0 ? command->levelCount : texture->mipLevelCount - command->baseMipLevel;
+    NK_ASSERT(command->baseMipLevel + levelCount <= texture->mipLevelCount);
+
+    VkFilter filter;
+    if (levelCount < 2 || !nkVkGetMipmapFilter(device, texture, &filter)) {
+        return;
+    }
+
+    // Generating hands the levels it covers back in the resting layout, so the ones below follow to keep a single
+    // layout for the whole texture.
+    const VkImageLayout restingLayout = nkVkTextureRestingLayout(texture);
+    if (command->baseMipLevel > 0 && texture->layout != restingLayout) {
+        nkVkTextureBarrier(commandBuffer, texture, 0, command->baseMipLevel, texture->layout, restingLayout,
+            VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+
+    nkVkRecordGenerateMipmaps(commandBuffer, texture, command->baseMipLevel, levelCount, texture->layout, filter);
+    texture->layout = restingLayout;
+}
+
+// Pipelines leave the viewport and line width dynamic, so every pass starts out covering its attachments.
+static void nkVkSetDefaultViewport(VkCommandBuffer commandBuffer, const NkRenderPassInfo* descriptor) {
+
+    VkExtent2D extent = { 0, 0 };
+    if (descriptor->colorAttachmentCount > 0) {
+        extent = descriptor->colorAttachments[0].attachment->extent;
+    }
+    else if (descriptor->depthStencilAttachment) {
+        extent = descriptor->depthStencilAttachment->attachment->extent;
+    }
+
+    VkViewport viewport;
+    {
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = NK_CAST(float, extent.width);
+        viewport.height = NK_CAST(float, extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+    }
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetLineWidth(commandBuffer, 1.0f);
+}
+
+// Replays a finished command buffer onto a Vulkan one. Nothing an encoder records is translated before this, so
+// whatever the commands reference has to stay alive until they're submitted.
+static void nkVkRecordCommands(NkDevice device, VkCommandBuffer commandBuffer, NkCommandBuffer commands) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(commands);
+
+    const NkBeginRenderPassCommand* renderPass = NK_NULL;
+    NkPipelineLayout pipelineLayout = NK_NULL; // of the bound pipeline, which bind groups are bound against
+    NkBool computePass = NkFalse;
+
+    for (uint32_t i = 0; i < commands->commandCount; i++) {
+        const void* command = commands->commands[i];
+
+        switch (*NK_PTR_CAST(const NkCommandType*, command)) {
+        case NkCommandType_BeginComputePass:
+            NK_ASSERT(renderPass == NK_NULL && !computePass);
+            computePass = NkTrue;
+            break;
+        case NkCommandType_ComputePassEncoderEndPass:
+            NK_ASSERT(computePass);
+            computePass = NkFalse;
+            pipelineLayout = NK_NULL;
+            break;
+        case NkCommandType_ComputePassEncoderSetPipeline: {
+            const NkComputePassEncoderSetPipelineCommand* setPipeline = NK_PTR_CAST(const NkComputePassEncoderSetPipelineCommand*, command);
+            NK_ASSERT(computePass);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, setPipeline->pipeline->pipeline);
+            pipelineLayout = setPipeline->pipeline->layout;
+            nkVkBindBindlessGroup(device, commandBuffer, pipelineLayout, VK_PIPELINE_BIND_POINT_COMPUTE);
+            break;
+        }
+        case NkCommandType_ComputePassEncoderSetBindGroup:
+            NK_ASSERT(pipelineLayout);
+            nkVkExecuteSetBindGroupCommand(commandBuffer, pipelineLayout, VK_PIPELINE_BIND_POINT_COMPUTE,
+                NK_PTR_CAST(const NkSetBindGroupCommand*, command));
+            break;
+        case NkCommandType_ComputePassEncoderDispatch: {
+            const NkComputePassEncoderDispatchCommand* dispatch = NK_PTR_CAST(const NkComputePassEncoderDispatchCommand*, command);
+            NK_ASSERT(pipelineLayout);
+            vkCmdDispatch(commandBuffer, dispatch->x, dispatch->y, dispatch->z);
+            break;
+        }
+        case NkCommandType_BeginRenderPass:
+            NK_ASSERT(renderPass == NK_NULL);
+            renderPass = NK_PTR_CAST(const NkBeginRenderPassCommand*, command);
+            nkVkBeginRenderPass(device, commandBuffer, &renderPass->info);
+            nkVkSetDefaultViewport(commandBuffer, &renderPass->info);
+            if (device->dynamicState) {
+                nkVkSetDefaultDynamicState(device, commandBuffer, renderPass->info.colorAttachmentCount);
+            }
+            break;
+        case NkCommandType_RenderPassEncoderEndPass:
+            NK_ASSERT(renderPass);
+            nkVkEndRenderPass(device, commandBuffer, &renderPass->info);
+            renderPass = NK_NULL;
+            pipelineLayout = NK_NULL;
+            break;
+        case NkCommandType_RenderPassEncoderSetPipeline: {
+            const NkRenderPassEncoderSetPipelineCommand* setPipeline = NK_PTR_CAST(const NkRenderPassEncoderSetPipelineCommand*, command);
+            nkMutexLock(&device->pipelineMutex);
+            const VkPipeline pipeline = setPipeline->pipeline->compiled->pipeline;
+            nkMutexUnlock(&device->pipelineMutex);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            pipelineLayout = setPipeline->pipeline->layout;
+            nkVkBindBindlessGroup(device, commandBuffer, pipelineLayout, VK_PIPELINE_BIND_POINT_GRAPHICS);
+            if (device->dynamicState) {
+                nkVkSetPipelineDynamicState(device, commandBuffer, &setPipeline->pipeline->dynamicState);
+            }
+            break;
+        }
+        case NkCommandType_RenderPassEncoderSetVertexBuffer: {
+            const NkRenderPassEncoderSetVertexBuffer* setVertexBuffer = NK_PTR_CAST(const NkRenderPassEncoderSetVertexBuffer*, command);
+            const VkDeviceSize offset = setVertexBuffer->offset;
+            vkCmdBindVertexBuffers(commandBuffer, setVertexBuffer->slot, 1, &setVertexBuffer->buffer->buffer, &offset);
+            break;
+        }
+        case NkCommandType_RenderPassEncoderDraw: {
+            const NkRenderPassEncoderDraw* draw = NK_PTR_CAST(const NkRenderPassEncoderDraw*, command);
+            vkCmdDraw(commandBuffer, draw->vertexCount, draw->instanceCount, draw->firstVertex, draw->firstInstance);
+            break;
+        }
+        case NkCommandType_RenderPassEncoderSetColorState:
+        case NkCommandType_RenderPassEncoderSetCullMode:
+        case NkCommandType_RenderPassEncoderSetDepthClamp:
+        case NkCommandType_RenderPassEncoderSetDepthTest:
+        case NkCommandType_RenderPassEncoderSetFrontFace:
+        case NkCommandType_RenderPassEncoderSetPrimitiveTopology:
+        case NkCommandType_RenderPassEncoderSetStencilTest:
+            nkVkExecuteDynamicStateCommand(device, commandBuffer, command);
+            break;
+        case NkCommandType_RenderPassEncoderPushBindGroup:
+            NK_ASSERT(pipelineLayout);
+            nkVkExecutePushBindGroupCommand(device, commandBuffer, pipelineLayout, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                NK_PTR_CAST(const NkRenderPassEncoderPushBindGroupCommand*, command));
+            break;
+        case NkCommandType_RenderPassEncoderSetBindGroup:
+            NK_ASSERT(pipelineLayout);
+            nkVkExecuteSetBindGroupCommand(commandBuffer, pipelineLayout, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                NK_PTR_CAST(const NkSetBindGroupCommand*, command));
+            break;
+        case NkCommandType_CommandEncoderGenerateMipmaps:
+            // Blits and layout transitions aren't allowed inside a pass.
+            NK_ASSERT(renderPass == NK_NULL && !computePass);
+            nkVkExecuteGenerateMipmapsCommand(device, commandBuffer, NK_PTR_CAST(const NkCommandEncoderGenerateMipmapsCommand*, command));
+            break;
+        default:
+            NK_ASSERT(NkFalse);
+            break;
+        }
+    }
+
+    NK_ASSERT(renderPass == NK_NULL && !computePass);
+}
+
+#define NK_VK_MAX_ENTRY_POINT_LENGTH 128
+
+// Every constant is 32 bits wide, so the data is an array of values and entry i points at value i.
+typedef struct NkVkSpecializationState {
+    VkSpecializationInfo info;
+    VkSpecializationMapEntry entries[NK_MAX_SPECIALIZATION_CONSTANTS];
+    uint32_t data[NK_MAX_SPECIALIZATION_CONSTANTS];
+} NkVkSpecializationState;
+
+// Everything vkCreateGraphicsPipelines reads, gathered in one place. The create info points into the rest
+// of the struct, so a state is filled in where it lives and never copied. Asynchronous creation keeps one of
+// these on the heap, which means the caller's descriptor doesn't need to outlive the call.
+#define NK_VK_MAX_DYNAMIC_STATES 16
+
+typedef struct NkVkRenderPipelineCreateState {
+    VkGraphicsPipelineCreateInfo createInfo;
+    VkPipelineShaderStageCreateInfo stages[2];
+    char entryPoints[2][NK_VK_MAX_ENTRY_POINT_LENGTH];
+    NkVkSpecializationState specializations[2];
+    VkVertexInputBindingDescription bindings[NK_MAX_BUFFERS];
+    VkVertexInputAttributeDescription attributes[NK_MAX_ATTRIBUTES];
+    VkPipelineVertexInputStateCreateInfo vertexInput;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+    VkPipelineRasterizationStateCreateInfo rasterization;
+    VkPipelineMultisampleStateCreateInfo multisample;
+    VkPipelineDepthStencilStateCreateInfo depthStencil;
+    VkPipelineColorBlendAttachmentState colorBlendAttachments[NK_MAX_COLOR_ATTACHMENTS];
+    VkPipelineColorBlendStateCreateInfo colorBlend;
+    VkDynamicState dynamicStates[NK_VK_MAX_DYNAMIC_STATES];
+    VkPipelineDynamicStateCreateInfo dynamicState;
+    VkFormat colorFormats[NK_MAX_COLOR_ATTACHMENTS];
+    VkPipelineRenderingCreateInfo rendering; // chained in place of a render pass with dynamic rendering
+    NkPipelineLayout layout; // not a reference, whoever resolved the layout keeps it alive
+} NkVkRenderPipelineCreateState;
+
+typedef struct NkVkComputePipelineCreateState {
+    VkComputePipelineCreateInfo createInfo;
+    char entryPoint[NK_VK_MAX_ENTRY_POINT_LENGTH];
+    NkVkSpecializationState specialization;
+    NkPipelineLayout layout;
+} NkVkComputePipelineCreateState;
+
+static void nkVkCopyEntryPoint(char* dst, const char* entryPoint) {
+
+    NK_ASSERT(entryPoint);
+
+    const size_t length = strlen(entryPoint);
+    NK_ASSERT(length < NK_VK_MAX_ENTRY_POINT_LENGTH);
+    memcpy(dst, entryPoint, length + 1);
+}
+
+static const VkSpecializationInfo* nkVkInitSpecialization(NkVkSpecializationState* specialization, const NkProgrammableStageInfo* programmableStage) {
+
+    if (programmableStage->constantCount == 0) {
+        return NULL;
+    }
+
+    NK_ASSERT(programmableStage->constants);
+    NK_ASSERT(programmableStage->constantCount <= NK_MAX_SPECIALIZATION_CONSTANTS);
+
+    for (uint32_t i = 0; i < programmableStage->constantCount; i++) {
+        VkSpecializationMapEntry* entry = specialization->entries + i;
+        entry->constantID = programmableStage->constants[i].constantId;
+        entry->offset = NK_CAST(uint32_t, sizeof(uint32_t) * i);
+        entry->size = sizeof(uint32_t);
+        specialization->data[i] = programmableStage->constants[i].value.u32;
+    }
+
+    VkSpecializationInfo* info = &specialization->info;
+    {
+        info->mapEntryCount = programmableStage->constantCount;
+        info->pMapEntries = specialization->entries;
+        info->dataSize = sizeof(uint32_t) * programmableStage->constantCount;
+        info->pData = specialization->data;
+    }
+    return info;
+}
+
+// Returns the flags the pipeline needs for this stage. A stage passed by identifier only works for pipelines the
+// cache already has, so the pipeline is asked to fail instead of compiling and nkVkCreateGraphicsPipelines retries.
+static VkPipelineCreateFlags nkVkInitShaderStage(VkPipelineShaderStageCreateInfo* stageInfo, VkShaderStageFlagBits stage, const NkProgrammableStageInfo* programmableStage, char* entryPoint, NkVkSpecializationState* specialization) {
+
+    NK_ASSERT(programmableStage->module);
+
+    NkShaderModule module = programmableStage->module;
+
+    nkVkCopyEntryPoint(entryPoint, programmableStage->entryPoint);
+
+    stageInfo->sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo->pNext  = NULL;
+    stageInfo->flags  = 0;
+    stageInfo->stage  = stage;
+    stageInfo->module = VK_NULL_HANDLE;
+    stageInfo->pName  = entryPoint;
+    stageInfo->pSpecializationInfo = nkVkInitSpecialization(specialization, programmableStage);
+
+    if (module->device->shaderModuleIdentifiers) {
+        stageInfo->pNext = &module->identifier.info;
+        return VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+    }
+
+    stageInfo->module = module->module;
+    return 0;
+}
+
+static VkShaderModule nkVkGetShaderModuleHandle(NkShaderModule shaderModule);
+
+// Swaps a stage passed by identifier for the module itself, creating the module if this is its first miss.
+static void nkVkResolveShaderStage(VkPipelineShaderStageCreateInfo* stageInfo) {
+
+    if (stageInfo->module != VK_NULL_HANDLE) {
+        return;
+    }
+
+    const NkVkShaderIdentifier* identifier = NK_PTR_CAST(const NkVkShaderIdentifier*, stageInfo->pNext);
+    NK_ASSERT(identifier);
+
+    stageInfo->module = nkVkGetShaderModuleHandle(identifier->module);
+    stageInfo->pNext = NK_NULL;
+}
+
+// vkCreateGraphicsPipelines, plus a second attempt with real shader modules for any pipeline whose stages were
+// passed by identifier and weren't in the pipeline cache.
+static VkResult nkVkCreateGraphicsPipelines(NkDevice device, uint32_t count, const VkGraphicsPipelineCreateInfo* createInfos, VkPipeline* pipelines) {
+
+    VkResult result = vkCreateGraphicsPipelines(device->device, device->pipelineCache, count, createInfos, NK_NULL, pipelines);
+    if (result != VK_PIPELINE_COMPILE_REQUIRED) {
+        return result;
+    }
+
+    result = VK_SUCCESS;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pipelines[i] != VK_NULL_HANDLE) {
+            continue;
+        }
+
+        NK_ASSERT(createInfos[i].stageCount <= 2);
+
+        VkPipelineShaderStageCreateInfo stages[2];
+        for (uint32_t stage = 0; stage < createInfos[i].stageCount; stage++) {
+            stages[stage] = createInfos[i].pStages[stage];
+            nkVkResolveShaderStage(stages + stage);
+        }
+
+        VkGraphicsPipelineCreateInfo createInfo = createInfos[i];
+        createInfo.flags &= ~NK_CAST(VkPipelineCreateFlags, VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT);
+        createInfo.pStages = stages;
+
+        const VkResult retry = vkCreateGraphicsPipelines(device->device, device->pipelineCache, 1, &createInfo, NK_NULL, pipelines + i);
+        if (retry != VK_SUCCESS) {
+            result = retry;
+        }
+    }
+    return result;
+}
+
+static VkResult nkVkCreateComputePipeline(NkDevice device, const VkComputePipelineCreateInfo* createInfo, VkPipeline* pipeline) {
+
+    VkResult result = vkCreateComputePipelines(device->device, device->pipelineCache, 1, createInfo, NK_NULL, pipeline);
+    if (result != VK_PIPELINE_COMPILE_REQUIRED) {
+        return result;
+    }
+
+    VkComputePipelineCreateInfo retry = *createInfo;
+    retry.flags &= ~NK_CAST(VkPipelineCreateFlags, VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT);
+    nkVkResolveShaderStage(&retry.stage);
+
+    return vkCreateComputePipelines(device->device, device->pipelineCache, 1, &retry, NK_NULL, pipeline);
+}
+
+static uint32_t nkVkInitDynamicStates(NkDevice device, VkDynamicState* dynamicStates) {
+
+    uint32_t count = 0;
+    dynamicStates[count++] = VK_DYNAMIC_STATE_VIEWPORT;
+    dynamicStates[count++] = VK_DYNAMIC_STATE_LINE_WIDTH;
+
+    if (device->dynamicState & NkDynamicState_Rasterization) {
+        dynamicStates[count++] = VK_DYNAMIC_STATE_CULL_MODE_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_FRONT_FACE_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+        if (device->dynamicPrimitiveRestart) {
+            dynamicStates[count++] = VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT;
+        }
+    }
+    if (device->dynamicState & NkDynamicState_DepthStencil) {
+        dynamicStates[count++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_STENCIL_OP_EXT;
+    }
+    if (device->dynamicState & NkDynamicState_ColorBlend) {
+        dynamicStates[count++] = VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
+        dynamicStates[count++] = VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT;
+    }
+    if (device->dynamicState & NkDynamicState_DepthClamp) {
+        dynamicStates[count++] = VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT;
+    }
+
+    NK_ASSERT(count <= NK_VK_MAX_DYNAMIC_STATES);
+    return count;
+}
+
+static void nkVkInitRenderPipelineCreateState(NkDevice device, NkVkRenderPipelineCreateState* state, const NkRenderPipelineInfo* descriptor, NkPipelineLayout layout) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(state);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(layout);
+
+    state->layout = layout;
+
+    VkGraphicsPipelineCreateInfo* createInfo = &state->createInfo;
+    {
+        createInfo->sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        createInfo->pNext = NULL;
+        createInfo->flags = 0;
+
+        createInfo->pTessellationState = NULL;
+        createInfo->pViewportState = NULL;
+
+        createInfo->flags |= nkVkInitShaderStage(state->stages + 0, VK_SHADER_STAGE_VERTEX_BIT, &descriptor->vertexStage, state->entryPoints[0], state->specializations + 0);
+        createInfo->flags |= nkVkInitShaderStage(state->stages + 1, VK_SHADER_STAGE_FRAGMENT_BIT, &descriptor->fragmentStage, state->entryPoints[1], state->specializations + 1);
+
+        createInfo->pStages    = state->stages;
+        createInfo->stageCount = 2;
+
+        // Leaving out the vertex state is fine for shaders that generate their vertices themselves.
+        const uint32_t vertexBufferCount = descriptor->vertexState ? descriptor->vertexState->vertexBufferCount : 0;
+
+        uint32_t bindingCount = 0;
+        uint32_t attributeCount = 0;
+
+        VkPipelineVertexInputStateCreateInfo* vertexInputInfo = &state->vertexInput;
+        {
+            for (uint32_t slot = 0; slot < vertexBufferCount; slot++) {
+
+                const NkVertexBufferLayoutInfo* vertexBufferLayoutInfo =
+                    descriptor->vertexState->vertexBuffers + slot;
+
+                if (vertexBufferLayoutInfo->attributeCount == 0) {
+                    continue;
+                }
+
+                NK_ASSERT(bindingCount < NK_MAX_BUFFERS);
+
+                VkVertexInputBindingDescription* bindingDesc = state->bindings + bindingCount;
+                bindingDesc->binding = slot;
+                bindingDesc->stride = vertexBufferLayoutInfo->arrayStride;
+                bindingDesc->inputRate = nkVkInputRate(vertexBufferLayoutInfo->stepMode);
+                bindingCount++;
+
+                for (uint32_t attributeIndex = 0; attributeIndex < vertexBufferLayoutInfo->attributeCount; attributeIndex++) {
+
+                    const NkVertexAttributeInfo* vertexAttributeInfo =
+                        vertexBufferLayoutInfo->attributes + attributeIndex;
+
+                    NK_ASSERT(attributeCount < NK_MAX_ATTRIBUTES);
+
+                    VkVertexInputAttributeDescription* attributeDesc = state->attributes + attributeCount;
+                    attributeDesc->location = vertexAttributeInfo->shaderLocation;
+                    attributeDesc->binding = slot;
+                    attributeDesc->format = nkVkFormat(vertexAttributeInfo->format);
+                    attributeDesc->offset = vertexAttributeInfo->offset;
+
+                    attributeCount++;
+                }
+            }
+
+#ifdef NK_DEBUG
+            // Every input the vertex shader reads has to be fed by an attribute.
+            const NkVkShaderReflection* reflection = &descriptor->vertexStage.module->reflection;
+            for (uint32_t i = 0; i < reflection->inputCount; i++) {
+                NkBool found = NkFalse;
+                for (uint32_t j = 0; j < attributeCount; j++) {
+                    if (state->attributes[j].location == reflection->inputs[i].location) {
+                        found = NkTrue;
+                        break;
+                    }
+                }
+                NK_ASSERT(found);
+                (void)found;
+            }
+#endif
+
+            vertexInputInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertexInputInfo->pNext = NULL;
+            vertexInputInfo->flags = 0;
+            vertexInputInfo->vertexBindingDescriptionCount = bindingCount;
+            vertexInputInfo->pVertexBindingDescriptions = state->bindings;
+            vertexInputInfo->vertexAttributeDescriptionCount = attributeCount;
+            vertexInputInfo->pVertexAttributeDescriptions = state->attributes;
+            createInfo->pVertexInputState = vertexInputInfo;
+        }
+
+        VkPipelineInputAssemblyStateCreateInfo* inputAssembly = &state->inputAssembly;
+        {
+            inputAssembly->sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            inputAssembly->pNext = NULL;
+            inputAssembly->flags = 0;
+            inputAssembly->topology = nkVkPrimitiveTopology(descriptor->primitiveTopology);
+            inputAssembly->primitiveRestartEnable = nkVkShouldEnablePrimitiveRestart(descriptor->primitiveTopology);
+            createInfo->pInputAssemblyState = inputAssembly;
+        }
+
+        VkPipelineRasterizationStateCreateInfo* rasterizer = &state->rasterization;
+        {
+            rasterizer->sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+            rasterizer->pNext = NULL;
+            rasterizer->flags = 0;
+            rasterizer->rasterizerDiscardEnable = VK_FALSE;
+            rasterizer->polygonMode = VK_POLYGON_MODE_FILL;
+            rasterizer->lineWidth = 1.0f;
+
+            const NkRasterizationStateInfo* rasterizationState = descriptor->rasterizationState;
+            if (rasterizationState) {
+                rasterizer->cullMode = nkVkCullMode(rasterizationState->cullMode);
+                rasterizer->frontFace = nkVkFrontFace(rasterizationState->frontFace);
+                rasterizer->depthBiasEnable = (rasterizationState->depthBias != 0 || rasterizationState->depthBiasSlopeScale != 0.0f) ? VK_TRUE : VK_FALSE;
+                rasterizer->depthBiasConstantFactor = NK_CAST(float, rasterizationState->depthBias);
+                rasterizer->depthBiasClamp = rasterizationState->depthBiasClamp;
+                rasterizer->depthBiasSlopeFactor = rasterizationState->depthBiasSlopeScale;
+                rasterizer->depthClampEnable = (rasterizationState->clampDepth && device->depthClamp) ? VK_TRUE : VK_FALSE;
+            }
+            else {
+                rasterizer->cullMode = VK_CULL_MODE_NONE;
+                rasterizer->frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                rasterizer->depthBiasEnable = VK_FALSE;
+                rasterizer->depthBiasConstantFactor = 0.0f;
+                rasterizer->depthBiasClamp = 0.0f;
+                rasterizer->depthBiasSlopeFactor = 0.0f;
+                rasterizer->depthClampEnable = VK_FALSE;
+            }
+            createInfo->pRasterizationState = rasterizer;
+        }
+
+        VkPipelineMultisampleStateCreateInfo* multisampling = &state->multisample;
+        {
+            multisampling->sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+            multisampling->pNext = NULL;
+            multisampling->flags = 0;
+            multisampling->sampleShadingEnable = VK_FALSE;
+            multisampling->rasterizationSamples = nkVkSampleCount(descriptor->sampleCount);
+            multisampling->minSampleShading = 1.0f; // Optional
+            multisampling->pSampleMask = NULL; // Optional
+            multisampling->alphaToCoverageEnable = VK_FALSE; // Optional
+            multisampling->alphaToOneEnable = VK_FALSE; // Optional
+            createInfo->pMultisampleState = multisampling;
+        }
+
+        NK_ASSERT(descriptor->colorStateCount <= NK_MAX_COLOR_ATTACHMENTS);
+
+        for (uint32_t i = 0; i < descriptor->colorStateCount; i++) {
+            const NkColorStateInfo* colorState = descriptor->colorStates + i;
+            VkPipelineColorBlendAttachmentState* colorBlendAttachment = state->colorBlendAttachments + i;
+            colorBlendAttachment->colorWriteMask = nkVkColorWriteMask(colorState->writeMask);
+            colorBlendAttachment->blendEnable = colorState->blendEnabled ? VK_TRUE : VK_FALSE;
+            colorBlendAttachment->srcColorBlendFactor = nkVkBlendFactor(colorState->colorBlend.srcFactor);
+            colorBlendAttachment->dstColorBlendFactor = nkVkBlendFactor(colorState->colorBlend.dstFactor);
+            colorBlendAttachment->colorBlendOp = nkVkBlendOp(colorState->colorBlend.operation);
+            colorBlendAttachment->srcAlphaBlendFactor = nkVkBlendFactor(colorState->alphaBlend.srcFactor);
+            colorBlendAttachment->dstAlphaBlendFactor = nkVkBlendFactor(colorState->alphaBlend.dstFactor);
+            colorBlendAttachment->alphaBlendOp = nkVkBlendOp(colorState->alphaBlend.operation);
+        }
+
+        VkPipelineColorBlendStateCreateInfo* colorBlending = &state->colorBlend;
+        {
+            colorBlending->sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            colorBlending->pNext = NULL;
+            colorBlending->flags = 0;
+            colorBlending->logicOpEnable = VK_FALSE;
+            colorBlending->logicOp = VK_LOGIC_OP_COPY; // Optional
+            colorBlending->attachmentCount = descriptor->colorStateCount;
+            colorBlending->pAttachments = state->colorBlendAttachments;
+            colorBlending->blendConstants[0] = 0.0f; // Optional
+            colorBlending->blendConstants[1] = 0.0f; // Optional
+            colorBlending->blendConstants[2] = 0.0f; // Optional
+            colorBlending->blendConstants[3] = 0.0f; // Optional
+            createInfo->pColorBlendState = colorBlending;
+        }
+
+        const uint32_t dynamicStateCount = nkVkInitDynamicStates(device, state->dynamicStates);
+
+        VkPipelineDynamicStateCreateInfo* dynamicState = &state->dynamicState;
+        {
+            dynamicState->sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+            dynamicState->pNext = NULL;
+            dynamicState->flags = 0;
+            dynamicState->dynamicStateCount = dynamicStateCount;
+            dynamicState->pDynamicStates = state->dynamicStates;
+            createInfo->pDynamicState = dynamicState;
+        }
+
+        createInfo->pDepthStencilState = NULL;
+
+        const NkDepthStencilStateInfo* depthStencilState = descriptor->depthStencilState;
+        if (depthStencilState) {
+            VkPipelineDepthStencilStateCreateInfo* depthStencil = &state->depthStencil;
+            const VkFormat format = nkVkTextureFormat(depthStencilState->format);
+            const NkStencilStateFaceInfo* faces[2] = { &depthStencilState->stencilFront, &depthStencilState->stencilBack };
+            VkStencilOpState* faceStates[2] = { &depthStencil->front, &depthStencil->back };
+
+            depthStencil->sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+            depthStencil->pNext = NULL;
+            depthStencil->flags = 0;
+            depthStencil->depthTestEnable = nkVkFormatHasDepth(format) ? VK_TRUE : VK_FALSE;
+            depthStencil->depthWriteEnable = depthStencilState->depthWriteEnabled ? VK_TRUE : VK_FALSE;
+            depthStencil->depthCompareOp = nkVkCompareOp(depthStencilState->depthCompare);
+            depthStencil->depthBoundsTestEnable = VK_FALSE;
+            depthStencil->stencilTestEnable = nkVkFormatHasStencil(format) ? VK_TRUE : VK_FALSE;
+            for (uint32_t i = 0; i < 2; i++) {
+                faceStates[i]->failOp = nkVkStencilOp(faces[i]->failOp);
+                faceStates[i]->passOp = nkVkStencilOp(faces[i]->passOp);
+                faceStates[i]->depthFailOp = nkVkStencilOp(faces[i]->depthFailOp);
+                faceStates[i]->compareOp = nkVkCompareOp(faces[i]->compare);
+                faceStates[i]->compareMask = depthStencilState->stencilReadMask;
+                faceStates[i]->writeMask = depthStencilState->stencilWriteMask;
+                faceStates[i]->reference = 0;
+            }
+            depthStencil->minDepthBounds = 0.0f;
+            depthStencil->maxDepthBounds = 1.0f;
+            createInfo->pDepthStencilState = depthStencil;
+        }
+
+        createInfo->layout = layout->layout;
+
+        if (device->dynamicRendering) {
+            const VkFormat depthStencilFormat = depthStencilState ? nkVkTextureFormat(depthStencilState->format) : VK_FORMAT_UNDEFINED;
+
+            for (uint32_t i = 0; i < descriptor->colorStateCount; i++) {
+                state->colorFormats[i] = nkVkTextureFormat(descriptor->colorStates[i].format);
+            }
+
+            VkPipelineRenderingCreateInfo* rendering = &state->rendering;
+            {
+                rendering->sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+                rendering->pNext = NULL;
+                rendering->viewMask = 0;
+                rendering->colorAttachmentCount = descriptor->colorStateCount;
+                rendering->pColorAttachmentFormats = state->colorFormats;
+                rendering->depthAttachmentFormat = nkVkFormatHasDepth(depthStencilFormat) ? depthStencilFormat : VK_FORMAT_UNDEFINED;
+                rendering->stencilAttachmentFormat = nkVkFormatHasStencil(depthStencilFormat) ? depthStencilFormat : VK_FORMAT_UNDEFINED;
+                createInfo->pNext = rendering;
+            }
+
+            createInfo->renderPass = VK_NULL_HANDLE;
+        }
+        else {
+            createInfo->renderPass = nkVkGetPipelineRenderPass(device, descriptor);
+        }
+
+        createInfo->subpass = 0;
+        createInfo->basePipelineHandle = VK_NULL_HANDLE;
+        createInfo->basePipelineIndex = -1;
+    }
+}
+
+static void nkVkInitComputePipelineCreateState(NkVkComputePipelineCreateState* state, const NkComputePipelineInfo* descriptor, NkPipelineLayout layout) {
+
+    NK_ASSERT(state);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(layout);
+
+    state->layout = layout;
+
+    VkComputePipelineCreateInfo* createInfo = &state->createInfo;
+    {
+        createInfo->sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        createInfo->pNext = NULL;
+        createInfo->flags = 0;
+        createInfo->flags |= nkVkInitShaderStage(&createInfo->stage, VK_SHADER_STAGE_COMPUTE_BIT, &descriptor->computeStage, state->entryPoint, &state->specialization);
+        createInfo->layout = layout->layout;
+        createInfo->basePipelineHandle = VK_NULL_HANDLE;
+        createInfo->basePipelineIndex = -1;
+    }
+}
+
+static void nkVkScheduleTask(NkDevice device, NkTaskFunction function, void* data) {
+
+    if (device->scheduleTask) {
+        device->scheduleTask(function, data, device->scheduleTaskUserdata);
+    }
+    else {
+        nkThreadPoolSchedule(device->threadPool, function, data);
+    }
+}
+
+// Work split into items that the calling thread and the device's tasks take one at a time. The caller only waits
+// for items somebody has taken, never for a task to start, so it gets through on its own when the scheduler is
+// busy, when it defers tasks to the calling thread, or when the caller is one of the device's tasks itself. The
+// job is reference counted, and a task that starts after every item is taken drops its reference without
+// touching the caller's data.
+typedef void (*NkVkParallelFunction)(void* data, uint32_t item, void* scratch);
+
+typedef struct NkVkParallelJob {
+    NkVkParallelFunction function;
+    void* data;
+    size_t scratchSize; // allocated once by every thread that takes an item
+    uint32_t itemCount;
+    NkMutex mutex;
+    NkCondition finished;
+    uint32_t nextItem;
+    uint32_t finishedCount;
+    uint32_t refCount;
+} NkVkParallelJob;
+
+static void nkVkTakeParallelItems(NkVkParallelJob* job) {
+
+    void* scratch = NK_NULL;
+
+    nkMutexLock(&job->mutex);
+    while (job->nextItem < job->itemCount) {
+        const uint32_t item = job->nextItem++;
+        nkMutexUnlock(&job->mutex);
+
+        if (scratch == NK_NULL && job->scratchSize > 0) {
+            scratch = NK_MALLOC(job->scratchSize);
+            NK_ASSERT(scratch);
+        }
+        job->function(job->data, item, scratch);
+
+        nkMutexLock(&job->mutex);
+        if (++job->finishedCount == job->itemCount) {
+            nkConditionSignal(&job->finished);
+        }
+    }
+    nkMutexUnlock(&job->mutex);
+
+    if (scratch) {
+        NK_FREE(scratch);
+    }
+}
+
+static void nkVkReleaseParallelJob(NkVkParallelJob* job) {
+
+    nkMutexLock(&job->mutex);
+    const uint32_t refCount = --job->refCount;
+    nkMutexUnlock(&job->mutex);
+
+    if (refCount == 0) {
+        nkConditionDestroy(&job->finished);
+        nkMutexDestroy(&job->mutex);
+        NK_FREE(job);
+    }
+}
+
+static void nkVkRunParallelTask(void* taskData) {
+
+    NkVkParallelJob* job = NK_PTR_CAST(NkVkParallelJob*, taskData);
+    nkVkTakeParallelItems(job);
+    nkVkReleaseParallelJob(job);
+}
+
+// Hands the items to taskCount of the device's tasks as well as the calling thread, and returns once every item
+// is done.
+static void nkVkRunParallel(NkDevice device, uint32_t itemCount, uint32_t taskCount, size_t scratchSize, NkVkParallelFunction function, void* data) {
+
+    NkVkParallelJob* job = NK_PTR_CAST(NkVkParallelJob*, NK_MALLOC(sizeof(NkVkParallelJob)));
+    NK_ASSERT(job);
+
+    job->function = function;
+    job->data = data;
+    job->scratchSize = scratchSize;
+    job->itemCount = itemCount;
+    nkMutexInit(&job->mutex);
+    nkConditionInit(&job->finished);
+    job->nextItem = 0;
+    job->finishedCount = 0;
+    job->refCount = taskCount + 1;
+
+    for (uint32_t i = 0; i < taskCount; i++) {
+        nkVkScheduleTask(device, nkVkRunParallelTask, job);
+    }
+    nkVkTakeParallelItems(job);
+
+    nkMutexLock(&job->mutex);
+    while (job->finishedCount < job->itemCount) {
+        nkConditionWait(&job->finished, &job->mutex);
+    }
+    nkMutexUnlock(&job->mutex);
+
+    nkVkReleaseParallelJob(job);
+}
+
+static NkRenderPipeline nkVkFindRenderPipeline(NkDevice device, uint64_t hash) {
+
+    nkMutexLock(&device->pipelineMutex);
+    NkRenderPipeline renderPipeline =
+        NK_PTR_CAST(NkRenderPipeline, nkHashMapFind(&device->renderPipelines, hash));
+    if (renderPipeline) {
+        renderPipeline->refCount++;
+    }
+    nkMutexUnlock(&device->pipelineMutex);
+
+    return renderPipeline;
+}
+
+static void nkVkScheduleRenderPipelineOptimization(NkRenderPipeline renderPipeline, const VkPipeline* libraries);
+
+// Pipelines are compiled without holding the device lock, so two threads can race to build the same one.
+// Whoever publishes second throws its copy away and takes a reference on the winner. Pipelines linked from
+// libraries get an optimized rebuild queued behind them.
+static NkRenderPipeline nkVkPublishRenderPipeline(NkDevice device, uint64_t hash, VkPipeline pipeline, const NkVkRenderPipelineCreateState* state, const VkPipeline* libraries) {
+
+    nkMutexLock(&device->pipelineMutex);
+
+    NkRenderPipeline renderPipeline =
+        NK_PTR_CAST(NkRenderPipeline, nkHashMapFind(&device->renderPipelines, hash));
+    if (renderPipeline) {
+        renderPipeline->refCount++;
+        nkMutexUnlock(&device->pipelineMutex);
+        vkDestroyPipeline(device->device, pipeline, NK_NULL);
+        return renderPipeline;
+    }
+
+    renderPipeline = NK_PTR_CAST(NkRenderPipeline, NK_MALLOC(sizeof(struct NkRenderPipelineImpl)));
+    NK_ASSERT(renderPipeline);
+
+    renderPipeline->device = device;
+    renderPipeline->compiled = renderPipeline;
+    renderPipeline->pipeline = pipeline;
+    renderPipeline->linkedPipeline = VK_NULL_HANDLE;
+    renderPipeline->layout = nkVkRetainPipelineLayout(state->layout);
+    memset(&renderPipeline->dynamicState, 0, sizeof(renderPipeline->dynamicState));
+    renderPipeline->hash = hash;
+    renderPipeline->refCount = libraries ? 2 : 1; // the optimization task holds a reference of its own
+
+    nkHashMapInsert(&device->renderPipelines, hash, renderPipeline);
+
+    nkMutexUnlock(&device->pipelineMutex);
+
+    if (libraries) {
+        nkVkScheduleRenderPipelineOptimization(renderPipeline, libraries);
+    }
+
+    return renderPipeline;
+}
+
+static void nkVkInitRenderPipelineDynamicState(NkDevice device, NkVkRenderPipelineDynamicState* state, const NkRenderPipelineInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(state);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(descriptor->colorStateCount <= NK_MAX_COLOR_ATTACHMENTS);
+
+    memset(state, 0, sizeof(*state));
+
+    state->topology = nkVkPrimitiveTopology(descriptor->primitiveTopology);
+    state->primitiveRestart = nkVkShouldEnablePrimitiveRestart(descriptor->primitiveTopology);
+
+    const NkRasterizationStateInfo* rasterizationState = descriptor->rasterizationState;
+    if (rasterizationState) {
+        state->cullMode = nkVkCullMode(rasterizationState->cullMode);
+        state->frontFace = nkVkFrontFace(rasterizationState->frontFace);
+        state->depthClamp = (rasterizationState->clampDepth && device->depthClamp) ? VK_TRUE : VK_FALSE;
+    }
+    else {
+        state->cullMode = VK_CULL_MODE_NONE;
+        state->frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        state->depthClamp = VK_FALSE;
+    }
+
+    const NkDepthStencilStateInfo* depthStencilState = descriptor->depthStencilState;
+    if (depthStencilState) {
+        const VkFormat format = nkVkTextureFormat(depthStencilState->format);
+        const NkStencilStateFaceInfo* faces[2] = { &depthStencilState->stencilFront, &depthStencilState->stencilBack };
+        state->depthTest = nkVkFormatHasDepth(format) ? VK_TRUE : VK_FALSE;
+        state->depthWrite = depthStencilState->depthWriteEnabled ? VK_TRUE : VK_FALSE;
+        state->depthCompare = nkVkCompareOp(depthStencilState->depthCompare);
+        state->stencilTest = nkVkFormatHasStencil(format) ? VK_TRUE : VK_FALSE;
+        for (uint32_t i = 0; i < 2; i++) {
+            state->stencilFaces[i].failOp = nkVkStencilOp(faces[i]->failOp);
+            state->stencilFaces[i].passOp = nkVkStencilOp(faces[i]->passOp);
+            state->stencilFaces[i].depthFailOp = nkVkStencilOp(faces[i]->depthFailOp);
+            state->stencilFaces[i].compareOp = nkVkCompareOp(faces[i]->compare);
+        }
+    }
+    else {
+        state->depthTest = VK_FALSE;
+        state->depthWrite = VK_FALSE;
+        state->depthCompare = VK_COMPARE_OP_ALWAYS;
+        state->stencilTest = VK_FALSE;
+        for (uint32_t i = 0; i < 2; i++) {
+            state->stencilFaces[i].failOp = VK_STENCIL_OP_KEEP;
+            state->stencilFaces[i].passOp = VK_STENCIL_OP_KEEP;
+            state->stencilFaces[i].depthFailOp = VK_STENCIL_OP_KEEP;
+            state->stencilFaces[i].compareOp = VK_COMPARE_OP_ALWAYS;
+        }
+    }
+
+    state->colorStateCount = descriptor->colorStateCount;
+    for (uint32_t i = 0; i < descriptor->colorStateCount; i++) {
+        const NkColorStateInfo* colorState = descriptor->colorStates + i;
+        VkColorBlendEquationEXT* equation = state->blendEquations + i;
+        state->blendEnables[i] = colorState->blendEnabled ? VK_TRUE : VK_FALSE;
+        equation->srcColorBlendFactor = nkVkBlendFactor(colorState->colorBlend.srcFactor);
+        equation->dstColorBlendFactor = nkVkBlendFactor(colorState->colorBlend.dstFactor);
+        equation->colorBlendOp = nkVkBlendOp(colorState->colorBlend.operation);
+        equation->srcAlphaBlendFactor = nkVkBlendFactor(colorState->alphaBlend.srcFactor);
+        equation->dstAlphaBlendFactor = nkVkBlendFactor(colorState->alphaBlend.dstFactor);
+        equation->alphaBlendOp = nkVkBlendOp(colorState->alphaBlend.operation);
+        state->writeMasks[i] = nkVkColorWriteMask(colorState->writeMask);
+    }
+}
+
+// On devices with extended dynamic state, descriptors that differ only in dynamic state share one compiled
+// pipeline. Each of them gets a variant back: a handle that holds a reference on the compiled pipeline and
+// remembers the state its descriptor asked for, which replay sets whenever the variant is bound. Takes over
+// the caller's reference on compiled.
+static NkRenderPipeline nkVkGetRenderPipelineVariant(NkDevice device, NkRenderPipeline compiled, const NkVkRenderPipelineDynamicState* state) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(state);
+
+    if (compiled == NK_NULL || device->dynamicState == 0) {
+        return compiled;
+    }
+
+    NK_ASSERT(compiled->compiled == compiled);
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU64(&hasher, compiled->hash);
+    nkHashBytes(&hasher, state, sizeof(*state));
+    const uint64_t hash = nkHasherFinish(&hasher);
+
+    nkMutexLock(&device->pipelineMutex);
+
+    NkRenderPipeline variant =
+        NK_PTR_CAST(NkRenderPipeline, nkHashMapFind(&device->renderPipelineVariants, hash));
+    if (variant) {
+        // The variant holds a reference on the compiled pipeline already, so the caller's one can go.
+        NK_ASSERT(compiled->refCount > 1);
+        compiled->refCount--;
+        variant->refCount++;
+        nkMutexUnlock(&device->pipelineMutex);
+        return variant;
+    }
+
+    variant = NK_PTR_CAST(NkRenderPipeline, NK_MALLOC(sizeof(struct NkRenderPipelineImpl)));
+    NK_ASSERT(variant);
+
+    variant->device = device;
+    variant->compiled = compiled;
+    variant->pipeline = VK_NULL_HANDLE;
+    variant->linkedPipeline = VK_NULL_HANDLE;
+    variant->layout = nkVkRetainPipelineLayout(compiled->layout);
+    variant->dynamicState = *state;
+    variant->hash = hash;
+    variant->refCount = 1;
+
+    nkHashMapInsert(&device->renderPipelineVariants, hash, variant);
+
+    nkMutexUnlock(&device->pipelineMutex);
+
+    return variant;
+}
+
+typedef struct NkVkPipelineLibrary {
+    VkPipeline pipeline;
+} NkVkPipelineLibrary;
+
+static const VkGraphicsPipelineLibraryFlagsEXT NkVkPipelineLibraryPartFlags[NkVkPipelineLibraryPart_Count] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+static VkResult nkVkCreatePipelineLibrary(NkDevice device, const NkVkRenderPipelineCreateState* state, NkVkPipelineLibraryPart part, VkPipeline* library) {
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo;
+    {
+        libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+        libraryInfo.pNext = NK_NULL;
+        libraryInfo.flags = NkVkPipelineLibraryPartFlags[part];
+    }
+
+    // without a render pass to take attachment formats from, every part has to see the rendering info too
+    VkPipelineRenderingCreateInfo rendering;
+    if (device->dynamicRendering) {
+        rendering = state->rendering;
+        rendering.pNext = &libraryInfo;
+    }
+
+    // The driver only reads the state that belongs to the part being built, so the full create info can be
+    // passed through as long as each shader ends up in the right library.
+    VkGraphicsPipelineCreateInfo createInfo = state->createInfo;
+    {
+        createInfo.pNext = device->dynamicRendering ? NK_PTR_CAST(const void*, &rendering) : NK_PTR_CAST(const void*, &libraryInfo);
+        createInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+        switch (part) {
+        case NkVkPipelineLibraryPart_PreRasterization:
+            createInfo.pStages = state->stages + 0;
+            createInfo.stageCount = 1;
+            break;
+        case NkVkPipelineLibraryPart_Fragment:
+            createInfo.pStages = state->stages + 1;
+            createInfo.stageCount = 1;
+            break;
+        default:
+            createInfo.pStages = NK_NULL;
+            createInfo.stageCount = 0;
+            break;
+        }
+    }
+
+    return nkVkCreateGraphicsPipelines(device, 1, &createInfo, library);
+}
+
+static VkResult nkVkGetPipelineLibrary(NkDevice device, const NkVkRenderPipelineCreateState* state, NkVkPipelineLibraryPart part, uint64_t hash, VkPipeline* library) {
+
+    nkMutexLock(&device->pipelineMutex);
+    NkVkPipelineLibrary* cached = NK_PTR_CAST(NkVkPipelineLibrary*, nkHashMapFind(&device->pipelineLibraries, hash));
+    nkMutexUnlock(&device->pipelineMutex);
+
+    if (cached) {
+        *library = cached->pipeline;
+        return VK_SUCCESS;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    const VkResult result = nkVkCreatePipelineLibrary(device, state, part, &pipeline);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    nkMutexLock(&device->pipelineMutex);
+
+    cached = NK_PTR_CAST(NkVkPipelineLibrary*, nkHashMapFind(&device->pipelineLibraries, hash));
+    if (cached) {
+        nkMutexUnlock(&device->pipelineMutex);
+        vkDestroyPipeline(device->device, pipeline, NK_NULL);
+        *library = cached->pipeline;
+        return VK_SUCCESS;
+    }
+
+    cached = NK_PTR_CAST(NkVkPipelineLibrary*, NK_MALLOC(sizeof(NkVkPipelineLibrary)));
+    NK_ASSERT(cached);
+    cached->pipeline = pipeline;
+    nkHashMapInsert(&device->pipelineLibraries, hash, cached);
+
+    nkMutexUnlock(&device->pipelineMutex);
+
+    *library = pipeline;
+    return VK_SUCCESS;
+}
+
+static VkResult nkVkLinkPipelineLibraries(NkDevice device, const VkPipeline* libraries, VkPipelineLayout layout, VkPipelineCreateFlags flags, VkPipeline* pipeline) {
+
+    VkPipelineLibraryCreateInfoKHR linkInfo;
+    {
+        linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+        linkInfo.pNext = NK_NULL;
+        linkInfo.libraryCount = NkVkPipelineLibraryPart_Count;
+        linkInfo.pLibraries = libraries;
+    }
+
+    VkGraphicsPipelineCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        createInfo.pNext = &linkInfo;
+        createInfo.flags = flags;
+        createInfo.stageCount = 0;
+        createInfo.pStages = NK_NULL;
+        createInfo.pVertexInputState = NK_NULL;
+        createInfo.pInputAssemblyState = NK_NULL;
+        createInfo.pTessellationState = NK_NULL;
+        createInfo.pViewportState = NK_NULL;
+        createInfo.pRasterizationState = NK_NULL;
+        createInfo.pMultisampleState = NK_NULL;
+        createInfo.pDepthStencilState = NK_NULL;
+        createInfo.pColorBlendState = NK_NULL;
+        createInfo.pDynamicState = NK_NULL;
+        createInfo.layout = layout;
+        createInfo.renderPass = VK_NULL_HANDLE;
+        createInfo.subpass = 0;
+        createInfo.basePipelineHandle = VK_NULL_HANDLE;
+        createInfo.basePipelineIndex = -1;
+    }
+
+    return vkCreateGraphicsPipelines(device->device, device->pipelineCache, 1, &createInfo, NK_NULL, pipeline);
+}
+
+// Compiles and publishes a render pipeline. With graphics pipeline libraries only parts that have never been
+// seen cost a compile, and linking them without link-time optimization takes microseconds rather than the
+// milliseconds of a full compile. The optimized pipeline follows later from the worker pool.
+static NkRenderPipeline nkVkBuildRenderPipeline(NkDevice device, const NkVkRenderPipelineCreateState* state, uint64_t hash, const uint64_t* partHashes, VkResult* result) {
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if (device->graphicsPipelineLibrary) {
+        VkPipeline libraries[NkVkPipelineLibraryPart_Count];
+        for (uint32_t part = 0; part < NkVkPipelineLibraryPart_Count; part++) {
+            *result = nkVkGetPipelineLibrary(device, state, NK_CAST(NkVkPipelineLibraryPart, part), partHashes[part], libraries + part);
+            if (*result != VK_SUCCESS) {
+                return NK_NULL;
+            }
+        }
+
+        *result = nkVkLinkPipelineLibraries(device, libraries, state->layout->layout, 0, &pipeline);
+        if (*result != VK_SUCCESS) {
+            return NK_NULL;
+        }
+
+        return nkVkPublishRenderPipeline(device, hash, pipeline, state, libraries);
+    }
+
+    *result = nkVkCreateGraphicsPipelines(device, 1, &state->createInfo, &pipeline);
+    if (*result != VK_SUCCESS) {
+        return NK_NULL;
+    }
+
+    return nkVkPublishRenderPipeline(device, hash, pipeline, state, NK_NULL);
+}
+
+NkRenderPipeline nkCreateRenderPipeline(NkDevice device, const NkRenderPipelineInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    // Identical descriptors are common when several subsystems build the same material. Handing back the
+    // pipeline we already have turns a driver compile into a hash and a table lookup.
+    NkPipelineLayout layout = nkVkResolveRenderPipelineLayout(device, descriptor);
+
+    uint64_t partHashes[NkVkPipelineLibraryPart_Count];
+    nkVkHashRenderPipelineParts(device, descriptor, layout, partHashes);
+    const uint64_t hash = nkVkHashPipelineParts(partHashes);
+
+    NkVkRenderPipelineDynamicState dynamicState;
+    nkVkInitRenderPipelineDynamicState(device, &dynamicState, descriptor);
+
+    NkRenderPipeline renderPipeline = nkVkFindRenderPipeline(device, hash);
+    if (renderPipeline) {
+        nkDestroyPipelineLayout(layout);
+        return nkVkGetRenderPipelineVariant(device, renderPipeline, &dynamicState);
+    }
+
+    NkVkRenderPipelineCreateState state;
+    nkVkInitRenderPipelineCreateState(device, &state, descriptor, layout);
+
+    VkResult result = VK_SUCCESS;
+    renderPipeline = nkVkBuildRenderPipeline(device, &state, hash, partHashes, &result);
+    NK_CHECK_VK(result);
+
+    nkDestroyPipelineLayout(layout);
+
+    return nkVkGetRenderPipelineVariant(device, renderPipeline, &dynamicState);
+}
+
+// A nkCreateRenderPipelines batch, compiled a slice at a time. Every slice shares the device's pipeline cache,
+// which Vulkan synchronises internally, so pipelines compiled on one thread can still hit blobs produced by another.
+typedef struct NkVkPipelineBatch {
+    NkDevice device;
+    const VkGraphicsPipelineCreateInfo* createInfos;
+    VkPipeline* pipelines;
+    uint32_t count;
+    uint32_t sliceSize;
+    VkResult* results; // one per slice
+} NkVkPipelineBatch;
+
+static void nkVkCompilePipelineBatchSlice(void* data, uint32_t slice, void* scratch) {
+
+    NkVkPipelineBatch* batch = NK_PTR_CAST(NkVkPipelineBatch*, data);
+    (void)scratch;
+
+    const uint32_t first = slice * batch->sliceSize;
+    const uint32_t count = NK_MIN(batch->sliceSize, batch->count - first);
+    batch->results[slice] = nkVkCreateGraphicsPipelines(batch->device, count, batch->createInfos + first, batch->pipelines + first);
+}
+
+static void nkVkCompilePipelineBatch(NkDevice device, uint32_t count, const VkGraphicsPipelineCreateInfo* createInfos, VkPipeline* pipelines) {
+
+    const uint32_t sliceSize = device->pipelineBatchSize > 0 ? device->pipelineBatchSize : count;
+    const uint32_t sliceCount = (count + sliceSize - 1) / sliceSize;
+
+    NkVkPipelineBatch batch;
+    batch.device = device;
+    batch.createInfos = createInfos;
+    batch.pipelines = pipelines;
+    batch.count = count;
+    batch.sliceSize = sliceSize;
+    batch.results = NK_PTR_CAST(VkResult*, NK_MALLOC(sizeof(VkResult) * sliceCount));
+    NK_ASSERT(batch.results);
+
+    // The calling thread compiles slices too rather than sitting idle while the workers do.
+    nkVkRunParallel(device, sliceCount, sliceCount - 1, 0, nkVkCompilePipelineBatchSlice, &batch);
+
+    VkResult result = VK_SUCCESS;
+    for (uint32_t i = 0; i < sliceCount; i++) {
+        result = batch.results[i] != VK_SUCCESS ? batch.results[i] : result;
+    }
+    NK_FREE(batch.results);
+
+    NK_CHECK_VK(result);
+}
+
+void nkCreateRenderPipelines(NkDevice device, uint32_t count, const NkRenderPipelineInfo* descriptors, NkRenderPipeline* pipelines) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(count == 0 || descriptors);
+    NK_ASSERT(count == 0 || pipelines);
+
+    if (count == 0) {
+        return;
+    }
+
+    uint64_t* hashes = NK_PTR_CAST(uint64_t*, NK_MALLOC(sizeof(uint64_t) * count));
+    NkVkRenderPipelineCreateState* states =
+        NK_PTR_CAST(NkVkRenderPipelineCreateState*, NK_MALLOC(sizeof(NkVkRenderPipelineCreateState) * count));
+    VkGraphicsPipelineCreateInfo* createInfos =
+        NK_PTR_CAST(VkGraphicsPipelineCreateInfo*, NK_MALLOC(sizeof(VkGraphicsPipelineCreateInfo) * count));
+    VkPipeline* compiled = NK_PTR_CAST(VkPipeline*, NK_MALLOC(sizeof(VkPipeline) * count));
+    uint32_t* compiledIndices = NK_PTR_CAST(uint32_t*, NK_MALLOC(sizeof(uint32_t) * count));
+    NkPipelineLayout* layouts = NK_PTR_CAST(NkPipelineLayout*, NK_MALLOC(sizeof(NkPipelineLayout) * count));
+    NK_ASSERT(hashes && states && createInfos && compiled && compiledIndices && layouts);
+
+    // Permutation lists tend to repeat themselves, so only descriptors that are neither cached already nor
+    // earlier in this batch are sent to the driver.
+    NkHashMap queued;
+    nkHashMapInit(&queued);
+
+    uint32_t compileCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        layouts[i] = nkVkResolveRenderPipelineLayout(device, descriptors + i);
+        hashes[i] = nkVkHashRenderPipelineInfo(device, descriptors + i, layouts[i]);
+        pipelines[i] = nkVkFindRenderPipeline(device, hashes[i]);
+        if (pipelines[i] || nkHashMapFind(&queued, hashes[i])) {
+            continue;
+        }
+
+        nkHashMapInsert(&queued, hashes[i], compiledIndices + compileCount);
+        nkVkInitRenderPipelineCreateState(device, states + compileCount, descriptors + i, layouts[i]);
+        createInfos[compileCount] = states[compileCount].createInfo;
+        compiledIndices[compileCount] = i;
+        compileCount++;
+    }
+
+    nkHashMapDestroy(&queued);
+
+    if (compileCount > 0) {
+        nkVkCompilePipelineBatch(device, compileCount, createInfos, compiled);
+    }
+
+    for (uint32_t i = 0; i < compileCount; i++) {
+        const uint32_t index = compiledIndices[i];
+        pipelines[index] = nkVkPublishRenderPipeline(device, hashes[index], compiled[i], states + i, NK_NULL);
+    }
+
+    // Repeats of a descriptor compiled above pick up their reference now that it's published.
+    for (uint32_t i = 0; i < count; i++) {
+        if (pipelines[i] == NK_NULL) {
+            pipelines[i] = nkVkFindRenderPipeline(device, hashes[i]);
+            NK_ASSERT(pipelines[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        NkVkRenderPipelineDynamicState dynamicState;
+        nkVkInitRenderPipelineDynamicState(device, &dynamicState, descriptors + i);
+        pipelines[i] = nkVkGetRenderPipelineVariant(device, pipelines[i], &dynamicState);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        nkDestroyPipelineLayout(layouts[i]);
+    }
+
+    NK_FREE(layouts);
+    NK_FREE(compiledIndices);
+    NK_FREE(compiled);
+    NK_FREE(createInfos);
+    NK_FREE(states);
+    NK_FREE(hashes);
+}
+
+typedef enum NkVkPipelineTaskType {
+    NkVkPipelineTaskType_Render,
+    NkVkPipelineTaskType_Compute,
+    NkVkPipelineTaskType_Optimize,
+} NkVkPipelineTaskType;
+
+// One asynchronous pipeline creation. The worker fills in the result, then the task waits on the device's
+// completed list until nkDeviceTick hands it back to the caller.
+typedef struct NkVkPipelineTask {
+    NkDevice device;
+    struct NkVkPipelineTask* next;
+    NkVkPipelineTaskType type;
+    uint64_t hash;
+    uint64_t partHashes[NkVkPipelineLibraryPart_Count];
+    NkPipelineLayout layout; // reference held until the pipeline is built
+    NkVkRenderPipelineDynamicState dynamicState; // render tasks only
+    VkResult result;
+    void* userdata;
+    union {
+        NkCreateRenderPipelineAsyncCallback render;
+        NkCreateComputePipelineAsyncCallback compute;
+    } callback;
+    union {
+        NkRenderPipeline render;
+        NkComputePipeline compute;
+    } pipeline;
+    union {
+        NkVkRenderPipelineCreateState render;
+        NkVkComputePipelineCreateState compute;
+        struct {
+            VkPipeline libraries[NkVkPipelineLibraryPart_Count];
+            VkPipelineLayout layout;
+            VkPipeline pipeline;
+        } optimize;
+    } state;
+} NkVkPipelineTask;
+
+static void nkVkCompletePipelineTask(NkVkPipelineTask* task, NkBool pending) {
+
+    NkDevice device = task->device;
+
+    nkMutexLock(&device->taskMutex);
+
+    task->next = NK_NULL;
+    if (device->completedTail) {
+        device->completedTail->next = task;
+    }
+    else {
+        device->completedHead = task;
+    }
+    device->completedTail = task;
+
+    if (pending) {
+        NK_ASSERT(device->pendingTaskCount > 0);
+        if (--device->pendingTaskCount == 0) {
+            nkConditionBroadcast(&device->tasksIdle);
+        }
+    }
+
+    nkMutexUnlock(&device->taskMutex);
+}
+
+static NkComputePipeline nkVkCreateComputePipelineObject(NkDevice device, VkPipeline pipeline, NkPipelineLayout layout) {
+
+    NkComputePipeline computePipeline = NK_PTR_CAST(NkComputePipeline, NK_MALLOC(sizeof(struct NkComputePipelineImpl)));
+    NK_ASSERT(computePipeline);
+
+    computePipeline->device = device;
+    computePipeline->pipeline = pipeline;
+    computePipeline->layout = nkVkRetainPipelineLayout(layout);
+
+    return computePipeline;
+}
+
+static void nkVkRunPipelineTask(void* taskData) {
+
+    NkVkPipelineTask* task = NK_PTR_CAST(NkVkPipelineTask*, taskData);
+    NkDevice device = task->device;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    switch (task->type) {
+    case NkVkPipelineTaskType_Render:
+        task->pipeline.render = nkVkBuildRenderPipeline(device, &task->state.render, task->hash, task->partHashes, &task->result);
+        task->pipeline.render = nkVkGetRenderPipelineVariant(device, task->pipeline.render, &task->dynamicState);
+        break;
+    case NkVkPipelineTaskType_Compute:
+        task->result = nkVkCreateComputePipeline(device, &task->state.compute.createInfo, &pipeline);
+        if (task->result == VK_SUCCESS) {
+            task->pipeline.compute = nkVkCreateComputePipelineObject(device, pipeline, task->layout);
+        }
+        break;
+    case NkVkPipelineTaskType_Optimize:
+        task->result = nkVkLinkPipelineLibraries(device, task->state.optimize.libraries, task->state.optimize.layout,
+            VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT, &task->state.optimize.pipeline);
+        break;
+    }
+
+    if (task->layout) {
+        nkDestroyPipelineLayout(task->layout);
+        task->layout = NK_NULL;
+    }
+
+    nkVkCompletePipelineTask(task, NkTrue);
+}
+
+static NkVkPipelineTask* nkVkCreatePipelineTask(NkDevice device, NkVkPipelineTaskType type, void* userdata) {
+
+    NkVkPipelineTask* task = NK_PTR_CAST(NkVkPipelineTask*, NK_MALLOC(sizeof(NkVkPipelineTask)));
+    NK_ASSERT(task);
+
+    task->device = device;
+    task->next = NK_NULL;
+    task->type = type;
+    task->hash = 0;
+    task->layout = NK_NULL;
+    task->result = VK_SUCCESS;
+    task->userdata = userdata;
+
+    return task;
+}
+
+static void nkVkSchedulePipelineTask(NkVkPipelineTask* task) {
+
+    NkDevice device = task->device;
+
+    nkMutexLock(&device->taskMutex);
+    device->pendingTaskCount++;
+    nkMutexUnlock(&device->taskMutex);
+
+    nkVkScheduleTask(device, nkVkRunPipelineTask, task);
+}
+
+void nkDeviceCreateRenderPipelineAsync(NkDevice device, const NkRenderPipelineInfo* descriptor, NkCreateRenderPipelineAsyncCallback callback, void* userdata) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(callback);
+
+    NkVkPipelineTask* task = nkVkCreatePipelineTask(device, NkVkPipelineTaskType_Render, userdata);
+    task->callback.render = callback;
+    task->layout = nkVkResolveRenderPipelineLayout(device, descriptor);
+    nkVkHashRenderPipelineParts(device, descriptor, task->layout, task->partHashes);
+    task->hash = nkVkHashPipelineParts(task->partHashes);
+    nkVkInitRenderPipelineDynamicState(device, &task->dynamicState, descriptor);
+
+    // A pipeline that's already built still reports through nkDeviceTick, so callers see the same ordering
+    // whether or not they hit the cache.
+    task->pipeline.render = nkVkFindRenderPipeline(device, task->hash);
+    if (task->pipeline.render) {
+        task->pipeline.render = nkVkGetRenderPipelineVariant(device, task->pipeline.render, &task->dynamicState);
+        nkDestroyPipelineLayout(task->layout);
+        task->layout = NK_NULL;
+        nkVkCompletePipelineTask(task, NkFalse);
+        return;
+    }
+
+    nkVkInitRenderPipelineCreateState(device, &task->state.render, descriptor, task->layout);
+    nkVkSchedulePipelineTask(task);
+}
+
+// The fast-linked pipeline is good enough to draw with straight away. Its optimized replacement is built in
+// the background from the same libraries, then swapped in by nkDeviceTick.
+static void nkVkScheduleRenderPipelineOptimization(NkRenderPipeline renderPipeline, const VkPipeline* libraries) {
+
+    NkVkPipelineTask* task = nkVkCreatePipelineTask(renderPipeline->device, NkVkPipelineTaskType_Optimize, NK_NULL);
+    task->pipeline.render = renderPipeline;
+    task->state.optimize.layout = renderPipeline->layout->layout;
+    task->state.optimize.pipeline = VK_NULL_HANDLE;
+    memcpy(task->state.optimize.libraries, libraries, sizeof(task->state.optimize.libraries));
+
+    nkVkSchedulePipelineTask(task);
+}
+
+NkComputePipeline nkCreateComputePipeline(NkDevice device, const NkComputePipelineInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    NkPipelineLayout layout = nkVkResolveComputePipelineLayout(device, descriptor);
+
+    NkVkComputePipelineCreateState state;
+    nkVkInitComputePipelineCreateState(&state, descriptor, layout);
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    NK_CHECK_VK(nkVkCreateComputePipeline(device, &state.createInfo, &pipeline));
+
+    NkComputePipeline computePipeline = nkVkCreateComputePipelineObject(device, pipeline, layout);
+    nkDestroyPipelineLayout(layout);
+
+    return computePipeline;
+}
+
+void nkDeviceCreateComputePipelineAsync(NkDevice device, const NkComputePipelineInfo* descriptor, NkCreateComputePipelineAsyncCallback callback, void* userdata) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+    NK_ASSERT(callback);
+
+    NkVkPipelineTask* task = nkVkCreatePipelineTask(device, NkVkPipelineTaskType_Compute, userdata);
+    task->callback.compute = callback;
+    task->pipeline.compute = NK_NULL;
+    task->layout = nkVkResolveComputePipelineLayout(device, descriptor);
+
+    nkVkInitComputePipelineCreateState(&task->state.compute, descriptor, task->layout);
+    nkVkSchedulePipelineTask(task);
+}
+
+static void nkVkFinishPipelineTask(NkVkPipelineTask* task, NkCreateReadyPipelineStatus status) {
+
+    if (task->type == NkVkPipelineTaskType_Optimize) {
+        NkRenderPipeline renderPipeline = task->pipeline.render;
+        if (task->result == VK_SUCCESS) {
+            if (status == NkCreateReadyPipelineStatus_Success) {
+                // Command buffers that were recorded with the fast-linked pipeline may still be in flight, so
+                // it lives on until the render pipeline itself is destroyed. Encoders may be reading pipeline on
+                // other threads, so the swap happens under the mutex they read it with.
+                nkMutexLock(&task->device->pipelineMutex);
+                renderPipeline->linkedPipeline = renderPipeline->pipeline;
+                renderPipeline->pipeline = task->state.optimize.pipeline;
+                nkMutexUnlock(&task->device->pipelineMutex);
+            }
+            else {
+                vkDestroyPipeline(task->device->device, task->state.optimize.pipeline, NK_NULL);
+            }
+        }
+        nkDestroyRenderPipeline(renderPipeline);
+        NK_FREE(task);
+        return;
+    }
+
+    const char* message = NK_NULL;
+    if (status == NkCreateReadyPipelineStatus_Success && task->result != VK_SUCCESS) {
+        status = NkCreateReadyPipelineStatus_Error;
+        message = task->type == NkVkPipelineTaskType_Render ?
+            "vkCreateGraphicsPipelines failed" : "vkCreateComputePipelines failed";
+    }
+    else if (status == NkCreateReadyPipelineStatus_DeviceDestroyed) {
+        message = "The device was destroyed before the pipeline was ready";
+    }
+
+    // Only a successful callback hands the pipeline over. Otherwise Neko still owns it and lets it go here.
+    switch (task->type) {
+    case NkVkPipelineTaskType_Render:
+        if (status == NkCreateReadyPipelineStatus_Success) {
+            task->callback.render(status, task->pipeline.render, message, task->userdata);
+        }
+        else {
+            if (task->result == VK_SUCCESS) {
+                nkDestroyRenderPipeline(task->pipeline.render);
+            }
+            task->callback.render(status, NK_NULL, message, task->userdata);
+        }
+        break;
+    case NkVkPipelineTaskType_Compute:
+        if (status == NkCreateReadyPipelineStatus_Success) {
+            task->callback.compute(status, task->pipeline.compute, message, task->userdata);
+        }
+        else {
+            if (task->result == VK_SUCCESS) {
+                nkDestroyComputePipeline(task->pipeline.compute);
+            }
+            task->callback.compute(status, NK_NULL, message, task->userdata);
+        }
+        break;
+    case NkVkPipelineTaskType_Optimize:
+        break;
+    }
+
+    NK_FREE(task);
+}
+
+static NkVkPipelineTask* nkVkTakeCompletedPipelineTasks(NkDevice device) {
+
+    nkMutexLock(&device->taskMutex);
+    NkVkPipelineTask* tasks = device->completedHead;
+    device->completedHead = NK_NULL;
+    device->completedTail = NK_NULL;
+    nkMutexUnlock(&device->taskMutex);
+
+    return tasks;
+}
+
+static VkSamplerAddressMode nkVkAddressMode(NkAddressMode mode) {
+    switch (mode) {
+    case NkAddressMode_MirrorRepeat:
+        return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    case NkAddressMode_ClampToEdge:
+        return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    default:
+        return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    }
+}
+
+static VkFilter nkVkFilter(NkFilterMode mode) {
+    return mode == NkFilterMode_Linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+}
+
+// Hashes what the VkSampler ends up with rather than the info as given, so infos that only differ in ways
+// Vulkan ignores still share a sampler.
+static uint64_t nkVkHashSampler(const NkSamplerInfo* descriptor, NkBool anisotropy, float maxAnisotropy) {
+
+    NkHasher hasher = nkCreateHasher();
+    nkHashU32(&hasher, descriptor->addressModeU);
+    nkHashU32(&hasher, descriptor->addressModeV);
+    nkHashU32(&hasher, descriptor->addressModeW);
+    nkHashU32(&hasher, descriptor->magFilter);
+    nkHashU32(&hasher, descriptor->minFilter);
+    nkHashU32(&hasher, descriptor->mipmapFilter);
+    nkHashFloat(&hasher, descriptor->lodMinClamp + 0.0f); // adding zero turns -0 into +0
+    nkHashFloat(&hasher, descriptor->lodMaxClamp + 0.0f);
+    nkHashU32(&hasher, descriptor->compare);
+    nkHashU32(&hasher, anisotropy);
+    nkHashFloat(&hasher, maxAnisotropy);
+    return nkHasherFinish(&hasher);
+}
+
+static void nkVkDestroySamplers(NkDevice device) {
+
+    // Anything still alive here was leaked by the application.
+    for (uint32_t i = 0; i < device->samplers.capacity; i++) {
+        NkSampler sampler = NK_PTR_CAST(NkSampler, device->samplers.values[i]);
+        if (device->samplers.keys[i] != 0 && sampler) {
+            nkVkReleaseBindlessIndex(device, NkBindlessBinding_Samplers, sampler->bindlessIndex);
+            vkDestroySampler(device->device, sampler->sampler, NK_NULL);
+            NK_FREE(sampler);
+        }
+    }
+    nkHashMapDestroy(&device->samplers);
+    nkMutexDestroy(&device->samplerMutex);
+}
+
+// Vulkan only promises a few thousand live samplers, and most materials ask for one of a handful of them, so
+// equal infos share one VkSampler and its bindless slot.
+NkSampler nkCreateSampler(NkDevice device, const NkSamplerInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    const NkBool anisotropy = (device->samplerAnisotropy && descriptor->maxAnisotropy > 1) ? NkTrue : NkFalse;
+    const float maxAnisotropy = anisotropy ?
+        NK_MIN(NK_CAST(float, descriptor->maxAnisotropy), device->properties.limits.maxSamplerAnisotropy) : 1.0f;
+    const uint64_t hash = nkVkHashSampler(descriptor, anisotropy, maxAnisotropy);
+
+    nkMutexLock(&device->samplerMutex);
+
+    NkSampler sampler = NK_PTR_CAST(NkSampler, nkHashMapFind(&device->samplers, hash));
+    if (sampler) {
+        sampler->refCount++;
+        nkMutexUnlock(&device->samplerMutex);
+        return sampler;
+    }
+
+    VkSamplerCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.magFilter = nkVkFilter(descriptor->magFilter);
+        createInfo.minFilter = nkVkFilter(descriptor->minFilter);
+        createInfo.mipmapMode = descriptor->mipmapFilter == NkFilterMode_Linear ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        createInfo.addressModeU = nkVkAddressMode(descriptor->addressModeU);
+        createInfo.addressModeV = nkVkAddressMode(descriptor->addressModeV);
+        createInfo.addressModeW = nkVkAddressMode(descriptor->addressModeW);
+        createInfo.mipLodBias = 0.0f;
+        createInfo.anisotropyEnable = anisotropy ? VK_TRUE : VK_FALSE;
+        createInfo.maxAnisotropy = maxAnisotropy;
+        createInfo.compareEnable = descriptor->compare != NkCompareFunction_Undefined ? VK_TRUE : VK_FALSE;
+        createInfo.compareOp = nkVkCompareOp(descriptor->compare);
+        createInfo.minLod = descriptor->lodMinClamp;
+        createInfo.maxLod = descriptor->lodMaxClamp;
+        createInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+        createInfo.unnormalizedCoordinates = VK_FALSE;
+    }
+
+    sampler = NK_PTR_CAST(NkSampler, NK_MALLOC(sizeof(struct NkSamplerImpl)));
+    NK_ASSERT(sampler);
+
+    sampler->device = device;
+    sampler->id = nkNextObjectId();
+    sampler->hash = hash;
+    sampler->refCount = 1;
+    sampler->bindlessIndex = NK_VK_BINDLESS_INVALID_INDEX;
+    NK_CHECK_VK(vkCreateSampler(device->device, &createInfo, NK_NULL, &sampler->sampler));
+
+    nkHashMapInsert(&device->samplers, hash, sampler);
+    nkMutexUnlock(&device->samplerMutex);
+
+    return sampler;
+}
+
+static void nkVkCreateShaderModuleHandle(NkDevice device, const uint32_t* code, uint32_t codeSize, VkShaderModule* module) {
+
+    VkShaderModuleCreateInfo shaderInfo;
+    {
+        shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        shaderInfo.pNext = NK_NULL;
+        shaderInfo.flags = 0;
+        shaderInfo.codeSize = codeSize;
+        shaderInfo.pCode = code;
+    }
+
+    NK_CHECK_VK(vkCreateShaderModule(device->device, &shaderInfo, NK_NULL, module));
+}
+
+// Only pipelines that missed the pipeline cache get here when the device passes identifiers. The code isn't
+// needed again once the module exists, so it's let go.
+static VkShaderModule nkVkGetShaderModuleHandle(NkShaderModule shaderModule) {
+
+    NkDevice device = shaderModule->device;
+
+    nkMutexLock(&device->moduleMutex);
+    if (shaderModule->module == VK_NULL_HANDLE) {
+        NK_ASSERT(shaderModule->code);
+        nkVkCreateShaderModuleHandle(device, shaderModule->code, shaderModule->codeSize, &shaderModule->module);
+        NK_FREE(shaderModule->code);
+        shaderModule->code = NK_NULL;
+    }
+    VkShaderModule module = shaderModule->module;
+    nkMutexUnlock(&device->moduleMutex);
+
+    return module;
+}
+
+static void nkVkFreeShaderModule(NkShaderModule shaderModule) {
+
+    if (shaderModule->module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(shaderModule->device->device, shaderModule->module, NK_NULL);
+    }
+    NK_FREE(shaderModule->code);
+    nkVkDestroyShaderReflection(&shaderModule->reflection);
+    NK_FREE(shaderModule);
+}
+
+static void nkVkDestroyShaderModules(NkDevice device) {
+
+    // Anything still alive here was leaked by the application.
+    for (uint32_t i = 0; i < device->shaderModules.capacity; i++) {
+        NkShaderModule shaderModule = NK_PTR_CAST(NkShaderModule, device->shaderModules.values[i]);
+        if (device->shaderModules.keys[i] != 0 && shaderModule) {
+            nkVkFreeShaderModule(shaderModule);
+        }
+    }
+    nkHashMapDestroy(&device->shaderModules);
+    nkMutexDestroy(&device->moduleMutex);
+}
+
+NkShaderModule nkCreateShaderModule(NkDevice device, const NkShaderModuleInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    // SPIR-V code is passed to Vulkan as an array of uint32_t. Neko's interface is generalised so it takes IR
+    // as a void pointer. Unfortunately that means that someone could feasibly feed it a byte buffer that is not
+    // aligned correctly. This is unlikely to happen as I think most general allocators will make sure that the
+    // data satisfies the worst-case alignment requirements, but just in case, we're just making sure the buffer
+    // is suitably aligned before we cast the pointer to a uint32_t.
+    NK_ASSERT(NK_IS_PTR_ALIGNED(descriptor->source, NK_ALIGN_OF(uint32_t)));
+
+    const uint32_t* code = NK_PTR_CAST(const uint32_t*, descriptor->source);
+    const uint64_t hash = nkHashShaderCode(code, descriptor->size);
+
+    nkMutexLock(&device->moduleMutex);
+
+    // Material systems hand the same few shaders over thousands of times, so identical code shares one module.
+    NkShaderModule shaderModule = NK_PTR_CAST(NkShaderModule, nkHashMapFind(&device->shaderModules, hash));
+    if (shaderModule) {
+        shaderModule->refCount++;
+        nkMutexUnlock(&device->moduleMutex);
+        return shaderModule;
+    }
+
+    shaderModule = NK_PTR_CAST(NkShaderModule, NK_MALLOC(sizeof(struct NkShaderModuleImpl)));
+    NK_ASSERT(shaderModule);
+
+    shaderModule->device = device;
+    shaderModule->module = VK_NULL_HANDLE;
+    shaderModule->hash = hash;
+    shaderModule->refCount = 1;
+    shaderModule->code = NK_NULL;
+    shaderModule->codeSize = descriptor->size;
+
+    if (device->shaderModuleIdentifiers) {
+        shaderModule->code = NK_PTR_CAST(uint32_t*, NK_MALLOC(descriptor->size));
+        NK_ASSERT(shaderModule->code);
+        memcpy(shaderModule->code, code, descriptor->size);
+
+        VkShaderModuleCreateInfo shaderInfo;
+        {
+            shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            shaderInfo.pNext = NK_NULL;
+            shaderInfo.flags = 0;
+            shaderInfo.codeSize = descriptor->size;
+            shaderInfo.pCode = code;
+        }
+
+        VkShaderModuleIdentifierEXT* identifier = &shaderModule->identifier.identifier;
+        identifier->sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+        identifier->pNext = NK_NULL;
+        device->getShaderModuleCreateInfoIdentifier(device->device, &shaderInfo, identifier);
+
+        VkPipelineShaderStageModuleIdentifierCreateInfoEXT* identifierInfo = &shaderModule->identifier.info;
+        {
+            identifierInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT;
+            identifierInfo->pNext = NK_NULL;
+            identifierInfo->identifierSize = identifier->identifierSize;
+            identifierInfo->pIdentifier = identifier->identifier;
+        }
+        shaderModule->identifier.module = shaderModule;
+    }
+    else {
+        nkVkCreateShaderModuleHandle(device, code, descriptor->size, &shaderModule->module);
+    }
+
+    nkVkReflectShader(code, descriptor->size / sizeof(uint32_t), &shaderModule->reflection);
+
+    nkHashMapInsert(&device->shaderModules, hash, shaderModule);
+
+    nkMutexUnlock(&device->moduleMutex);
+
+    return shaderModule;
+}
+
+void nkDestroyShaderModule(NkShaderModule shaderModule) {
+
+    NK_ASSERT(shaderModule);
+
+    NkDevice device = shaderModule->device;
+
+    nkMutexLock(&device->moduleMutex);
+    NK_ASSERT(shaderModule->refCount > 0);
+
+    if (--shaderModule->refCount > 0) {
+        nkMutexUnlock(&device->moduleMutex);
+        return;
+    }
+
+    nkHashMapRemove(&device->shaderModules, shaderModule->hash);
+    nkMutexUnlock(&device->moduleMutex);
+
+    nkVkFreeShaderModule(shaderModule);
+}
+
+typedef struct NkVkSurfaceSupportDetails {
+    VkSurfaceCapabilitiesKHR capabilities;
+    VkSurfaceFormatKHR* formats;
+    uint32_t formatCount;
+    VkPresentModeKHR* presentModes;
+    uint32_t presentModeCount;
+} NkVkSurfaceSupportDetails;
+
+static NkVkSurfaceSupportDetails nkVkCreateSurfaceSupportDetails(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+
+    NK_ASSERT_VK_HANDLE(physicalDevice);
+    NK_ASSERT_VK_HANDLE(surface);
+
+    NkVkSurfaceSupportDetails details;
+    {
+        details.formats = NK_NULL;
+        details.formatCount = 0;
+        details.presentModes = NK_NULL;
+        details.presentModeCount = 0;
+    }
+
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &details.capabilities);
+
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &details.formatCount, NK_NULL);
+
+    if (details.formatCount != 0) {
+        details.formats = NK_PTR_CAST(VkSurfaceFormatKHR*, NK_MALLOC(details.formatCount * sizeof(VkSurfaceFormatKHR)));
+        NK_ASSERT(details.formats);
+
+        vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &details.formatCount, details.formats);
+    }
+
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &details.presentModeCount, NK_NULL);
+
+    if (details.presentModeCount != 0) {
+        details.presentModes = NK_PTR_CAST(VkPresentModeKHR*, NK_MALLOC(details.presentModeCount * sizeof(VkPresentModeKHR)));
+        NK_ASSERT(details.presentModes);
+
+        vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &details.presentModeCount, details.presentModes);
+    }
+
+    return details;
+}
+
+static NkVkSurfaceSupportDetails nkVkDestroySurfaceSupportDetails(NkVkSurfaceSupportDetails* details) {
+
+    NK_ASSERT(details);
+    NK_FREE(details->formats);
+    NK_FREE(details->presentModes);
+}
+
+static VkPresentModeKHR nkVkChooseSwapPresentMode(VkPresentModeKHR const* availablePresentModes, uint32_t availablePresentModeCount) {
+
+    NK_ASSERT(availablePresentModes);
+    NK_ASSERT(availablePresentModeCount != 0);
+
+    for (size_t i = 0; i < availablePresentModeCount - 1; i++) {
+        if (availablePresentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
+            return availablePresentModes[i];
+        }
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static VkSurfaceFormatKHR nkVkChooseSwapSurfaceFormat(VkSurfaceFormatKHR const* availableFormats, uint32_t availableFormatCount) {
+
+    NK_ASSERT(availableFormats);
+    NK_ASSERT(availableFormatCount != 0);
+
+    for (size_t i = 0; i < availableFormatCount - 1; i++) {
+        if (availableFormats[i].format == VK_FORMAT_B8G8R8A8_SRGB && availableFormats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return availableFormats[i];
+        }
+    }
+
+    return availableFormats[0];
+}
+
+static VkExtent2D nkVkChooseSwapExtent(VkSurfaceCapabilitiesKHR const* capabilities, const NkSwapChainInfo* info) {
+
+    NK_ASSERT(capabilities);
+    NK_ASSERT(info);
+
+    if (capabilities->currentExtent.width != UINT32_MAX) {
+        return capabilities->currentExtent;
+    } else {
+        VkExtent2D actualExtent = {
+            info->width,
+            info->height
+        };
+
+        actualExtent.width
+            = NK_MAX(capabilities->minImageExtent.width, NK_MIN(capabilities->maxImageExtent.width, actualExtent.width));
+
+        actualExtent.height
+            = NK_MAX(capabilities->minImageExtent.height, NK_MIN(capabilities->maxImageExtent.height, actualExtent.height));
+
+        return actualExtent;
+    }
+}
+
+static NkVkQueueFamilyIndices nkVkFindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
+
+    NK_ASSERT_VK_HANDLE(device);
+    NK_ASSERT_VK_HANDLE(surface);
+
+    NkVkQueueFamilyIndices indices;
+    {
+        indices.graphicsFamily = UINT32_MAX;
+        indices.presentFamily = UINT32_MAX;
+    }
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NK_NULL);
+
+    VkQueueFamilyProperties* queueFamilies = NK_PTR_CAST(VkQueueFamilyProperties*, NK_MALLOC(sizeof(VkQueueFamilyProperties) * queueFamilyCount));
+    NK_ASSERT(queueFamilies);
+
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
+
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+
+        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            indices.graphicsFamily = i;
+        }
+
+        if (surface != VK_NULL_HANDLE) {
+
+            VkBool32 presentSupport = VK_FALSE;
+            NK_CHECK_VK(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport));
+
+            if (presentSupport) {
+                indices.presentFamily = i;
+            }
+        }
+
+        if (indices.graphicsFamily != UINT32_MAX &&
+            indices.presentFamily != UINT32_MAX) {
+            break;
+        }
+    }
+
+    NK_FREE(queueFamilies);
+
+    return indices;
+}
+
+NkSwapChain nkCreateSwapChain(NkDevice device, NkSurface surface, const NkSwapChainInfo* info) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(surface);
+    NK_ASSERT(info);
+
+    NkSwapChain swapChain = NK_PTR_CAST(NkSwapChain, NK_MALLOC(sizeof(struct NkSwapChainImpl)));
+    NK_ASSERT(swapChain);
+
+    swapChain->currentFrame = 0;
+
+    NkVkSurfaceSupportDetails surfaceSupport = nkVkCreateSurfaceSupportDetails(device->physicalDevice, surface->surface);
+    VkSurfaceFormatKHR surfaceFormat = nkVkChooseSwapSurfaceFormat(surfaceSupport.formats, surfaceSupport.formatCount);
+    VkPresentModeKHR presentMode = nkVkChooseSwapPresentMode(surfaceSupport.presentModes, surfaceSupport.presentModeCount);
+    VkExtent2D extent = nkVkChooseSwapExtent(&surfaceSupport.capabilities, info);
+
+    uint32_t imageCount = surfaceSupport.capabilities.minImageCount + 1;
+    if (surfaceSupport.capabilities.maxImageCount > 0 && imageCount > surfaceSupport.capabilities.maxImageCount) {
+        imageCount = surfaceSupport.capabilities.maxImageCount;
+    }
+
+    NkVkQueueFamilyIndices indices =
+        nkVkFindQueueFamilies(device->physicalDevice, surface->surface);
+
+    uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
+
+    VkSwapchainCreateInfoKHR createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        createInfo.flags = 0;
+        createInfo.pNext = NK_NULL;
+        createInfo.surface = surface->surface;
+        createInfo.minImageCount = imageCount;
+        createInfo.imageFormat = surfaceFormat.format;
+        createInfo.imageColorSpace = surfaceFormat.colorSpace;
+        createInfo.imageExtent = extent;
+        createInfo.imageArrayLayers = 1;
+        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+        if (indices.graphicsFamily != indices.presentFamily) {
+            createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+            createInfo.queueFamilyIndexCount = 2;
+            createInfo.pQueueFamilyIndices = queueFamilyIndices;
+        }
+        else {
+            createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            createInfo.queueFamilyIndexCount = 0;
+            createInfo.pQueueFamilyIndices = NK_NULL;
+        }
+
+        createInfo.preTransform = surfaceSupport.capabilities.currentTransform;
+        createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        createInfo.presentMode = presentMode;
+        createInfo.clipped = VK_TRUE;
+
+        createInfo.oldSwapchain = VK_NULL_HANDLE;
+    }
+    NK_CHECK_VK(vkCreateSwapchainKHR(device->device, &createInfo, NK_NULL, &swapChain->swapChain));
+
+    swapChain->device = device->device;
+
+    NK_CHECK_VK(vkGetSwapchainImagesKHR(device->device, swapChain->swapChain, &swapChain->swapChainImageCount, NK_NULL));
+
+    swapChain->swapChainImages = NK_PTR_CAST(VkImage*, NK_MALLOC(sizeof(VkImage) * swapChain->swapChainImageCount));
+    NK_ASSERT(swapChain->swapChainImages);
+
+    NK_CHECK_VK(vkGetSwapchainImagesKHR(device->device, swapChain->swapChain, &swapChain->swapChainImageCount, swapChain->swapChainImages));
+
+    nkVkDestroySurfaceSupportDetails(&surfaceSupport);
+
+    swapChain->swapChainTextureViews = NK_PTR_CAST(struct NkTextureViewImpl*, NK_MALLOC(sizeof(struct NkTextureViewImpl) * swapChain->swapChainImageCount));
+    NK_ASSERT(swapChain->swapChainTextureViews);
+
+    for (size_t i = 0; i < swapChain->swapChainImageCount; i++) {
+        VkImageViewCreateInfo imageViewCreateInfo;
+        {
+            imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            imageViewCreateInfo.flags = 0;
+            imageViewCreateInfo.pNext = NK_NULL;
+            imageViewCreateInfo.image = swapChain->swapChainImages[i];
+            imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            imageViewCreateInfo.format = surfaceFormat.format;
+            imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+            imageViewCreateInfo.subresourceRange.levelCount = 1;
+            imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+            imageViewCreateInfo.subresourceRange.layerCount = 1;
+        }
+
+        NkTextureView textureView = swapChain->swapChainTextureViews + i;
+        textureView->device = device;
+        textureView->texture = NK_NULL;
+        textureView->refCount = 1;
+        textureView->image = swapChain->swapChainImages[i];
+        textureView->id = nkNextObjectId();
+        textureView->format = surfaceFormat.format;
+        textureView->extent = extent;
+        textureView->sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        textureView->subresourceRange = imageViewCreateInfo.subresourceRange;
+        textureView->presentable = NkTrue;
+        textureView->bindlessIndex = NK_VK_BINDLESS_INVALID_INDEX;
+        NK_CHECK_VK(vkCreateImageView(device->device, &imageViewCreateInfo, NK_NULL, &textureView->imageView));
+    }
+
+    return swapChain;
 }
 
-static VkPrimitiveTopology nkVkPrimitiveTopology(NkPrimitiveTopology topology) {
-    switch (topology) {
-    case NkPrimitiveTopology_PointList:
-        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
-    case NkPrimitiveTopology_LineList:
-        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
-    case NkPrimitiveTopology_LineStrip:
-        return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
-    case NkPrimitiveTopology_TriangleList:
-        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    case NkPrimitiveTopology_TriangleStrip:
-        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+static VkImageUsageFlags nkVkImageUsage(NkTextureUsageFlags usage, VkFormat format) {
+
+    VkImageUsageFlags flags = 0;
+    if (usage & NkTextureUsage_CopySrc) {
+        flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     }
-    return VK_PRIMITIVE_TOPOLOGY_MAX_ENUM;
+    if (usage & NkTextureUsage_CopyDst) {
+        flags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    if (usage & NkTextureUsage_Sampled) {
+        flags |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+    if (usage & NkTextureUsage_Storage) {
+        flags |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+    if (usage & NkTextureUsage_RenderAttachment) {
+        flags |= (nkVkFormatHasDepth(format) || nkVkFormatHasStencil(format)) ?
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    }
+    return flags;
+}
+
+static VkImageType nkVkImageType(NkTextureDimension dimension) {
+    switch (dimension) {
+    case NkTextureDimension_1D:
+        return VK_IMAGE_TYPE_1D;
+    case NkTextureDimension_2D:
+        return VK_IMAGE_TYPE_2D;
+    case NkTextureDimension_3D:
+        return VK_IMAGE_TYPE_3D;
+    default:
+        return VK_IMAGE_TYPE_2D;
+    }
+}
+
+// The depth of the size is the layer count for 1D and 2D textures, and the depth for 3D ones.
+NkTexture nkCreateTexture(NkDevice device, const NkTextureInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    NkTexture texture = NK_PTR_CAST(NkTexture, NK_MALLOC(sizeof(struct NkTextureImpl)));
+    NK_ASSERT(texture);
+
+    const NkBool volume = descriptor->dimension == NkTextureDimension_3D ? NkTrue : NkFalse;
+
+    texture->device = device;
+    texture->id = nkNextObjectId();
+    texture->usage = descriptor->usage;
+    texture->dimension = descriptor->dimension;
+    texture->format = descriptor->format;
+    texture->imageFormat = nkVkTextureFormat(descriptor->format);
+    texture->size.width = descriptor->size.width;
+    texture->size.height = NK_MAX(descriptor->size.height, 1);
+    texture->size.depth = volume ? NK_MAX(descriptor->size.depth, 1) : 1;
+    texture->mipLevelCount = NK_MAX(descriptor->mipLevelCount, 1);
+    texture->arrayLayerCount = volume ? 1 : NK_MAX(descriptor->size.depth, 1);
+    texture->sampleCount = nkVkSampleCount(descriptor->sampleCount);
+    texture->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    nkMutexInit(&texture->viewMutex);
+    texture->views = texture->inlineViews;
+    texture->viewCount = 0;
+    texture->viewCapacity = NK_VK_INLINE_TEXTURE_VIEWS;
+
+    // Any square texture with six or more layers might be viewed as a cube, and Vulkan wants to know up front.
+    // Multisampled images can't be cube compatible.
+    const NkBool cube = (descriptor->dimension == NkTextureDimension_2D && texture->arrayLayerCount >= 6 &&
+        texture->size.width == texture->size.height && texture->sampleCount == VK_SAMPLE_COUNT_1_BIT) ? NkTrue : NkFalse;
+
+    VkImageCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+        createInfo.imageType = nkVkImageType(descriptor->dimension);
+        createInfo.format = texture->imageFormat;
+        createInfo.extent.width = texture->size.width;
+        createInfo.extent.height = texture->size.height;
+        createInfo.extent.depth = texture->size.depth;
+        createInfo.mipLevels = texture->mipLevelCount;
+        createInfo.arrayLayers = texture->arrayLayerCount;
+        createInfo.samples = texture->sampleCount;
+        createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        createInfo.usage = nkVkImageUsage(descriptor->usage, texture->imageFormat);
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.queueFamilyIndexCount = 0;
+        createInfo.pQueueFamilyIndices = NK_NULL;
+        createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    NK_CHECK_VK(vkCreateImage(device->device, &createInfo, NK_NULL, &texture->image));
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device->device, texture->image, &requirements);
+
+    VkMemoryAllocateInfo allocateInfo;
+    {
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.pNext = NK_NULL;
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = nkVkFindMemoryType(device, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    }
+
+    NK_CHECK_VK(vkAllocateMemory(device->device, &allocateInfo, NK_NULL, &texture->memory));
+    NK_CHECK_VK(vkBindImageMemory(device->device, texture->image, texture->memory, 0));
+
+    return texture;
+}
+
+NkBindGroup nkDeviceGetBindlessBindGroup(NkDevice device) {
+    NK_ASSERT(device);
+    return device->bindless ? &device->bindlessBindGroup : NK_NULL;
+}
+
+NkBindGroupLayout nkDeviceGetBindlessBindGroupLayout(NkDevice device) {
+    NK_ASSERT(device);
+    return device->bindless ? nkVkRetainBindGroupLayout(device->bindlessLayout) : NK_NULL;
+}
+
+NkBool nkDeviceGetBufferDeviceAddressSupport(NkDevice device) {
+    NK_ASSERT(device);
+    return device->bufferDeviceAddress;
+}
+
+NkQueue nkDeviceGetDefaultQueue(NkDevice device) {
+    return &device->queue;
+}
+
+NkDynamicStateFlags nkDeviceGetDynamicState(NkDevice device) {
+    NK_ASSERT(device);
+    return device->dynamicState;
+}
+
+void nkDeviceTick(NkDevice device) {
+
+    NK_ASSERT(device);
+
+    NkVkPipelineTask* task = nkVkTakeCompletedPipelineTasks(device);
+    while (task) {
+        NkVkPipelineTask* next = task->next;
+        nkVkFinishPipelineTask(task, NkCreateReadyPipelineStatus_Success);
+        task = next;
+    }
+
+    nkVkRetireLevelUploads(&device->queue);
+    nkVkAdvanceBindGroupFrame(device);
+}
+
+// Waits for every background compile and file write to land, then tells the callers that never got their
+// pipeline that they aren't going to.
+static void nkVkDestroyPipelineTasks(NkDevice device) {
+
+    nkMutexLock(&device->taskMutex);
+    while (device->pendingTaskCount > 0) {
+        nkConditionWait(&device->tasksIdle, &device->taskMutex);
+    }
+    nkMutexUnlock(&device->taskMutex);
+
+    NkVkPipelineTask* task = nkVkTakeCompletedPipelineTasks(device);
+    while (task) {
+        NkVkPipelineTask* next = task->next;
+        nkVkFinishPipelineTask(task, NkCreateReadyPipelineStatus_DeviceDestroyed);
+        task = next;
+    }
+
+    if (device->threadPool) {
+        nkDestroyThreadPool(device->threadPool);
+    }
+    nkConditionDestroy(&device->tasksIdle);
+    nkMutexDestroy(&device->taskMutex);
+}
+
+static void nkVkDestroyPipelineLibraries(NkDevice device) {
+
+    for (uint32_t i = 0; i < device->pipelineLibraries.capacity; i++) {
+        NkVkPipelineLibrary* library = NK_PTR_CAST(NkVkPipelineLibrary*, device->pipelineLibraries.values[i]);
+        if (device->pipelineLibraries.keys[i] != 0 && library) {
+            vkDestroyPipeline(device->device, library->pipeline, NK_NULL);
+            NK_FREE(library);
+        }
+    }
+    nkHashMapDestroy(&device->pipelineLibraries);
+}
+
+static void nkVkInitDeviceTasks(NkDevice device, const NkDeviceInfo* descriptor) {
+
+    nkMutexInit(&device->taskMutex);
+    nkConditionInit(&device->tasksIdle);
+    device->pendingTaskCount = 0;
+    device->completedHead = NK_NULL;
+    device->completedTail = NK_NULL;
+
+    device->scheduleTask = descriptor->scheduleTask;
+    device->scheduleTaskUserdata = descriptor->scheduleTaskUserdata;
+    device->pipelineBatchSize = descriptor->pipelineBatchSize;
+    device->threadPool = NK_NULL;
+
+    if (!device->scheduleTask) {
+        // Leave a core for the thread that's recording frames.
+        const uint32_t processorCount = nkGetProcessorCount();
+        const uint32_t threadCount = descriptor->workerThreadCount > 0 ?
+            descriptor->workerThreadCount : NK_MAX(1u, processorCount - 1);
+        device->threadPool = nkCreateThreadPool(threadCount);
+    }
+}
+
+// Neko prefixes the driver's pipeline cache blob with its own header. The header Vulkan puts in front of the
+// data doesn't record the driver version, and some drivers behave badly when handed a cache from a different
+// driver build, so anything that doesn't match the current device exactly is rejected before it reaches the
+// driver. The payload starts on a 16 byte boundary, so a mapped cache file can be handed to the driver in place.
+
+#define NK_VK_PIPELINE_CACHE_MAGIC 0x43504B4E // "NKPC"
+#define NK_VK_PIPELINE_CACHE_VERSION 1
+
+typedef struct NkVkPipelineCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint32_t headerSize;
+    uint64_t dataSize;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+} NkVkPipelineCacheHeader;
+
+static void nkVkInitPipelineCacheHeader(NkDevice device, NkVkPipelineCacheHeader* header, uint64_t dataSize) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(header);
+
+    header->magic = NK_VK_PIPELINE_CACHE_MAGIC;
+    header->version = NK_VK_PIPELINE_CACHE_VERSION;
+    header->vendorID = device->properties.vendorID;
+    header->deviceID = device->properties.deviceID;
+    header->driverVersion = device->properties.driverVersion;
+    header->headerSize = sizeof(NkVkPipelineCacheHeader);
+    header->dataSize = dataSize;
+    memcpy(header->pipelineCacheUUID, device->properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Returns a pointer to the driver payload inside the blob, or NK_NULL if the blob can't be used on this device.
+static const void* nkVkValidatePipelineCache(NkDevice device, const void* data, size_t size, size_t* outPayloadSize) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(outPayloadSize);
+
+    *outPayloadSize = 0;
+
+    if (data == NK_NULL || size < sizeof(NkVkPipelineCacheHeader) || !NK_IS_PTR_ALIGNED(data, NK_ALIGN_OF(NkVkPipelineCacheHeader))) {
+        return NK_NULL;
+    }
+
+    NkVkPipelineCacheHeader expected;
+    nkVkInitPipelineCacheHeader(device, &expected, size - sizeof(NkVkPipelineCacheHeader));
+
+    // The header has no padding, so the whole thing can be compared in one go. Comparing dataSize as well
+    // catches files that were truncated by a crash while they were being written.
+    if (memcmp(data, &expected, sizeof(NkVkPipelineCacheHeader)) != 0) {
+        NK_LOG("Neko: discarding pipeline cache created for a different device or driver at %s:%d.\n");
+        return NK_NULL;
+    }
+
+    *outPayloadSize = NK_CAST(size_t, expected.dataSize);
+    return NK_PTR_CAST(const uint8_t*, data) + sizeof(NkVkPipelineCacheHeader);
+}
+
+static void nkVkCreatePipelineCache(NkDevice device, const NkDeviceInfo* descriptor) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(descriptor);
+
+    NkMappedFile mappedFile;
+    {
+        mappedFile.data = NK_NULL;
+        mappedFile.size = 0;
+    }
+
+    const void* initialData = NK_NULL;
+    size_t initialDataSize = 0;
+
+    if (descriptor->pipelineCacheData) {
+        initialData = nkVkValidatePipelineCache(device, descriptor->pipelineCacheData, descriptor->pipelineCacheSize, &initialDataSize);
+    }
+    else if (descriptor->pipelineCachePath && nkMapFile(descriptor->pipelineCachePath, &mappedFile)) {
+        initialData = nkVkValidatePipelineCache(device, mappedFile.data, mappedFile.size, &initialDataSize);
+    }
+
+    VkPipelineCacheCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.initialDataSize = initialDataSize;
+        createInfo.pInitialData = initialData;
+    }
+
+    NK_CHECK_VK(vkCreatePipelineCache(device->device, &createInfo, NK_NULL, &device->pipelineCache));
+
+    // The driver has consumed the initial data by now, so the file can be unmapped straight away.
+    // This also means it can be overwritten when the device is destroyed.
+    nkUnmapFile(&mappedFile);
+
+    device->pipelineCachePath = NK_NULL;
+    if (descriptor->pipelineCachePath) {
+        const size_t pathSize = strlen(descriptor->pipelineCachePath) + 1;
+        device->pipelineCachePath = NK_PTR_CAST(char*, NK_MALLOC(pathSize));
+        NK_ASSERT(device->pipelineCachePath);
+        memcpy(device->pipelineCachePath, descriptor->pipelineCachePath, pathSize);
+    }
+}
+
+NkBool nkDeviceGetPipelineCacheData(NkDevice device, size_t* dataSize, void* data) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(dataSize);
+
+    size_t payloadSize = 0;
+    NK_CHECK_VK(vkGetPipelineCacheData(device->device, device->pipelineCache, &payloadSize, NK_NULL));
+
+    if (data == NK_NULL) {
+        *dataSize = sizeof(NkVkPipelineCacheHeader) + payloadSize;
+        return NkTrue;
+    }
+
+    NK_ASSERT(NK_IS_PTR_ALIGNED(data, NK_ALIGN_OF(NkVkPipelineCacheHeader)));
+
+    if (*dataSize < sizeof(NkVkPipelineCacheHeader)) {
+        *dataSize = 0;
+        return NkFalse;
+    }
+
+    payloadSize = *dataSize - sizeof(NkVkPipelineCacheHeader);
+    uint8_t* payload = NK_PTR_CAST(uint8_t*, data) + sizeof(NkVkPipelineCacheHeader);
+
+    // VK_INCOMPLETE means the cache grew since the size was queried, e.g. because a pipeline was compiled
+    // on another thread in the meantime. A truncated cache is useless, so report failure and let the caller retry.
+    VkResult result = vkGetPipelineCacheData(device->device, device->pipelineCache, &payloadSize, payload);
+    if (result == VK_INCOMPLETE) {
+        *dataSize = 0;
+        return NkFalse;
+    }
+    NK_CHECK_VK(result);
+
+    nkVkInitPipelineCacheHeader(device, NK_PTR_CAST(NkVkPipelineCacheHeader*, data), payloadSize);
+    *dataSize = sizeof(NkVkPipelineCacheHeader) + payloadSize;
+
+    return NkTrue;
+}
+
+static void nkVkSavePipelineCache(NkDevice device) {
+
+    NK_ASSERT(device);
+    NK_ASSERT(device->pipelineCachePath);
+
+    size_t dataSize = 0;
+    void* data = NK_NULL;
+    NkBool complete = NkFalse;
+
+    while (!complete) {
+        NK_FREE(data);
+        nkDeviceGetPipelineCacheData(device, &dataSize, NK_NULL);
+        data = NK_MALLOC(dataSize);
+        NK_ASSERT(data);
+        complete = nkDeviceGetPipelineCacheData(device, &dataSize, data);
+    }
+
+    if (!nkWriteFile(device->pipelineCachePath, data, dataSize)) {
+        NK_LOG("Neko: failed to write pipeline cache at %s:%d.\n");
+    }
+
+    NK_FREE(data);
 }
 
-VkBool32 nkVkShouldEnablePrimitiveRestart(NkPrimitiveTopology topology) {
-    // Primitive restart is always enabled in Neko (due to Metal always enabling primitive restart)
-    // but Vulkan validation rules ask that primitive restart be only enabled on primitive topologies
-    // that support restarting.
+NkBool nkDevicePopErrorScope(NkDevice device, NkErrorCallback callback, void* userdata) {
+
+}
+
+void nkDevicePushErrorScope(NkDevice device, NkErrorFilter filter) {
+
+}
+
+void nkDeviceSetDeviceLostCallback(NkDevice device, NkDeviceLostCallback callback, void* userdata) {
+
+}
+
+void nkDeviceSetUncapturedErrorCallback(NkDevice device, NkErrorCallback callback, void* userdata) {
+
+}
+
+// Methods of Fence
+void nkDeviceFence(NkFence fence) {
+
+}
+
+uint64_t nkFenceGetCompletedValue(NkFence fence) {
+
+}
+
+void nkFenceOnCompletion(NkFence fence, uint64_t value, NkFenceOnCompletionCallback callback, void* userdata) {
+
+}
+
+// Methods of Instance
+void nkDestroyInstance(NkInstance instance) {
+
+    NK_ASSERT(instance);
 
-    switch (topology) {
-    case NkPrimitiveTopology_PointList:
-    case NkPrimitiveTopology_LineList:
-    case NkPrimitiveTopology_TriangleList:
-        return NkFalse;
-    case NkPrimitiveTopology_LineStrip:
-    case NkPrimitiveTopology_TriangleStrip:
-        return NkTrue;
+    if (NkEnableValidationLayers) {
+        nkVkDestroyDebugUtilsMessengerEXT(instance->instance, instance->debugMessenger, NK_NULL);
     }
+    vkDestroyInstance(instance->instance, NK_NULL);
+    NK_FREE(instance);
 }
 
-NkRenderPipeline nkCreateRenderPipeline(NkDevice device, const NkRenderPipelineInfo* descriptor) {
+NkSurface nkCreateSurface(NkInstance instance, const NkSurfaceInfo* descriptor) {
 
-    NK_ASSERT(device);
+    NK_ASSERT(instance);
     NK_ASSERT(descriptor);
 
-    NkRenderPipeline renderPipeline =
-        NK_PTR_CAST(NkRenderPipeline, NK_MALLOC(sizeof(struct NkRenderPipelineImpl)));
-    NK_ASSERT(renderPipeline);
+    NkSurface surface = NK_PTR_CAST(NkSurface, NK_MALLOC(sizeof(struct NkSurfaceImpl)));
+    NK_ASSERT(surface);
 
-    VkGraphicsPipelineCreateInfo createInfo;
+    surface->instance = instance->instance;
+
+#if defined(_WIN32)
+    VkWin32SurfaceCreateInfoKHR createInfo;
     {
-        createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        createInfo.pNext = NULL;
+        createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+        createInfo.pNext = NK_NULL;
         createInfo.flags = 0;
+        createInfo.hwnd = descriptor->native.hwnd;
+        createInfo.hinstance = descriptor->native.hinstance;
+    }
+    NK_CHECK_VK(vkCreateWin32SurfaceKHR(instance->instance, &createInfo, NK_NULL, &surface->surface));
+#endif
 
-        createInfo.pTessellationState = NULL;
-        createInfo.pViewportState = NULL;
+    return surface;
+}
 
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo;
-        {
-            vertShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-            vertShaderStageInfo.pNext  = NULL;
-            vertShaderStageInfo.flags  = 0;
-            vertShaderStageInfo.stage  = VK_SHADER_STAGE_VERTEX_BIT;
-            vertShaderStageInfo.module = descriptor->vertexStage.module->module;
-            vertShaderStageInfo.pName  = descriptor->vertexStage.entryPoint;
-            vertShaderStageInfo.pSpecializationInfo = NULL;
-        }
+static const char* NkVkDeviceEnabledExtensionNames[] = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+};
 
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo;
-        {
-            fragShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-            fragShaderStageInfo.pNext  = NULL;
-            fragShaderStageInfo.flags  = 0;
-            fragShaderStageInfo.stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
-            fragShaderStageInfo.module = descriptor->fragmentStage.module->module;
-            fragShaderStageInfo.pName  = descriptor->fragmentStage.entryPoint;
-            fragShaderStageInfo.pSpecializationInfo = NULL;
-        }
+static const uint32_t NkVkDeviceEnabledExtensionCount
+    = sizeof(NkVkDeviceEnabledExtensionNames) / sizeof(NkVkDeviceEnabledExtensionNames[0]);
+
+static NkBool nkVkCheckDeviceExtensionProperties(VkExtensionProperties* properties, uint32_t propertyCount) {
+
+    NK_ASSERT(properties);
+    NK_ASSERT(propertyCount != 0);
 
-        VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+    for (uint32_t i = 0; i < NkVkDeviceEnabledExtensionCount; i++) {
+        uint32_t enabledExtensionCount = 0;
+        for (uint32_t j = 0; j < propertyCount - 1; j++) {
+            if (strcmp(NkVkDeviceEnabledExtensionNames[i], properties[j].extensionName) == 0) {
+                ++enabledExtensionCount;
+            }
+            if (enabledExtensionCount == NkVkDeviceEnabledExtensionCount) {
+                return NkTrue;
+            }
+        }
+    }
+    return NkFalse;
+}
 
-        createInfo.pStages    = shaderStages;
-        createInfo.stageCount = 2;
+static NkBool nkVkIsPhysicalDeviceSuitable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
 
-        // TODO: set up default vertex state info when user doesn't supply a custom one.
-        // For now just assert it's not NULL.
-        NK_ASSERT(descriptor->vertexState);
+    NK_ASSERT_VK_HANDLE(physicalDevice);
+    NK_ASSERT_VK_HANDLE(surface);
 
-        uint32_t bindingCount = 0;
-        VkVertexInputBindingDescription bindings[NK_MAX_BUFFERS];
+    uint32_t propertyCount = 0;
 
-        uint32_t attributeCount = 0;
-        VkVertexInputAttributeDescription attributes[NK_MAX_ATTRIBUTES];
+    NK_CHECK_VK(vkEnumerateDeviceExtensionProperties(physicalDevice, NK_NULL, &propertyCount, NK_NULL));
 
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo;
-        {
-            for (uint32_t slot = 0; slot < descriptor->vertexState->vertexBufferCount; slot++) {
+    VkExtensionProperties* properties = NK_PTR_CAST(VkExtensionProperties*, NK_MALLOC(sizeof(VkExtensionProperties) * propertyCount));
+    NK_ASSERT(properties);
 
-                NkVertexBufferLayoutInfo* vertexBufferLayoutInfo =
-                    descriptor->vertexState->vertexBuffers + slot;
+    NK_CHECK_VK(vkEnumerateDeviceExtensionProperties(physicalDevice, NK_NULL, &propertyCount, properties));
 
-                if (vertexBufferLayoutInfo->attributeCount == 0) {
-                    continue;
-                }
+    NkVkQueueFamilyIndices queueFamilyIndices = nkVkFindQueueFamilies(physicalDevice, surface);
 
-                VkVertexInputBindingDescription* bindingDesc = bindings + bindingCount;
-                bindingDesc->binding = slot;
-                bindingDesc->stride = vertexBufferLayoutInfo->arrayStride;
-                bindingDesc->inputRate = nkVkInputRate(vertexBufferLayoutInfo->stepMode);
-                bindingCount++;
+    NkBool indicesIsComplete = queueFamilyIndices.graphicsFamily != UINT32_MAX &&
+                               queueFamilyIndices.presentFamily != UINT32_MAX;
 
-                for (uint32_t attributeIndex = 0; attributeIndex < vertexBufferLayoutInfo->attributeCount; attributeIndex++) {
+    NkBool extensionsSupported = nkVkCheckDeviceExtensionProperties(properties, propertyCount);
 
-                    NkVertexAttributeInfo* vertexAttributeInfo =
-                        vertexBufferLayoutInfo->attributes + attributeIndex;
+    NkBool surfaceAdequate = NkFalse;
+    if (extensionsSupported) {
+        NkVkSurfaceSupportDetails details = nkVkCreateSurfaceSupportDetails(physicalDevice, surface);
+        surfaceAdequate = details.formatCount != 0 && details.presentModeCount != 0;
+        nkVkDestroySurfaceSupportDetails(&details);
+    }
 
-                    VkVertexInputAttributeDescription* attributeDesc = attributes + attributeCount;
-                    attributeDesc->location = vertexAttributeInfo->shaderLocation;
-                    attributeDesc->binding = slot;
-                    attributeDesc->format = nkVkFormat(vertexAttributeInfo->format);
-                    attributeDesc->offset = vertexAttributeInfo->offset;
+    NK_FREE(properties);
 
-                    attributeCount++;
-                }
-            }
+    return indicesIsComplete && extensionsSupported && surfaceAdequate;
+}
 
-            vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-            vertexInputInfo.pNext = NULL;
-            vertexInputInfo.flags = 0;
-            vertexInputInfo.vertexBindingDescriptionCount = bindingCount;
-            vertexInputInfo.pVertexBindingDescriptions = bindings;
-            vertexInputInfo.vertexAttributeDescriptionCount = attributeCount;
-            vertexInputInfo.pVertexAttributeDescriptions = attributes;
-            createInfo.pVertexInputState = &vertexInputInfo;
+#define NK_VK_MAX_DEVICE_EXTENSIONS 16
+
+// Extensions and features Neko takes advantage of when the device has them. Each feature struct is only
+// chained into device creation when its extension is present.
+typedef struct NkVkDeviceFeatures {
+    VkPhysicalDeviceFeatures2 features2;
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibrary;
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRendering;
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicState;
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT extendedDynamicState2;
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3;
+    VkPhysicalDevicePipelineCreationCacheControlFeatures pipelineCreationCacheControl;
+    VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifier;
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexing;
+    VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddress;
+    const char* extensionNames[NK_VK_MAX_DEVICE_EXTENSIONS];
+    uint32_t extensionCount;
+} NkVkDeviceFeatures;
+
+static NkBool nkVkHasDeviceExtension(const VkExtensionProperties* properties, uint32_t propertyCount, const char* name) {
+
+    for (uint32_t i = 0; i < propertyCount; i++) {
+        if (strcmp(properties[i].extensionName, name) == 0) {
+            return NkTrue;
         }
+    }
+    return NkFalse;
+}
 
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly;
-        {
-            inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-            inputAssembly.pNext = NULL;
-            inputAssembly.flags = 0;
-            inputAssembly.topology = nkVkPrimitiveTopology(descriptor->primitiveTopology);
-            inputAssembly.primitiveRestartEnable = nkVkShouldEnablePrimitiveRestart(descriptor->primitiveTopology);
-            createInfo.pInputAssemblyState = &inputAssembly;
-        }
+static void nkVkEnableDeviceExtension(NkVkDeviceFeatures* features, const char* name) {
 
-        VkPipelineRasterizationStateCreateInfo rasterizer;
-        {
-            rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-            rasterizer.pNext = NULL;
-            rasterizer.flags = 0;
-            rasterizer.rasterizerDiscardEnable = VK_FALSE;
-            rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-            rasterizer.lineWidth = 1.0f;
-            rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-            rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-            rasterizer.depthBiasEnable = VK_FALSE;
-            rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-            rasterizer.depthBiasClamp = 0.0f; // Optional
-            rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-            rasterizer.depthClampEnable = VK_FALSE;
-            createInfo.pRasterizationState = &rasterizer;
-        }
-
-        VkPipelineMultisampleStateCreateInfo multisampling;
-        {
-            multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-            multisampling.pNext = NULL;
-            multisampling.flags = 0;
-            multisampling.sampleShadingEnable = VK_FALSE;
-            multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-            multisampling.minSampleShading = 1.0f; // Optional
-            multisampling.pSampleMask = NULL; // Optional
-            multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-            multisampling.alphaToOneEnable = VK_FALSE; // Optional
-            createInfo.pMultisampleState = &multisampling;
-        }
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment;
-        {
-            colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-            colorBlendAttachment.blendEnable = VK_FALSE;
-            colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-            colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-            colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-            colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-            colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-        }
+    NK_ASSERT(features->extensionCount < NK_VK_MAX_DEVICE_EXTENSIONS);
+    features->extensionNames[features->extensionCount++] = name;
+}
 
-        VkPipelineColorBlendStateCreateInfo colorBlending;
-        {
-            colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-            colorBlending.pNext = NULL;
-            colorBlending.flags = 0;
-            colorBlending.logicOpEnable = VK_FALSE;
-            colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-            colorBlending.attachmentCount = 1;
-            colorBlending.pAttachments = &colorBlendAttachment;
-            colorBlending.blendConstants[0] = 0.0f; // Optional
-            colorBlending.blendConstants[1] = 0.0f; // Optional
-            colorBlending.blendConstants[2] = 0.0f; // Optional
-            colorBlending.blendConstants[3] = 0.0f; // Optional
-            createInfo.pColorBlendState = &colorBlending;
-        }
-
-        VkDynamicState dynamicStates[] = {
-            VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_LINE_WIDTH
-        };
+static void nkVkChainDeviceFeatures(VkBaseOutStructure** tail, void* features) {
 
-        VkPipelineDynamicStateCreateInfo dynamicState;
-        {
-            dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-            dynamicState.pNext = NULL;
-            dynamicState.flags = 0;
-            dynamicState.dynamicStateCount = 2;
-            dynamicState.pDynamicStates = dynamicStates;
-            createInfo.pDynamicState = &dynamicState;
+    VkBaseOutStructure* next = NK_PTR_CAST(VkBaseOutStructure*, features);
+    next->pNext = NK_NULL;
+    (*tail)->pNext = next;
+    *tail = next;
+}
+
+static void nkVkSelectDeviceFeatures(NkDevice device, const NkDeviceInfo* descriptor, NkVkDeviceFeatures* features) {
+
+    uint32_t propertyCount = 0;
+    NK_CHECK_VK(vkEnumerateDeviceExtensionProperties(device->physicalDevice, NK_NULL, &propertyCount, NK_NULL));
+
+    VkExtensionProperties* properties = NK_PTR_CAST(VkExtensionProperties*, NK_MALLOC(sizeof(VkExtensionProperties) * propertyCount));
+    NK_ASSERT(properties);
+
+    NK_CHECK_VK(vkEnumerateDeviceExtensionProperties(device->physicalDevice, NK_NULL, &propertyCount, properties));
+
+    features->extensionCount = 0;
+    for (uint32_t i = 0; i < NkVkDeviceEnabledExtensionCount; i++) {
+        nkVkEnableDeviceExtension(features, NkVkDeviceEnabledExtensionNames[i]);
+    }
+
+    features->features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features->features2.pNext = NK_NULL;
+    VkBaseOutStructure* tail = NK_PTR_CAST(VkBaseOutStructure*, &features->features2);
+
+    features->graphicsPipelineLibrary.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    features->graphicsPipelineLibrary.graphicsPipelineLibrary = VK_FALSE;
+    if (nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        nkVkEnableDeviceExtension(features, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+        nkVkChainDeviceFeatures(&tail, &features->graphicsPipelineLibrary);
+    }
+
+    // On Vulkan 1.1 dynamic rendering also needs the extensions it was built on top of.
+    features->dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    features->dynamicRendering.dynamicRendering = VK_FALSE;
+    if (nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        nkVkEnableDeviceExtension(features, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+        nkVkEnableDeviceExtension(features, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        nkVkChainDeviceFeatures(&tail, &features->dynamicRendering);
+    }
+
+    // Extended dynamic state is opt in, since it moves work from pipeline creation onto every render pass.
+    memset(&features->extendedDynamicState, 0, sizeof(features->extendedDynamicState));
+    memset(&features->extendedDynamicState2, 0, sizeof(features->extendedDynamicState2));
+    memset(&features->extendedDynamicState3, 0, sizeof(features->extendedDynamicState3));
+    features->extendedDynamicState.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    features->extendedDynamicState2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    features->extendedDynamicState3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    if (descriptor->extendedDynamicState && nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        nkVkChainDeviceFeatures(&tail, &features->extendedDynamicState);
+
+        if (nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+            nkVkEnableDeviceExtension(features, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+            nkVkChainDeviceFeatures(&tail, &features->extendedDynamicState2);
+        }
+        if (nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+            nkVkEnableDeviceExtension(features, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+            nkVkChainDeviceFeatures(&tail, &features->extendedDynamicState3);
         }
+    }
+
+    // Identifiers only pay off for pipelines that hit the cache, and failing the ones that don't needs cache control.
+    features->pipelineCreationCacheControl.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES;
+    features->pipelineCreationCacheControl.pipelineCreationCacheControl = VK_FALSE;
+    features->shaderModuleIdentifier.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+    features->shaderModuleIdentifier.shaderModuleIdentifier = VK_FALSE;
+    if (descriptor->shaderModuleIdentifiers &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME) &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME);
+        nkVkEnableDeviceExtension(features, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+        nkVkChainDeviceFeatures(&tail, &features->pipelineCreationCacheControl);
+        nkVkChainDeviceFeatures(&tail, &features->shaderModuleIdentifier);
+    }
 
-        createInfo.pDepthStencilState = NULL;
+    // Push descriptors have no features of their own, so having the extension is enough.
+    device->pushDescriptors = NkFalse;
+    if (nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+        device->pushDescriptors = NkTrue;
+    }
 
-        createInfo.layout = VK_NULL_HANDLE; // TODO
+    memset(&features->descriptorIndexing, 0, sizeof(features->descriptorIndexing));
+    features->descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    if (descriptor->bindless &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_MAINTENANCE3_EXTENSION_NAME) &&
+        nkVkHasDeviceExtension(properties, propertyCount, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        nkVkEnableDeviceExtension(features, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        nkVkChainDeviceFeatures(&tail, &features->descriptorIndexing);
     }
 
-    NK_CHECK_VK(vkCreateGraphicsPipelines(device->device, VK_NULL_HANDLE, 1, &createInfo, NULL, &renderPipeline->pipeline));
+    memset(&features->bufferDeviceAddress, 0, sizeof(features->bufferDeviceAddress));
+    features->bufferDeviceAddress.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    if (nkVkHasDeviceExtension(properties, propertyCount, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)) {
+        nkVkEnableDeviceExtension(features, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+        nkVkChainDeviceFeatures(&tail, &features->bufferDeviceAddress);
+    }
 
-    return renderPipeline;
+    NK_FREE(properties);
+
+    vkGetPhysicalDeviceFeatures2(device->physicalDevice, &features->features2);
+
+    // Neko doesn't rely on any of the other core features yet, so none are turned on just because they exist.
+    const VkBool32 depthClamp = features->features2.features.depthClamp;
+    const VkBool32 samplerAnisotropy = features->features2.features.samplerAnisotropy;
+    memset(&features->features2.features, 0, sizeof(features->features2.features));
+    features->features2.features.depthClamp = depthClamp;
+    features->features2.features.samplerAnisotropy = samplerAnisotropy;
+
+    // Of the second and third extensions only the pieces the encoder exposes are turned on.
+    features->extendedDynamicState2.extendedDynamicState2LogicOp = VK_FALSE;
+    features->extendedDynamicState2.extendedDynamicState2PatchControlPoints = VK_FALSE;
+    const VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supported3 = features->extendedDynamicState3;
+    memset(&features->extendedDynamicState3, 0, sizeof(features->extendedDynamicState3));
+    features->extendedDynamicState3.sType = supported3.sType;
+    features->extendedDynamicState3.pNext = supported3.pNext;
+    features->extendedDynamicState3.extendedDynamicState3DepthClampEnable = (supported3.extendedDynamicState3DepthClampEnable && depthClamp) ? VK_TRUE : VK_FALSE;
+    if (supported3.extendedDynamicState3ColorBlendEnable && supported3.extendedDynamicState3ColorBlendEquation && supported3.extendedDynamicState3ColorWriteMask) {
+        features->extendedDynamicState3.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+        features->extendedDynamicState3.extendedDynamicState3ColorBlendEquation = VK_TRUE;
+        features->extendedDynamicState3.extendedDynamicState3ColorWriteMask = VK_TRUE;
+    }
+
+    // Bindless tables need every one of these, and only these are turned on.
+    const VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing = features->descriptorIndexing;
+    memset(&features->descriptorIndexing, 0, sizeof(features->descriptorIndexing));
+    features->descriptorIndexing.sType = supportedIndexing.sType;
+    features->descriptorIndexing.pNext = supportedIndexing.pNext;
+    device->bindless = (supportedIndexing.runtimeDescriptorArray && supportedIndexing.descriptorBindingPartiallyBound &&
+        supportedIndexing.descriptorBindingUpdateUnusedWhilePending &&
+        supportedIndexing.descriptorBindingSampledImageUpdateAfterBind && supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind &&
+        supportedIndexing.shaderSampledImageArrayNonUniformIndexing && supportedIndexing.shaderStorageBufferArrayNonUniformIndexing) ? NkTrue : NkFalse;
+    if (device->bindless) {
+        features->descriptorIndexing.runtimeDescriptorArray = VK_TRUE;
+        features->descriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+        features->descriptorIndexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        features->descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features->descriptorIndexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features->descriptorIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features->descriptorIndexing.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    }
+
+    // Capture and replay is for tools, and multi device addresses for device groups, neither of which Neko has.
+    features->bufferDeviceAddress.bufferDeviceAddressCaptureReplay = VK_FALSE;
+    features->bufferDeviceAddress.bufferDeviceAddressMultiDevice = VK_FALSE;
+    device->bufferDeviceAddress = features->bufferDeviceAddress.bufferDeviceAddress ? NkTrue : NkFalse;
+
+    device->graphicsPipelineLibrary = features->graphicsPipelineLibrary.graphicsPipelineLibrary ? NkTrue : NkFalse;
+    device->dynamicRendering = features->dynamicRendering.dynamicRendering ? NkTrue : NkFalse;
+    device->depthClamp = depthClamp ? NkTrue : NkFalse;
+    device->samplerAnisotropy = samplerAnisotropy ? NkTrue : NkFalse;
+    device->shaderModuleIdentifiers =
+        (features->pipelineCreationCacheControl.pipelineCreationCacheControl && features->shaderModuleIdentifier.shaderModuleIdentifier) ? NkTrue : NkFalse;
+
+    device->dynamicState = NkDynamicState_None;
+    device->dynamicPrimitiveRestart = NkFalse;
+    if (features->extendedDynamicState.extendedDynamicState) {
+        device->dynamicState |= NkDynamicState_Rasterization | NkDynamicState_DepthStencil;
+        device->dynamicPrimitiveRestart = features->extendedDynamicState2.extendedDynamicState2 ? NkTrue : NkFalse;
+        device->dynamicState |= features->extendedDynamicState3.extendedDynamicState3ColorBlendEnable ? NkDynamicState_ColorBlend : 0;
+        device->dynamicState |= features->extendedDynamicState3.extendedDynamicState3DepthClampEnable ? NkDynamicState_DepthClamp : 0;
+    }
 }
 
-NkSampler nkCreateSampler(NkDevice device, const NkSamplerInfo* descriptor) {
+#define NK_VK_LOAD_DEVICE_FUNCTION(device, type, name) NK_PTR_CAST(type, vkGetDeviceProcAddr((device)->device, name))
 
+static void nkVkLoadDynamicStateFunctions(NkDevice device) {
+
+    NkVkDynamicStateFunctions* functions = &device->dynamicStateFunctions;
+    memset(functions, 0, sizeof(NkVkDynamicStateFunctions));
+
+    if (device->dynamicState & NkDynamicState_Rasterization) {
+        functions->cmdSetCullMode = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetCullModeEXT, "vkCmdSetCullModeEXT");
+        functions->cmdSetFrontFace = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetFrontFaceEXT, "vkCmdSetFrontFaceEXT");
+        functions->cmdSetPrimitiveTopology = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetPrimitiveTopologyEXT, "vkCmdSetPrimitiveTopologyEXT");
+        NK_ASSERT(functions->cmdSetCullMode && functions->cmdSetFrontFace && functions->cmdSetPrimitiveTopology);
+    }
+    if (device->dynamicPrimitiveRestart) {
+        functions->cmdSetPrimitiveRestartEnable = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetPrimitiveRestartEnableEXT, "vkCmdSetPrimitiveRestartEnableEXT");
+        NK_ASSERT(functions->cmdSetPrimitiveRestartEnable);
+    }
+    if (device->dynamicState & NkDynamicState_DepthStencil) {
+        functions->cmdSetDepthTestEnable = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetDepthTestEnableEXT, "vkCmdSetDepthTestEnableEXT");
+        functions->cmdSetDepthWriteEnable = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetDepthWriteEnableEXT, "vkCmdSetDepthWriteEnableEXT");
+        functions->cmdSetDepthCompareOp = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetDepthCompareOpEXT, "vkCmdSetDepthCompareOpEXT");
+        functions->cmdSetStencilTestEnable = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetStencilTestEnableEXT, "vkCmdSetStencilTestEnableEXT");
+        functions->cmdSetStencilOp = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetStencilOpEXT, "vkCmdSetStencilOpEXT");
+        NK_ASSERT(functions->cmdSetDepthTestEnable && functions->cmdSetDepthWriteEnable && functions->cmdSetDepthCompareOp);
+        NK_ASSERT(functions->cmdSetStencilTestEnable && functions->cmdSetStencilOp);
+    }
+    if (device->dynamicState & NkDynamicState_ColorBlend) {
+        functions->cmdSetColorBlendEnable = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetColorBlendEnableEXT, "vkCmdSetColorBlendEnableEXT");
+        functions->cmdSetColorBlendEquation = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetColorBlendEquationEXT, "vkCmdSetColorBlendEquationEXT");
+        functions->cmdSetColorWriteMask = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetColorWriteMaskEXT, "vkCmdSetColorWriteMaskEXT");
+        NK_ASSERT(functions->cmdSetColorBlendEnable && functions->cmdSetColorBlendEquation && functions->cmdSetColorWriteMask);
+    }
+    if (device->dynamicState & NkDynamicState_DepthClamp) {
+        functions->cmdSetDepthClampEnable = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdSetDepthClampEnableEXT, "vkCmdSetDepthClampEnableEXT");
+        NK_ASSERT(functions->cmdSetDepthClampEnable);
+    }
 }
 
-NkShaderModule nkCreateShaderModule(NkDevice device, const NkShaderModuleInfo* descriptor) {
+NkDevice nkCreateDevice(NkInstance instance, const NkDeviceInfo* descriptor) {
 
-    NK_ASSERT(device);
+    NK_ASSERT(instance);
     NK_ASSERT(descriptor);
+    NK_ASSERT(descriptor->surface);
 
-    NkShaderModule shaderModule = NK_PTR_CAST(NkShaderModule, NK_MALLOC(sizeof(struct NkShaderModuleImpl)));
-    NK_ASSERT(shaderModule);
+    NkSurface surface = descriptor->surface;
 
-    // SPIR-V code is passed to Vulkan as an array of uint32_t. Neko's interface is generalised so it takes IR
-    // as a void pointer. Unfortunately that means that someone could feasibly feed it a byte buffer that is not
-    // aligned correctly. This is unlikely to happen as I think most general allocators will make sure that the
-    // data satisfies the worst-case alignment requirements, but just in case, we're just making sure the buffer
-    // is suitably aligned before we cast the pointer to a uint32_t.
-    NK_ASSERT(NK_IS_PTR_ALIGNED(descriptor->source, NK_ALIGN_OF(uint32_t)));
+    NkDevice device = NK_PTR_CAST(NkDevice, NK_MALLOC(sizeof(struct NkDeviceImpl)));
+    NK_ASSERT(device);
 
-    VkShaderModuleCreateInfo shaderInfo;
-    {
-        shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderInfo.pNext = NK_NULL;
-        shaderInfo.flags = 0;
-        shaderInfo.codeSize = descriptor->size;
-        shaderInfo.pCode = NK_PTR_CAST(const uint32_t*, descriptor->source);
+    device->instance = instance;
+    
+    // select physical device
+
+    uint32_t physicalDeviceCount = 0;
+    NK_CHECK_VK(vkEnumeratePhysicalDevices(instance->instance, &physicalDeviceCount, NK_NULL));
+
+    VkPhysicalDevice* physicalDevices =
+        NK_PTR_CAST(VkPhysicalDevice*, NK_MALLOC(sizeof(VkPhysicalDevice) * physicalDeviceCount));
+    NK_ASSERT(physicalDevices);
+
+    vkEnumeratePhysicalDevices(instance->instance, &physicalDeviceCount, physicalDevices);
+
+    VkSurfaceKHR vkSurface = surface->surface;
+
+    device->physicalDevice = VK_NULL_HANDLE;
+    for (size_t i = 0; i < physicalDeviceCount; i++) {
+        if (nkVkIsPhysicalDeviceSuitable(physicalDevices[i], vkSurface)) {
+            device->physicalDevice = physicalDevices[i];   
+            break;
+        }
     }
+    NK_ASSERT_VK_HANDLE(device->physicalDevice);
 
-    NK_CHECK_VK(vkCreateShaderModule(device->device, &shaderInfo, NK_NULL, &shaderModule->module));
+    NK_FREE(physicalDevices);
 
-    return shaderModule;
-}
+    vkGetPhysicalDeviceProperties(device->physicalDevice, &device->properties);
+    vkGetPhysicalDeviceMemoryProperties(device->physicalDevice, &device->memoryProperties);
 
-void nkDestroyShaderModule(NkShaderModule shaderModule) {
+    // select logical device
 
-    NK_ASSERT(shaderModule);
-    vkDestroyShaderModule(shaderModule->device, shaderModule->module, NULL);
-    NK_FREE(shaderModule);
-}
+    NkVkQueueFamilyIndices queueFamilyIndices = 
+        nkVkFindQueueFamilies(device->physicalDevice, vkSurface);
 
-typedef struct NkVkSurfaceSupportDetails {
-    VkSurfaceCapabilitiesKHR capabilities;
-    VkSurfaceFormatKHR* formats;
-    uint32_t formatCount;
-    VkPresentModeKHR* presentModes;
-    uint32_t presentModeCount;
-} NkVkSurfaceSupportDetails;
+    VkDeviceQueueCreateInfo queueCreateInfos[2];
+    uint32_t queueCount = 0;
+    float queuePriority = 1.0f;
 
-static NkVkSurfaceSupportDetails nkVkCreateSurfaceSupportDetails(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+    for (size_t i = 0; i < 2; i++) {
+        VkDeviceQueueCreateInfo info;
+        {
+            info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            info.pNext = NK_NULL;
+            info.flags = 0;
+            info.queueFamilyIndex = *(&queueFamilyIndices.graphicsFamily + i);
+            info.queueCount = 1;
+            info.pQueuePriorities = &queuePriority;
+        }
+        queueCreateInfos[i] = info;
 
-    NK_ASSERT_VK_HANDLE(physicalDevice);
-    NK_ASSERT_VK_HANDLE(surface);
+        queueCount = i + 1;
 
-    NkVkSurfaceSupportDetails details;
-    {
-        details.formats = NK_NULL;
-        details.formatCount = 0;
-        details.presentModes = NK_NULL;
-        details.presentModeCount = 0;
+        if (queueFamilyIndices.graphicsFamily == queueFamilyIndices.presentFamily) {
+            break;
+        }
     }
 
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &details.capabilities);
+    NkVkDeviceFeatures features;
+    nkVkSelectDeviceFeatures(device, descriptor, &features);
 
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &details.formatCount, NK_NULL);
+    VkDeviceCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &features.features2;
+        createInfo.flags = 0;
+        createInfo.queueCreateInfoCount = queueCount;
+        createInfo.pQueueCreateInfos = queueCreateInfos;
+        createInfo.enabledLayerCount = 0;       // deprecated and ignored
+        createInfo.ppEnabledLayerNames = NK_NULL;  // deprecated and ignored
+        createInfo.enabledExtensionCount = features.extensionCount;
+        createInfo.ppEnabledExtensionNames = features.extensionNames;
+        createInfo.pEnabledFeatures = NK_NULL;
+    }
+
+    NK_CHECK_VK(vkCreateDevice(device->physicalDevice, &createInfo, NK_NULL, &device->device));
 
-    if (details.formatCount != 0) {
-        details.formats = NK_PTR_CAST(VkSurfaceFormatKHR*, NK_MALLOC(details.formatCount * sizeof(VkSurfaceFormatKHR)));
-        NK_ASSERT(details.formats);
+    nkVkInitQueue(device, queueFamilyIndices.graphicsFamily);
 
-        vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &details.formatCount, details.formats);
+    device->cmdBeginRendering = NK_NULL;
+    device->cmdEndRendering = NK_NULL;
+    if (device->dynamicRendering) {
+        device->cmdBeginRendering = NK_PTR_CAST(PFN_vkCmdBeginRenderingKHR, vkGetDeviceProcAddr(device->device, "vkCmdBeginRenderingKHR"));
+        device->cmdEndRendering = NK_PTR_CAST(PFN_vkCmdEndRenderingKHR, vkGetDeviceProcAddr(device->device, "vkCmdEndRenderingKHR"));
+        NK_ASSERT(device->cmdBeginRendering && device->cmdEndRendering);
     }
 
-    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &details.presentModeCount, NK_NULL);
-
-    if (details.presentModeCount != 0) {
-        details.presentModes = NK_PTR_CAST(VkPresentModeKHR*, NK_MALLOC(details.presentModeCount * sizeof(VkPresentModeKHR)));
-        NK_ASSERT(details.presentModes);
+    nkVkLoadDynamicStateFunctions(device);
 
-        vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &details.presentModeCount, details.presentModes);
+    device->cmdPushDescriptorSet = NK_NULL;
+    if (device->pushDescriptors) {
+        device->cmdPushDescriptorSet = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkCmdPushDescriptorSetKHR, "vkCmdPushDescriptorSetKHR");
+        NK_ASSERT(device->cmdPushDescriptorSet);
     }
 
-    return details;
-}
+    device->getBufferDeviceAddress = NK_NULL;
+    if (device->bufferDeviceAddress) {
+        device->getBufferDeviceAddress = NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkGetBufferDeviceAddressKHR, "vkGetBufferDeviceAddressKHR");
+        NK_ASSERT(device->getBufferDeviceAddress);
+    }
 
-static NkVkSurfaceSupportDetails nkVkDestroySurfaceSupportDetails(NkVkSurfaceSupportDetails* details) {
+    device->getShaderModuleCreateInfoIdentifier = NK_NULL;
+    if (device->shaderModuleIdentifiers) {
+        device->getShaderModuleCreateInfoIdentifier =
+            NK_VK_LOAD_DEVICE_FUNCTION(device, PFN_vkGetShaderModuleCreateInfoIdentifierEXT, "vkGetShaderModuleCreateInfoIdentifierEXT");
+        NK_ASSERT(device->getShaderModuleCreateInfoIdentifier);
+    }
 
-    NK_ASSERT(details);
-    NK_FREE(details->formats);
-    NK_FREE(details->presentModes);
-}
+    nkVkCreatePipelineCache(device, descriptor);
 
-static VkPresentModeKHR nkVkChooseSwapPresentMode(VkPresentModeKHR const* availablePresentModes, uint32_t availablePresentModeCount) {
+    nkMutexInit(&device->pipelineMutex);
+    nkHashMapInit(&device->renderPipelines);
+    nkHashMapInit(&device->renderPipelineVariants);
+    nkHashMapInit(&device->pipelineLibraries);
 
-    NK_ASSERT(availablePresentModes);
-    NK_ASSERT(availablePresentModeCount != 0);
+    nkMutexInit(&device->layoutMutex);
+    nkHashMapInit(&device->bindGroupLayouts);
+    nkHashMapInit(&device->pipelineLayouts);
 
-    for (size_t i = 0; i < availablePresentModeCount - 1; i++) {
-        if (availablePresentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentModes[i];
-        }
-    }
+    nkMutexInit(&device->renderPassMutex);
+    nkHashMapInit(&device->renderPasses);
+    nkHashMapInit(&device->framebuffers);
 
-    return VK_PRESENT_MODE_FIFO_KHR;
-}
+    nkMutexInit(&device->moduleMutex);
+    nkHashMapInit(&device->shaderModules);
 
-static VkSurfaceFormatKHR nkVkChooseSwapSurfaceFormat(VkSurfaceFormatKHR const* availableFormats, uint32_t availableFormatCount) {
+    nkMutexInit(&device->samplerMutex);
+    nkHashMapInit(&device->samplers);
 
-    NK_ASSERT(availableFormats);
-    NK_ASSERT(availableFormatCount != 0);
+    nkVkInitBindGroups(device, descriptor);
+    nkVkInitBindless(device);
 
-    for (size_t i = 0; i < availableFormatCount - 1; i++) {
-        if (availableFormats[i].format == VK_FORMAT_B8G8R8A8_SRGB && availableFormats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-            return availableFormats[i];
-        }
-    }
+    nkVkInitDeviceTasks(device, descriptor);
 
-    return availableFormats[0];
+    return device;
 }
 
-static VkExtent2D nkVkChooseSwapExtent(VkSurfaceCapabilitiesKHR const* capabilities, const NkSwapChainInfo* info) {
-
-    NK_ASSERT(capabilities);
-    NK_ASSERT(info);
+// Methods of PipelineLayout
+void nkDestroyPipelineLayout(NkPipelineLayout pipelineLayout) {
 
-    if (capabilities->currentExtent.width != UINT32_MAX) {
-        return capabilities->currentExtent;
-    } else {
-        VkExtent2D actualExtent = {
-            info->width,
-            info->height
-        };
+    NK_ASSERT(pipelineLayout);
 
-        actualExtent.width
-            = NK_MAX(capabilities->minImageExtent.width, NK_MIN(capabilities->maxImageExtent.width, actualExtent.width));
+    NkDevice device = pipelineLayout->device;
 
-        actualExtent.height
-            = NK_MAX(capabilities->minImageExtent.height, NK_MIN(capabilities->maxImageExtent.height, actualExtent.height));
+    nkMutexLock(&device->layoutMutex);
+    NK_ASSERT(pipelineLayout->refCount > 0);
 
-        return actualExtent;
+    if (--pipelineLayout->refCount > 0) {
+        nkMutexUnlock(&device->layoutMutex);
+        return;
     }
-}
 
-static NkVkQueueFamilyIndices nkVkFindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    nkHashMapRemove(&device->pipelineLayouts, pipelineLayout->hash);
+    nkMutexUnlock(&device->layoutMutex);
 
-    NK_ASSERT_VK_HANDLE(device);
-    NK_ASSERT_VK_HANDLE(surface);
+    vkDestroyPipelineLayout(device->device, pipelineLayout->layout, NK_NULL);
 
-    NkVkQueueFamilyIndices indices;
-    {
-        indices.graphicsFamily = UINT32_MAX;
-        indices.presentFamily = UINT32_MAX;
+    for (uint32_t i = 0; i < pipelineLayout->bindGroupLayoutCount; i++) {
+        nkDestroyBindGroupLayout(pipelineLayout->bindGroupLayouts[i]);
     }
 
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NK_NULL);
+    NK_FREE(pipelineLayout);
+}
 
-    VkQueueFamilyProperties* queueFamilies = NK_PTR_CAST(VkQueueFamilyProperties*, NK_MALLOC(sizeof(VkQueueFamilyProperties) * queueFamilyCount));
-    NK_ASSERT(queueFamilies);
+// Methods of QuerySet
+void nkDestroyQuerySet(NkQuerySet querySet) {
 
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
+}
 
-    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+// Methods of Queue
+void nkDestroyQueue(NkQueue queue) {
 
-        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            indices.graphicsFamily = i;
-        }
+}
 
-        if (surface != VK_NULL_HANDLE) {
+NkFence nkCreateFence(NkQueue queue, const NkFenceInfo* descriptor) {
 
-            VkBool32 presentSupport = VK_FALSE;
-            NK_CHECK_VK(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport));
+}
 
-            if (presentSupport) {
-                indices.presentFamily = i;
-            }
-        }
+// The layout of a KTX2 or DDS file's data. Each level records where its first layer's image starts and the pitch
+// of its rows, and layers of a level are layerStrides apart.
+typedef struct NkVkTextureFile {
+    NkTextureInfo info;
+    NkTextureDataLayout levels[32];
+    uint64_t layerStrides[32];
+} NkVkTextureFile;
 
-        if (indices.graphicsFamily != UINT32_MAX &&
-            indices.presentFamily != UINT32_MAX) {
-            break;
-        }
-    }
+static uint32_t nkVkReadU32(const uint8_t* bytes) {
 
-    NK_FREE(queueFamilies);
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(uint32_t));
+    return value;
+}
 
-    return indices;
+static uint64_t nkVkReadU64(const uint8_t* bytes) {
+
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(uint64_t));
+    return value;
 }
 
-NkSwapChain nkCreateSwapChain(NkDevice device, NkSurface surface, const NkSwapChainInfo* info) {
+// Bytes of one layer of a level, and with rowCount the block rows in each of its images.
+static uint64_t nkVkTextureLevelSize(const NkTextureInfo* info, uint32_t mipLevel, uint32_t* bytesPerRow, uint32_t* rowCount) {
 
-    NK_ASSERT(device);
-    NK_ASSERT(surface);
-    NK_ASSERT(info);
+    uint32_t blockSize;
+    const uint32_t blockBytes = nkVkTexelBlockSize(info->format, &blockSize);
+    const uint32_t width = NK_MAX(info->size.width >> mipLevel, 1u);
+    const uint32_t height = NK_MAX(info->size.height >> mipLevel, 1u);
+    const uint32_t depth = info->dimension == NkTextureDimension_3D ? NK_MAX(info->size.depth >> mipLevel, 1u) : 1;
 
-    NkSwapChain swapChain = NK_PTR_CAST(NkSwapChain, NK_MALLOC(sizeof(struct NkSwapChainImpl)));
-    NK_ASSERT(swapChain);
+    *bytesPerRow = (width + blockSize - 1) / blockSize * blockBytes;
+    *rowCount = (height + blockSize - 1) / blockSize;
+    return NK_CAST(uint64_t, *bytesPerRow) * *rowCount * depth;
+}
 
-    swapChain->currentFrame = 0;
+// Shared checks once a file's header is read. Sizes are bounded so nothing after this can overflow.
+static NkBool nkVkValidateTextureFile(const NkTextureInfo* info, uint32_t layerCount) {
 
-    NkVkSurfaceSupportDetails surfaceSupport = nkVkCreateSurfaceSupportDetails(device->physicalDevice, surface->surface);
-    VkSurfaceFormatKHR surfaceFormat = nkVkChooseSwapSurfaceFormat(surfaceSupport.formats, surfaceSupport.formatCount);
-    VkPresentModeKHR presentMode = nkVkChooseSwapPresentMode(surfaceSupport.presentModes, surfaceSupport.presentModeCount);
-    VkExtent2D extent = nkVkChooseSwapExtent(&surfaceSupport.capabilities, info);
+    uint32_t blockSize;
+    if (info->format == NkTextureFormat_Undefined || nkVkTexelBlockSize(info->format, &blockSize) == 0) {
+        return NkFalse;
+    }
+    if (info->size.width == 0 || info->size.width > 65536 || info->size.height > 65536 || info->size.depth > 65536) {
+        return NkFalse;
+    }
+    if (info->dimension == NkTextureDimension_3D && layerCount != 1) {
+        return NkFalse;
+    }
 
-    uint32_t imageCount = surfaceSupport.capabilities.minImageCount + 1;
-    if (surfaceSupport.capabilities.maxImageCount > 0 && imageCount > surfaceSupport.capabilities.maxImageCount) {
-        imageCount = surfaceSupport.capabilities.maxImageCount;
+    const uint32_t largest = NK_MAX(info->size.width, NK_MAX(info->size.height, info->dimension == NkTextureDimension_3D ? info->size.depth : 1));
+    uint32_t maxLevelCount = 1;
+    while ((largest >> maxLevelCount) != 0) {
+        maxLevelCount++;
     }
+    return info->mipLevelCount >= 1 && info->mipLevelCount <= maxLevelCount ? NkTrue : NkFalse;
+}
 
-    NkVkQueueFamilyIndices indices =
-        nkVkFindQueueFamilies(device->physicalDevice, surface->surface);
+static NkTextureFormat nkVkFindTextureFormat(VkFormat format) {
 
-    uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
+    for (uint32_t i = NkTextureFormat_R8Unorm; i <= NkTextureFormat_BC7RGBAUnormSrgb; i++) {
+        if (nkVkTextureFormat(NK_CAST(NkTextureFormat, i)) == format) {
+            return NK_CAST(NkTextureFormat, i);
+        }
+    }
+    return NkTextureFormat_Undefined;
+}
 
-    VkSwapchainCreateInfoKHR createInfo;
-    {
-        createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-        createInfo.flags = 0;
-        createInfo.pNext = NK_NULL;
-        createInfo.surface = surface->surface;
-        createInfo.minImageCount = imageCount;
-        createInfo.imageFormat = surfaceFormat.format;
-        createInfo.imageColorSpace = surfaceFormat.colorSpace;
-        createInfo.imageExtent = extent;
-        createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+static NkBool nkVkParseKtx2(const uint8_t* data, size_t size, NkVkTextureFile* file) {
 
-        if (indices.graphicsFamily != indices.presentFamily) {
-            createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-            createInfo.queueFamilyIndexCount = 2;
-            createInfo.pQueueFamilyIndices = queueFamilyIndices;
-        }
-        else {
-            createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            createInfo.queueFamilyIndexCount = 0;
-            createInfo.pQueueFamilyIndices = NK_NULL;
-        }
+    static const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
 
-        createInfo.preTransform = surfaceSupport.capabilities.currentTransform;
-        createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-        createInfo.presentMode = presentMode;
-        createInfo.clipped = VK_TRUE;
+    if (size < 80 || memcmp(data, identifier, sizeof(identifier)) != 0) {
+        return NkFalse;
+    }
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+    const uint32_t vkFormat = nkVkReadU32(data + 12);
+    const uint32_t width = nkVkReadU32(data + 20);
+    const uint32_t height = nkVkReadU32(data + 24);
+    const uint32_t depth = nkVkReadU32(data + 28);
+    const uint32_t layerCount = NK_MAX(nkVkReadU32(data + 32), 1u) * nkVkReadU32(data + 36);
+    const uint32_t levelCount = NK_MAX(nkVkReadU32(data + 40), 1u);
+    const uint32_t supercompressionScheme = nkVkReadU32(data + 44);
+
+    // Basis and zstd payloads would need decoding before they're staged.
+    if (vkFormat == VK_FORMAT_UNDEFINED || supercompressionScheme != 0 || size < 80 + NK_CAST(size_t, levelCount) * 24) {
+        return NkFalse;
     }
-    NK_CHECK_VK(vkCreateSwapchainKHR(device->device, &createInfo, NK_NULL, &swapChain->swapChain));
 
-    swapChain->device = device->device;
+    NkTextureInfo* info = &file->info;
+    info->dimension = depth > 0 ? NkTextureDimension_3D : (height > 0 ? NkTextureDimension_2D : NkTextureDimension_1D);
+    info->size.width = width;
+    info->size.height = NK_MAX(height, 1u);
+    info->size.depth = depth > 0 ? depth : layerCount;
+    info->format = nkVkFindTextureFormat(NK_CAST(VkFormat, vkFormat));
+    info->mipLevelCount = levelCount;
+    info->sampleCount = 1;
 
-    NK_CHECK_VK(vkGetSwapchainImagesKHR(device->device, swapChain->swapChain, &swapChain->swapChainImageCount, NK_NULL));
+    if (layerCount == 0 || !nkVkValidateTextureFile(info, depth > 0 ? layerCount : 1)) {
+        return NkFalse;
+    }
 
-    swapChain->swapChainImages = NK_PTR_CAST(VkImage*, NK_MALLOC(sizeof(VkImage) * swapChain->swapChainImageCount));
-    NK_ASSERT(swapChain->swapChainImages);
+    // Images of a level are tightly packed, layers and cube faces one after another.
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const uint64_t byteOffset = nkVkReadU64(data + 80 + i * 24);
+        const uint64_t byteLength = nkVkReadU64(data + 88 + i * 24);
+        const uint32_t layers = depth > 0 ? 1 : layerCount;
 
-    NK_CHECK_VK(vkGetSwapchainImagesKHR(device->device, swapChain->swapChain, &swapChain->swapChainImageCount, swapChain->swapChainImages));
+        uint32_t rowCount;
+        const uint64_t layerSize = nkVkTextureLevelSize(info, i, &file->levels[i].bytesPerRow, &rowCount);
+        if (byteOffset > size || byteLength > size - byteOffset || byteLength < layerSize * layers) {
+            return NkFalse;
+        }
 
-    nkVkDestroySurfaceSupportDetails(&surfaceSupport);
+        file->levels[i].offset = byteOffset;
+        file->levels[i].rowsPerImage = rowCount;
+        file->levels[i].generateMipmaps = NkFalse;
+        file->levels[i].sourceFormat = NkTextureSourceFormat_Undefined;
+        file->layerStrides[i] = layerSize;
+    }
+    return NkTrue;
+}
 
-    swapChain->swapChainTextureViews = NK_PTR_CAST(struct NkTextureViewImpl*, NK_MALLOC(sizeof(struct NkTextureViewImpl) * swapChain->swapChainImageCount));
-    NK_ASSERT(swapChain->swapChainTextureViews);
+static NkTextureFormat nkVkDxgiTextureFormat(uint32_t dxgiFormat) {
+    switch (dxgiFormat) {
+    case 2:
+        return NkTextureFormat_RGBA32Float;
+    case 3:
+        return NkTextureFormat_RGBA32Uint;
+    case 4:
+        return NkTextureFormat_RGBA32Sint;
+    case 10:
+        return NkTextureFormat_RGBA16Float;
+    case 12:
+        return NkTextureFormat_RGBA16Uint;
+    case 14:
+        return NkTextureFormat_RGBA16Sint;
+    case 16:
+        return NkTextureFormat_RG32Float;
+    case 17:
+        return NkTextureFormat_RG32Uint;
+    case 18:
+        return NkTextureFormat_RG32Sint;
+    case 24:
+        return NkTextureFormat_RGB10A2Unorm;
+    case 26:
+        return NkTextureFormat_RG11B10Ufloat;
+    case 28:
+        return NkTextureFormat_RGBA8Unorm;
+    case 29:
+        return NkTextureFormat_RGBA8UnormSrgb;
+    case 30:
+        return NkTextureFormat_RGBA8Uint;
+    case 31:
+        return NkTextureFormat_RGBA8Snorm;
+    case 32:
+        return NkTextureFormat_RGBA8Sint;
+    case 34:
+        return NkTextureFormat_RG16Float;
+    case 36:
+        return NkTextureFormat_RG16Uint;
+    case 38:
+        return NkTextureFormat_RG16Sint;
+    case 41:
+        return NkTextureFormat_R32Float;
+    case 42:
+        return NkTextureFormat_R32Uint;
+    case 43:
+        return NkTextureFormat_R32Sint;
+    case 49:
+        return NkTextureFormat_RG8Unorm;
+    case 50:
+        return NkTextureFormat_RG8Uint;
+    case 51:
+        return NkTextureFormat_RG8Snorm;
+    case 52:
+        return NkTextureFormat_RG8Sint;
+    case 54:
+        return NkTextureFormat_R16Float;
+    case 57:
+        return NkTextureFormat_R16Uint;
+    case 59:
+        return NkTextureFormat_R16Sint;
+    case 61:
+        return NkTextureFormat_R8Unorm;
+    case 62:
+        return NkTextureFormat_R8Uint;
+    case 63:
+        return NkTextureFormat_R8Snorm;
+    case 64:
+        return NkTextureFormat_R8Sint;
+    case 67:
+        return NkTextureFormat_RGB9E5Ufloat;
+    case 71:
+        return NkTextureFormat_BC1RGBAUnorm;
+    case 72:
+        return NkTextureFormat_BC1RGBAUnormSrgb;
+    case 74:
+        return NkTextureFormat_BC2RGBAUnorm;
+    case 75:
+        return NkTextureFormat_BC2RGBAUnormSrgb;
+    case 77:
+        return NkTextureFormat_BC3RGBAUnorm;
+    case 78:
+        return NkTextureFormat_BC3RGBAUnormSrgb;
+    case 80:
+        return NkTextureFormat_BC4RUnorm;
+    case 81:
+        return NkTextureFormat_BC4RSnorm;
+    case 83:
+        return NkTextureFormat_BC5RGUnorm;
+    case 84:
+        return NkTextureFormat_BC5RGSnorm;
+    case 87:
+        return NkTextureFormat_BGRA8Unorm;
+    case 91:
+        return NkTextureFormat_BGRA8UnormSrgb;
+    case 95:
+        return NkTextureFormat_BC6HRGBUfloat;
+    case 96:
+        return NkTextureFormat_BC6HRGBFloat;
+    case 98:
+        return NkTextureFormat_BC7RGBAUnorm;
+    case 99:
+        return NkTextureFormat_BC7RGBAUnormSrgb;
+    default:
+        return NkTextureFormat_Undefined;
+    }
+}
 
-    for (size_t i = 0; i < swapChain->swapChainImageCount; i++) {
-        VkImageViewCreateInfo imageViewCreateInfo;
-        {
-            imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            imageViewCreateInfo.flags = 0;
-            imageViewCreateInfo.pNext = NK_NULL;
-            imageViewCreateInfo.image = swapChain->swapChainImages[i];
-            imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            imageViewCreateInfo.format = surfaceFormat.format;
-            imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-            imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-            imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-            imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-            imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-            imageViewCreateInfo.subresourceRange.levelCount = 1;
-            imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-            imageViewCreateInfo.subresourceRange.layerCount = 1;
+#define NK_VK_FOURCC(a, b, c, d) (NK_CAST(uint32_t, (a)) | (NK_CAST(uint32_t, (b)) << 8) | (NK_CAST(uint32_t, (c)) << 16) | (NK_CAST(uint32_t, (d)) << 24))
+
+// Files without a DX10 header describe their format with a four character code or channel masks.
+static NkTextureFormat nkVkLegacyDdsTextureFormat(const uint8_t* pixelFormat) {
+
+    const uint32_t flags = nkVkReadU32(pixelFormat + 4);
+    const uint32_t fourCC = nkVkReadU32(pixelFormat + 8);
+    const uint32_t bitCount = nkVkReadU32(pixelFormat + 12);
+    const uint32_t redMask = nkVkReadU32(pixelFormat + 16);
+    const uint32_t alphaMask = nkVkReadU32(pixelFormat + 28);
+
+    if (flags & 0x4) {
+        switch (fourCC) {
+        case NK_VK_FOURCC('D', 'X', 'T', '1'):
+            return NkTextureFormat_BC1RGBAUnorm;
+        case NK_VK_FOURCC('D', 'X', 'T', '2'):
+        case NK_VK_FOURCC('D', 'X', 'T', '3'):
+            return NkTextureFormat_BC2RGBAUnorm;
+        case NK_VK_FOURCC('D', 'X', 'T', '4'):
+        case NK_VK_FOURCC('D', 'X', 'T', '5'):
+            return NkTextureFormat_BC3RGBAUnorm;
+        case NK_VK_FOURCC('A', 'T', 'I', '1'):
+        case NK_VK_FOURCC('B', 'C', '4', 'U'):
+            return NkTextureFormat_BC4RUnorm;
+        case NK_VK_FOURCC('B', 'C', '4', 'S'):
+            return NkTextureFormat_BC4RSnorm;
+        case NK_VK_FOURCC('A', 'T', 'I', '2'):
+        case NK_VK_FOURCC('B', 'C', '5', 'U'):
+            return NkTextureFormat_BC5RGUnorm;
+        case NK_VK_FOURCC('B', 'C', '5', 'S'):
+            return NkTextureFormat_BC5RGSnorm;
+        case 113:
+            return NkTextureFormat_RGBA16Float;
+        case 116:
+            return NkTextureFormat_RGBA32Float;
+        default:
+            return NkTextureFormat_Undefined;
         }
-        NK_CHECK_VK(vkCreateImageView(device->device, &imageViewCreateInfo, NK_NULL, &swapChain->swapChainTextureViews[i].imageView));
     }
 
-    return swapChain;
+    if (bitCount == 32 && alphaMask == 0xFF000000u) {
+        return redMask == 0x000000FFu ? NkTextureFormat_RGBA8Unorm : (redMask == 0x00FF0000u ? NkTextureFormat_BGRA8Unorm : NkTextureFormat_Undefined);
+    }
+    if (bitCount == 8 && redMask == 0xFFu) {
+        return NkTextureFormat_R8Unorm;
+    }
+    return NkTextureFormat_Undefined;
 }
 
-NkTexture nkCreateTexture(NkDevice device, const NkTextureInfo* descriptor) {
+static NkBool nkVkParseDds(const uint8_t* data, size_t size, NkVkTextureFile* file) {
 
-}
+    if (size < 128 || nkVkReadU32(data) != NK_VK_FOURCC('D', 'D', 'S', ' ') || nkVkReadU32(data + 4) != 124) {
+        return NkFalse;
+    }
 
-NkQueue nkDeviceGetDefaultQueue(NkDevice device) {
-    return &device->queue;
-}
+    const uint8_t* header = data + 4;
+    const uint32_t height = nkVkReadU32(header + 8);
+    const uint32_t width = nkVkReadU32(header + 12);
+    const uint32_t depth = nkVkReadU32(header + 20);
+    const uint32_t levelCount = NK_MAX(nkVkReadU32(header + 24), 1u);
+    const uint32_t caps2 = nkVkReadU32(header + 108);
+
+    NkTextureInfo* info = &file->info;
+    size_t dataOffset = 128;
+    uint32_t layerCount = (caps2 & 0x200) ? 6 : 1;
+    info->dimension = (caps2 & 0x200000) ? NkTextureDimension_3D : NkTextureDimension_2D;
+    info->format = nkVkLegacyDdsTextureFormat(header + 72);
+
+    if (nkVkReadU32(header + 80) == NK_VK_FOURCC('D', 'X', '1', '0')) {
+        if (size < 148) {
+            return NkFalse;
+        }
+        const uint8_t* extension = data + 128;
+        const uint32_t resourceDimension = nkVkReadU32(extension + 4);
+        info->format = nkVkDxgiTextureFormat(nkVkReadU32(extension));
+        info->dimension = resourceDimension == 4 ? NkTextureDimension_3D :
+            (resourceDimension == 2 ? NkTextureDimension_1D : NkTextureDimension_2D);
+        layerCount = NK_MAX(nkVkReadU32(extension + 12), 1u) * ((nkVkReadU32(extension + 8) & 0x4) ? 6 : 1);
+        dataOffset = 148;
+    }
 
-NkBool nkDevicePopErrorScope(NkDevice device, NkErrorCallback callback, void* userdata) {
+    const NkBool volume = info->dimension == NkTextureDimension_3D ? NkTrue : NkFalse;
+    info->size.width = width;
+    info->size.height = info->dimension == NkTextureDimension_1D ? 1 : height;
+    info->size.depth = volume ? NK_MAX(depth, 1u) : layerCount;
+    info->mipLevelCount = levelCount;
+    info->sampleCount = 1;
 
-}
+    if (!nkVkValidateTextureFile(info, layerCount)) {
+        return NkFalse;
+    }
 
-void nkDevicePushErrorScope(NkDevice device, NkErrorFilter filter) {
+    // Each layer holds its whole mip chain before the next layer starts.
+    uint64_t chainSize = 0;
+    for (uint32_t i = 0; i < levelCount; i++) {
+        uint32_t rowCount;
+        file->levels[i].offset = dataOffset + chainSize;
+        chainSize += nkVkTextureLevelSize(info, i, &file->levels[i].bytesPerRow, &rowCount);
+        file->levels[i].rowsPerImage = rowCount;
+        file->levels[i].generateMipmaps = NkFalse;
+        file->levels[i].sourceFormat = NkTextureSourceFormat_Undefined;
+    }
+    for (uint32_t i = 0; i < levelCount; i++) {
+        file->layerStrides[i] = chainSize;
+    }
 
+    return chainSize * layerCount <= size - dataOffset ? NkTrue : NkFalse;
 }
 
-void nkDeviceSetDeviceLostCallback(NkDevice device, NkDeviceLostCallback callback, void* userdata) {
+static void nkVkRecordTextureFileCopy(VkCommandBuffer commandBuffer, NkTexture texture, NkBuffer staging, const VkBufferImageCopy* regions, uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout restingLayout) {
 
-}
+    nkVkTextureBarrier(commandBuffer, texture, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-void nkDeviceSetUncapturedErrorCallback(NkDevice device, NkErrorCallback callback, void* userdata) {
+    vkCmdCopyBufferToImage(commandBuffer, staging->buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        levelCount, regions + baseMipLevel);
 
+    nkVkTextureBarrier(commandBuffer, texture, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, restingLayout,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 }
 
-// Methods of Fence
-void nkDeviceFence(NkFence fence) {
+NkTexture nkQueueLoadTexture(NkQueue queue, const char* path, const NkTextureFileInfo* descriptor) {
 
-}
+    NK_ASSERT(queue);
+    NK_ASSERT(path);
+    NK_ASSERT(descriptor);
 
-uint64_t nkFenceGetCompletedValue(NkFence fence) {
+    NkDevice device = queue->device;
 
-}
+    NkMappedFile mappedFile;
+    if (!nkMapFile(path, &mappedFile)) {
+        return NK_NULL;
+    }
 
-void nkFenceOnCompletion(NkFence fence, uint64_t value, NkFenceOnCompletionCallback callback, void* userdata) {
+    const uint8_t* data = NK_PTR_CAST(const uint8_t*, mappedFile.data);
+    NkVkTextureFile file;
+    if (!nkVkParseKtx2(data, mappedFile.size, &file) && !nkVkParseDds(data, mappedFile.size, &file)) {
+        nkUnmapFile(&mappedFile);
+        return NK_NULL;
+    }
 
-}
+    file.info.usage = descriptor->usage | NkTextureUsage_CopyDst;
+    NkTexture texture = nkCreateTexture(device, &file.info);
 
-// Methods of Instance
-void nkDestroyInstance(NkInstance instance) {
+    const NkBool volume = texture->dimension == NkTextureDimension_3D ? NkTrue : NkFalse;
+    const uint32_t layerCount = volume ? 1 : texture->arrayLayerCount;
+    const uint32_t levelCount = texture->mipLevelCount;
 
-    NK_ASSERT(instance);
+    // Levels are staged one after another, each with its layers back to back, so every level is one region. Copy
+    // offsets must be a multiple of four as well as of the texel block size, which are both powers of two.
+    VkBufferImageCopy regions[32];
+    uint64_t stagingSize = 0;
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const NkTextureDataLayout* level = &file.levels[i];
+        stagingSize = (stagingSize + 3) & ~NK_CAST(uint64_t, 3);
 
-    if (NkEnableValidationLayers) {
-        nkVkDestroyDebugUtilsMessengerEXT(instance->instance, instance->debugMessenger, NK_NULL);
+        VkBufferImageCopy* region = regions + i;
+        {
+            region->bufferOffset = stagingSize;
+            region->bufferRowLength = 0;
+            region->bufferImageHeight = 0;
+            region->imageSubresource.aspectMask = nkVkImageAspect(texture->imageFormat, NkTextureAspect_All);
+            region->imageSubresource.mipLevel = i;
+            region->imageSubresource.baseArrayLayer = 0;
+            region->imageSubresource.layerCount = layerCount;
+            region->imageOffset.x = 0;
+            region->imageOffset.y = 0;
+            region->imageOffset.z = 0;
+            region->imageExtent.width = NK_MAX(texture->size.width >> i, 1u);
+            region->imageExtent.height = NK_MAX(texture->size.height >> i, 1u);
+            region->imageExtent.depth = volume ? NK_MAX(texture->size.depth >> i, 1u) : 1;
+        }
+
+        const uint64_t imageSize = NK_CAST(uint64_t, level->bytesPerRow) * level->rowsPerImage * region->imageExtent.depth;
+        stagingSize += imageSize * layerCount;
     }
-    vkDestroyInstance(instance->instance, NK_NULL);
-    NK_FREE(instance);
-}
 
-NkSurface nkCreateSurface(NkInstance instance, const NkSurfaceInfo* descriptor) {
+    NkBufferInfo stagingInfo;
+    {
+        stagingInfo.usage = NkBufferUsage_MapWrite | NkBufferUsage_CopySrc;
+        stagingInfo.size = stagingSize;
+        stagingInfo.mappedAtCreation = NkFalse;
+    }
 
-    NK_ASSERT(instance);
-    NK_ASSERT(descriptor);
+    NkBuffer staging = nkCreateBuffer(device, &stagingInfo);
 
-    NkSurface surface = NK_PTR_CAST(NkSurface, NK_MALLOC(sizeof(struct NkSurfaceImpl)));
-    NK_ASSERT(surface);
+    // The only copy the CPU makes is from the mapping into staging memory.
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const uint64_t imageSize = NK_CAST(uint64_t, file.levels[i].bytesPerRow) * file.levels[i].rowsPerImage * regions[i].imageExtent.depth;
+        uint8_t* destination = NK_PTR_CAST(uint8_t*, staging->mapped) + regions[i].bufferOffset;
+        const uint8_t* source = data + file.levels[i].offset;
 
-    surface->instance = instance->instance;
+        if (file.layerStrides[i] == imageSize) {
+            memcpy(destination, source, NK_CAST(size_t, imageSize * layerCount));
+            continue;
+        }
+        for (uint32_t layer = 0; layer < layerCount; layer++) {
+            memcpy(destination + imageSize * layer, source + file.layerStrides[i] * layer, NK_CAST(size_t, imageSize));
+        }
+    }
 
-#if defined(_WIN32)
-    VkWin32SurfaceCreateInfoKHR createInfo;
-    {
-        createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-        createInfo.pNext = NK_NULL;
-        createInfo.flags = 0;
-        createInfo.hwnd = descriptor->native.hwnd;
-        createInfo.hinstance = descriptor->native.hinstance;
+    nkUnmapFile(&mappedFile);
+
+    // Later work on the queue is ordered after the copies, so the texture can be treated as resident right away.
+    const VkImageLayout restingLayout = nkVkTextureRestingLayout(texture);
+    texture->layout = restingLayout;
+
+    if (!descriptor->smallestMipFirst) {
+        VkCommandBuffer commandBuffer = nkVkBeginUpload(queue);
+        nkVkRecordTextureFileCopy(commandBuffer, texture, staging, regions, 0, levelCount, restingLayout);
+        nkVkSubmitUpload(queue, commandBuffer);
+        nkDestroyBuffer(staging);
+
+        if (descriptor->levelsResident) {
+            descriptor->levelsResident(texture, 0, descriptor->userdata);
+        }
+        return texture;
     }
-    NK_CHECK_VK(vkCreateWin32SurfaceKHR(instance->instance, &createInfo, NK_NULL, &surface->surface));
-#endif
 
-    return surface;
+    NkVkTextureStream* stream = NK_PTR_CAST(NkVkTextureStream*, NK_MALLOC(sizeof(NkVkTextureStream)));
+    NK_ASSERT(stream);
+
+    stream->texture = texture;
+    stream->staging = staging;
+    stream->levelsResident = descriptor->levelsResident;
+    stream->userdata = descriptor->userdata;
+    stream->pendingLevelCount = levelCount;
+
+    for (uint32_t level = levelCount; level-- > 0;) {
+        VkCommandBuffer commandBuffer = nkVkBeginUpload(queue);
+        nkVkRecordTextureFileCopy(commandBuffer, texture, staging, regions, level, 1, restingLayout);
+        nkVkSubmitLevelUpload(queue, commandBuffer, stream, level);
+    }
+
+    return texture;
 }
 
-static const char* NkVkDeviceEnabledExtensionNames[] = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-};
+void nkQueueSignal(NkQueue queue, NkFence fence, uint64_t signalValue) {
 
-static const uint32_t NkVkDeviceEnabledExtensionCount
-    = sizeof(NkVkDeviceEnabledExtensionNames) / sizeof(NkVkDeviceEnabledExtensionNames[0]);
+}
 
-static NkBool nkVkCheckDeviceExtensionProperties(VkExtensionProperties* properties, uint32_t propertyCount) {
+// Command buffers are replayed onto a single Vulkan command buffer and waited for, the same way queue writes are.
+void nkQueueSubmit(NkQueue queue, uint32_t commandCount, const NkCommandBuffer* commands) {
 
-    NK_ASSERT(properties);
-    NK_ASSERT(propertyCount != 0);
+    NK_ASSERT(queue);
+    NK_ASSERT(commandCount == 0 || commands);
 
-    for (uint32_t i = 0; i < NkVkDeviceEnabledExtensionCount; i++) {
-        uint32_t enabledExtensionCount = 0;
-        for (uint32_t j = 0; j < propertyCount - 1; j++) {
-            if (strcmp(NkVkDeviceEnabledExtensionNames[i], properties[j].extensionName) == 0) {
-                ++enabledExtensionCount;
-            }
-            if (enabledExtensionCount == NkVkDeviceEnabledExtensionCount) {
-                return NkTrue;
-            }
-        }
+    if (commandCount == 0) {
+        return;
+    }
+
+    VkCommandBuffer commandBuffer = nkVkBeginUpload(queue);
+    for (uint32_t i = 0; i < commandCount; i++) {
+        nkVkRecordCommands(queue->device, commandBuffer, commands[i]);
+    }
+    nkVkSubmitUpload(queue, commandBuffer);
+
+    for (uint32_t i = 0; i < commandCount; i++) {
+        nkFreeCommandBuffer(commands[i]);
     }
-    return NkFalse;
 }
 
-static NkBool nkVkIsPhysicalDeviceSuitable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+void nkQueueWriteBuffer(NkQueue queue, NkBuffer buffer, uint64_t bufferOffset, const void* data, size_t size) {
 
-    NK_ASSERT_VK_HANDLE(physicalDevice);
-    NK_ASSERT_VK_HANDLE(surface);
+}
 
-    uint32_t propertyCount = 0;
+// A nkQueueWriteBufferFromFile call. The read lands in staging memory, or straight in the buffer when it's
+// mapped, and the copy out of staging runs on the device's tasks.
+typedef struct NkVkFileWrite {
+    NkQueue queue;
+    NkBuffer buffer;
+    uint64_t bufferOffset;
+    NkBuffer staging; // NK_NULL when the buffer is read into directly
+    int fd;
+    uint64_t fileOffset;
+    size_t size;
+    NkQueueWriteBufferFromFileCallback callback;
+    void* userdata;
+    NkBool success;
+} NkVkFileWrite;
+
+static void nkVkFinishFileWrite(void* taskData) {
+
+    NkVkFileWrite* write = NK_PTR_CAST(NkVkFileWrite*, taskData);
+    NkQueue queue = write->queue;
+    NkDevice device = queue->device;
+
+    if (write->success && write->staging) {
+        VkCommandBuffer commandBuffer = nkVkBeginUpload(queue);
+
+        VkBufferCopy region;
+        {
+            region.srcOffset = 0;
+            region.dstOffset = write->bufferOffset;
+            region.size = write->size;
+        }
 
-    NK_CHECK_VK(vkEnumerateDeviceExtensionProperties(physicalDevice, NK_NULL, &propertyCount, NK_NULL));
+        vkCmdCopyBuffer(commandBuffer, write->staging->buffer, write->buffer->buffer, 1, &region);
 
-    VkExtensionProperties* properties = NK_PTR_CAST(VkExtensionProperties*, NK_MALLOC(sizeof(VkExtensionProperties) * propertyCount));
-    NK_ASSERT(properties);
+        VkBufferMemoryBarrier barrier;
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.pNext = NK_NULL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = write->buffer->buffer;
+            barrier.offset = write->bufferOffset;
+            barrier.size = write->size;
+        }
 
-    NK_CHECK_VK(vkEnumerateDeviceExtensionProperties(physicalDevice, NK_NULL, &propertyCount, properties));
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            0, NK_NULL, 1, &barrier, 0, NK_NULL);
 
-    NkVkQueueFamilyIndices queueFamilyIndices = nkVkFindQueueFamilies(physicalDevice, surface);
+        nkVkSubmitUpload(queue, commandBuffer);
+    }
 
-    NkBool indicesIsComplete = queueFamilyIndices.graphicsFamily != UINT32_MAX &&
-                               queueFamilyIndices.presentFamily != UINT32_MAX;
+    if (write->staging) {
+        nkDestroyBuffer(write->staging);
+    }
 
-    NkBool extensionsSupported = nkVkCheckDeviceExtensionProperties(properties, propertyCount);
+    if (write->callback) {
+        write->callback(write->success ? NkQueueWriteStatus_Success : NkQueueWriteStatus_Error, write->userdata);
+    }
+    NK_FREE(write);
 
-    NkBool surfaceAdequate = NkFalse;
-    if (extensionsSupported) {
-        NkVkSurfaceSupportDetails details = nkVkCreateSurfaceSupportDetails(physicalDevice, surface);
-        surfaceAdequate = details.formatCount != 0 && details.presentModeCount != 0;
-        nkVkDestroySurfaceSupportDetails(&details);
+    nkMutexLock(&device->taskMutex);
+    NK_ASSERT(device->pendingTaskCount > 0);
+    if (--device->pendingTaskCount == 0) {
+        nkConditionBroadcast(&device->tasksIdle);
     }
+    nkMutexUnlock(&device->taskMutex);
+}
 
-    NK_FREE(properties);
+#if defined(NK_IO_URING)
+// Runs on the ring's thread, which goes straight back to reaping reads while a task records the copy. A read the
+// kernel refused fails on the thread that asked for it instead.
+static void nkVkFileWriteRead(NkBool success, void* data) {
 
-    return indicesIsComplete && extensionsSupported && surfaceAdequate;
+    NkVkFileWrite* write = NK_PTR_CAST(NkVkFileWrite*, data);
+    write->success = success;
+    nkVkScheduleTask(write->queue->device, nkVkFinishFileWrite, write);
 }
+#endif
 
-NkDevice nkCreateDevice(NkInstance instance, NkSurface surface) {
+static void nkVkReadFileWrite(void* taskData) {
 
-    NK_ASSERT(instance);
-    NK_ASSERT(surface);
+    NkVkFileWrite* write = NK_PTR_CAST(NkVkFileWrite*, taskData);
+    void* destination = write->staging ? write->staging->mapped : NK_PTR_CAST(uint8_t*, write->buffer->mapped) + write->bufferOffset;
+    write->success = nkReadFileAt(write->fd, destination, write->size, write->fileOffset);
+    nkVkFinishFileWrite(write);
+}
 
-    NkDevice device = NK_PTR_CAST(NkDevice, NK_MALLOC(sizeof(struct NkDeviceImpl)));
-    NK_ASSERT(device);
+void nkQueueWriteBufferFromFile(NkQueue queue, NkBuffer buffer, uint64_t bufferOffset, int fd, uint64_t fileOffset, size_t size, NkQueueWriteBufferFromFileCallback callback, void* userdata) {
 
-    device->instance = instance;
-    
-    // select physical device
+    NK_ASSERT(queue);
+    NK_ASSERT(buffer);
+    NK_ASSERT(fd >= 0);
+    NK_ASSERT(size > 0 && bufferOffset + size <= buffer->size);
 
-    uint32_t physicalDeviceCount = 0;
-    NK_CHECK_VK(vkEnumeratePhysicalDevices(instance->instance, &physicalDeviceCount, NK_NULL));
+    NkDevice device = queue->device;
 
-    VkPhysicalDevice* physicalDevices =
-        NK_PTR_CAST(VkPhysicalDevice*, NK_MALLOC(sizeof(VkPhysicalDevice) * physicalDeviceCount));
-    NK_ASSERT(physicalDevices);
+    NkVkFileWrite* write = NK_PTR_CAST(NkVkFileWrite*, NK_MALLOC(sizeof(NkVkFileWrite)));
+    NK_ASSERT(write);
 
-    vkEnumeratePhysicalDevices(instance->instance, &physicalDeviceCount, physicalDevices);
+    write->queue = queue;
+    write->buffer = buffer;
+    write->bufferOffset = bufferOffset;
+    write->staging = NK_NULL;
+    write->fd = fd;
+    write->fileOffset = fileOffset;
+    write->size = size;
+    write->callback = callback;
+    write->userdata = userdata;
+    write->success = NkFalse;
 
-    VkSurfaceKHR vkSurface = surface->surface;
+    if (!buffer->mapped) {
+        NK_ASSERT(buffer->usage & NkBufferUsage_CopyDst);
 
-    device->physicalDevice = VK_NULL_HANDLE;
-    for (size_t i = 0; i < physicalDeviceCount; i++) {
-        if (nkVkIsPhysicalDeviceSuitable(physicalDevices[i], vkSurface)) {
-            device->physicalDevice = physicalDevices[i];   
-            break;
+        NkBufferInfo stagingInfo;
+        {
+            stagingInfo.usage = NkBufferUsage_MapWrite | NkBufferUsage_CopySrc;
+            stagingInfo.size = size;
+            stagingInfo.mappedAtCreation = NkFalse;
         }
+
+        write->staging = nkCreateBuffer(device, &stagingInfo);
     }
-    NK_ASSERT_VK_HANDLE(device->physicalDevice);
 
-    NK_FREE(physicalDevices);
+    // Counted with the pipeline tasks, so destroying the device waits for the write to land.
+    nkMutexLock(&device->taskMutex);
+    device->pendingTaskCount++;
+    nkMutexUnlock(&device->taskMutex);
 
-    // select logical device
+#if defined(NK_IO_URING)
+    if (queue->ioRing) {
+        void* destination = write->staging ? write->staging->mapped : NK_PTR_CAST(uint8_t*, buffer->mapped) + bufferOffset;
+        nkIoRingRead(queue->ioRing, fd, destination, size, fileOffset, nkVkFileWriteRead, write);
+        return;
+    }
+#endif
+    nkVkScheduleTask(device, nkVkReadFileWrite, write);
+}
 
-    NkVkQueueFamilyIndices queueFamilyIndices = 
-        nkVkFindQueueFamilies(device->physicalDevice, vkSurface);
+// Converted texels are staged tightly packed, whatever the layout of the data they came from.
+static void nkVkStageConvertedTexels(void* staging, const void* data, size_t dataSize, const NkTextureDataLayout* dataLayout, NkTextureFormat format, uint32_t width, uint32_t height, uint32_t depth) {
 
-    VkDeviceQueueCreateInfo queueCreateInfos[2];
-    uint32_t queueCount = 0;
-    float queuePriority = 1.0f;
+    const uint32_t sourceSize = nkTextureSourceFormatSize(dataLayout->sourceFormat);
+    const uint32_t texelSize = nkConvertedTexelSize(format);
+    NK_ASSERT(sourceSize != 0 && texelSize != 0);
 
-    for (size_t i = 0; i < 2; i++) {
-        VkDeviceQueueCreateInfo info;
-        {
-            info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            info.pNext = NK_NULL;
-            info.flags = 0;
-            info.queueFamilyIndex = *(&queueFamilyIndices.graphicsFamily + i);
-            info.queueCount = 1;
-            info.pQueuePriorities = &queuePriority;
-        }
-        queueCreateInfos[i] = info;
+    const size_t rowPitch = dataLayout->bytesPerRow != 0 ? dataLayout->bytesPerRow : NK_CAST(size_t, width) * sourceSize;
+    const size_t imagePitch = rowPitch * (dataLayout->rowsPerImage != 0 ? dataLayout->rowsPerImage : height);
+    NK_ASSERT(dataLayout->offset + imagePitch * (depth - 1) + rowPitch * (height - 1) + NK_CAST(size_t, width) * sourceSize <= dataSize);
+    (void)dataSize;
 
-        queueCount = i + 1;
+    const uint8_t* source = NK_PTR_CAST(const uint8_t*, data) + dataLayout->offset;
+    uint8_t* destination = NK_PTR_CAST(uint8_t*, staging);
 
-        if (queueFamilyIndices.graphicsFamily == queueFamilyIndices.presentFamily) {
-            break;
+    for (uint32_t z = 0; z < depth; z++) {
+        for (uint32_t y = 0; y < height; y++) {
+            nkConvertTexels(dataLayout->sourceFormat, format, source + imagePitch * z + rowPitch * y, destination, width);
+            destination += NK_CAST(size_t, width) * texelSize;
         }
     }
+}
 
-    VkDeviceCreateInfo createInfo;
-    {
-        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        createInfo.pNext = NK_NULL;
-        createInfo.flags = 0;
-        createInfo.queueCreateInfoCount = queueCount;
-        createInfo.pQueueCreateInfos = queueCreateInfos;
-        createInfo.enabledLayerCount = 0;       // deprecated and ignored
-        createInfo.ppEnabledLayerNames = NK_NULL;  // deprecated and ignored
-        createInfo.enabledExtensionCount = NkVkDeviceEnabledExtensionCount;
-        createInfo.ppEnabledExtensionNames = NkVkDeviceEnabledExtensionNames;
-        createInfo.pEnabledFeatures = NK_NULL;
+// Block rows a compression task should have to itself before another task is worth scheduling.
+#define NK_VK_COMPRESS_ROWS_PER_TASK 8
+
+// Compression of one nkQueueWriteTexture call, spread over the device's tasks with nkVkRunParallel. Each block
+// row is an item, so a task the scheduler starts late finds nothing to do instead of holding the write up.
+typedef struct NkVkCompressBatch {
+    const uint8_t* source;
+    uint8_t* destination;
+    NkTextureSourceFormat sourceFormat;
+    NkTextureFormat format;
+    uint32_t width;
+    uint32_t height;
+    size_t rowPitch;
+    size_t imagePitch;
+    size_t blockRowSize;
+    uint32_t blockRowsPerImage;
+} NkVkCompressBatch;
+
+// The scratch holds the four rows of the block row, converted to 8-bit RGBA.
+static void nkVkCompressBlockRow(void* data, uint32_t blockRow, void* scratch) {
+
+    const NkVkCompressBatch* batch = NK_PTR_CAST(const NkVkCompressBatch*, data);
+
+    const uint32_t z = blockRow / batch->blockRowsPerImage;
+    const uint32_t top = (blockRow % batch->blockRowsPerImage) * 4;
+    const uint8_t* rows[4];
+    for (uint32_t y = 0; y < 4; y++) {
+        rows[y] = batch->source + batch->imagePitch * z + batch->rowPitch * NK_MIN(top + y, batch->height - 1);
     }
+    nkCompressBlockRow(batch->sourceFormat, batch->format, rows, batch->width, NK_PTR_CAST(uint8_t*, scratch),
+        batch->destination + batch->blockRowSize * blockRow);
+}
 
-    NK_CHECK_VK(vkCreateDevice(device->physicalDevice, &createInfo, NK_NULL, &device->device));
+// Compressed blocks are staged tightly packed like converted texels.
+static void nkVkStageCompressedTexels(NkDevice device, void* staging, const void* data, size_t dataSize, const NkTextureDataLayout* dataLayout, NkTextureFormat format, uint32_t width, uint32_t height, uint32_t depth) {
+
+    const uint32_t sourceSize = nkTextureSourceFormatSize(dataLayout->sourceFormat);
+    NK_ASSERT(sourceSize != 0);
+
+    const size_t rowPitch = dataLayout->bytesPerRow != 0 ? dataLayout->bytesPerRow : NK_CAST(size_t, width) * sourceSize;
+    const size_t imagePitch = rowPitch * (dataLayout->rowsPerImage != 0 ? dataLayout->rowsPerImage : height);
+    NK_ASSERT(dataLayout->offset + imagePitch * (depth - 1) + rowPitch * (height - 1) + NK_CAST(size_t, width) * sourceSize <= dataSize);
+    (void)dataSize;
+
+    NkVkCompressBatch batch;
+    batch.source = NK_PTR_CAST(const uint8_t*, data) + dataLayout->offset;
+    batch.destination = NK_PTR_CAST(uint8_t*, staging);
+    batch.sourceFormat = dataLayout->sourceFormat;
+    batch.format = format;
+    batch.width = width;
+    batch.height = height;
+    batch.rowPitch = rowPitch;
+    batch.imagePitch = imagePitch;
+    batch.blockRowSize = NK_CAST(size_t, (width + 3) / 4) * nkCompressedBlockSize(format);
+    batch.blockRowsPerImage = (height + 3) / 4;
+
+    // The calling thread compresses alongside the tasks, so it counts as one of them.
+    const uint32_t blockRowCount = batch.blockRowsPerImage * depth;
+    const uint32_t wantedTasks = (blockRowCount + NK_VK_COMPRESS_ROWS_PER_TASK - 1) / NK_VK_COMPRESS_ROWS_PER_TASK;
+    const uint32_t taskCount = NK_MAX(1u, NK_MIN(wantedTasks, nkGetProcessorCount()));
+    nkVkRunParallel(device, blockRowCount, taskCount - 1, NK_CAST(size_t, width) * 4 * 4, nkVkCompressBlockRow, &batch);
+}
 
-    vkGetDeviceQueue(device->device, queueFamilyIndices.graphicsFamily, 0, &device->queue.queue);
+void nkQueueWriteTexture(NkQueue queue, const NkTextureCopyView* destination, const void* data, size_t dataSize, const NkTextureDataLayout* dataLayout, const NkExtent3D* writeSize) {
 
-    return device;
-}
+    NK_ASSERT(queue);
+    NK_ASSERT(destination && destination->texture);
+    NK_ASSERT(data);
+    NK_ASSERT(dataLayout && dataLayout->offset <= dataSize);
+    NK_ASSERT(writeSize);
 
-// Methods of QuerySet
-void nkDestroyQuerySet(NkQuerySet querySet) {
+    NkDevice device = queue->device;
+    NkTexture texture = destination->texture;
+    NK_ASSERT(destination->mipLevel < texture->mipLevelCount);
 
-}
+    const NkBool convert = dataLayout->sourceFormat != NkTextureSourceFormat_Undefined ? NkTrue : NkFalse;
+    const NkBool compress = (convert && nkCompressedBlockSize(texture->format) != 0) ? NkTrue : NkFalse;
+    const uint32_t width = writeSize->width;
+    const uint32_t height = NK_MAX(writeSize->height, 1);
+    const uint32_t depth = NK_MAX(writeSize->depth, 1);
 
-// Methods of Queue
-void nkDestroyQueue(NkQueue queue) {
+    NkBufferInfo stagingInfo;
+    {
+        stagingInfo.usage = NkBufferUsage_MapWrite | NkBufferUsage_CopySrc;
+        if (compress) {
+            stagingInfo.size = NK_CAST(uint64_t, (width + 3) / 4) * ((height + 3) / 4) * depth * nkCompressedBlockSize(texture->format);
+        }
+        else if (convert) {
+            stagingInfo.size = NK_CAST(uint64_t, width) * height * depth * nkConvertedTexelSize(texture->format);
+        }
+        else {
+            stagingInfo.size = dataSize - dataLayout->offset;
+        }
+        stagingInfo.mappedAtCreation = NkFalse;
+    }
 
-}
+    NkBuffer staging = nkCreateBuffer(device, &stagingInfo);
+    if (compress) {
+        nkVkStageCompressedTexels(device, staging->mapped, data, dataSize, dataLayout, texture->format, width, height, depth);
+    }
+    else if (convert) {
+        nkVkStageConvertedTexels(staging->mapped, data, dataSize, dataLayout, texture->format, width, height, depth);
+    }
+    else {
+        memcpy(staging->mapped, NK_PTR_CAST(const uint8_t*, data) + dataLayout->offset, NK_CAST(size_t, stagingInfo.size));
+    }
 
-NkFence nkCreateFence(NkQueue queue, const NkFenceInfo* descriptor) {
+    uint32_t blockSize;
+    const uint32_t blockBytes = nkVkTexelBlockSize(texture->format, &blockSize);
+    NK_ASSERT(blockBytes != 0);
 
-}
+    // Layers of 1D and 2D textures are addressed through the origin's and the size's depth, like in the texture info.
+    const NkBool volume = texture->dimension == NkTextureDimension_3D ? NkTrue : NkFalse;
 
-void nkQueueSignal(NkQueue queue, NkFence fence, uint64_t signalValue) {
+    VkBufferImageCopy region;
+    {
+        region.bufferOffset = 0;
+        region.bufferRowLength = convert ? 0 : dataLayout->bytesPerRow / blockBytes * blockSize;
+        region.bufferImageHeight = convert ? 0 : dataLayout->rowsPerImage * blockSize;
+        region.imageSubresource.aspectMask = nkVkImageAspect(texture->imageFormat, NkTextureAspect_All);
+        region.imageSubresource.mipLevel = destination->mipLevel;
+        region.imageSubresource.baseArrayLayer = volume ? 0 : destination->origin.z;
+        region.imageSubresource.layerCount = volume ? 1 : depth;
+        region.imageOffset.x = NK_CAST(int32_t, destination->origin.x);
+        region.imageOffset.y = NK_CAST(int32_t, destination->origin.y);
+        region.imageOffset.z = volume ? NK_CAST(int32_t, destination->origin.z) : 0;
+        region.imageExtent.width = width;
+        region.imageExtent.height = height;
+        region.imageExtent.depth = volume ? depth : 1;
+    }
 
-}
+    // Whether the mips can be generated is settled before anything is recorded, so a format that can't be blitted
+    // just leaves them alone.
+    const uint32_t mipLevel = destination->mipLevel;
+    VkFilter filter = VK_FILTER_NEAREST;
+    const NkBool generateMipmaps = (dataLayout->generateMipmaps && mipLevel + 1 < texture->mipLevelCount &&
+        nkVkGetMipmapFilter(device, texture, &filter)) ? NkTrue : NkFalse;
 
-void nkQueueSubmit(NkQueue queue, uint32_t commandCount, const NkCommandBuffer* commands) {
+    VkCommandBuffer commandBuffer = nkVkBeginUpload(queue);
 
-}
+    const VkImageLayout restingLayout = nkVkTextureRestingLayout(texture);
 
-void nkQueueWriteBuffer(NkQueue queue, NkBuffer buffer, uint64_t bufferOffset, const void* data, size_t size) {
+    nkVkTextureBarrier(commandBuffer, texture, 0, texture->mipLevelCount, texture->layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-}
+    vkCmdCopyBufferToImage(commandBuffer, staging->buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-void nkQueueWriteTexture(NkQueue queue, const NkTextureCopyView* destination, const void* data, size_t dataSize, const NkTextureDataLayout* dataLayout, const NkExtent3D* writeSize) {
+    texture->layout = restingLayout;
 
+    // Generating the mips hands their levels back itself, the ones above the written level still need it.
+    const uint32_t untouchedLevels = generateMipmaps ? mipLevel : texture->mipLevelCount;
+    if (untouchedLevels > 0) {
+        nkVkTextureBarrier(commandBuffer, texture, 0, untouchedLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, restingLayout,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+    if (generateMipmaps) {
+        nkVkRecordGenerateMipmaps(commandBuffer, texture, mipLevel, texture->mipLevelCount - mipLevel, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, filter);
+    }
+
+    nkVkSubmitUpload(queue, commandBuffer);
+    nkDestroyBuffer(staging);
 }
 
 // Methods of RenderBundleEncoder
@@ -2645,11 +12383,81 @@ void nkDestroyRenderPipeline(NkRenderPipeline renderPipeline) {
 
     NK_ASSERT(renderPipeline);
 
+    NkDevice device = renderPipeline->device;
+
+    nkMutexLock(&device->pipelineMutex);
+    NK_ASSERT(renderPipeline->refCount > 0);
+
+    // Pipelines are shared between every caller that created them with the same descriptor,
+    // so the Vulkan pipeline only goes away with the last reference.
+    if (--renderPipeline->refCount > 0) {
+        nkMutexUnlock(&device->pipelineMutex);
+        return;
+    }
+
+    if (renderPipeline->compiled != renderPipeline) {
+        NkRenderPipeline compiled = renderPipeline->compiled;
+        nkHashMapRemove(&device->renderPipelineVariants, renderPipeline->hash);
+        nkMutexUnlock(&device->pipelineMutex);
+
+        nkDestroyPipelineLayout(renderPipeline->layout);
+        NK_FREE(renderPipeline);
+        nkDestroyRenderPipeline(compiled);
+        return;
+    }
+
+    nkHashMapRemove(&device->renderPipelines, renderPipeline->hash);
+    nkMutexUnlock(&device->pipelineMutex);
+
+    vkDestroyPipeline(device->device, renderPipeline->pipeline, NK_NULL);
+    vkDestroyPipeline(device->device, renderPipeline->linkedPipeline, NK_NULL);
+    nkDestroyPipelineLayout(renderPipeline->layout);
     NK_FREE(renderPipeline);
 }
 
 NkBindGroupLayout nkRenderPipelineGetBindGroupLayout(NkRenderPipeline renderPipeline, uint32_t groupIndex) {
 
+    NK_ASSERT(renderPipeline);
+    NK_ASSERT(groupIndex < renderPipeline->layout->bindGroupLayoutCount);
+
+    return nkVkRetainBindGroupLayout(renderPipeline->layout->bindGroupLayouts[groupIndex]);
+}
+
+// Methods of Sampler
+void nkDestroySampler(NkSampler sampler) {
+
+    NK_ASSERT(sampler);
+
+    NkDevice device = sampler->device;
+
+    nkMutexLock(&device->samplerMutex);
+    NK_ASSERT(sampler->refCount > 0);
+
+    if (--sampler->refCount > 0) {
+        nkMutexUnlock(&device->samplerMutex);
+        return;
+    }
+
+    nkHashMapRemove(&device->samplers, sampler->hash);
+    nkMutexUnlock(&device->samplerMutex);
+
+    nkVkReleaseBindlessIndex(device, NkBindlessBinding_Samplers, sampler->bindlessIndex);
+    vkDestroySampler(device->device, sampler->sampler, NK_NULL);
+    NK_FREE(sampler);
+}
+
+uint32_t nkSamplerGetBindlessIndex(NkSampler sampler) {
+
+    NK_ASSERT(sampler);
+
+    VkDescriptorImageInfo imageInfo;
+    {
+        imageInfo.sampler = sampler->sampler;
+        imageInfo.imageView = VK_NULL_HANDLE;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    return nkVkGetBindlessIndex(sampler->device, NkBindlessBinding_Samplers, &sampler->bindlessIndex, &imageInfo, NK_NULL);
 }
 
 // Methods of Surface
@@ -2661,13 +12469,21 @@ void nkDestroySurface(NkSurface surface) {
     NK_FREE(surface);
 }
 
+// Views of swap chain images live in the swap chain's own array, so releasing a view is kept apart from freeing it.
+static void nkVkReleaseTextureView(NkTextureView textureView) {
+
+    nkVkEvictFramebuffers(textureView->device, textureView->id);
+    nkVkReleaseBindlessIndex(textureView->device, NkBindlessBinding_Textures, textureView->bindlessIndex);
+    vkDestroyImageView(textureView->device->device, textureView->imageView, NK_NULL);
+}
+
 // Methods of SwapChain
 void nkDestroySwapChain(NkSwapChain swapChain) {
 
     NK_ASSERT(swapChain);
 
     for (uint32_t i = 0; i < swapChain->swapChainImageCount; i++) {
-        vkDestroyImageView(swapChain->device, swapChain->swapChainTextureViews[i].imageView, NK_NULL);
+        nkVkReleaseTextureView(swapChain->swapChainTextureViews + i);
     }
     NK_FREE(swapChain->swapChainTextureViews);
     vkDestroySwapchainKHR(swapChain->device, swapChain->swapChain, NK_NULL);
@@ -2686,13 +12502,222 @@ void nkSwapChainPresent(NkSwapChain swapChain) {
 
 }
 
+// Fills in whatever the info leaves to the texture, so infos that end up describing the same view look the same.
+static NkTextureViewInfo nkVkResolveTextureViewInfo(NkTexture texture, const NkTextureViewInfo* descriptor) {
+
+    NkTextureViewInfo info;
+    if (descriptor) {
+        info = *descriptor;
+    }
+    else {
+        memset(&info, 0, sizeof(info));
+    }
+
+    if (info.format == NkTextureFormat_Undefined) {
+        info.format = texture->format;
+    }
+    if (info.dimension == NkTextureViewDimension_Undefined) {
+        switch (texture->dimension) {
+        case NkTextureDimension_1D:
+            info.dimension = NkTextureViewDimension_1D;
+            break;
+        case NkTextureDimension_3D:
+            info.dimension = NkTextureViewDimension_3D;
+            break;
+        default:
+            info.dimension = texture->arrayLayerCount > 1 ? NkTextureViewDimension_2DArray : NkTextureViewDimension_2D;
+            break;
+        }
+    }
+
+    NK_ASSERT(info.baseMipLevel < texture->mipLevelCount);
+    NK_ASSERT(info.baseArrayLayer < texture->arrayLayerCount);
+    if (info.mipLevelCount == 0) {
+        info.mipLevelCount = texture->mipLevelCount - info.baseMipLevel;
+    }
+    if (info.arrayLayerCount == 0) {
+        info.arrayLayerCount = texture->arrayLayerCount - info.baseArrayLayer;
+    }
+    NK_ASSERT(info.baseMipLevel + info.mipLevelCount <= texture->mipLevelCount);
+    NK_ASSERT(info.baseArrayLayer + info.arrayLayerCount <= texture->arrayLayerCount);
+
+    return info;
+}
+
+static uint64_t nkVkPackTextureViewInfo(const NkTextureViewInfo* info) {
+
+    NK_ASSERT(info->format <= 0xFF && info->dimension <= 0xF && info->aspect <= 0xF);
+    NK_ASSERT(info->baseMipLevel <= 0xFF && info->mipLevelCount <= 0xFF);
+    NK_ASSERT(info->baseArrayLayer <= 0xFFFF && info->arrayLayerCount <= 0xFFFF);
+
+    return NK_CAST(uint64_t, info->format) |
+        (NK_CAST(uint64_t, info->dimension) << 8) |
+        (NK_CAST(uint64_t, info->aspect) << 12) |
+        (NK_CAST(uint64_t, info->baseMipLevel) << 16) |
+        (NK_CAST(uint64_t, info->mipLevelCount) << 24) |
+        (NK_CAST(uint64_t, info->baseArrayLayer) << 32) |
+        (NK_CAST(uint64_t, info->arrayLayerCount) << 48);
+}
+
+static VkImageViewType nkVkImageViewType(NkTextureViewDimension dimension) {
+    switch (dimension) {
+    case NkTextureViewDimension_1D:
+        return VK_IMAGE_VIEW_TYPE_1D;
+    case NkTextureViewDimension_2D:
+        return VK_IMAGE_VIEW_TYPE_2D;
+    case NkTextureViewDimension_2DArray:
+        return VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    case NkTextureViewDimension_Cube:
+        return VK_IMAGE_VIEW_TYPE_CUBE;
+    case NkTextureViewDimension_CubeArray:
+        return VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+    case NkTextureViewDimension_3D:
+        return VK_IMAGE_VIEW_TYPE_3D;
+    default:
+        return VK_IMAGE_VIEW_TYPE_MAX_ENUM;
+    }
+}
+
+static NkTextureView nkVkCreateTextureView(NkTexture texture, const NkTextureViewInfo* info) {
+
+    NkDevice device = texture->device;
+
+    VkImageViewCreateInfo createInfo;
+    {
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.pNext = NK_NULL;
+        createInfo.flags = 0;
+        createInfo.image = texture->image;
+        createInfo.viewType = nkVkImageViewType(info->dimension);
+        createInfo.format = nkVkTextureFormat(info->format);
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.subresourceRange.aspectMask = nkVkImageAspect(texture->imageFormat, info->aspect);
+        createInfo.subresourceRange.baseMipLevel = info->baseMipLevel;
+        createInfo.subresourceRange.levelCount = info->mipLevelCount;
+        createInfo.subresourceRange.baseArrayLayer = info->baseArrayLayer;
+        createInfo.subresourceRange.layerCount = info->arrayLayerCount;
+    }
+
+    NkTextureView textureView = NK_PTR_CAST(NkTextureView, NK_MALLOC(sizeof(struct NkTextureViewImpl)));
+    NK_ASSERT(textureView);
+
+    textureView->device = device;
+    textureView->texture = texture;
+    textureView->refCount = 0;
+    textureView->image = texture->image;
+    textureView->id = nkNextObjectId();
+    textureView->format = createInfo.format;
+    textureView->extent.width = NK_MAX(texture->size.width >> info->baseMipLevel, 1);
+    textureView->extent.height = NK_MAX(texture->size.height >> info->baseMipLevel, 1);
+    textureView->sampleCount = texture->sampleCount;
+    textureView->subresourceRange = createInfo.subresourceRange;
+    textureView->presentable = NkFalse;
+    textureView->bindlessIndex = NK_VK_BINDLESS_INVALID_INDEX;
+    NK_CHECK_VK(vkCreateImageView(device->device, &createInfo, NK_NULL, &textureView->imageView));
+
+    return textureView;
+}
+
 // Methods of Texture
+// Views are cached on their texture and live as long as it does, so asking for the same view every frame hands
+// back the same object, and the framebuffers and bind groups made with it keep hitting their caches too.
 NkTextureView nkCreateTextureView(NkTexture texture, const NkTextureViewInfo* descriptor) {
 
+    NK_ASSERT(texture);
+
+    const NkTextureViewInfo info = nkVkResolveTextureViewInfo(texture, descriptor);
+    const uint64_t key = nkVkPackTextureViewInfo(&info);
+
+    // Images aren't created with mutable formats, so a view can't reinterpret its texture.
+    NK_ASSERT(info.format == texture->format);
+
+    nkMutexLock(&texture->viewMutex);
+
+    // Textures rarely have more than a handful of views, so a linear search beats hashing.
+    for (uint32_t i = 0; i < texture->viewCount; i++) {
+        if (texture->views[i].key == key) {
+            NkTextureView textureView = texture->views[i].view;
+            textureView->refCount++;
+            nkMutexUnlock(&texture->viewMutex);
+            return textureView;
+        }
+    }
+
+    if (texture->viewCount == texture->viewCapacity) {
+        const uint32_t capacity = texture->viewCapacity * 2;
+        NkVkTextureViewEntry* views = NK_PTR_CAST(NkVkTextureViewEntry*, NK_MALLOC(sizeof(NkVkTextureViewEntry) * capacity));
+        NK_ASSERT(views);
+        memcpy(views, texture->views, sizeof(NkVkTextureViewEntry) * texture->viewCount);
+        if (texture->views != texture->inlineViews) {
+            NK_FREE(texture->views);
+        }
+        texture->views = views;
+        texture->viewCapacity = capacity;
+    }
+
+    NkTextureView textureView = nkVkCreateTextureView(texture, &info);
+    textureView->refCount = 1;
+
+    texture->views[texture->viewCount].key = key;
+    texture->views[texture->viewCount].view = textureView;
+    texture->viewCount++;
+
+    nkMutexUnlock(&texture->viewMutex);
+
+    return textureView;
 }
 
 void nkDestroyTexture(NkTexture texture) {
 
+    NK_ASSERT(texture);
+
+    NkDevice device = texture->device;
+
+    for (uint32_t i = 0; i < texture->viewCount; i++) {
+        nkVkReleaseTextureView(texture->views[i].view);
+        NK_FREE(texture->views[i].view);
+    }
+    if (texture->views != texture->inlineViews) {
+        NK_FREE(texture->views);
+    }
+    nkMutexDestroy(&texture->viewMutex);
+
+    vkDestroyImage(device->device, texture->image, NK_NULL);
+    vkFreeMemory(device->device, texture->memory, NK_NULL);
+    NK_FREE(texture);
+}
+
+// Methods of TextureView
+// Only drops the reference, the view itself stays cached until its texture is destroyed.
+void nkDestroyTextureView(NkTextureView textureView) {
+
+    NK_ASSERT(textureView);
+
+    // Swap chain views belong to their swap chain.
+    NkTexture texture = textureView->texture;
+    NK_ASSERT(texture);
+
+    nkMutexLock(&texture->viewMutex);
+    NK_ASSERT(textureView->refCount > 0);
+    textureView->refCount--;
+    nkMutexUnlock(&texture->viewMutex);
+}
+
+uint32_t nkTextureViewGetBindlessIndex(NkTextureView textureView) {
+
+    NK_ASSERT(textureView);
+
+    VkDescriptorImageInfo imageInfo;
+    {
+        imageInfo.sampler = VK_NULL_HANDLE;
+        imageInfo.imageView = textureView->imageView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    return nkVkGetBindlessIndex(textureView->device, NkBindlessBinding_Textures, &textureView->bindlessIndex, &imageInfo, NK_NULL);
 }
 
 #endif // NK_VULKAN_IMPLEMENTATION
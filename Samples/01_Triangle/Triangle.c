@@ -1,8 +1,8 @@
 ﻿
 #include <Neko/Neko.h>
 #include <Neko/Sample.h>
-#include <Neko/Shaders/TriangleFragment.h>
-#include <Neko/Shaders/TriangleVertex.h>
+
+#include <stdio.h>
 
 typedef struct NkPositionColorVertex {
     NkFloat3 position;
@@ -34,19 +34,29 @@ int main() {
         .native = nativeSurface
     });
 
-    const NkDevice device = nkCreateDevice(instance, surface);
+    const NkDevice device = nkCreateDevice(instance, &(NkDeviceInfo) {
+        .surface           = surface,
+        .pipelineCachePath = "Triangle.pipelinecache"
+    });
 
     const NkQueue queue = nkDeviceGetDefaultQueue(device);
 
-    const NkShaderModule vertexShader = nkCreateShaderModule(device, &(NkShaderModuleInfo) {
-        .source = NkTriangleFragmentSource,
-        .size   = NkTriangleFragmentSourceSize
-    });
+    const NkShaderArchive shaderArchive = nkOpenShaderArchive(NK_SHADER_ARCHIVE_PATH);
+    if (!shaderArchive) {
+        fprintf(stderr, "Triangle: couldn't open shader archive '%s'\n", NK_SHADER_ARCHIVE_PATH);
+        return 1;
+    }
 
-    const NkShaderModule pixelShader = nkCreateShaderModule(device, &(NkShaderModuleInfo) {
-        .source = NkTriangleVertexSource,
-        .size   = NkTriangleVertexSourceSize
-    });
+    NkShaderModuleInfo vertexShaderInfo;
+    NkShaderModuleInfo pixelShaderInfo;
+    if (!nkShaderArchiveGetModuleInfo(shaderArchive, "TriangleVertex", &vertexShaderInfo) ||
+        !nkShaderArchiveGetModuleInfo(shaderArchive, "TriangleFragment", &pixelShaderInfo)) {
+        fprintf(stderr, "Triangle: shader archive '%s' is missing the triangle shaders\n", NK_SHADER_ARCHIVE_PATH);
+        return 1;
+    }
+
+    const NkShaderModule vertexShader = nkCreateShaderModule(device, &vertexShaderInfo);
+    const NkShaderModule pixelShader = nkCreateShaderModule(device, &pixelShaderInfo);
 
     const NkRenderPipeline renderPipeline = nkCreateRenderPipeline(device, &(NkRenderPipelineInfo) {
         .vertexStage   = { .module = vertexShader, .entryPoint = "vertexMain" },
@@ -63,7 +73,12 @@ int main() {
                 .attributeCount = 2
             },
             .vertexBufferCount = 1
-        }
+        },
+        .colorStates = &(NkColorStateInfo) {
+            .format = NkTextureFormat_BGRA8UnormSrgb,
+            .writeMask = NkColorWriteMask_All
+        },
+        .colorStateCount = 1
     });
 
     const NkBuffer vertexBuffer = nkCreateBuffer(device, &(NkBufferInfo) {
@@ -96,6 +111,7 @@ int main() {
         nkRenderPassEncoderSetPipeline(renderPass, renderPipeline);
         nkRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexBuffer, 0, 0);
         nkRenderPassEncoderDraw(renderPass, 3, 1, 0, 0);
+        nkRenderPassEncoderEndPass(renderPass);
 
         const NkCommandBuffer commandBuffer = nkCommandEncoderFinish(encoder);
         nkQueueSubmit(queue, 1, &commandBuffer);
@@ -106,6 +122,7 @@ int main() {
     nkDestroyRenderPipeline(renderPipeline);
     nkDestroyShaderModule(vertexShader);
     nkDestroyShaderModule(pixelShader);
+    nkCloseShaderArchive(shaderArchive);
     nkDestroyDevice(device);
     nkDestroySurface(surface);
     nkDestroyInstance(instance);
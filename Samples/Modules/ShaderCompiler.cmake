@@ -1,41 +1,53 @@
-if(NEKO_GENERATE_MODE)
-    function(WRAP_STRING)
-        set(oneValueArgs VARIABLE AT_COLUMN)
-        cmake_parse_arguments(WRAP_STRING "${options}" "${oneValueArgs}" "" ${ARGN})
-
-        string(LENGTH ${${WRAP_STRING_VARIABLE}} stringLength)
-        math(EXPR offset "0")
-
-        while(stringLength GREATER 0)
-
-            if(stringLength GREATER ${WRAP_STRING_AT_COLUMN})
-                math(EXPR length "${WRAP_STRING_AT_COLUMN}")
-            else()
-                math(EXPR length "${stringLength}")
+if(NEKO_DEPFILE_MODE)
+    # writes a Makefile style depfile listing every file SOURCE_FILE includes, directly or not
+    set(pending "${SOURCE_FILE}")
+    set(visited)
+
+    while(pending)
+        list(GET pending 0 current)
+        list(REMOVE_AT pending 0)
+        list(APPEND visited "${current}")
+
+        get_filename_component(currentDir "${current}" DIRECTORY)
+        file(STRINGS "${current}" includes REGEX "^[ \t]*#[ \t]*include[ \t]*[\"<][^\">]+[\">]")
+
+        foreach(include ${includes})
+            string(REGEX REPLACE "^[ \t]*#[ \t]*include[ \t]*[\"<]([^\">]+)[\">].*$" "\\1" includePath "${include}")
+            get_filename_component(includePath "${currentDir}/${includePath}" ABSOLUTE)
+
+            list(FIND visited "${includePath}" visitedIndex)
+            list(FIND pending "${includePath}" pendingIndex)
+            if(EXISTS "${includePath}" AND visitedIndex EQUAL -1 AND pendingIndex EQUAL -1)
+                list(APPEND pending "${includePath}")
             endif()
+        endforeach()
+    endwhile()
 
-            string(SUBSTRING ${${WRAP_STRING_VARIABLE}} ${offset} ${length} line)
-            set(lines "${lines}\n${line}")
+    string(REPLACE " " "\\ " dependencies "${DEPFILE_TARGET}:")
+    foreach(dependency ${visited})
+        string(REPLACE " " "\\ " dependency "${dependency}")
+        set(dependencies "${dependencies} \\\n  ${dependency}")
+    endforeach()
 
-            math(EXPR stringLength "${stringLength} - ${length}")
-            math(EXPR offset "${offset} + ${length}")
-        endwhile()
+    file(WRITE ${DEPFILE} "${dependencies}\n")
 
-        set(${WRAP_STRING_VARIABLE} "${lines}" PARENT_SCOPE)
-    endfunction()
+    return()
+endif()
 
+if(NEKO_GENERATE_MODE)
     file(READ ${INPUT_FILE} hexString HEX)
     string(LENGTH ${hexString} hexStringLength)
-
-    # wraps the hex string into multiple lines at column 32(i.e. 16 bytes per line)
-    wrap_string(VARIABLE hexString AT_COLUMN 32)
     math(EXPR arraySize "${hexStringLength} / 2")
 
     # adds '0x' prefix and comma suffix before and after every byte respectively
     string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " arrayValues ${hexString})
 
+    # wraps the array into multiple lines of 16 bytes. One regex pass, the old substring loop was quadratic.
+    string(REPEAT "0x[0-9a-f][0-9a-f], " 16 linePattern)
+    string(REGEX REPLACE "(${linePattern})" "\\1\n" arrayValues ${arrayValues})
+
     # removes trailing comma
-    string(REGEX REPLACE ", $" "" arrayValues ${arrayValues})
+    string(REGEX REPLACE ", \n?$" "" arrayValues ${arrayValues})
 
     string(MAKE_C_IDENTIFIER "${SYMBOL}" SYMBOL)
 
@@ -55,8 +67,25 @@ endif()
 
 set(NEKO_SHADER_SCRIPT "${CMAKE_CURRENT_LIST_FILE}" CACHE INTERNAL "Path to ShaderCompiler script")
 
+find_program(NEKO_SPIRV_OPT spirv-opt HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+option(NEKO_SHADER_OPTIMIZE "Optimize compiled shaders and strip their debug info with spirv-opt" ON)
+
+# Bindings and specialization constants are preserved, pipeline layouts and NkProgrammableStageInfo constants are
+# reflected from them at runtime.
+set(NEKO_SPIRV_OPT_FLAGS -O --strip-debug --strip-reflect --preserve-bindings --preserve-spec-constants)
+
+# add_shader_module(<target> NAME <name> INPUT <source> ENTRY_POINT <entry> STAGE <stage> [ARCHIVE])
+#
+# Compiles a shader into Neko/Shaders/<name>.h. With ARCHIVE the binary is kept as Neko/Shaders/<name>.spv instead,
+# so it can be packed with add_shader_archive and changing it doesn't recompile any C code.
+#
+# Neko/Shaders/<name>Layout.h is generated alongside, see ShaderReflector. Its bind group layouts, vertex layout and
+# uniform structs are constant data, and a C struct that drifts from the shader fails to compile.
+#
+# Every shader is its own custom command with no targets in between, so a parallel build compiles them all at once.
+# Shaders are rebuilt when anything they include changes.
 function(add_shader_module name)
-    set(options)
+    set(options ARCHIVE)
     set(oneValueArgs NAME INPUT ENTRY_POINT STAGE)
     set(multiValueArgs)
     cmake_parse_arguments(
@@ -69,29 +98,117 @@ function(add_shader_module name)
 
     get_filename_component(ShaderInput "${CMAKE_CURRENT_SOURCE_DIR}/${SHADER_INPUT}" ABSOLUTE)
     get_filename_component(ShaderHeader "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${SHADER_NAME}.h" ABSOLUTE)
-    get_filename_component(ShaderBin "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${SHADER_NAME}.bin" ABSOLUTE)
+    get_filename_component(ShaderLayoutHeader "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${SHADER_NAME}Layout.h" ABSOLUTE)
+    get_filename_component(ShaderBin "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${SHADER_NAME}.spv" ABSOLUTE)
+    get_filename_component(ShaderUnoptimized "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${SHADER_NAME}.unoptimized.spv" ABSOLUTE)
+    get_filename_component(ShaderDepFile "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${SHADER_NAME}.d" ABSOLUTE)
 
     set_source_files_properties(${SHADER_INPUT} PROPERTIES VS_TOOL_OVERRIDE "None")
-
-    add_custom_target("${SHADER_NAME}" ALL
-        ${CMAKE_COMMAND} -E echo "Compiling shaders..."
-        DEPENDS ${ShaderHeader}
-    )
+    file(MAKE_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders")
 
     # TODO: change target depending on backend. Vulkan only for now.
     set(TARGET spirv)
 
+    if(SHADER_ARCHIVE)
+        set(ShaderOutput ${ShaderBin})
+    else()
+        set(ShaderOutput ${ShaderHeader})
+    endif()
+
+    set(ShaderCommands)
+
+    # Ninja reads include dependencies from a depfile, Makefiles scan for them with IMPLICIT_DEPENDS
+    set(ShaderDependencies)
+    if(CMAKE_GENERATOR MATCHES "Ninja")
+        file(RELATIVE_PATH ShaderDepFileTarget "${CMAKE_BINARY_DIR}" "${ShaderOutput}")
+        list(APPEND ShaderCommands
+            COMMAND ${CMAKE_COMMAND} -DNEKO_DEPFILE_MODE=TRUE -DSOURCE_FILE=${ShaderInput} -DDEPFILE=${ShaderDepFile}
+                                     -DDEPFILE_TARGET=${ShaderDepFileTarget} -P ${NEKO_SHADER_SCRIPT}
+        )
+        set(ShaderDependencies DEPFILE ${ShaderDepFile})
+    elseif(CMAKE_GENERATOR MATCHES "Makefiles")
+        set(ShaderDependencies IMPLICIT_DEPENDS C ${ShaderInput})
+    endif()
+
+    if(NEKO_SHADER_OPTIMIZE AND NEKO_SPIRV_OPT)
+        list(APPEND ShaderCommands
+            COMMAND ShaderConductor -I ${ShaderInput} -O ${ShaderUnoptimized} -S ${SHADER_STAGE} -E ${SHADER_ENTRY_POINT} -T ${TARGET}
+            COMMAND ShaderReflector ${ShaderUnoptimized} ${ShaderLayoutHeader} ${SHADER_NAME}
+            COMMAND ${NEKO_SPIRV_OPT} ${NEKO_SPIRV_OPT_FLAGS} ${ShaderUnoptimized} -o ${ShaderBin}
+            COMMAND ${CMAKE_COMMAND} -E remove ${ShaderUnoptimized}
+        )
+    else()
+        list(APPEND ShaderCommands
+            COMMAND ShaderConductor -I ${ShaderInput} -O ${ShaderBin} -S ${SHADER_STAGE} -E ${SHADER_ENTRY_POINT} -T ${TARGET}
+            COMMAND ShaderReflector ${ShaderBin} ${ShaderLayoutHeader} ${SHADER_NAME}
+        )
+    endif()
+
+    if(NOT SHADER_ARCHIVE)
+        list(APPEND ShaderCommands
+            COMMAND ${CMAKE_COMMAND} -DNEKO_GENERATE_MODE=TRUE -DNAMESPACE="Nk" -DTARGET=${TARGET} -DSOURCE_FILE=${ShaderInput}
+                                     -DSYMBOL=${SHADER_NAME} -DINPUT_FILE=${ShaderBin} -DOUTPUT_FILE=${ShaderHeader}
+                                     -P ${NEKO_SHADER_SCRIPT}
+            COMMAND ${CMAKE_COMMAND} -E remove ${ShaderBin}
+        )
+    endif()
+
     add_custom_command(
-        OUTPUT  ${ShaderHeader}
-        COMMAND ${CMAKE_COMMAND} -E echo "Compiling shader ${ShaderInput}. Generating shader binary header: ${ShaderHeader}"
-        COMMAND ShaderConductor -I ${ShaderInput} -O ${ShaderBin} -S ${SHADER_STAGE} -E ${SHADER_ENTRY_POINT} -T ${TARGET}
-        COMMAND ${CMAKE_COMMAND} -DNEKO_GENERATE_MODE=TRUE -DNAMESPACE="Nk" -DTARGET=${TARGET} -DSOURCE_FILE=${ShaderInput}
-                                 -DSYMBOL=${SHADER_NAME} -DINPUT_FILE=${ShaderBin} -DOUTPUT_FILE=${ShaderHeader}
-                                 -P ${NEKO_SHADER_SCRIPT}
-        COMMAND ${CMAKE_COMMAND} -E remove ${ShaderBin}
-        DEPENDS ${SHADER_INPUT}
+        OUTPUT  ${ShaderOutput} ${ShaderLayoutHeader}
+        COMMAND ${CMAKE_COMMAND} -E echo "Compiling shader ${ShaderInput}. Generating: ${ShaderOutput}"
+        ${ShaderCommands}
+        DEPENDS ${SHADER_INPUT} ShaderReflector
+        ${ShaderDependencies}
     )
 
-    target_sources(${name} PRIVATE ${SHADER_INPUT} ${ShaderHeader})
+    if(SHADER_ARCHIVE)
+        target_sources(${name} PRIVATE ${SHADER_INPUT} ${ShaderLayoutHeader})
+    else()
+        target_sources(${name} PRIVATE ${SHADER_INPUT} ${ShaderHeader} ${ShaderLayoutHeader})
+    endif()
     target_include_directories(${name} PUBLIC ${CMAKE_CURRENT_BINARY_DIR})
 endfunction()
+
+# add_shader_archive(<target> NAME <name> [COMPRESS] SHADERS <shader names...>)
+#
+# Packs shaders compiled with add_shader_module(... ARCHIVE) into <name>.nkshaders, which the target opens at runtime
+# with nkOpenShaderArchive(NK_SHADER_ARCHIVE_PATH). Each shader is looked up by the name it was compiled with.
+function(add_shader_archive name)
+    set(options COMPRESS)
+    set(oneValueArgs NAME)
+    set(multiValueArgs SHADERS)
+    cmake_parse_arguments(
+        ARCHIVE
+        "${options}"
+        "${oneValueArgs}"
+        "${multiValueArgs}"
+        ${ARGN}
+    )
+
+    get_filename_component(ArchiveOutput "${CMAKE_CURRENT_BINARY_DIR}/${ARCHIVE_NAME}.nkshaders" ABSOLUTE)
+
+    set(ArchiveFlags)
+    if(ARCHIVE_COMPRESS)
+        set(ArchiveFlags --compress)
+    endif()
+
+    set(ArchiveEntries)
+    set(ArchiveInputs)
+    foreach(Shader ${ARCHIVE_SHADERS})
+        get_filename_component(ShaderBin "${CMAKE_CURRENT_BINARY_DIR}/Neko/Shaders/${Shader}.spv" ABSOLUTE)
+        list(APPEND ArchiveEntries "${Shader}=${ShaderBin}")
+        list(APPEND ArchiveInputs ${ShaderBin})
+    endforeach()
+
+    add_custom_command(
+        OUTPUT  ${ArchiveOutput}
+        COMMAND ${CMAKE_COMMAND} -E echo "Packing shader archive: ${ArchiveOutput}"
+        COMMAND ShaderPacker ${ArchiveFlags} -o ${ArchiveOutput} ${ArchiveEntries}
+        DEPENDS ShaderPacker ${ArchiveInputs}
+    )
+
+    add_custom_target("${ARCHIVE_NAME}Shaders" ALL DEPENDS ${ArchiveOutput})
+    add_dependencies(${name} "${ARCHIVE_NAME}Shaders")
+
+    target_compile_definitions(${name} PRIVATE NK_SHADER_ARCHIVE_PATH="${ArchiveOutput}")
+endfunction()
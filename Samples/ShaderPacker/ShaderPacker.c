@@ -0,0 +1,302 @@
+// ShaderPacker: packs compiled shaders into one archive that nkOpenShaderArchive can map.
+//
+//     ShaderPacker [--compress] -o <archive> <name>=<shader binary>...
+//
+// Every shader is looked up at runtime by the name it was given here. With --compress shaders are stored as LZ4
+// blocks, unless compressing one doesn't make it smaller.
+
+#define NK_IMPLEMENTATION
+#include <Neko/Neko.h>
+
+#include <stdlib.h>
+
+typedef struct NkPackerEntry {
+    const char* name;
+    uint8_t* code;
+    size_t size;
+    uint8_t* stored;
+    size_t storedSize;
+    NkShaderArchiveEntry entry;
+} NkPackerEntry;
+
+#define NK_LZ4_HASH_BITS 12
+#define NK_LZ4_NO_POSITION 0xFFFFFFFFu
+
+static uint32_t nkLz4Read32(const uint8_t* bytes) {
+
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(uint32_t));
+    return value;
+}
+
+static void nkLz4WriteLength(uint8_t** out, size_t length) {
+
+    while (length >= 255) {
+        *(*out)++ = 255;
+        length -= 255;
+    }
+    *(*out)++ = NK_CAST(uint8_t, length);
+}
+
+static void nkLz4WriteSequence(uint8_t** out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+
+    uint8_t* token = (*out)++;
+    *token = NK_CAST(uint8_t, (NK_MIN(literalLength, 15) << 4));
+    if (literalLength >= 15) {
+        nkLz4WriteLength(out, literalLength - 15);
+    }
+
+    memcpy(*out, literals, literalLength);
+    *out += literalLength;
+
+    // the last sequence is literals only
+    if (matchLength == 0) {
+        return;
+    }
+
+    *(*out)++ = NK_CAST(uint8_t, (offset & 0xFF));
+    *(*out)++ = NK_CAST(uint8_t, (offset >> 8));
+
+    const size_t length = matchLength - 4;
+    *token |= NK_CAST(uint8_t, NK_MIN(length, 15));
+    if (length >= 15) {
+        nkLz4WriteLength(out, length - 15);
+    }
+}
+
+static size_t nkLz4CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+// Greedy LZ4 block compressor. The format wants the last five bytes to be literals, and the last match to start
+// at least twelve bytes before the end of the block.
+static size_t nkLz4Compress(const uint8_t* src, size_t size, uint8_t* dst) {
+
+    uint32_t* table = NK_PTR_CAST(uint32_t*, NK_MALLOC(sizeof(uint32_t) << NK_LZ4_HASH_BITS));
+    NK_ASSERT(table);
+    for (uint32_t i = 0; i < (1u << NK_LZ4_HASH_BITS); i++) {
+        table[i] = NK_LZ4_NO_POSITION;
+    }
+
+    uint8_t* out = dst;
+    size_t anchor = 0;
+    size_t position = 0;
+    const size_t matchLimit = size > 12 ? size - 12 : 0;
+
+    while (position < matchLimit) {
+        const uint32_t sequence = nkLz4Read32(src + position);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - NK_LZ4_HASH_BITS);
+        const uint32_t candidate = table[hash];
+        table[hash] = NK_CAST(uint32_t, position);
+
+        if (candidate == NK_LZ4_NO_POSITION || position - candidate > 0xFFFF || nkLz4Read32(src + candidate) != sequence) {
+            position++;
+            continue;
+        }
+
+        const size_t maxLength = size - 5 - position;
+        size_t matchLength = 4;
+        while (matchLength < maxLength && src[candidate + matchLength] == src[position + matchLength]) {
+            matchLength++;
+        }
+
+        nkLz4WriteSequence(&out, src + anchor, position - anchor, position - candidate, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+
+    nkLz4WriteSequence(&out, src + anchor, size - anchor, 0, 0);
+
+    NK_FREE(table);
+    return NK_CAST(size_t, (out - dst));
+}
+
+static uint8_t* nkReadFile(const char* path, size_t* size) {
+
+    FILE* file = fopen(path, "rb");
+    if (file == NK_NULL) {
+        return NK_NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = NK_NULL;
+    if (length > 0) {
+        data = NK_PTR_CAST(uint8_t*, NK_MALLOC(NK_CAST(size_t, length)));
+        NK_ASSERT(data);
+        if (fread(data, 1, NK_CAST(size_t, length), file) != NK_CAST(size_t, length)) {
+            NK_FREE(data);
+            data = NK_NULL;
+        }
+    }
+    fclose(file);
+
+    *size = NK_CAST(size_t, length);
+    return data;
+}
+
+static int nkCompareEntries(const void* lhs, const void* rhs) {
+
+    const uint64_t left = NK_PTR_CAST(const NkPackerEntry*, lhs)->entry.nameHash;
+    const uint64_t right = NK_PTR_CAST(const NkPackerEntry*, rhs)->entry.nameHash;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+static NkBool nkWritePadding(FILE* file, uint64_t* offset) {
+
+    static const uint8_t zeroes[NK_SHADER_ARCHIVE_ALIGNMENT] = { 0 };
+
+    const uint64_t padding = (NK_SHADER_ARCHIVE_ALIGNMENT - *offset % NK_SHADER_ARCHIVE_ALIGNMENT) % NK_SHADER_ARCHIVE_ALIGNMENT;
+    *offset += padding;
+    return fwrite(zeroes, 1, NK_CAST(size_t, padding), file) == padding ? NkTrue : NkFalse;
+}
+
+static int nkUsage(void) {
+
+    fprintf(stderr, "usage: ShaderPacker [--compress] -o <archive> <name>=<shader binary>...\n");
+    return EXIT_FAILURE;
+}
+
+// Parses the arguments into entries and writes the archive. Entries are counted as soon as they're started, so
+// main can free whatever was read however far this got.
+static int nkPack(int argc, char** argv, NkPackerEntry* entries, uint32_t* entryCountOut) {
+
+    const char* outputPath = NK_NULL;
+    NkBool compress = NkFalse;
+
+    uint32_t entryCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compress") == 0) {
+            compress = NkTrue;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else {
+            char* separator = strchr(argv[i], '=');
+            if (separator == NK_NULL || separator == argv[i]) {
+                return nkUsage();
+            }
+            *separator = '\0';
+
+            NkPackerEntry* entry = entries + entryCount++;
+            *entryCountOut = entryCount;
+            entry->name = argv[i];
+            entry->code = nkReadFile(separator + 1, &entry->size);
+            if (entry->code == NK_NULL || entry->size % sizeof(uint32_t) != 0 || entry->size > UINT32_MAX) {
+                fprintf(stderr, "ShaderPacker: '%s' is not a shader binary\n", separator + 1);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (outputPath == NK_NULL || entryCount == 0) {
+        return nkUsage();
+    }
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        NkPackerEntry* entry = entries + i;
+        entry->entry.nameHash = nkHashShaderName(entry->name);
+        entry->entry.codeHash = nkHashShaderCode(entry->code, entry->size);
+        entry->entry.size = NK_CAST(uint32_t, entry->size);
+        entry->entry.flags = NkShaderArchiveEntryFlags_None;
+        entry->stored = entry->code;
+        entry->storedSize = entry->size;
+
+        if (!compress) {
+            continue;
+        }
+
+        uint8_t* compressed = NK_PTR_CAST(uint8_t*, NK_MALLOC(nkLz4CompressBound(entry->size)));
+        NK_ASSERT(compressed);
+        const size_t compressedSize = nkLz4Compress(entry->code, entry->size, compressed);
+
+        // Every block is read back before it's trusted, a broken archive is worse than a big one.
+        uint8_t* roundTrip = NK_PTR_CAST(uint8_t*, NK_MALLOC(entry->size));
+        NK_ASSERT(roundTrip);
+        const NkBool valid = nkLz4Decompress(compressed, compressedSize, roundTrip, entry->size) &&
+            memcmp(roundTrip, entry->code, entry->size) == 0;
+        NK_FREE(roundTrip);
+
+        if (valid && compressedSize < entry->size) {
+            entry->stored = compressed;
+            entry->storedSize = compressedSize;
+            entry->entry.flags = NkShaderArchiveEntryFlags_Compressed;
+        }
+        else {
+            NK_FREE(compressed);
+        }
+    }
+
+    qsort(entries, entryCount, sizeof(NkPackerEntry), nkCompareEntries);
+
+    for (uint32_t i = 1; i < entryCount; i++) {
+        if (entries[i - 1].entry.nameHash == entries[i].entry.nameHash) {
+            fprintf(stderr, "ShaderPacker: '%s' and '%s' can't share an archive\n", entries[i - 1].name, entries[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint64_t offset = sizeof(NkShaderArchiveHeader) + sizeof(NkShaderArchiveEntry) * entryCount;
+    for (uint32_t i = 0; i < entryCount; i++) {
+        offset += (NK_SHADER_ARCHIVE_ALIGNMENT - offset % NK_SHADER_ARCHIVE_ALIGNMENT) % NK_SHADER_ARCHIVE_ALIGNMENT;
+        entries[i].entry.offset = offset;
+        entries[i].entry.storedSize = NK_CAST(uint32_t, entries[i].storedSize);
+        offset += entries[i].storedSize;
+    }
+
+    FILE* file = fopen(outputPath, "wb");
+    if (file == NK_NULL) {
+        fprintf(stderr, "ShaderPacker: couldn't open '%s' for writing\n", outputPath);
+        return EXIT_FAILURE;
+    }
+
+    NkShaderArchiveHeader header;
+    header.magic = NK_SHADER_ARCHIVE_MAGIC;
+    header.version = NK_SHADER_ARCHIVE_VERSION;
+    header.entryCount = entryCount;
+    header.reserved = 0;
+
+    NkBool written = fwrite(&header, sizeof(header), 1, file) == 1 ? NkTrue : NkFalse;
+    for (uint32_t i = 0; i < entryCount && written; i++) {
+        written = fwrite(&entries[i].entry, sizeof(NkShaderArchiveEntry), 1, file) == 1 ? NkTrue : NkFalse;
+    }
+
+    offset = sizeof(NkShaderArchiveHeader) + sizeof(NkShaderArchiveEntry) * entryCount;
+    for (uint32_t i = 0; i < entryCount && written; i++) {
+        written = nkWritePadding(file, &offset);
+        written = written && fwrite(entries[i].stored, 1, entries[i].storedSize, file) == entries[i].storedSize ? NkTrue : NkFalse;
+        offset += entries[i].storedSize;
+    }
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "ShaderPacker: couldn't write '%s'\n", outputPath);
+        remove(outputPath);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+
+    // Zeroed, so entries that never got their code or a compressed copy free nothing.
+    NkPackerEntry* entries = NK_PTR_CAST(NkPackerEntry*, NK_CALLOC(NK_MAX(argc, 1), sizeof(NkPackerEntry)));
+    NK_ASSERT(entries);
+    uint32_t entryCount = 0;
+
+    const int result = nkPack(argc, argv, entries, &entryCount);
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        if (entries[i].stored != entries[i].code) {
+            NK_FREE(entries[i].stored);
+        }
+        NK_FREE(entries[i].code);
+    }
+    NK_FREE(entries);
+
+    return result;
+}
@@ -0,0 +1,845 @@
+// ShaderReflector: writes a C header describing the interface of a compiled shader.
+//
+//     ShaderReflector <shader binary> <header> <name>
+//
+// The header holds an NkBindGroupLayoutEntry array per bind group, the NkVertexAttributeInfo table of a vertex
+// shader and a C struct for every buffer block, padded to match the shader and checked with static asserts.
+// Everything is prefixed with Nk<name>. It needs SPIR-V that still has its debug names, so run it before stripping.
+
+#define NK_IMPLEMENTATION
+#include <Neko/Neko.h>
+
+#include <stdlib.h>
+
+#define NK_SPIRV_MAGIC 0x07230203
+
+typedef enum NkSpirvOp {
+    NkSpirvOp_Name = 5,
+    NkSpirvOp_MemberName = 6,
+    NkSpirvOp_EntryPoint = 15,
+    NkSpirvOp_TypeBool = 20,
+    NkSpirvOp_TypeInt = 21,
+    NkSpirvOp_TypeFloat = 22,
+    NkSpirvOp_TypeVector = 23,
+    NkSpirvOp_TypeMatrix = 24,
+    NkSpirvOp_TypeImage = 25,
+    NkSpirvOp_TypeSampler = 26,
+    NkSpirvOp_TypeSampledImage = 27,
+    NkSpirvOp_TypeArray = 28,
+    NkSpirvOp_TypeRuntimeArray = 29,
+    NkSpirvOp_TypeStruct = 30,
+    NkSpirvOp_TypePointer = 32,
+    NkSpirvOp_Constant = 43,
+    NkSpirvOp_Function = 54,
+    NkSpirvOp_Variable = 59,
+    NkSpirvOp_Decorate = 71,
+    NkSpirvOp_MemberDecorate = 72,
+} NkSpirvOp;
+
+typedef enum NkSpirvDecoration {
+    NkSpirvDecoration_Block = 2,
+    NkSpirvDecoration_BufferBlock = 3,
+    NkSpirvDecoration_RowMajor = 4,
+    NkSpirvDecoration_ArrayStride = 6,
+    NkSpirvDecoration_MatrixStride = 7,
+    NkSpirvDecoration_BuiltIn = 11,
+    NkSpirvDecoration_NonWritable = 24,
+    NkSpirvDecoration_Location = 30,
+    NkSpirvDecoration_Binding = 33,
+    NkSpirvDecoration_DescriptorSet = 34,
+    NkSpirvDecoration_Offset = 35,
+} NkSpirvDecoration;
+
+typedef enum NkSpirvStorageClass {
+    NkSpirvStorageClass_UniformConstant = 0,
+    NkSpirvStorageClass_Input = 1,
+    NkSpirvStorageClass_Uniform = 2,
+    NkSpirvStorageClass_PushConstant = 9,
+    NkSpirvStorageClass_StorageBuffer = 12,
+} NkSpirvStorageClass;
+
+#define NK_SPIRV_EXECUTION_MODEL_VERTEX 0
+#define NK_SPIRV_EXECUTION_MODEL_FRAGMENT 4
+#define NK_SPIRV_EXECUTION_MODEL_COMPUTE 5
+
+#define NK_SPIRV_DIM_1D 0
+#define NK_SPIRV_DIM_3D 2
+#define NK_SPIRV_DIM_CUBE 3
+#define NK_SPIRV_DIM_BUFFER 5
+#define NK_SPIRV_DIM_SUBPASS_DATA 6
+
+#define NK_SPIRV_FLAG_SET (1u << 0)
+#define NK_SPIRV_FLAG_BINDING (1u << 1)
+#define NK_SPIRV_FLAG_LOCATION (1u << 2)
+#define NK_SPIRV_FLAG_BLOCK (1u << 3)
+#define NK_SPIRV_FLAG_BUFFER_BLOCK (1u << 4)
+#define NK_SPIRV_FLAG_BUILT_IN (1u << 5)
+#define NK_SPIRV_FLAG_NON_WRITABLE (1u << 6)
+#define NK_SPIRV_FLAG_EMITTED (1u << 7)
+
+typedef struct NkReflectorMember {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t matrixStride;
+    NkBool rowMajor;
+    const char* name;
+} NkReflectorMember;
+
+// What the reflector remembers about a single SPIR-V id. As in the runtime reflection, the meaning of the operands
+// depends on the opcode that defined the id.
+typedef struct NkReflectorId {
+    uint32_t opcode;
+    uint32_t operands[9];
+    uint32_t size;
+    uint32_t paddedSize;
+    uint32_t flags;
+    uint32_t set;
+    uint32_t binding;
+    uint32_t location;
+    uint32_t arrayStride;
+    const char* name;
+    NkReflectorMember* members;
+    uint32_t memberCount;
+} NkReflectorId;
+
+typedef struct NkReflectorVariable {
+    uint32_t id;
+    uint32_t storageClass;
+    uint32_t type;
+} NkReflectorVariable;
+
+typedef struct NkReflector {
+    const char* prefix;
+    NkReflectorId* ids;
+    uint32_t bound;
+    uint32_t executionModel;
+    NkReflectorVariable* variables;
+    uint32_t variableCount;
+} NkReflector;
+
+static uint8_t* nkReadFile(const char* path, size_t* size) {
+
+    FILE* file = fopen(path, "rb");
+    if (file == NK_NULL) {
+        return NK_NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = NK_NULL;
+    if (length > 0) {
+        data = NK_PTR_CAST(uint8_t*, NK_MALLOC(NK_CAST(size_t, length)));
+        NK_ASSERT(data);
+        if (fread(data, 1, NK_CAST(size_t, length), file) != NK_CAST(size_t, length)) {
+            NK_FREE(data);
+            data = NK_NULL;
+        }
+    }
+    fclose(file);
+
+    *size = NK_CAST(size_t, length);
+    return data;
+}
+
+// DXC names block types things like "type.ConstantBuffer.Constants", only the last part is worth keeping.
+static void nkWriteIdentifier(FILE* out, const char* name, const char* fallback, uint32_t fallbackIndex) {
+
+    const char* start = name ? strrchr(name, '.') : NK_NULL;
+    start = start ? start + 1 : name;
+
+    if (start == NK_NULL || *start == '\0') {
+        fprintf(out, "%s%u", fallback, fallbackIndex);
+        return;
+    }
+
+    if (*start >= '0' && *start <= '9') {
+        fputc('_', out);
+    }
+    for (const char* c = start; *c; c++) {
+        const NkBool valid = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_';
+        fputc(valid ? *c : '_', out);
+    }
+}
+
+static void nkWriteStructName(FILE* out, const NkReflector* reflector, uint32_t structId) {
+
+    fputs(reflector->prefix, out);
+    nkWriteIdentifier(out, reflector->ids[structId].name, "Struct", structId);
+}
+
+static const char* nkScalarType(const NkReflectorId* scalar) {
+
+    if (scalar->opcode == NkSpirvOp_TypeFloat) {
+        return scalar->operands[0] == 64 ? "double" : scalar->operands[0] == 16 ? "uint16_t" : "float";
+    }
+    if (scalar->opcode == NkSpirvOp_TypeInt) {
+        if (scalar->operands[0] == 64) {
+            return scalar->operands[1] ? "int64_t" : "uint64_t";
+        }
+        if (scalar->operands[0] == 16) {
+            return scalar->operands[1] ? "int16_t" : "uint16_t";
+        }
+        return scalar->operands[1] ? "int32_t" : "uint32_t";
+    }
+    return "uint32_t"; // booleans are 32 bits wide in buffers
+}
+
+static uint32_t nkScalarSize(const NkReflectorId* scalar) {
+    return scalar->opcode == NkSpirvOp_TypeBool ? 4 : scalar->operands[0] / 8;
+}
+
+// Writes a member as a C declaration. Vectors and matrices become arrays of their scalar type, and array elements
+// that the shader pads out to a larger stride get that padding as an extra dimension.
+static void nkWriteMember(FILE* out, const NkReflector* reflector, const NkReflectorMember* member, uint32_t memberIndex) {
+
+    const NkReflectorId* ids = reflector->ids;
+
+    char dimensions[256] = "";
+    size_t length = 0;
+
+    uint32_t typeId = member->type;
+    uint32_t elementStride = 0;
+    while (ids[typeId].opcode == NkSpirvOp_TypeArray) {
+        length += snprintf(dimensions + length, sizeof(dimensions) - length, "[%u]", ids[typeId].operands[1]);
+        elementStride = ids[typeId].arrayStride;
+        typeId = ids[typeId].operands[0];
+    }
+
+    const NkReflectorId* type = ids + typeId;
+
+    if (type->opcode == NkSpirvOp_TypeStruct) {
+        fputs("    ", out);
+        nkWriteStructName(out, reflector, typeId);
+    }
+    else if (type->opcode == NkSpirvOp_TypeMatrix) {
+        const NkReflectorId* column = ids + type->operands[0];
+        const NkReflectorId* scalar = ids + column->operands[0];
+        const uint32_t vectorCount = member->rowMajor ? column->operands[1] : type->operands[1];
+        const uint32_t vectorSize = member->matrixStride ? member->matrixStride : column->size;
+        snprintf(dimensions + length, sizeof(dimensions) - length, "[%u][%u]", vectorCount, vectorSize / nkScalarSize(scalar));
+        fprintf(out, "    %s", nkScalarType(scalar));
+    }
+    else {
+        const NkReflectorId* scalar = type->opcode == NkSpirvOp_TypeVector ? ids + type->operands[0] : type;
+        const uint32_t componentCount = type->opcode == NkSpirvOp_TypeVector ? type->operands[1] : 1;
+        const uint32_t paddedCount = NK_MAX(componentCount, elementStride / nkScalarSize(scalar));
+        if (paddedCount > 1) {
+            snprintf(dimensions + length, sizeof(dimensions) - length, "[%u]", paddedCount);
+        }
+        fprintf(out, "    %s", nkScalarType(scalar));
+    }
+
+    fputc(' ', out);
+    nkWriteIdentifier(out, member->name, "member", memberIndex);
+    fprintf(out, "%s;\n", dimensions);
+}
+
+static uint32_t nkMemberSize(const NkReflector* reflector, const NkReflectorMember* member) {
+
+    const NkReflectorId* type = reflector->ids + member->type;
+    if (type->opcode == NkSpirvOp_TypeMatrix && member->matrixStride) {
+        const NkReflectorId* column = reflector->ids + type->operands[0];
+        return (member->rowMajor ? column->operands[1] : type->operands[1]) * member->matrixStride;
+    }
+    if (type->opcode == NkSpirvOp_TypeStruct) {
+        return type->paddedSize;
+    }
+    return type->size;
+}
+
+static void nkWriteStruct(FILE* out, NkReflector* reflector, uint32_t structId) {
+
+    NkReflectorId* type = reflector->ids + structId;
+    if (type->flags & NK_SPIRV_FLAG_EMITTED) {
+        return;
+    }
+    type->flags |= NK_SPIRV_FLAG_EMITTED;
+
+    // Nested structs go first, C needs them complete before they're used.
+    for (uint32_t i = 0; i < type->memberCount; i++) {
+        uint32_t memberType = type->members[i].type;
+        while (reflector->ids[memberType].opcode == NkSpirvOp_TypeArray) {
+            memberType = reflector->ids[memberType].operands[0];
+        }
+        if (reflector->ids[memberType].opcode == NkSpirvOp_TypeStruct) {
+            nkWriteStruct(out, reflector, memberType);
+        }
+    }
+
+    fputs("typedef struct ", out);
+    nkWriteStructName(out, reflector, structId);
+    fputs(" {\n", out);
+
+    uint32_t offset = 0;
+    uint32_t paddingCount = 0;
+    for (uint32_t i = 0; i < type->memberCount; i++) {
+        const NkReflectorMember* member = type->members + i;
+
+        // A runtime array can't be a C member, it's whatever follows the struct in the buffer.
+        if (reflector->ids[member->type].opcode == NkSpirvOp_TypeRuntimeArray) {
+            fputs("    // ", out);
+            nkWriteIdentifier(out, member->name, "member", i);
+            fprintf(out, ": runtime array with a stride of %u bytes follows\n", reflector->ids[member->type].arrayStride);
+            continue;
+        }
+
+        if (member->offset > offset) {
+            fprintf(out, "    uint8_t padding%u[%u];\n", paddingCount++, member->offset - offset);
+        }
+        nkWriteMember(out, reflector, member, i);
+        offset = member->offset + nkMemberSize(reflector, member);
+    }
+
+    if (type->paddedSize > offset) {
+        fprintf(out, "    uint8_t padding%u[%u];\n", paddingCount++, type->paddedSize - offset);
+    }
+
+    fputs("} ", out);
+    nkWriteStructName(out, reflector, structId);
+    fputs(";\n\n", out);
+
+    fputs("NK_STATIC_ASSERT(sizeof(", out);
+    nkWriteStructName(out, reflector, structId);
+    fprintf(out, ") == %u, \"size doesn't match the shader\");\n", type->paddedSize);
+
+    for (uint32_t i = 0; i < type->memberCount; i++) {
+        const NkReflectorMember* member = type->members + i;
+        if (reflector->ids[member->type].opcode == NkSpirvOp_TypeRuntimeArray) {
+            continue;
+        }
+        fputs("NK_STATIC_ASSERT(offsetof(", out);
+        nkWriteStructName(out, reflector, structId);
+        fputs(", ", out);
+        nkWriteIdentifier(out, member->name, "member", i);
+        fprintf(out, ") == %u, \"offset doesn't match the shader\");\n", member->offset);
+    }
+    fputc('\n', out);
+}
+
+static const char* nkStorageTextureFormat(uint32_t format) {
+
+    switch (format) {
+    case 1: return "NkTextureFormat_RGBA32Float";
+    case 2: return "NkTextureFormat_RGBA16Float";
+    case 3: return "NkTextureFormat_R32Float";
+    case 4: return "NkTextureFormat_RGBA8Unorm";
+    case 5: return "NkTextureFormat_RGBA8Snorm";
+    case 23: return "NkTextureFormat_RGBA8Sint";
+    case 32: return "NkTextureFormat_RGBA8Uint";
+    case 33: return "NkTextureFormat_R32Uint";
+    default: return NK_NULL;
+    }
+}
+
+static const char* nkViewDimension(const NkReflectorId* image) {
+
+    const NkBool arrayed = image->operands[3] ? NkTrue : NkFalse;
+    switch (image->operands[0]) {
+    case NK_SPIRV_DIM_1D: return "NkTextureViewDimension_1D";
+    case NK_SPIRV_DIM_3D: return "NkTextureViewDimension_3D";
+    case NK_SPIRV_DIM_CUBE: return arrayed ? "NkTextureViewDimension_CubeArray" : "NkTextureViewDimension_Cube";
+    default: return arrayed ? "NkTextureViewDimension_2DArray" : "NkTextureViewDimension_2D";
+    }
+}
+
+static const char* nkVisibility(uint32_t executionModel) {
+
+    switch (executionModel) {
+    case NK_SPIRV_EXECUTION_MODEL_VERTEX: return "NkShaderStage_Vertex";
+    case NK_SPIRV_EXECUTION_MODEL_FRAGMENT: return "NkShaderStage_Fragment";
+    case NK_SPIRV_EXECUTION_MODEL_COMPUTE: return "NkShaderStage_Compute";
+    default: return "NkShaderStage_None";
+    }
+}
+
+// Writes one binding as an NkBindGroupLayoutEntry initializer. Mirrors nkVkReflectBindingType.
+static NkBool nkWriteBinding(FILE* out, const NkReflector* reflector, const NkReflectorVariable* variable) {
+
+    const NkReflectorId* ids = reflector->ids;
+    const NkReflectorId* id = ids + variable->id;
+
+    uint32_t typeId = variable->type;
+    uint32_t arraySize = 1;
+    if (ids[typeId].opcode == NkSpirvOp_TypeArray) {
+        arraySize = ids[typeId].operands[1];
+        typeId = ids[typeId].operands[0];
+    }
+    else if (ids[typeId].opcode == NkSpirvOp_TypeRuntimeArray) {
+        arraySize = 0;
+        typeId = ids[typeId].operands[0];
+    }
+    const NkReflectorId* type = ids + typeId;
+
+    char fields[256] = "";
+    const char* bindingType = NK_NULL;
+
+    if (variable->storageClass == NkSpirvStorageClass_StorageBuffer ||
+        (variable->storageClass == NkSpirvStorageClass_Uniform && (type->flags & NK_SPIRV_FLAG_BUFFER_BLOCK))) {
+        bindingType = (id->flags & NK_SPIRV_FLAG_NON_WRITABLE) ? "NkBindingType_ReadonlyStorageBuffer" : "NkBindingType_StorageBuffer";
+        snprintf(fields, sizeof(fields), ", .minBufferBindingSize = %u", type->size);
+    }
+    else if (variable->storageClass == NkSpirvStorageClass_Uniform) {
+        bindingType = "NkBindingType_UniformBuffer";
+        snprintf(fields, sizeof(fields), ", .minBufferBindingSize = %u", type->size);
+    }
+    else if (type->opcode == NkSpirvOp_TypeSampler) {
+        bindingType = "NkBindingType_Sampler";
+    }
+    else if (type->opcode == NkSpirvOp_TypeSampledImage) {
+        bindingType = "NkBindingType_CombinedTextureSampler";
+        type = ids + type->operands[0];
+    }
+    else if (type->opcode == NkSpirvOp_TypeImage) {
+        if (type->operands[0] == NK_SPIRV_DIM_BUFFER || type->operands[0] == NK_SPIRV_DIM_SUBPASS_DATA) {
+            return NkFalse;
+        }
+        if (type->operands[2] == 2) {
+            bindingType = (id->flags & NK_SPIRV_FLAG_NON_WRITABLE) ? "NkBindingType_ReadonlyStorageTexture" : "NkBindingType_WriteonlyStorageTexture";
+        }
+        else {
+            bindingType = type->operands[1] ? "NkBindingType_MultisampledTexture" : "NkBindingType_SampledTexture";
+        }
+    }
+
+    if (bindingType == NK_NULL) {
+        return NkFalse;
+    }
+
+    if (type->opcode == NkSpirvOp_TypeImage) {
+        const NkReflectorId* sampled = ids + type->operands[4];
+        const char* componentType = sampled->opcode == NkSpirvOp_TypeFloat ? "NkTextureComponentType_Float" :
+            sampled->operands[1] ? "NkTextureComponentType_Sint" : "NkTextureComponentType_Uint";
+        const char* storageFormat = nkStorageTextureFormat(type->operands[5]);
+
+        // fields are written in declaration order, so the header also builds as C++20
+        size_t length = 0;
+        if (type->operands[1]) {
+            length += snprintf(fields + length, sizeof(fields) - length, ", .multisampled = NkTrue");
+        }
+        length += snprintf(fields + length, sizeof(fields) - length, ", .viewDimension = %s, .textureComponentType = %s",
+            nkViewDimension(type), componentType);
+        if (type->operands[2] == 2 && storageFormat) {
+            snprintf(fields + length, sizeof(fields) - length, ", .storageTextureFormat = %s", storageFormat);
+        }
+    }
+
+    fprintf(out, "    { .binding = %u, .visibility = %s, .type = %s%s, .arraySize = %u },\n",
+        id->binding, nkVisibility(reflector->executionModel), bindingType, fields, arraySize);
+    return NkTrue;
+}
+
+static const char* nkVertexFormat(const NkReflectorId* ids, uint32_t typeId, uint32_t* size) {
+
+    static const char* floatFormats[] = { "NkVertexFormat_Float", "NkVertexFormat_Float2", "NkVertexFormat_Float3", "NkVertexFormat_Float4" };
+    static const char* uintFormats[] = { "NkVertexFormat_UInt", "NkVertexFormat_UInt2", "NkVertexFormat_UInt3", "NkVertexFormat_UInt4" };
+    static const char* intFormats[] = { "NkVertexFormat_Int", "NkVertexFormat_Int2", "NkVertexFormat_Int3", "NkVertexFormat_Int4" };
+
+    const NkReflectorId* type = ids + typeId;
+    const NkReflectorId* scalar = type->opcode == NkSpirvOp_TypeVector ? ids + type->operands[0] : type;
+    const uint32_t componentCount = type->opcode == NkSpirvOp_TypeVector ? type->operands[1] : 1;
+
+    if ((scalar->opcode != NkSpirvOp_TypeFloat && scalar->opcode != NkSpirvOp_TypeInt) ||
+        scalar->operands[0] != 32 || componentCount < 1 || componentCount > 4) {
+        return NK_NULL;
+    }
+
+    *size = componentCount * 4;
+    if (scalar->opcode == NkSpirvOp_TypeFloat) {
+        return floatFormats[componentCount - 1];
+    }
+    return scalar->operands[1] ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+}
+
+static const NkReflectorId* nkSortIds;
+
+static int nkCompareInputs(const void* lhs, const void* rhs) {
+
+    const uint32_t left = nkSortIds[NK_PTR_CAST(const NkReflectorVariable*, lhs)->id].location;
+    const uint32_t right = nkSortIds[NK_PTR_CAST(const NkReflectorVariable*, rhs)->id].location;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+static int nkCompareBindings(const void* lhs, const void* rhs) {
+
+    const NkReflectorId* left = nkSortIds + NK_PTR_CAST(const NkReflectorVariable*, lhs)->id;
+    const NkReflectorId* right = nkSortIds + NK_PTR_CAST(const NkReflectorVariable*, rhs)->id;
+    if (left->set != right->set) {
+        return left->set < right->set ? -1 : 1;
+    }
+    return left->binding < right->binding ? -1 : (left->binding > right->binding ? 1 : 0);
+}
+
+// Vertex inputs are laid out tightly in location order, in a single interleaved buffer.
+static void nkWriteVertexLayout(FILE* out, NkReflector* reflector) {
+
+    NkReflectorVariable* inputs = NK_PTR_CAST(NkReflectorVariable*, NK_MALLOC(sizeof(NkReflectorVariable) * NK_MAX(reflector->variableCount, 1)));
+    NK_ASSERT(inputs);
+
+    uint32_t inputCount = 0;
+    for (uint32_t i = 0; i < reflector->variableCount; i++) {
+        const NkReflectorVariable* variable = reflector->variables + i;
+        const NkReflectorId* id = reflector->ids + variable->id;
+        if (variable->storageClass == NkSpirvStorageClass_Input && (id->flags & NK_SPIRV_FLAG_LOCATION) &&
+            !(id->flags & NK_SPIRV_FLAG_BUILT_IN)) {
+            inputs[inputCount++] = *variable;
+        }
+    }
+
+    if (inputCount > 0) {
+        nkSortIds = reflector->ids;
+        qsort(inputs, inputCount, sizeof(NkReflectorVariable), nkCompareInputs);
+
+        fprintf(out, "static const NkVertexAttributeInfo %sAttributes[] = {\n", reflector->prefix);
+
+        uint32_t offset = 0;
+        uint32_t attributeCount = 0;
+        for (uint32_t i = 0; i < inputCount; i++) {
+            uint32_t size = 0;
+            const char* format = nkVertexFormat(reflector->ids, inputs[i].type, &size);
+            if (format == NK_NULL) {
+                fprintf(stderr, "ShaderReflector: skipping vertex input at location %u, it has no NkVertexFormat\n",
+                    reflector->ids[inputs[i].id].location);
+                continue;
+            }
+            fprintf(out, "    { .format = %s, .offset = %u, .shaderLocation = %u },\n", format, offset, reflector->ids[inputs[i].id].location);
+            offset += size;
+            attributeCount++;
+        }
+        fputs("};\n\n", out);
+
+        fprintf(out, "static const NkVertexBufferLayoutInfo %sVertexBuffer = {\n", reflector->prefix);
+        fprintf(out, "    .arrayStride = %u,\n", offset);
+        fprintf(out, "    .stepMode = NkInputStepMode_Vertex,\n");
+        fprintf(out, "    .attributeCount = %u,\n", attributeCount);
+        fprintf(out, "    .attributes = %sAttributes\n", reflector->prefix);
+        fputs("};\n\n", out);
+    }
+
+    NK_FREE(inputs);
+}
+
+static void nkWriteBindGroups(FILE* out, NkReflector* reflector) {
+
+    NkReflectorVariable* bindings = NK_PTR_CAST(NkReflectorVariable*, NK_MALLOC(sizeof(NkReflectorVariable) * NK_MAX(reflector->variableCount, 1)));
+    NK_ASSERT(bindings);
+
+    uint32_t bindingCount = 0;
+    for (uint32_t i = 0; i < reflector->variableCount; i++) {
+        const NkReflectorVariable* variable = reflector->variables + i;
+        if ((variable->storageClass == NkSpirvStorageClass_UniformConstant || variable->storageClass == NkSpirvStorageClass_Uniform ||
+             variable->storageClass == NkSpirvStorageClass_StorageBuffer) && (reflector->ids[variable->id].flags & NK_SPIRV_FLAG_BINDING)) {
+            bindings[bindingCount++] = *variable;
+        }
+    }
+
+    nkSortIds = reflector->ids;
+    qsort(bindings, bindingCount, sizeof(NkReflectorVariable), nkCompareBindings);
+
+    for (uint32_t first = 0; first < bindingCount;) {
+        const uint32_t group = reflector->ids[bindings[first].id].set;
+
+        fprintf(out, "static const NkBindGroupLayoutEntry %sGroup%uEntries[] = {\n", reflector->prefix, group);
+
+        uint32_t entryCount = 0;
+        uint32_t last = first;
+        for (; last < bindingCount && reflector->ids[bindings[last].id].set == group; last++) {
+            if (nkWriteBinding(out, reflector, bindings + last)) {
+                entryCount++;
+            }
+            else {
+                fprintf(stderr, "ShaderReflector: ignoring unsupported shader resource at set %u, binding %u\n",
+                    group, reflector->ids[bindings[last].id].binding);
+            }
+        }
+        fputs("};\n\n", out);
+
+        fprintf(out, "static const NkBindGroupLayoutInfo %sGroup%u = {\n", reflector->prefix, group);
+        fprintf(out, "    .entryCount = %u,\n", entryCount);
+        fprintf(out, "    .entries = %sGroup%uEntries\n", reflector->prefix, group);
+        fputs("};\n\n", out);
+
+        first = last;
+    }
+
+    NK_FREE(bindings);
+}
+
+static NkBool nkReflect(NkReflector* reflector, const uint32_t* code, size_t wordCount) {
+
+    if (wordCount < 5 || code[0] != NK_SPIRV_MAGIC) {
+        return NkFalse;
+    }
+
+    reflector->bound = code[3];
+    reflector->ids = NK_PTR_CAST(NkReflectorId*, NK_CALLOC(reflector->bound, sizeof(NkReflectorId)));
+    reflector->variables = NK_PTR_CAST(NkReflectorVariable*, NK_MALLOC(sizeof(NkReflectorVariable) * reflector->bound));
+    reflector->variableCount = 0;
+    reflector->executionModel = NK_SPIRV_EXECUTION_MODEL_VERTEX;
+    NK_ASSERT(reflector->ids && reflector->variables);
+
+    NkReflectorId* ids = reflector->ids;
+
+    // Member decorations and names come before the struct they belong to, so structs are sized up first.
+    for (size_t word = 5; word < wordCount;) {
+        const uint32_t opcode = code[word] & 0xFFFF;
+        const uint32_t length = code[word] >> 16;
+        if (length == 0 || word + length > wordCount || opcode == NkSpirvOp_Function) {
+            break;
+        }
+        if (opcode == NkSpirvOp_TypeStruct && code[word + 1] < reflector->bound) {
+            NkReflectorId* type = ids + code[word + 1];
+            type->memberCount = length - 2;
+            type->members = NK_PTR_CAST(NkReflectorMember*, NK_CALLOC(NK_MAX(type->memberCount, 1), sizeof(NkReflectorMember)));
+            NK_ASSERT(type->members);
+        }
+        word += length;
+    }
+
+    for (size_t word = 5; word < wordCount;) {
+        const uint32_t opcode = code[word] & 0xFFFF;
+        const uint32_t length = code[word] >> 16;
+        const uint32_t* operands = code + word + 1;
+
+        if (length == 0 || word + length > wordCount || opcode == NkSpirvOp_Function) {
+            break;
+        }
+        if (length > 1 && operands[0] >= reflector->bound && opcode != NkSpirvOp_EntryPoint && opcode != NkSpirvOp_Constant) {
+            return NkFalse;
+        }
+
+        switch (opcode) {
+        case NkSpirvOp_Name:
+            ids[operands[0]].name = NK_PTR_CAST(const char*, (operands + 1));
+            break;
+        case NkSpirvOp_MemberName:
+            if (operands[1] < ids[operands[0]].memberCount) {
+                ids[operands[0]].members[operands[1]].name = NK_PTR_CAST(const char*, (operands + 2));
+            }
+            break;
+        case NkSpirvOp_EntryPoint:
+            reflector->executionModel = operands[0];
+            break;
+        case NkSpirvOp_Decorate: {
+            NkReflectorId* target = ids + operands[0];
+            switch (operands[1]) {
+            case NkSpirvDecoration_Block:
+                target->flags |= NK_SPIRV_FLAG_BLOCK;
+                break;
+            case NkSpirvDecoration_BufferBlock:
+                target->flags |= NK_SPIRV_FLAG_BUFFER_BLOCK;
+                break;
+            case NkSpirvDecoration_ArrayStride:
+                target->arrayStride = operands[2];
+                break;
+            case NkSpirvDecoration_BuiltIn:
+                target->flags |= NK_SPIRV_FLAG_BUILT_IN;
+                break;
+            case NkSpirvDecoration_NonWritable:
+                target->flags |= NK_SPIRV_FLAG_NON_WRITABLE;
+                break;
+            case NkSpirvDecoration_Location:
+                target->flags |= NK_SPIRV_FLAG_LOCATION;
+                target->location = operands[2];
+                break;
+            case NkSpirvDecoration_Binding:
+                target->flags |= NK_SPIRV_FLAG_BINDING;
+                target->binding = operands[2];
+                break;
+            case NkSpirvDecoration_DescriptorSet:
+                target->flags |= NK_SPIRV_FLAG_SET;
+                target->set = operands[2];
+                break;
+            }
+            break;
+        }
+        case NkSpirvOp_MemberDecorate: {
+            NkReflectorId* target = ids + operands[0];
+            if (operands[1] >= target->memberCount) {
+                break;
+            }
+            NkReflectorMember* member = target->members + operands[1];
+            switch (operands[2]) {
+            case NkSpirvDecoration_Offset:
+                member->offset = operands[3];
+                break;
+            case NkSpirvDecoration_MatrixStride:
+                member->matrixStride = operands[3];
+                break;
+            case NkSpirvDecoration_RowMajor:
+                member->rowMajor = NkTrue;
+                break;
+            case NkSpirvDecoration_BuiltIn:
+                target->flags |= NK_SPIRV_FLAG_BUILT_IN;
+                break;
+            }
+            break;
+        }
+        case NkSpirvOp_TypeBool:
+            ids[operands[0]].opcode = opcode;
+            ids[operands[0]].size = 4;
+            break;
+        case NkSpirvOp_TypeInt:
+        case NkSpirvOp_TypeFloat: {
+            NkReflectorId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1]; // width
+            type->operands[1] = opcode == NkSpirvOp_TypeInt ? operands[2] : 1; // signedness
+            type->size = operands[1] / 8;
+            break;
+        }
+        case NkSpirvOp_TypeVector:
+        case NkSpirvOp_TypeMatrix: {
+            NkReflectorId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1]; // component or column type
+            type->operands[1] = operands[2]; // component or column count
+            type->size = ids[operands[1]].size * operands[2];
+            break;
+        }
+        case NkSpirvOp_TypeImage: {
+            NkReflectorId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[2]; // dim
+            type->operands[1] = operands[5]; // multisampled
+            type->operands[2] = operands[6]; // sampled: 1 sampled image, 2 storage image
+            type->operands[3] = operands[4]; // arrayed
+            type->operands[4] = operands[1]; // sampled type
+            type->operands[5] = operands[7]; // image format
+            break;
+        }
+        case NkSpirvOp_TypeSampler:
+            ids[operands[0]].opcode = opcode;
+            break;
+        case NkSpirvOp_TypeSampledImage:
+            ids[operands[0]].opcode = opcode;
+            ids[operands[0]].operands[0] = operands[1]; // image type
+            break;
+        case NkSpirvOp_TypeArray:
+        case NkSpirvOp_TypeRuntimeArray: {
+            NkReflectorId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1];
+            type->operands[1] = opcode == NkSpirvOp_TypeArray ? ids[operands[2]].operands[0] : 0;
+            if (type->arrayStride == 0) {
+                type->arrayStride = ids[operands[1]].opcode == NkSpirvOp_TypeStruct ? ids[operands[1]].paddedSize : ids[operands[1]].size;
+            }
+            type->size = type->arrayStride * type->operands[1];
+
+            // Structs in arrays are padded out to the array stride.
+            NkReflectorId* element = ids + operands[1];
+            if (element->opcode == NkSpirvOp_TypeStruct) {
+                element->paddedSize = NK_MAX(element->paddedSize, type->arrayStride);
+            }
+            break;
+        }
+        case NkSpirvOp_TypeStruct: {
+            NkReflectorId* type = ids + operands[0];
+            type->opcode = opcode;
+            uint32_t size = 0;
+            for (uint32_t member = 0; member < type->memberCount; member++) {
+                type->members[member].type = operands[member + 1];
+                if (ids[operands[member + 1]].opcode != NkSpirvOp_TypeRuntimeArray) {
+                    size = NK_MAX(size, type->members[member].offset + nkMemberSize(reflector, type->members + member));
+                }
+            }
+            type->size = size;
+            type->paddedSize = size;
+            break;
+        }
+        case NkSpirvOp_TypePointer: {
+            NkReflectorId* type = ids + operands[0];
+            type->opcode = opcode;
+            type->operands[0] = operands[1]; // storage class
+            type->operands[1] = operands[2]; // pointee
+            break;
+        }
+        case NkSpirvOp_Constant:
+            // Only 32-bit integer constants matter here, they size arrays.
+            if (operands[1] < reflector->bound) {
+                ids[operands[1]].opcode = opcode;
+                ids[operands[1]].operands[0] = operands[2];
+            }
+            break;
+        case NkSpirvOp_Variable: {
+            NkReflectorVariable* variable = reflector->variables + reflector->variableCount++;
+            variable->id = operands[1];
+            variable->storageClass = operands[2];
+            variable->type = ids[operands[0]].operands[1];
+            break;
+        }
+        }
+
+        word += length;
+    }
+
+    return NkTrue;
+}
+
+int main(int argc, char** argv) {
+
+    if (argc != 4) {
+        fprintf(stderr, "usage: ShaderReflector <shader binary> <header> <name>\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t size = 0;
+    uint8_t* code = nkReadFile(argv[1], &size);
+    if (code == NK_NULL || size % sizeof(uint32_t) != 0) {
+        fprintf(stderr, "ShaderReflector: '%s' is not a shader binary\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    char prefix[256];
+    snprintf(prefix, sizeof(prefix), "Nk%s", argv[3]);
+
+    NkReflector reflector;
+    memset(&reflector, 0, sizeof(reflector));
+    reflector.prefix = prefix;
+
+    if (!nkReflect(&reflector, NK_PTR_CAST(const uint32_t*, code), size / sizeof(uint32_t))) {
+        fprintf(stderr, "ShaderReflector: '%s' is not valid SPIR-V\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* out = fopen(argv[2], "w");
+    if (out == NK_NULL) {
+        fprintf(stderr, "ShaderReflector: couldn't open '%s' for writing\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    fputs("#pragma once\n\n#include <Neko/Neko.h>\n\n", out);
+    fputs("// Warning: this file was generated by ShaderReflector. Do not modify it!\n", out);
+    fprintf(out, "// This header contains the layouts reflected from %s\n\n", argv[1]);
+
+    for (uint32_t i = 0; i < reflector.variableCount; i++) {
+        const NkReflectorVariable* variable = reflector.variables + i;
+        const uint32_t storageClass = variable->storageClass;
+        if ((storageClass == NkSpirvStorageClass_Uniform || storageClass == NkSpirvStorageClass_StorageBuffer ||
+             storageClass == NkSpirvStorageClass_PushConstant) && reflector.ids[variable->type].opcode == NkSpirvOp_TypeStruct) {
+            nkWriteStruct(out, &reflector, variable->type);
+        }
+    }
+
+    nkWriteBindGroups(out, &reflector);
+
+    if (reflector.executionModel == NK_SPIRV_EXECUTION_MODEL_VERTEX) {
+        nkWriteVertexLayout(out, &reflector);
+    }
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "ShaderReflector: couldn't write '%s'\n", argv[2]);
+        remove(argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < reflector.bound; i++) {
+        NK_FREE(reflector.ids[i].members);
+    }
+    NK_FREE(reflector.ids);
+    NK_FREE(reflector.variables);
+    NK_FREE(code);
+
+    return EXIT_SUCCESS;
+}